@@ -27,8 +27,12 @@ private:
     Image* settingsButton;
     Image* collaborationButton;
     Image* extensionUploaderButton;
+    Text* statusText = nullptr; // how far a load or export has got
 
     bool wasPlaying = false;
+    std::string lastStatus;
+
+    std::string getStatus() const;
 };
 
 #include "Application.hpp"
@@ -283,6 +287,13 @@ void AppControls::init() {
             spacer(Modifier().setfixedWidth(16).align(Align::LEFT)),
             extensionUploaderButton,
             spacer(Modifier().setfixedWidth(16).align(Align::LEFT)),
+            statusText = text(
+                Modifier().align(Align::LEFT | Align::CENTER_Y).setfixedWidth(220).setfixedHeight(32)
+                    .setColor(app->resources.activeTheme->primary_text_color),
+                "",
+                app->resources.dejavuSansFont,
+                "status_text"
+            ),
             playButton,
             spacer(Modifier().setfixedWidth(16).align(Align::CENTER_X)),
             metronomeButton,
@@ -325,6 +336,13 @@ bool AppControls::handleEvents() {
     bool automationShown = app->readConfig<bool>("show_automation", false);
     sf::Color automationButtonBaseColor = automationShown ? baseMuteColor : baseButtonColor;
 
+    const std::string status = getStatus();
+    if (statusText && status != lastStatus) {
+        statusText->setString(status);
+        lastStatus = status;
+        forceUpdate = true;
+    }
+
     bool currentlyPlaying = app->isPlaying();
     if (currentlyPlaying != wasPlaying) {
         if (playButton) {
@@ -579,6 +597,22 @@ bool AppControls::handleEvents() {
     return forceUpdate;
 }
 
+std::string AppControls::getStatus() const {
+    if (app->isExporting()) {
+        const auto progress = app->getExportProgress();
+        return "Exporting " + std::to_string(static_cast<int>(progress.fraction * 100.0)) + "%";
+    }
+
+    const auto progress = app->getLoadProgress();
+    if (progress.reading) {
+        return "Reading project...";
+    }
+    if (progress.loading) {
+        return "Loading audio " + std::to_string(progress.clipsReady + progress.clipsFailed)
+             + "/" + std::to_string(progress.clipsTotal);
+    }
+    return "";
+}
 
 GET_INTERFACE
 DECLARE_PLUGIN(AppControls)
\ No newline at end of file
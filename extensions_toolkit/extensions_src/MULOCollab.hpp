@@ -28,23 +28,20 @@ private:
     
     std::string currentRoomName = "";
     std::string lastRoomName = "";
-    std::string lastEngineState = "";
     std::string lastStateHash = "";
-    std::string cachedStateString = "";
+    std::uint64_t lastSnapshotHash = 0;
     std::vector<std::string> participantsList;
     
     // State change batching
-    std::string pendingStateUpdate = "";
     std::chrono::steady_clock::time_point lastChangeTime;
     std::chrono::steady_clock::time_point joinTime;
-    std::chrono::steady_clock::time_point lastRemoteCheck;
+    std::chrono::steady_clock::time_point lastPublishTime;
     bool hasPendingUpdate = false;
     bool wasDragging = false;
     bool justJoinedRoom = false;
     bool automationDirty = false;
     static constexpr int UPDATE_DEBOUNCE_MS = 300;
-    static constexpr int REMOTE_CHECK_INTERVAL_MS = 8000;
-    static constexpr int FAST_CHECK_INTERVAL_MS = 2000;
+    static constexpr int PARAMETER_SYNC_MS = 1000;
 
     void showWindow();
     void hideWindow();
@@ -65,7 +62,6 @@ void MULOCollab::init() {
     resolution.size.y = app->getWindow().getSize().y / 1.2;
     windowView.setSize(static_cast<sf::Vector2f>(resolution.size));
     
-    lastRemoteCheck = std::chrono::steady_clock::now();
     lastChangeTime = std::chrono::steady_clock::now();
     hasPendingUpdate = false;
     wasDragging = false;
@@ -91,29 +87,19 @@ void MULOCollab::update() {
             justJoinedRoom = true;
             joinTime = std::chrono::steady_clock::now();
             hasPendingUpdate = false;
-            app->checkRoomEngineState(currentRoomName);
-            lastRemoteCheck = std::chrono::steady_clock::now();
         }
     }
     
     if (!currentRoomName.empty()) {
         auto now = std::chrono::steady_clock::now();
         
+        // Only says whether to publish; the session works out what changed
         std::string currentStateHash = app->getEngineStateHash();
         bool stateChanged = (currentStateHash != lastStateHash);
         
-        std::string currentEngineState;
         if (stateChanged) {
-            if (cachedStateString.empty() || currentStateHash != lastStateHash) {
-                currentEngineState = app->getEngineStateString();
-                cachedStateString = currentEngineState;
-            } else {
-                currentEngineState = cachedStateString;
-            }
-            pendingStateUpdate = currentEngineState;
             lastChangeTime = now;
             hasPendingUpdate = true;
-            lastEngineState = currentEngineState;
             lastStateHash = currentStateHash;
         }
         
@@ -154,10 +140,20 @@ void MULOCollab::update() {
             }
         }
         
-        if (shouldSendUpdate && hasPendingUpdate && !justJoinedRoom) {
-            app->updateRoomEngineState(currentRoomName, pendingStateUpdate);
+        // Parameter values are left out of the state hash, so now and then
+        // the collab snapshot is hashed too; automated values aren't in it,
+        // so playback alone never sends anything
+        auto timeSincePublish = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastPublishTime).count();
+        if (!hasPendingUpdate && !isDragging && !wasDragging && timeSincePublish >= PARAMETER_SYNC_MS) {
+            lastPublishTime = now;
+            shouldSendUpdate = app->getCollabSnapshotHash() != lastSnapshotHash;
+        }
+        
+        if (shouldSendUpdate && !justJoinedRoom) {
+            app->publishCollabChanges();
+            lastSnapshotHash = app->getCollabSnapshotHash();
             hasPendingUpdate = false;
-            pendingStateUpdate = "";
+            lastPublishTime = now;
         }
         
         if (justJoinedRoom) {
@@ -166,16 +162,9 @@ void MULOCollab::update() {
             }
         }
         
-        auto timeSinceLastCheck = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastRemoteCheck).count();
-        int checkInterval = REMOTE_CHECK_INTERVAL_MS;
-        
-        if (stateChanged) {
-            checkInterval = FAST_CHECK_INTERVAL_MS;
-        }
-        
-        if (timeSinceLastCheck > checkInterval) {
-            app->checkRoomEngineState(currentRoomName);
-            lastRemoteCheck = now;
+        // Ops arrive in the background and are cheap to apply, but not under a drag
+        if (!isDragging && !wasDragging) {
+            app->pollCollabChanges();
         }
     }
 
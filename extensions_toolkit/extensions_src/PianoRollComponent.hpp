@@ -638,7 +638,8 @@ void PianoRoll::handleNoteClick(int noteNumber, float xPosition, bool isRightCli
         deleteNoteAtTime(noteNumber, rawClipTime);
     } else {
         float noteDuration = getSubmeasureDuration();
-        selectedMIDIClip->addNote(noteNumber, 1.0f, timelineTime, noteDuration);
+        selectedMIDIClip->addNote(noteNumber, 1.0f, timelineTime, noteDuration, app->getBpm());
+        app->markMIDIClipChanged(selectedMIDIClip);
     }
 }
 
@@ -679,45 +680,45 @@ void PianoRoll::deleteNoteAtTime(int noteNumber, float timelineTime) {
     if (!selectedMIDIClip) return;
     
     juce::MidiBuffer newMidiData;
-    int sampleRate = 44100;
-    int targetSample = static_cast<int>(timelineTime * sampleRate);
+    const double bpm = app->getBpm();
+    int targetTick = MIDIClip::secondsToTicks(timelineTime, bpm);
     float submeasureDuration = getSubmeasureDuration();
     
-    int noteOnSampleToDelete = -1;
-    int noteOffSampleToDelete = -1;
+    int noteOnTickToDelete = -1;
+    int noteOffTickToDelete = -1;
     
     for (const auto& event : selectedMIDIClip->midiData) {
         const juce::MidiMessage& message = event.getMessage();
         if (message.isNoteOn() && message.getNoteNumber() == noteNumber) {
-            int noteOnSample = event.samplePosition;
-            int noteOffSample = noteOnSample + static_cast<int>(submeasureDuration * sampleRate);
+            int noteOnTick = event.samplePosition;
+            int noteOffTick = noteOnTick + MIDIClip::secondsToTicks(submeasureDuration, bpm);
             
             for (const auto& offEvent : selectedMIDIClip->midiData) {
                 const juce::MidiMessage& offMessage = offEvent.getMessage();
                 if (offMessage.isNoteOff() && 
                     offMessage.getNoteNumber() == noteNumber &&
-                    offEvent.samplePosition > noteOnSample) {
-                    noteOffSample = offEvent.samplePosition;
+                    offEvent.samplePosition > noteOnTick) {
+                    noteOffTick = offEvent.samplePosition;
                     break;
                 }
             }
             
-            const int tolerance = static_cast<int>(0.001f * sampleRate);
-            if (targetSample >= (noteOnSample - tolerance) && targetSample <= (noteOffSample + tolerance)) {
-                noteOnSampleToDelete = noteOnSample;
-                noteOffSampleToDelete = noteOffSample;
+            const int tolerance = MIDIClip::secondsToTicks(0.001, bpm);
+            if (targetTick >= (noteOnTick - tolerance) && targetTick <= (noteOffTick + tolerance)) {
+                noteOnTickToDelete = noteOnTick;
+                noteOffTickToDelete = noteOffTick;
                 break;
             }
         }
     }
     
-    if (noteOnSampleToDelete == -1) return;
+    if (noteOnTickToDelete == -1) return;
     
     for (const auto& event : selectedMIDIClip->midiData) {
         const juce::MidiMessage& message = event.getMessage();
         
-        if ((message.isNoteOn() && message.getNoteNumber() == noteNumber && event.samplePosition == noteOnSampleToDelete) ||
-            (message.isNoteOff() && message.getNoteNumber() == noteNumber && event.samplePosition == noteOffSampleToDelete)) {
+        if ((message.isNoteOn() && message.getNoteNumber() == noteNumber && event.samplePosition == noteOnTickToDelete) ||
+            (message.isNoteOff() && message.getNoteNumber() == noteNumber && event.samplePosition == noteOffTickToDelete)) {
             continue;
         }
         
@@ -725,6 +726,7 @@ void PianoRoll::deleteNoteAtTime(int noteNumber, float timelineTime) {
     }
     
     selectedMIDIClip->midiData = std::move(newMidiData);
+    app->markMIDIClipChanged(selectedMIDIClip);
 }
 
 int PianoRoll::getNoteNumberFromRowName(const std::string& noteName) const {
@@ -743,6 +745,7 @@ std::vector<std::shared_ptr<sf::Drawable>> PianoRoll::generateNoteRectsForRow(in
     if (!selectedMIDIClip || clipDuration <= 0.001f) return noteRects;
     
     const float pixelsPerSecond = getCurrentPixelsPerSecond();
+    const double bpm = app->getBpm();
         
     std::vector<std::pair<float, float>> noteSpans;
     
@@ -751,7 +754,7 @@ std::vector<std::shared_ptr<sf::Drawable>> PianoRoll::generateNoteRectsForRow(in
         
         if (message.isNoteOn() && message.getNoteNumber() == targetNoteNumber) {
             // Note time is relative to the clip (0 to clipDuration)
-            float noteStartTime = static_cast<float>(event.samplePosition) / 44100.0f;
+            float noteStartTime = static_cast<float>(MIDIClip::ticksToSeconds(event.samplePosition, bpm));
             if (noteStartTime < 0.0f || noteStartTime >= clipDuration) continue;
             
             float noteEndTime = noteStartTime + 0.25f;
@@ -761,7 +764,7 @@ std::vector<std::shared_ptr<sf::Drawable>> PianoRoll::generateNoteRectsForRow(in
                 if (offMessage.isNoteOff() && 
                     offMessage.getNoteNumber() == targetNoteNumber &&
                     offEvent.samplePosition > event.samplePosition) {
-                    noteEndTime = static_cast<float>(offEvent.samplePosition) / 44100.0f;
+                    noteEndTime = static_cast<float>(MIDIClip::ticksToSeconds(offEvent.samplePosition, bpm));
                     break;
                 }
             }
@@ -807,7 +810,8 @@ void PianoRoll::handleNoteDragStart(int noteNumber, float xPosition) {
     if (clipTime < 0.0f || clipTime >= clipDuration) return;
     
     float noteDuration = getSubmeasureDuration();
-    selectedMIDIClip->addNote(noteNumber, 1.0f, clipTime, noteDuration);
+    selectedMIDIClip->addNote(noteNumber, 1.0f, clipTime, noteDuration, app->getBpm());
+    app->markMIDIClipChanged(selectedMIDIClip);
     
     isDraggingNote = true;
     draggingNoteNumber = noteNumber;
@@ -839,29 +843,30 @@ void PianoRoll::handleNoteDragUpdate() {
     snappedEndTime = std::min(snappedEndTime, clipDuration);
     
     juce::MidiBuffer newMidiData;
-    int dragStartSample = static_cast<int>(dragStartTime * 44100.0f);
-    int newEndSample = static_cast<int>(snappedEndTime * 44100.0f);
+    const double bpm = app->getBpm();
+    int dragStartTick = MIDIClip::secondsToTicks(dragStartTime, bpm);
+    int newEndTick = MIDIClip::secondsToTicks(snappedEndTime, bpm);
     
     for (const auto& event : selectedMIDIClip->midiData) {
         const juce::MidiMessage& message = event.getMessage();
         
         if (message.isNoteOff() && 
             message.getNoteNumber() == draggingNoteNumber &&
-            event.samplePosition > dragStartSample) {
+            event.samplePosition > dragStartTick) {
             
             bool foundMatchingNoteOn = false;
             for (const auto& checkEvent : selectedMIDIClip->midiData) {
                 const juce::MidiMessage& checkMessage = checkEvent.getMessage();
                 if (checkMessage.isNoteOn() && 
                     checkMessage.getNoteNumber() == draggingNoteNumber &&
-                    std::abs(checkEvent.samplePosition - dragStartSample) < 1000) {
+                    std::abs(checkEvent.samplePosition - dragStartTick) < MIDIClip::secondsToTicks(0.02, bpm)) {
                     foundMatchingNoteOn = true;
                     break;
                 }
             }
             
             if (foundMatchingNoteOn) {
-                newMidiData.addEvent(message, newEndSample);
+                newMidiData.addEvent(message, newEndTick);
             } else {
                 newMidiData.addEvent(message, event.samplePosition);
             }
@@ -871,6 +876,7 @@ void PianoRoll::handleNoteDragUpdate() {
     }
 
     selectedMIDIClip->midiData = std::move(newMidiData);
+    app->markMIDIClipChanged(selectedMIDIClip);
     lastMeasureWidth = -1.0f;
     lastScrollOffset = -1.0f;
     lastRowSize = {-1.0f, -1.0f};
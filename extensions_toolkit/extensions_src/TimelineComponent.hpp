@@ -103,6 +103,7 @@ private:
         bool showVirtualCursor = false;
         std::chrono::steady_clock::time_point lastBlinkTime;
         bool virtualCursorVisible = true;
+        std::uint64_t waveformGeneration = 0; // WaveformPeaks generation last drawn
     } timelineState;
 
     struct DragState {
@@ -285,7 +286,7 @@ inline float secondsToXPosition(double bpm, float beatWidth, float seconds) noex
 
 inline std::vector<std::shared_ptr<sf::Drawable>> generateWaveformData(
     const AudioClip& clip, const sf::Vector2f& clipPosition, 
-    const sf::Vector2f& clipSize, float verticalOffset, 
+    const sf::Vector2f& clipSize, float visibleWidth, float verticalOffset, 
     UIResources* resources, UIState* uiState
 );
 
@@ -299,11 +300,8 @@ inline std::vector<std::shared_ptr<sf::Drawable>> generateTimelineMeasures(
 );
 
 inline float xPosToSeconds(double bpm, float beatWidth, float xPos, float scrollOffset) noexcept;
-inline std::unordered_map<std::string, std::vector<float>>& getWaveformCache();
-inline void ensureWaveformIsCached(const AudioClip& clip);
 inline void clearWaveformCache();
 inline double getSourceFileDuration(const AudioClip& clip);
-inline void invalidateClipWaveform(const AudioClip& clip);
 
 TimelineComponent::TimelineComponent() { 
     name = "timeline"; 
@@ -546,6 +544,13 @@ bool TimelineComponent::handleEvents() {
     if (app->freshRebuild) {
         rebuildUI();
     }
+
+    // Waveforms whose peaks finished building since the last frame
+    const std::uint64_t waveformGeneration = WaveformPeaks::getInstance().getGeneration();
+    if (waveformGeneration != timelineState.waveformGeneration) {
+        timelineState.waveformGeneration = waveformGeneration;
+        forceUpdate = true;
+    }
     
     return forceUpdate;
 }
@@ -2110,6 +2115,7 @@ void TimelineComponent::handleCustomUIElements() {
                     // Skipping MIDI clip position update because resize is active
                 } else {
                     dragState.draggedMIDIClip->startTime = newStartTime;
+                    app->markMIDIClipChanged(dragState.draggedMIDIClip);
                 }
             }
         } else {
@@ -2293,103 +2299,14 @@ void TimelineComponent::syncSlidersToEngine() {
     }
 }
 
-inline std::unordered_map<std::string, std::vector<float>>& getWaveformCache() {
-    static std::unordered_map<std::string, std::vector<float>> s_waveformCache;
-    return s_waveformCache;
-}
-
 inline void clearWaveformCache() {
-    auto& cache = getWaveformCache();
-    // Clear waveform cache
-    cache.clear();
-}
-
-inline void ensureWaveformIsCached(const AudioClip& clip) {
-    if (!clip.sourceFile.existsAsFile()) return;
-
-    auto& cache = getWaveformCache();
-    const std::string filePath = clip.sourceFile.getFullPathName().toStdString();
-    
-    if (cache.find(filePath) != cache.end()) return;
-
-    static thread_local juce::AudioFormatManager formatManager;
-    static thread_local bool initialized = false;
-    if (!initialized) {
-        formatManager.registerBasicFormats();
-        initialized = true;
-    }
-    
-    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(clip.sourceFile));
-    if (!reader) {
-        cache.emplace(filePath, std::vector<float>{});
-        return;
-    }
-
-    const long long totalSamples = reader->lengthInSamples;
-    if (totalSamples == 0) {
-        cache.emplace(filePath, std::vector<float>{});
-        return;
-    }
-    
-    constexpr float peakResolution = 0.05f;
-    const int desiredPeaks = std::max(1, static_cast<int>(std::ceil(clip.duration / peakResolution)));
-    const long long samplesPerPeak = std::max(1LL, totalSamples / desiredPeaks);
-
-    std::vector<float> peaks;
-    peaks.reserve(desiredPeaks);
-
-    const int bufferSize = static_cast<int>(std::min(samplesPerPeak, 8192LL));
-    juce::AudioBuffer<float> buffer(reader->numChannels, bufferSize);
-
-    for (int i = 0; i < desiredPeaks; ++i) {
-        const long long startSample = static_cast<long long>(i) * samplesPerPeak;
-        if (startSample >= totalSamples) break;
-
-        const int numSamplesToRead = static_cast<int>(
-            std::min(static_cast<long long>(bufferSize), 
-                    std::min(samplesPerPeak, totalSamples - startSample))
-        );
-        
-        reader->read(&buffer, 0, numSamplesToRead, startSample, true, true);
-
-        float maxAmplitude = 0.0f;
-        for (int channel = 0; channel < reader->numChannels; ++channel) {
-            const float channelMagnitude = buffer.getMagnitude(channel, 0, numSamplesToRead);
-            maxAmplitude = std::max(maxAmplitude, channelMagnitude);
-        }
-        peaks.emplace_back(maxAmplitude);
-    }
-
-    cache.emplace(filePath, std::move(peaks));
+    // Peaks are read back from their sidecars the next time they are drawn
+    WaveformPeaks::getInstance().clear();
 }
 
 inline double getSourceFileDuration(const AudioClip& clip) {
-    if (!clip.sourceFile.existsAsFile()) return 0.0;
-    
-    static thread_local juce::AudioFormatManager formatManager;
-    static thread_local bool initialized = false;
-    if (!initialized) {
-        formatManager.registerBasicFormats();
-        initialized = true;
-    }
-    
-    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(clip.sourceFile));
-    if (!reader) return 0.0;
-    
-    return reader->lengthInSamples / reader->sampleRate;
-}
-
-inline void invalidateClipWaveform(const AudioClip& clip) {
-    if (!clip.sourceFile.existsAsFile()) return;
-    
-    auto& cache = getWaveformCache();
-    const std::string filePath = clip.sourceFile.getFullPathName().toStdString();
-    
-    auto it = cache.find(filePath);
-    if (it != cache.end()) {
-        cache.erase(it);
-        // Invalidated cache for file
-    }
+    // Called on every mouse move of a clip resize; the header is read once
+    return AudioFileInfoCache::getInstance().getLengthInSeconds(clip.sourceFile);
 }
 
 inline std::vector<std::shared_ptr<sf::Drawable>> generateTimelineMeasures(
@@ -2528,6 +2445,7 @@ inline std::vector<std::shared_ptr<sf::Drawable>> generateClipRects(
             ac,
             sf::Vector2f(clipXPosition, 0.f),
             sf::Vector2f(clipWidthPixels, rowSize.y),
+            rowSize.x,
             verticalOffset,
             resources,
             uiState
@@ -2815,70 +2733,49 @@ inline float xPosToSeconds(double bpm, float beatWidth, float xPos, float scroll
 
 inline std::vector<std::shared_ptr<sf::Drawable>> generateWaveformData(
     const AudioClip& clip, const sf::Vector2f& clipPosition,
-    const sf::Vector2f& clipSize, float verticalOffset,
+    const sf::Vector2f& clipSize, float visibleWidth, float verticalOffset,
     UIResources* resources, UIState* uiState
 ) {
-    ensureWaveformIsCached(clip);
+    if (clipSize.x <= 0 || clip.duration <= 0) return {};
 
-    const auto& cache = getWaveformCache();
-    const std::string filePath = clip.sourceFile.getFullPathName().toStdString();
-    
-    auto cacheIt = cache.find(filePath);
-    if (cacheIt == cache.end()) return {};
-    
-    const auto& peaks = cacheIt->second;
-    if (peaks.empty() || clipSize.x <= 0) return {};
+    // Null until the file's peaks are built; handleEvents redraws once they are
+    const auto pyramid = WaveformPeaks::getInstance().get(clip.sourceFile);
+    if (!pyramid) return {};
 
-    constexpr float linesPerSecond = 100.0f;
     constexpr float waveformScale = 0.9f;
     constexpr float peakThreshold = 0.001f;
-    
-    const int numPeaks = static_cast<int>(peaks.size());
-    const double sourceFileDuration = getSourceFileDuration(clip);
-    
-    if (sourceFileDuration <= 0) return {};
-    
-    const int numLines = static_cast<int>(clip.duration * linesPerSecond);
-    if (numLines <= 0) return {};
-    
+
+    // One line per pixel column, for the columns of the clip that are on screen
+    const int firstColumn = std::max(0, static_cast<int>(std::floor(-clipPosition.x)));
+    const int endColumn = static_cast<int>(std::ceil(std::min(clipSize.x, visibleWidth - clipPosition.x)));
+    if (endColumn <= firstColumn) return {};
+
+    const double samplesPerPixel = clip.duration * pyramid->getSampleRate() / clipSize.x;
+    const int level = pyramid->chooseLevel(samplesPerPixel);
+    const double firstSample = clip.offset * pyramid->getSampleRate();
+
     sf::Color waveformColorWithAlpha = resources->activeTheme->wave_form_color;
     waveformColorWithAlpha.a = 180;
 
-    const float lineHeightScale = clipSize.y * waveformScale;
+    const float halfHeight = clipSize.y * waveformScale * 0.5f;
     const float baseLineY = clipPosition.y + clipSize.y * 0.5f + verticalOffset;
-    const float lineSpacing = clipSize.x / static_cast<float>(numLines);
 
     auto vertexArray = std::make_shared<sf::VertexArray>(sf::PrimitiveType::Lines);
-    vertexArray->resize(numLines * 2);
+    vertexArray->resize(static_cast<size_t>(endColumn - firstColumn) * 2);
 
     size_t vertexIndex = 0;
-    for (int i = 0; i < numLines; ++i) {
-        const double timeInClip = (static_cast<double>(i) / static_cast<double>(numLines)) * clip.duration;
-        const double timeInSource = clip.offset + timeInClip;
-        const double peakIndexFloat = (timeInSource / sourceFileDuration) * (numPeaks - 1);
-        const int peakIndex = static_cast<int>(peakIndexFloat);
-        const float frac = static_cast<float>(peakIndexFloat - peakIndex);
-        
-        if (peakIndex >= numPeaks) break;
-        
-        float peakValue = peaks[peakIndex];
-        if (peakIndex + 1 < numPeaks) {
-            peakValue = std::fma(peaks[peakIndex + 1] - peaks[peakIndex], frac, peaks[peakIndex]);
-        }
-        
-        if (peakValue > peakThreshold) {
-            const float lineHeight = peakValue * lineHeightScale;
-            const float lineX = clipPosition.x + i * lineSpacing;
-            const float lineYTop = baseLineY - lineHeight * 0.5f;
-            const float lineYBottom = baseLineY + lineHeight * 0.5f;
-            
-            if (vertexIndex + 1 < vertexArray->getVertexCount()) {
-                (*vertexArray)[vertexIndex].position = sf::Vector2f(lineX, lineYTop);
-                (*vertexArray)[vertexIndex].color = waveformColorWithAlpha;
-                (*vertexArray)[vertexIndex + 1].position = sf::Vector2f(lineX, lineYBottom);
-                (*vertexArray)[vertexIndex + 1].color = waveformColorWithAlpha;
-                vertexIndex += 2;
-            }
+    for (int column = firstColumn; column < endColumn; ++column) {
+        const auto startSample = static_cast<std::int64_t>(firstSample + column * samplesPerPixel);
+        const auto endSample = static_cast<std::int64_t>(firstSample + (column + 1) * samplesPerPixel);
+        const WaveformPeaks::Range range = pyramid->getRange(level, startSample, endSample);
+
+        if (range.max - range.min > peakThreshold) {
+            const float lineX = clipPosition.x + static_cast<float>(column);
+            (*vertexArray)[vertexIndex].position = sf::Vector2f(lineX, baseLineY - range.max * halfHeight);
+            (*vertexArray)[vertexIndex].color = waveformColorWithAlpha;
+            (*vertexArray)[vertexIndex + 1].position = sf::Vector2f(lineX, baseLineY - range.min * halfHeight);
+            (*vertexArray)[vertexIndex + 1].color = waveformColorWithAlpha;
+            vertexIndex += 2;
         }
     }
     
@@ -3666,7 +3563,6 @@ void TimelineComponent::updateDragState() {
                 if (std::abs(newDuration - selectedClip->duration) > 0.001) {
                     selectedClip->duration = newDuration;
                     selectedClipEnd = selectedClip->startTime + selectedClip->duration;
-                    invalidateClipWaveform(*selectedClip);
                     
                     timelineState.virtualCursorTime = selectedClip->startTime + selectedClip->duration;
                     timelineState.showVirtualCursor = true;
@@ -3725,7 +3621,6 @@ void TimelineComponent::updateDragState() {
                         selectedClip->duration = newDuration;
                         selectedClip->offset = newOffset;
                         selectedClipEnd = selectedClip->startTime + selectedClip->duration;
-                        invalidateClipWaveform(*selectedClip);
                     
                         timelineState.virtualCursorTime = selectedClip->startTime;
                         timelineState.showVirtualCursor = true;
@@ -3772,6 +3667,7 @@ void TimelineComponent::updateDragState() {
                     
                     if (std::abs(newDuration - selectedMIDIClip->duration) > 0.001) {
                         selectedMIDIClip->duration = newDuration;
+                        app->markMIDIClipChanged(selectedMIDIClip);
                         selectedMIDIClipInfo.duration = newDuration;
                         
                         timelineState.virtualCursorTime = selectedMIDIClip->startTime + selectedMIDIClip->duration;
@@ -3792,6 +3688,7 @@ void TimelineComponent::updateDragState() {
                     if (newDuration > 0.1 && newStartTime >= 0.0) {
                         selectedMIDIClip->startTime = newStartTime;
                         selectedMIDIClip->duration = newDuration;
+                        app->markMIDIClipChanged(selectedMIDIClip);
                         selectedMIDIClipInfo.startTime = newStartTime;
                         selectedMIDIClipInfo.duration = newDuration;
                         
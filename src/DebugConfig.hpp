@@ -4,6 +4,10 @@
 // Uncomment the line below to enable debug output
 // #define MULO_DEBUG
 
+// Uncomment to count heap allocations made on the audio thread
+// (see audio/AudioThreadAllocationGuard.hpp)
+// #define MULO_DEBUG_AUDIO_ALLOCATIONS
+
 #ifdef MULO_DEBUG
     #include <iostream>
     #include <iomanip>
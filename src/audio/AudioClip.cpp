@@ -1,5 +1,48 @@
 #include "AudioClip.hpp"
 
+#include <atomic>
+#include <type_traits>
+
+// std::vector only moves elements that can't throw; otherwise it copies them and streams are lost
+static_assert(std::is_nothrow_move_constructible_v<AudioClip>, "AudioClip moves must not throw");
+
+namespace {
+    std::atomic<double> streamingThresholdSeconds { 60.0 };
+}
+
+void AudioClip::setStreamingThreshold(double seconds) {
+    streamingThresholdSeconds.store(seconds, std::memory_order_relaxed);
+}
+
+double AudioClip::getStreamingThreshold() {
+    return streamingThresholdSeconds.load(std::memory_order_relaxed);
+}
+
+const juce::AudioBuffer<float>* AudioClip::getLoadedBuffer(double targetSampleRate) const {
+    if (stream) return nullptr;
+    // The newest request wins over whatever was loaded before it
+    if (pendingAudio && pendingSampleRate == targetSampleRate
+        && pendingAudio->ready.load(std::memory_order_acquire) && pendingAudio->buffer) {
+        return pendingAudio->buffer.get();
+    }
+    if (isLoaded && cachedSampleRate == targetSampleRate && preRenderedAudio) {
+        return preRenderedAudio.get();
+    }
+    return nullptr;
+}
+
+juce::int64 AudioClip::getNumLoadedSamples(double targetSampleRate) const {
+    if (stream) return stream->getLengthInSamples();
+    if (auto* buffer = getLoadedBuffer(targetSampleRate)) return buffer->getNumSamples();
+    return 0;
+}
+
+int AudioClip::getNumLoadedChannels(double targetSampleRate) const {
+    if (stream) return stream->getNumChannels();
+    if (auto* buffer = getLoadedBuffer(targetSampleRate)) return buffer->getNumChannels();
+    return 0;
+}
+
 AudioClip::AudioClip() : startTime(0.0), offset(0.0), duration(0.0), volume(1.0f), 
                         cachedSampleRate(0.0), isLoaded(false) {}
 
@@ -14,6 +57,7 @@ AudioClip::AudioClip(const AudioClip& other)
       duration(other.duration), 
       volume(other.volume),
       cachedSampleRate(0.0), isLoaded(false) {
+    shareAudioDataFrom(other);
 }
 
 AudioClip& AudioClip::operator=(const AudioClip& other) {
@@ -25,75 +69,118 @@ AudioClip& AudioClip::operator=(const AudioClip& other) {
         volume = other.volume;
         
         unloadAudioData();
+        shareAudioDataFrom(other);
     }
     return *this;
 }
 
+void AudioClip::shareAudioDataFrom(const AudioClip& other) const {
+    // Pooled audio is immutable, so a copy can use it as is. Streams carry a
+    // play cursor and are opened for the copy by requestAudioData instead.
+    if (other.isLoaded && other.preRenderedAudio) {
+        preRenderedAudio = other.preRenderedAudio;
+        cachedSampleRate = other.cachedSampleRate;
+        isLoaded = true;
+    }
+    
+    // A decode still in flight finishes for both copies
+    if (other.pendingAudio) {
+        pendingAudio = other.pendingAudio;
+        pendingSampleRate = other.pendingSampleRate;
+    }
+}
+
 void AudioClip::loadAudioData(juce::AudioFormatManager& formatManager, double targetSampleRate) const {
-    if (isLoaded && cachedSampleRate == targetSampleRate && preRenderedAudio != nullptr) {
+    if (pollAudioData(targetSampleRate)) {
         return;
     }
     
-    if (!cachedReader) {
-        cachedReader = std::unique_ptr<juce::AudioFormatReader>(
-            formatManager.createReaderFor(sourceFile));
+    // Drop a stream opened for a different rate first so its file handle is released
+    stream.reset();
+    
+    // Long clips stream from disk; the stream takes over the reader
+    const double threshold = getStreamingThreshold();
+    if (threshold > 0.0 && duration > threshold) {
         if (!cachedReader) {
-            return;
+            cachedReader = std::unique_ptr<juce::AudioFormatReader>(
+                formatManager.createReaderFor(sourceFile));
+            if (!cachedReader) {
+                return;
+            }
         }
+        
+        preRenderedAudio.reset();
+        stream = std::make_unique<AudioClipStream>(std::move(cachedReader), offset, duration, targetSampleRate);
+        cachedSampleRate = targetSampleRate;
+        isLoaded = true;
+        return;
     }
     
-    double sourceSampleRate = cachedReader->sampleRate;
-    
-    juce::int64 sourceStartSample = static_cast<juce::int64>(offset * sourceSampleRate);
-    juce::int64 sourceEndSample = static_cast<juce::int64>((offset + duration) * sourceSampleRate);
-    juce::int64 numSourceSamples = sourceEndSample - sourceStartSample;
+    preRenderedAudio = SamplePool::getInstance().acquire(sourceFile, offset, duration, targetSampleRate);
+    if (!preRenderedAudio) {
+        isLoaded = false;
+        return;
+    }
     
-    if (numSourceSamples <= 0) {
+    cachedSampleRate = targetSampleRate;
+    isLoaded = true;
+}
+
+void AudioClip::requestAudioData(juce::AudioFormatManager& formatManager, double targetSampleRate) const {
+    if (pollAudioData(targetSampleRate)) {
         return;
     }
     
-    juce::AudioBuffer<float> sourceBuffer(cachedReader->numChannels, (int)numSourceSamples);
-    sourceBuffer.clear();
-    cachedReader->read(&sourceBuffer, 0, (int)numSourceSamples, sourceStartSample, true, true);
+    // Opening a stream is cheap, the disk thread does the rest
+    const double threshold = getStreamingThreshold();
+    if (threshold > 0.0 && duration > threshold) {
+        loadAudioData(formatManager, targetSampleRate);
+        return;
+    }
     
-    if (std::abs(sourceSampleRate - targetSampleRate) > 0.1) {
-        double ratio = targetSampleRate / sourceSampleRate;
-        int numOutputSamples = static_cast<int>(numSourceSamples * ratio + 0.5);
-        
-        preRenderedAudio = std::make_unique<juce::AudioBuffer<float>>(cachedReader->numChannels, numOutputSamples);
-        preRenderedAudio->clear();
-        
-        for (int ch = 0; ch < sourceBuffer.getNumChannels(); ++ch) {
-            const float* inputData = sourceBuffer.getReadPointer(ch);
-            float* outputData = preRenderedAudio->getWritePointer(ch);
-            
-            for (int i = 0; i < numOutputSamples; ++i) {
-                double sourcePos = (double)i / ratio;
-                int baseIndex = (int)sourcePos;
-                double fraction = sourcePos - baseIndex;
-                
-                if (baseIndex >= 0 && baseIndex < numSourceSamples - 1) {
-                    float y0 = inputData[baseIndex];
-                    float y1 = inputData[baseIndex + 1];
-                    outputData[i] = y0 + (float)fraction * (y1 - y0);
-                } else if (baseIndex >= 0 && baseIndex < numSourceSamples) {
-                    outputData[i] = inputData[baseIndex];
-                } else {
-                    outputData[i] = 0.0f;
-                }
-            }
-        }
-    } else {
-        preRenderedAudio = std::make_unique<juce::AudioBuffer<float>>(sourceBuffer);
+    if (pendingAudio && pendingSampleRate == targetSampleRate) {
+        return;
     }
     
-    cachedSampleRate = targetSampleRate;
-    isLoaded = true;
+    pendingAudio = SamplePool::getInstance().request(sourceFile, offset, duration, targetSampleRate);
+    pendingSampleRate = targetSampleRate;
+}
+
+bool AudioClip::pollAudioData(double targetSampleRate) const {
+    // Reads only: the finished decode is used where it lies rather than moved
+    // into preRenderedAudio, so no buffer reference is taken or dropped here
+    if (stream) {
+        return isLoaded && cachedSampleRate == targetSampleRate;
+    }
+    return getLoadedBuffer(targetSampleRate) != nullptr;
+}
+
+bool AudioClip::isAudioDataLoaded() const {
+    if (stream) {
+        return isLoaded;
+    }
+    return (isLoaded && preRenderedAudio != nullptr)
+        || (pendingAudio && pendingAudio->ready.load(std::memory_order_acquire) && pendingAudio->buffer);
+}
+
+bool AudioClip::isAudioPending() const {
+    return pendingAudio && !pendingAudio->ready.load(std::memory_order_acquire);
+}
+
+bool AudioClip::hasAudioFailed() const {
+    if (pendingAudio) {
+        return pendingAudio->ready.load(std::memory_order_acquire) && !pendingAudio->buffer;
+    }
+    // Loaded synchronously or streaming; only this thread sets these then
+    return !isLoaded && stream == nullptr;
 }
 
 void AudioClip::unloadAudioData() const {
     cachedReader.reset();
     preRenderedAudio.reset();
+    stream.reset();
+    pendingAudio.reset();
+    pendingSampleRate = 0.0;
     isLoaded = false;
     cachedSampleRate = 0.0;
 }
\ No newline at end of file
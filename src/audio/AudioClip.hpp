@@ -5,6 +5,9 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <memory>
 
+#include "AudioClipStream.hpp"
+#include "SamplePool.hpp"
+
 struct AudioClip {
     juce::File sourceFile;
     double startTime;
@@ -13,17 +16,52 @@ struct AudioClip {
     float volume;
     
     mutable std::unique_ptr<juce::AudioFormatReader> cachedReader;
-    mutable std::unique_ptr<juce::AudioBuffer<float>> preRenderedAudio;
+    mutable SamplePool::SharedBuffer preRenderedAudio; // shared with every clip over the same range
+    mutable std::unique_ptr<AudioClipStream> stream;
+    mutable SamplePool::PendingHandle pendingAudio; // background decode started by requestAudioData
+    mutable double pendingSampleRate = 0.0;
     mutable double cachedSampleRate = 0.0;
     mutable bool isLoaded = false;
 
     AudioClip();
     AudioClip(const juce::File& sourceFile, double startTime, double offset, double duration, float volume = 1.f);
+    // Copies share pooled audio but not a stream, which carries its own
+    // play cursor; they get one when the track requests their audio.
+    // Moves keep everything, so a clip vector can grow or shift without
+    // silencing the streaming clips in it.
     AudioClip(const AudioClip& other);
     AudioClip& operator=(const AudioClip& other);
+    AudioClip(AudioClip&& other) noexcept = default;
+    AudioClip& operator=(AudioClip&& other) noexcept = default;
     
-    // Cache management
+    // Cache management. Everything that changes the clip's audio runs on the
+    // message thread, before the clip is published to the audio thread or
+    // under the device's callback lock; the audio thread only ever reads it.
     void loadAudioData(juce::AudioFormatManager& formatManager, double targetSampleRate) const;
+    // Starts decoding in the background and returns at once; the audio
+    // thread reads the result straight out of pendingAudio once it is ready
+    void requestAudioData(juce::AudioFormatManager& formatManager, double targetSampleRate) const;
+    // Audio-thread safe: never blocks, allocates or writes. True once audio is ready at targetSampleRate
+    bool pollAudioData(double targetSampleRate) const;
     void unloadAudioData() const;
-    bool isAudioDataLoaded() const { return isLoaded && preRenderedAudio != nullptr; }
+    void shareAudioDataFrom(const AudioClip& other) const;
+    bool isAudioDataLoaded() const;
+    // Pending while a background decode is still running; failed once the
+    // last load finished without producing any audio
+    bool isAudioPending() const;
+    bool hasAudioFailed() const;
+
+    // Clips longer than the threshold stream from disk instead of being
+    // pre-rendered into memory. A threshold of 0 or less turns streaming off.
+    static void setStreamingThreshold(double seconds);
+    static double getStreamingThreshold();
+    bool isStreaming() const { return stream != nullptr; }
+
+    // The decoded audio at the target rate, from a finished background decode
+    // or preRenderedAudio; nullptr for streaming clips and audio not ready yet
+    const juce::AudioBuffer<float>* getLoadedBuffer(double targetSampleRate) const;
+    // Length and channel count of the loaded audio at the target rate, from
+    // whichever of the decoded audio or stream is active
+    juce::int64 getNumLoadedSamples(double targetSampleRate) const;
+    int getNumLoadedChannels(double targetSampleRate) const;
 };
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "AudioClipStream.hpp"
+#include "../DebugConfig.hpp"
+
+#include <cmath>
+
+namespace {
+    // Samples read per clip per pass, so one busy clip cannot starve the others
+    constexpr int fillChunkSamples = 8192;
+}
+
+AudioClipStream::AudioClipStream(std::unique_ptr<juce::AudioFormatReader> sourceReader,
+                                 double offsetSeconds, double durationSeconds, double rate)
+    : reader(std::move(sourceReader)),
+      numChannels(reader ? static_cast<int>(reader->numChannels) : 0),
+      targetSampleRate(rate),
+      sourceSamplesPerOutputSample(reader ? reader->sampleRate / rate : 1.0),
+      needsResampling(reader && std::abs(reader->sampleRate - rate) > 0.1),
+      sourceStartSample(reader ? static_cast<juce::int64>(offsetSeconds * reader->sampleRate) : 0),
+      fifo(juce::roundToInt(readAheadSeconds * rate) + 1) {
+    if (reader) {
+        // Same length the pre-rendered path would produce
+        const auto sourceEndSample = static_cast<juce::int64>((offsetSeconds + durationSeconds) * reader->sampleRate);
+        const auto numSourceSamples = sourceEndSample - sourceStartSample;
+        lengthInSamples = needsResampling
+            ? static_cast<juce::int64>(numSourceSamples / sourceSamplesPerOutputSample + 0.5)
+            : numSourceSamples;
+        lengthInSamples = juce::jmax<juce::int64>(0, lengthInSamples);
+    }
+
+    ring.setSize(juce::jmax(1, numChannels), fifo.getTotalSize());
+    ring.clear();
+    interpolators.resize(static_cast<size_t>(numChannels));
+
+    AudioClipStreamer::getInstance().addStream(this);
+}
+
+AudioClipStream::~AudioClipStream() {
+    AudioClipStreamer::getInstance().removeStream(this);
+}
+
+void AudioClipStream::read(juce::AudioBuffer<float>& dest, juce::int64 position, int numSamples) {
+    if (seekPending.load(std::memory_order_acquire)) {
+        // Keep moving the target along with the playhead until the reader catches up
+        requestedPosition.store(position + numSamples, std::memory_order_release);
+        dest.clear(0, numSamples);
+        return;
+    }
+
+    if (awaitingSeek) {
+        nextReadPosition = fifoStartPosition.load(std::memory_order_relaxed);
+        awaitingSeek = false;
+    }
+
+    if (position != nextReadPosition) {
+        const auto skip = position - nextReadPosition;
+        if (skip > 0 && skip < fifo.getNumReady()) {
+            fifo.finishedRead(static_cast<int>(skip));
+            nextReadPosition = position;
+        } else {
+            requestSeek(position + numSamples);
+            dest.clear(0, numSamples);
+            return;
+        }
+    }
+
+    const int numAvailable = juce::jmin(numSamples, fifo.getNumReady());
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(numAvailable, start1, size1, start2, size2);
+
+    const int numDestChannels = juce::jmin(dest.getNumChannels(), numChannels);
+    for (int ch = 0; ch < numDestChannels; ++ch) {
+        if (size1 > 0) dest.copyFrom(ch, 0, ring, ch, start1, size1);
+        if (size2 > 0) dest.copyFrom(ch, size1, ring, ch, start2, size2);
+    }
+    fifo.finishedRead(size1 + size2);
+    nextReadPosition += size1 + size2;
+
+    if (numAvailable < numSamples) {
+        dest.clear(numAvailable, numSamples - numAvailable);
+        if (nextReadPosition < lengthInSamples) {
+            underruns.fetch_add(1, std::memory_order_relaxed);
+            requestSeek(position + numSamples);
+        }
+    }
+}
+
+void AudioClipStream::cue(juce::int64 position) {
+    position = juce::jlimit<juce::int64>(0, lengthInSamples, position);
+    const auto cuedPosition = awaitingSeek ? requestedPosition.load(std::memory_order_relaxed) : nextReadPosition;
+    if (position != cuedPosition) {
+        requestSeek(position);
+    }
+}
+
+void AudioClipStream::requestSeek(juce::int64 position) {
+    requestedPosition.store(position, std::memory_order_release);
+    awaitingSeek = true;
+    seekPending.store(true, std::memory_order_release);
+}
+
+bool AudioClipStream::service(juce::AudioBuffer<float>& sourceScratch) {
+    if (!reader) {
+        return false;
+    }
+
+    if (seekPending.load(std::memory_order_acquire)) {
+        // The audio thread leaves the fifo alone until seekPending is cleared
+        const auto target = juce::jlimit<juce::int64>(0, lengthInSamples, requestedPosition.load(std::memory_order_acquire));
+        fifo.reset();
+        writePosition = target;
+        sourceReadPosition = sourceStartSample + static_cast<juce::int64>(static_cast<double>(target) * sourceSamplesPerOutputSample);
+        for (auto& interpolator : interpolators) {
+            interpolator.reset();
+        }
+
+        fill(sourceScratch, fillChunkSamples);
+
+        fifoStartPosition.store(target, std::memory_order_relaxed);
+        seekPending.store(false, std::memory_order_release);
+        return true;
+    }
+
+    return fill(sourceScratch, fillChunkSamples) > 0;
+}
+
+int AudioClipStream::fill(juce::AudioBuffer<float>& sourceScratch, int maxSamples) {
+    const int numToWrite = static_cast<int>(juce::jmin<juce::int64>(juce::jmin(maxSamples, fifo.getFreeSpace()),
+                                                                    lengthInSamples - writePosition));
+    if (numToWrite <= 0) {
+        return 0;
+    }
+
+    const int numSourceSamples = needsResampling
+        ? static_cast<int>(std::ceil(numToWrite * sourceSamplesPerOutputSample)) + 2
+        : numToWrite;
+
+    if (sourceScratch.getNumChannels() < numChannels || sourceScratch.getNumSamples() < numSourceSamples) {
+        sourceScratch.setSize(juce::jmax(numChannels, sourceScratch.getNumChannels()),
+                              juce::jmax(numSourceSamples, sourceScratch.getNumSamples()),
+                              false, false, true);
+    }
+
+    juce::AudioBuffer<float> source(sourceScratch.getArrayOfWritePointers(), numChannels, numSourceSamples);
+    reader->read(&source, 0, numSourceSamples, sourceReadPosition, true, true);
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(numToWrite, start1, size1, start2, size2);
+
+    int numSourceSamplesUsed = size1 + size2;
+    for (int ch = 0; ch < numChannels; ++ch) {
+        const float* input = source.getReadPointer(ch);
+
+        if (needsResampling) {
+            // Every channel's interpolator advances identically, so any channel's count will do
+            auto& interpolator = interpolators[static_cast<size_t>(ch)];
+            int used = 0;
+            if (size1 > 0) used += interpolator.process(sourceSamplesPerOutputSample, input, ring.getWritePointer(ch, start1), size1);
+            if (size2 > 0) used += interpolator.process(sourceSamplesPerOutputSample, input + used, ring.getWritePointer(ch, start2), size2);
+            numSourceSamplesUsed = used;
+        } else {
+            if (size1 > 0) ring.copyFrom(ch, start1, input, size1);
+            if (size2 > 0) ring.copyFrom(ch, start2, input + size1, size2);
+        }
+    }
+
+    fifo.finishedWrite(size1 + size2);
+    writePosition += size1 + size2;
+    sourceReadPosition += numSourceSamplesUsed;
+    return size1 + size2;
+}
+
+AudioClipStreamer::AudioClipStreamer() : juce::Thread("MULO Disk Reader") {}
+
+AudioClipStreamer::~AudioClipStreamer() {
+    stopThread(2000);
+}
+
+void AudioClipStreamer::addStream(AudioClipStream* stream) {
+    const juce::ScopedLock lock(streamsLock);
+    streams.addIfNotAlreadyThere(stream);
+
+    if (!isThreadRunning()) {
+        startThread(juce::Thread::Priority::high);
+        DEBUG_PRINT("[AudioClipStreamer] Disk reader started");
+    }
+}
+
+void AudioClipStreamer::removeStream(AudioClipStream* stream) {
+    // Holding the lock guarantees the disk thread is not inside this stream
+    const juce::ScopedLock lock(streamsLock);
+    streams.removeFirstMatchingValue(stream);
+}
+
+void AudioClipStreamer::run() {
+    while (!threadShouldExit()) {
+        bool didWork = false;
+        {
+            const juce::ScopedLock lock(streamsLock);
+            for (auto* stream : streams) {
+                didWork = stream->service(sourceScratch) || didWork;
+            }
+        }
+
+        if (!didWork) {
+            wait(5);
+        }
+    }
+}
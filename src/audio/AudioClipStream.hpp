@@ -0,0 +1,101 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// AudioClipStream - plays a long clip straight from disk instead of decoding
+// it into memory. The shared AudioClipStreamer thread keeps a small ring
+// buffer per clip topped up ahead of the play position, so resident memory
+// is bounded by the read-ahead rather than by the clip length.
+class AudioClipStream {
+public:
+    // Seconds of audio buffered ahead of the play position, per clip
+    static constexpr double readAheadSeconds = 2.0;
+
+    AudioClipStream(std::unique_ptr<juce::AudioFormatReader> reader,
+                    double offsetSeconds, double durationSeconds, double targetSampleRate);
+    ~AudioClipStream();
+
+    int getNumChannels() const { return numChannels; }
+    juce::int64 getLengthInSamples() const { return lengthInSamples; }
+    double getTargetSampleRate() const { return targetSampleRate; }
+    juce::uint64 getUnderrunCount() const { return underruns.load(std::memory_order_relaxed); }
+
+    // Audio thread only. Fills dest with numSamples starting at clip sample
+    // `position` (at the target rate). Whatever the disk thread has not read
+    // yet, e.g. right after a jump, comes out as silence.
+    void read(juce::AudioBuffer<float>& dest, juce::int64 position, int numSamples);
+
+    // Has the disk thread start filling from `position` before playback gets
+    // there, so the first blocks after a play or seek aren't silent. Does
+    // nothing if the stream is already there or on its way. Message thread,
+    // with the audio callback locked so read() isn't running.
+    void cue(juce::int64 position);
+    // False while the disk thread is still refilling after a cue or a jump
+    bool isCued() const { return !seekPending.load(std::memory_order_acquire); }
+
+private:
+    friend class AudioClipStreamer;
+
+    // Disk thread only. Handles a pending seek and tops the ring up.
+    // Returns true if anything was read.
+    bool service(juce::AudioBuffer<float>& sourceScratch);
+    int fill(juce::AudioBuffer<float>& sourceScratch, int maxSamples);
+    void requestSeek(juce::int64 position);
+
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    const int numChannels;
+    const double targetSampleRate;
+    const double sourceSamplesPerOutputSample;
+    const bool needsResampling;
+    const juce::int64 sourceStartSample;
+    juce::int64 lengthInSamples = 0;
+
+    juce::AbstractFifo fifo;
+    juce::AudioBuffer<float> ring;
+
+    // Handshake: while seekPending is set only the disk thread touches the fifo
+    std::atomic<bool> seekPending { true };
+    std::atomic<juce::int64> requestedPosition { 0 };
+    std::atomic<juce::int64> fifoStartPosition { 0 };
+    std::atomic<juce::uint64> underruns { 0 };
+
+    // Audio thread only
+    juce::int64 nextReadPosition = 0;
+    bool awaitingSeek = true;
+
+    // Disk thread only
+    juce::int64 writePosition = 0;
+    juce::int64 sourceReadPosition = 0;
+    std::vector<juce::Interpolators::Linear> interpolators;
+};
+
+// AudioClipStreamer - the single background thread that services every
+// AudioClipStream. Started on first use.
+class AudioClipStreamer : private juce::Thread {
+public:
+    static AudioClipStreamer& getInstance() {
+        static AudioClipStreamer instance;
+        return instance;
+    }
+
+    void addStream(AudioClipStream* stream);
+    void removeStream(AudioClipStream* stream);
+
+private:
+    AudioClipStreamer();
+    ~AudioClipStreamer() override;
+    AudioClipStreamer(const AudioClipStreamer&) = delete;
+    AudioClipStreamer& operator=(const AudioClipStreamer&) = delete;
+
+    void run() override;
+
+    juce::CriticalSection streamsLock;
+    juce::Array<AudioClipStream*> streams;
+    juce::AudioBuffer<float> sourceScratch;
+};
@@ -0,0 +1,78 @@
+#include "AudioFileInfoCache.hpp"
+
+#include <memory>
+
+AudioFileInfoCache::AudioFileInfoCache() {
+    formatManager.registerBasicFormats();
+}
+
+AudioFileInfo AudioFileInfoCache::get(const juce::File& file) {
+    const std::string key = file.getFullPathName().toStdString();
+    if (key.empty()) return {};
+
+    const juce::uint32 now = juce::Time::getMillisecondCounter();
+    {
+        const juce::ScopedLock sl(lock);
+        auto entry = entries.find(key);
+        if (entry != entries.end() && now - entry->second.lastChecked < recheckIntervalMs) {
+            return entry->second.info;
+        }
+    }
+
+    // Stat'ed and read outside the lock, so a slow disk only holds up its own caller
+    const std::int64_t fileSize = file.getSize();
+    const std::int64_t modificationTime = file.getLastModificationTime().toMilliseconds();
+
+    AudioFileInfo info;
+    bool unchanged = false;
+    {
+        const juce::ScopedLock sl(lock);
+        auto entry = entries.find(key);
+        if (entry != entries.end() && entry->second.info.fileSize == fileSize
+            && entry->second.info.modificationTime == modificationTime) {
+            entry->second.lastChecked = now;
+            info = entry->second.info;
+            unchanged = true;
+        }
+    }
+    if (unchanged) return info;
+
+    info = readInfo(file);
+    info.fileSize = fileSize;
+    info.modificationTime = modificationTime;
+
+    const juce::ScopedLock sl(lock);
+    entries[key] = { info, now };
+    return info;
+}
+
+double AudioFileInfoCache::getLengthInSeconds(const juce::File& file, double fallback) {
+    const AudioFileInfo info = get(file);
+    return info.valid && info.sampleRate > 0.0 ? info.getLengthInSeconds() : fallback;
+}
+
+void AudioFileInfoCache::invalidate(const juce::File& file) {
+    const juce::ScopedLock sl(lock);
+    entries.erase(file.getFullPathName().toStdString());
+}
+
+void AudioFileInfoCache::clear() {
+    const juce::ScopedLock sl(lock);
+    entries.clear();
+}
+
+AudioFileInfo AudioFileInfoCache::readInfo(const juce::File& file) {
+    AudioFileInfo info;
+    if (!file.existsAsFile()) return info;
+
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (!reader) return info;
+
+    info.valid = true;
+    info.sampleRate = reader->sampleRate;
+    info.lengthInSamples = reader->lengthInSamples;
+    info.numChannels = static_cast<int>(reader->numChannels);
+    info.bitsPerSample = static_cast<int>(reader->bitsPerSample);
+    info.formatName = reader->getFormatName().toStdString();
+    return info;
+}
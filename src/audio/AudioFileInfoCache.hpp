@@ -0,0 +1,65 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// What an audio file's header says, and the file it was read from
+struct AudioFileInfo {
+    bool valid = false; // false if the file is missing or no format reads it
+    double sampleRate = 0.0;
+    std::int64_t lengthInSamples = 0;
+    int numChannels = 0;
+    int bitsPerSample = 0;
+    std::string formatName;
+    std::int64_t fileSize = 0;
+    std::int64_t modificationTime = 0; // ms since the epoch
+
+    double getLengthInSeconds() const {
+        return sampleRate > 0.0 ? static_cast<double>(lengthInSamples) / sampleRate : 0.0;
+    }
+};
+
+// AudioFileInfoCache - process-wide cache of audio file headers, keyed by
+// path. A header is read once; after that the file is only stat'ed, at most
+// once per recheck interval, and read again if its size or modification
+// time has changed. Safe to call from any thread but the audio thread.
+class AudioFileInfoCache {
+public:
+    static constexpr juce::uint32 recheckIntervalMs = 1000;
+
+    static AudioFileInfoCache& getInstance() {
+        static AudioFileInfoCache instance;
+        return instance;
+    }
+
+    AudioFileInfo get(const juce::File& file);
+
+    // The file's length, or `fallback` if it can't be read
+    double getLengthInSeconds(const juce::File& file, double fallback = 0.0);
+
+    // Reads the file's header again on the next get(), e.g. after writing it
+    void invalidate(const juce::File& file);
+    void clear();
+
+private:
+    AudioFileInfoCache();
+    AudioFileInfoCache(const AudioFileInfoCache&) = delete;
+    AudioFileInfoCache& operator=(const AudioFileInfoCache&) = delete;
+
+    struct Entry {
+        AudioFileInfo info;
+        juce::uint32 lastChecked = 0; // juce::Time::getMillisecondCounter
+    };
+
+    AudioFileInfo readInfo(const juce::File& file);
+
+    juce::CriticalSection lock;
+    std::unordered_map<std::string, Entry> entries;
+
+    // Its own readers, so callers on any thread never share an engine's
+    juce::AudioFormatManager formatManager;
+};
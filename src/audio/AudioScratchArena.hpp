@@ -0,0 +1,52 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <vector>
+
+// AudioScratchArena - a fixed set of scratch buffers sized once in
+// prepareToPlay. The audio thread borrows them as referencing views,
+// so building a temporary buffer in the callback never touches the heap.
+class AudioScratchArena {
+public:
+    void prepare(int numChannels, int maxSamples, int numSlots) {
+        numChannels = juce::jmax(1, numChannels);
+        maxSamples = juce::jmax(1, maxSamples);
+
+        if (static_cast<int>(slots.size()) < numSlots) {
+            slots.resize(static_cast<size_t>(numSlots));
+        }
+
+        for (auto& slot : slots) {
+            if (slot.getNumChannels() < numChannels || slot.getNumSamples() < maxSamples) {
+                slot.setSize(juce::jmax(numChannels, slot.getNumChannels()),
+                             juce::jmax(maxSamples, slot.getNumSamples()),
+                             false, true, true);
+            }
+        }
+    }
+
+    // Returns a cleared view onto the given slot. Only grows (and allocates)
+    // when a caller asks for more than prepare() reserved.
+    juce::AudioBuffer<float> get(int slotIndex, int numChannels, int numSamples) {
+        if (slotIndex >= static_cast<int>(slots.size())) {
+            slots.resize(static_cast<size_t>(slotIndex + 1));
+        }
+
+        auto& slot = slots[static_cast<size_t>(slotIndex)];
+        if (slot.getNumChannels() < numChannels || slot.getNumSamples() < numSamples) {
+            slot.setSize(juce::jmax(numChannels, slot.getNumChannels()),
+                         juce::jmax(numSamples, slot.getNumSamples()),
+                         false, false, true);
+        }
+
+        juce::AudioBuffer<float> view(slot.getArrayOfWritePointers(), numChannels, numSamples);
+        view.clear();
+        return view;
+    }
+
+    int getNumSlots() const { return static_cast<int>(slots.size()); }
+
+private:
+    std::vector<juce::AudioBuffer<float>> slots;
+};
@@ -0,0 +1,86 @@
+#include "AudioThreadAllocationGuard.hpp"
+
+#ifdef MULO_DEBUG_AUDIO_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#include <new>
+
+namespace {
+    thread_local int audioScopeDepth = 0;
+    std::atomic<std::uint64_t> allocationCount { 0 };
+    std::atomic<std::uint64_t> largestAllocation { 0 };
+
+    void recordAllocation(std::size_t size) {
+        if (audioScopeDepth <= 0) {
+            return;
+        }
+
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+        auto largest = largestAllocation.load(std::memory_order_relaxed);
+        while (size > largest && !largestAllocation.compare_exchange_weak(largest, size, std::memory_order_relaxed)) {}
+    }
+
+    void* allocate(std::size_t size) {
+        recordAllocation(size);
+        if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+            return ptr;
+        }
+        throw std::bad_alloc();
+    }
+
+    void* allocateAligned(std::size_t size, std::align_val_t alignment) {
+        recordAllocation(size);
+        const auto align = static_cast<std::size_t>(alignment);
+        const auto rounded = ((size == 0 ? 1 : size) + align - 1) / align * align;
+#ifdef _WIN32
+        if (void* ptr = _aligned_malloc(rounded, align)) {
+            return ptr;
+        }
+#else
+        if (void* ptr = std::aligned_alloc(align, rounded)) {
+            return ptr;
+        }
+#endif
+        throw std::bad_alloc();
+    }
+
+    void freeAligned(void* ptr) {
+#ifdef _WIN32
+        _aligned_free(ptr);
+#else
+        std::free(ptr);
+#endif
+    }
+}
+
+namespace AudioThreadAllocationGuard {
+    void enterAudioThreadScope() { ++audioScopeDepth; }
+    void exitAudioThreadScope() { --audioScopeDepth; }
+    std::uint64_t getAllocationCount() { return allocationCount.load(std::memory_order_relaxed); }
+    std::uint64_t getLargestAllocation() { return largestAllocation.load(std::memory_order_relaxed); }
+    void resetCounters() {
+        allocationCount.store(0, std::memory_order_relaxed);
+        largestAllocation.store(0, std::memory_order_relaxed);
+    }
+}
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { freeAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { freeAligned(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { freeAligned(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { freeAligned(ptr); }
+
+#endif
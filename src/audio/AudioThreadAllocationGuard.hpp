@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../DebugConfig.hpp"
+
+#include <cstdint>
+
+// Debug aid for the allocation-free audio path. With MULO_DEBUG_AUDIO_ALLOCATIONS
+// defined, global operator new counts every allocation made while a
+// ScopedAudioThreadAllocationCheck is alive on the current thread.
+// Without it the guard compiles away to nothing.
+namespace AudioThreadAllocationGuard {
+
+#ifdef MULO_DEBUG_AUDIO_ALLOCATIONS
+    void enterAudioThreadScope();
+    void exitAudioThreadScope();
+    std::uint64_t getAllocationCount();
+    std::uint64_t getLargestAllocation();
+    void resetCounters();
+#else
+    inline void enterAudioThreadScope() {}
+    inline void exitAudioThreadScope() {}
+    inline std::uint64_t getAllocationCount() { return 0; }
+    inline std::uint64_t getLargestAllocation() { return 0; }
+    inline void resetCounters() {}
+#endif
+
+    struct ScopedAudioThreadAllocationCheck {
+        ScopedAudioThreadAllocationCheck() { enterAudioThreadScope(); }
+        ~ScopedAudioThreadAllocationCheck() { exitAudioThreadScope(); }
+
+        ScopedAudioThreadAllocationCheck(const ScopedAudioThreadAllocationCheck&) = delete;
+        ScopedAudioThreadAllocationCheck& operator=(const ScopedAudioThreadAllocationCheck&) = delete;
+    };
+
+}
@@ -1,23 +1,107 @@
 #include "AudioTrack.hpp"
+#include "StateHasher.hpp"
 #include "../DebugConfig.hpp"
 #include <juce_dsp/juce_dsp.h>
 
 AudioTrack::AudioTrack(juce::AudioFormatManager& fm) : Track(), formatManager(fm) {}
 
-void AudioTrack::addClip(const AudioClip& c) { clips.push_back(c); }
+void AudioTrack::addClip(const AudioClip& c) {
+    // Requested before it goes in, so the lock is only held for the insert
+    AudioClip clip(c);
+    if (currentSampleRate > 0.0) {
+        clip.requestAudioData(formatManager, currentSampleRate);
+    }
+    editRendered([this, &clip] { clips.push_back(std::move(clip)); });
+    clipsStateNode.invalidate();
+}
 
 void AudioTrack::removeClip(size_t idx) {
     if (idx < clips.size()) {
-        clips.erase(clips.begin() + idx);
+        // Freed after the lock is let go; a streaming clip waits for the disk thread
+        std::vector<AudioClip> removed;
+        editRendered([this, idx, &removed] {
+            removed.push_back(std::move(clips[idx]));
+            clips.erase(clips.begin() + static_cast<std::ptrdiff_t>(idx));
+        });
+        clipsStateNode.invalidate();
     }
 }
 
+void AudioTrack::replaceClip(size_t idx, const AudioClip& c) {
+    if (idx >= clips.size()) {
+        return;
+    }
+
+    AudioClip clip(c);
+    if (currentSampleRate > 0.0) {
+        clip.requestAudioData(formatManager, currentSampleRate);
+    }
+    std::vector<AudioClip> removed;
+    editRendered([this, idx, &clip, &removed] {
+        removed.push_back(std::move(clips[idx]));
+        clips.erase(clips.begin() + static_cast<std::ptrdiff_t>(idx));
+        clips.push_back(std::move(clip));
+    });
+    clipsStateNode.invalidate();
+}
+
 const std::vector<AudioClip>& AudioTrack::getClips() const { return clips; }
 
-void AudioTrack::clearClips() { clips.clear(); }
+void AudioTrack::clearClips() {
+    std::vector<AudioClip> removed;
+    editRendered([this, &removed] { removed.swap(clips); });
+    clipsStateNode.invalidate();
+}
+
+void AudioTrack::requestClipAudio(const std::vector<AudioClip>& newClips) const {
+    if (currentSampleRate > 0.0) {
+        for (const auto& clip : newClips) {
+            clip.requestAudioData(formatManager, currentSampleRate);
+        }
+    }
+}
+
+void AudioTrack::swapClips(std::vector<AudioClip>& newClips) {
+    clips.swap(newClips);
+    clipsStateNode.invalidate();
+}
+
+void AudioTrack::hashFreezeContent(StateHasher& hasher) const {
+    for (const auto& clip : clips) {
+        hasher.add(clip.sourceFile.getFullPathName().toStdString());
+        hasher.add(clip.startTime);
+        hasher.add(clip.offset);
+        hasher.add(clip.duration);
+        hasher.add(clip.volume);
+    }
+}
+
+void AudioTrack::hashClipState(StateHasher& hasher) const {
+    // Saved by file name, so a clip found in another directory hashes the same
+    auto addClip = [&hasher](const AudioClip& clip) {
+        hasher.add(clip.sourceFile.getFileName().toStdString());
+        hasher.add(clip.startTime);
+        hasher.add(clip.offset);
+        hasher.add(clip.duration);
+        hasher.add(clip.volume);
+    };
+    for (const auto& clip : clips) {
+        addClip(clip);
+    }
+    hasher.add(referenceClip != nullptr);
+    if (referenceClip) {
+        addClip(*referenceClip);
+    }
+}
 
 void AudioTrack::setReferenceClip(const AudioClip& clip) {
-    referenceClip = std::make_unique<AudioClip>(clip);
+    auto newReferenceClip = std::make_unique<AudioClip>(clip);
+    if (currentSampleRate > 0.0) {
+        newReferenceClip->requestAudioData(formatManager, currentSampleRate);
+    }
+    // The offline renderer preloads it, so it changes under the lock too
+    editRendered([this, &newReferenceClip] { std::swap(referenceClip, newReferenceClip); });
+    clipsStateNode.invalidate();
 }
 
 AudioClip* AudioTrack::getReferenceClip() {
@@ -28,6 +112,10 @@ void AudioTrack::process(double playheadSeconds,
                     juce::AudioBuffer<float>& output,
                     int numSamples,
                     double sampleRate) {
+    if (processFrozen(playheadSeconds, output, numSamples, sampleRate)) {
+        return;
+    }
+
     if (muted) {
         return;
     }
@@ -49,10 +137,8 @@ void AudioTrack::process(double playheadSeconds,
         if (playheadSeconds < c.startTime + c.duration &&
             playheadSeconds + (double)numSamples / sampleRate > c.startTime)
         {
-            c.loadAudioData(formatManager, sampleRate);
-            
-            if (!c.isAudioDataLoaded()) {
-                DBG("Failed to load audio data for: " << c.sourceFile.getFullPathName());
+            // Clips still decoding in the background stay silent until they're ready
+            if (!c.pollAudioData(sampleRate)) {
                 continue;
             }
 
@@ -71,38 +157,65 @@ void AudioTrack::process(double playheadSeconds,
             int endSampleInSourceFile = static_cast<int>((readEndTimeInClip + c.offset) * sampleRate);
             int numSamplesToRead = endSampleInSourceFile - startSampleInSourceFile;
 
-            if (numSamplesToRead <= 0 || startSampleInSourceFile >= c.preRenderedAudio->getNumSamples()) {
+            const juce::int64 numLoadedSamples = c.getNumLoadedSamples(sampleRate);
+            if (numSamplesToRead <= 0 || startSampleInSourceFile >= numLoadedSamples) {
                 continue;
             }
             
-            numSamplesToRead = juce::jmin(numSamplesToRead, c.preRenderedAudio->getNumSamples() - startSampleInSourceFile);
+            numSamplesToRead = static_cast<int>(std::min(static_cast<juce::int64>(numSamplesToRead), numLoadedSamples - startSampleInSourceFile));
 
             juce::int64 outputBufferStartSample = static_cast<juce::int64>(juce::jmax(0.0, (c.startTime - blockStartTimeSeconds) * sampleRate));
             outputBufferStartSample = juce::jmax((juce::int64)0, outputBufferStartSample);
 
-            juce::AudioBuffer<float> volPanBuf(output.getNumChannels(), numSamplesToRead);
-            volPanBuf.clear();
+            auto volPanBuf = scratchBuffers.get(0, output.getNumChannels(), numSamplesToRead);
+
+            // Streaming clips are pulled out of their ring buffer into scratch first
+            const juce::AudioBuffer<float>* source = c.getLoadedBuffer(sampleRate);
+            int sourceStartSample = startSampleInSourceFile;
+            juce::AudioBuffer<float> streamedAudio;
+            if (c.stream) {
+                streamedAudio = scratchBuffers.get(1, c.stream->getNumChannels(), numSamplesToRead);
+                c.stream->read(streamedAudio, startSampleInSourceFile, numSamplesToRead);
+                source = &streamedAudio;
+                sourceStartSample = 0;
+            }
+
+            // Automated volume/pan: per-sample ramps, indexed from where the clip lands in the block
+            const int outputStart = static_cast<int>(outputBufferStartSample);
+            const int numRampSamples = juce::jmin(numSamplesToRead, numSamples - outputStart);
+            const bool useRamps = automationRampsActive && numRampSamples > 0;
 
-            if (c.preRenderedAudio->getNumChannels() == 1 && output.getNumChannels() == 2) {
+            if (useRamps && source->getNumChannels() <= 2 && output.getNumChannels() == 2) {
+                const bool isMono = source->getNumChannels() == 1;
+                volPanBuf.copyFrom(0, 0, *source, 0, sourceStartSample, numSamplesToRead);
+                volPanBuf.copyFrom(1, 0, *source, isMono ? 0 : 1, sourceStartSample, numSamplesToRead);
+                applyAutomationRamp(volPanBuf, 0, isMono ? MonoLeftRamp : StereoLeftRamp, outputStart, numRampSamples);
+                applyAutomationRamp(volPanBuf, 1, isMono ? MonoRightRamp : StereoRightRamp, outputStart, numRampSamples);
+            } else if (useRamps) {
+                for (int ch = 0; ch < juce::jmin(source->getNumChannels(), output.getNumChannels()); ++ch) {
+                    volPanBuf.copyFrom(ch, 0, *source, ch, sourceStartSample, numSamplesToRead);
+                    applyAutomationRamp(volPanBuf, ch, GainRamp, outputStart, numRampSamples);
+                }
+            } else if (source->getNumChannels() == 1 && output.getNumChannels() == 2) {
                 float leftGain = std::sqrt((1.0f - pan) / 2.0f) * juce::Decibels::decibelsToGain(volumeDb);
                 float rightGain = std::sqrt((1.0f + pan) / 2.0f) * juce::Decibels::decibelsToGain(volumeDb);
                 
-                volPanBuf.copyFrom(0, 0, *c.preRenderedAudio, 0, startSampleInSourceFile, numSamplesToRead);
-                volPanBuf.copyFrom(1, 0, *c.preRenderedAudio, 0, startSampleInSourceFile, numSamplesToRead);
+                volPanBuf.copyFrom(0, 0, *source, 0, sourceStartSample, numSamplesToRead);
+                volPanBuf.copyFrom(1, 0, *source, 0, sourceStartSample, numSamplesToRead);
                 volPanBuf.applyGain(0, 0, numSamplesToRead, leftGain);
                 volPanBuf.applyGain(1, 0, numSamplesToRead, rightGain);
-            } else if (c.preRenderedAudio->getNumChannels() == 2 && output.getNumChannels() == 2) {
+            } else if (source->getNumChannels() == 2 && output.getNumChannels() == 2) {
                 float leftGain = juce::Decibels::decibelsToGain(volumeDb) * (1.0f - juce::jmax(0.0f, pan));
                 float rightGain = juce::Decibels::decibelsToGain(volumeDb) * (1.0f + juce::jmin(0.0f, pan));
                 
-                volPanBuf.copyFrom(0, 0, *c.preRenderedAudio, 0, startSampleInSourceFile, numSamplesToRead);
-                volPanBuf.copyFrom(1, 0, *c.preRenderedAudio, 1, startSampleInSourceFile, numSamplesToRead);
+                volPanBuf.copyFrom(0, 0, *source, 0, sourceStartSample, numSamplesToRead);
+                volPanBuf.copyFrom(1, 0, *source, 1, sourceStartSample, numSamplesToRead);
                 volPanBuf.applyGain(0, 0, numSamplesToRead, leftGain);
                 volPanBuf.applyGain(1, 0, numSamplesToRead, rightGain);
             } else {
                 float gain = juce::Decibels::decibelsToGain(volumeDb);
-                for (int ch = 0; ch < juce::jmin(c.preRenderedAudio->getNumChannels(), output.getNumChannels()); ++ch) {
-                    volPanBuf.copyFrom(ch, 0, *c.preRenderedAudio, ch, startSampleInSourceFile, numSamplesToRead);
+                for (int ch = 0; ch < juce::jmin(source->getNumChannels(), output.getNumChannels()); ++ch) {
+                    volPanBuf.copyFrom(ch, 0, *source, ch, sourceStartSample, numSamplesToRead);
                     volPanBuf.applyGain(ch, 0, numSamplesToRead, gain);
                 }
             }
@@ -122,17 +235,14 @@ void AudioTrack::process(double playheadSeconds,
     processEffects(output);
 
     // Apply track volume and mute
-    if (muted) {
-        output.clear();
-    } else {
-        float trackGain = juce::Decibels::decibelsToGain(volumeDb);
-        output.applyGain(trackGain);
-    }
+    applyTrackGain(output, numSamples);
 }
 
 void AudioTrack::prepareToPlay(double sampleRate, int bufferSize) {
     currentSampleRate = sampleRate;
     currentBufferSize = bufferSize;
+    scratchBuffers.prepare(2, bufferSize, 2);
+    prepareAutomation(bufferSize);
     
     // Prepare all effects
     for (auto& effect : effects) {
@@ -141,7 +251,36 @@ void AudioTrack::prepareToPlay(double sampleRate, int bufferSize) {
         }
     }
     
-    preloadAllClips(sampleRate);
+    requestAllClips(sampleRate);
+}
+
+bool AudioTrack::cueStreams(double playheadSeconds, double sampleRate) {
+    if (isFrozen()) {
+        return Track::cueStreams(playheadSeconds, sampleRate);
+    }
+
+    bool allCued = true;
+    for (const auto& c : clips) {
+        if (!c.stream || !c.pollAudioData(sampleRate) || playheadSeconds >= c.startTime + c.duration) {
+            continue;
+        }
+
+        // Where process() first reads the clip from
+        const double readStartTimeInClip = juce::jmax(0.0, playheadSeconds - c.startTime);
+        c.stream->cue(static_cast<juce::int64>((readStartTimeInClip + c.offset) * sampleRate));
+        allCued = c.stream->isCued() && allCued;
+    }
+    return allCued;
+}
+
+void AudioTrack::requestAllClips(double sampleRate) {
+    for (const auto& clip : clips) {
+        clip.requestAudioData(formatManager, sampleRate);
+    }
+    
+    if (referenceClip) {
+        referenceClip->requestAudioData(formatManager, sampleRate);
+    }
 }
 
 void AudioTrack::preloadAllClips(double sampleRate) {
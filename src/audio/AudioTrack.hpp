@@ -21,20 +21,32 @@ public:
     // Audio clip management
     void addClip(const AudioClip& clip) override;
     void removeClip(size_t index) override;
+    // Removes the clip at index and appends clip in its place, as one edit
+    void replaceClip(size_t index, const AudioClip& clip);
     const std::vector<AudioClip>& getClips() const override;
     void clearClips() override;
     void setReferenceClip(const AudioClip& clip);
     AudioClip* getReferenceClip() override;
+    // Replacing the clips of a track that is being rendered: the new list is
+    // built and its audio requested first, then swapped in under the audio
+    // callback lock, leaving the old clips in newClips to be freed after it
+    void requestClipAudio(const std::vector<AudioClip>& newClips) const;
+    void swapClips(std::vector<AudioClip>& newClips);
 
     // Audio processing implementation
     void process(double playheadSeconds, juce::AudioBuffer<float>& outputBuffer, int numSamples, double sampleRate) override;
     void prepareToPlay(double sampleRate, int bufferSize) override;
+    bool cueStreams(double playheadSeconds, double sampleRate) override;
     
     // Cache management
-    void preloadAllClips(double sampleRate);
+    void preloadAllClips(double sampleRate);   // blocks until every clip is decoded
+    void requestAllClips(double sampleRate);   // decodes in the background
     void unloadAllClips();
 
 private:
+    void hashFreezeContent(StateHasher& hasher) const override;
+    void hashClipState(StateHasher& hasher) const override;
+
     // Audio-specific data
     std::vector<AudioClip> clips;
     std::unique_ptr<AudioClip> referenceClip;
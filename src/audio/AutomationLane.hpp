@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// AutomationLane - one automated parameter, compiled from the editable
+// automation points into a time-sorted array. Playback walks it with a
+// cursor kept from the previous lookup, so following the playhead costs a
+// comparison or two per block; only a jump backwards falls back to a
+// binary search. Built on the message thread, then owned by whichever
+// thread renders the track.
+struct AutomationLane {
+    enum class Target { TrackVolume, TrackPan, EffectParameter };
+
+    struct Point {
+        double time;
+        float value;
+        float curve;
+    };
+
+    Target target = Target::EffectParameter;
+    int effectIndex = -1;
+    int parameterIndex = -1;
+    std::vector<Point> points; // time >= 0, ascending
+    size_t cursor = 0;         // segment [cursor, cursor + 1] of the last lookup
+
+    // Same shaping the automation editor draws: 0.5 is linear, lower values
+    // ease in and higher values ease out, sharpening towards a corner at 0 and 1
+    static float interpolate(const Point& p1, const Point& p2, double time) {
+        if (p2.time <= p1.time) {
+            return p2.value;
+        }
+
+        double t = (time - p1.time) / (p2.time - p1.time);
+
+        if (std::abs(p1.curve - 0.5f) < 0.001f) {
+            return p1.value + static_cast<float>(t) * (p2.value - p1.value);
+        }
+
+        float adjustedT;
+        if (p1.curve < 0.5f) {
+            float factor = 50.0f * (0.5f - p1.curve);
+            adjustedT = std::pow(static_cast<float>(t), 1.0f + factor);
+        } else {
+            float factor = 50.0f * (p1.curve - 0.5f);
+            adjustedT = 1.0f - std::pow(1.0f - static_cast<float>(t), 1.0f + factor);
+        }
+        return p1.value + adjustedT * (p2.value - p1.value);
+    }
+
+    // Lane value at time. Never allocates.
+    float valueAt(double time) {
+        if (time <= points.front().time) {
+            cursor = 0;
+            return points.front().value;
+        }
+        if (time >= points.back().time) {
+            cursor = points.size() - 1;
+            return points.back().value;
+        }
+
+        // points.size() >= 2 from here on
+        cursor = std::min(cursor, points.size() - 2);
+        if (time < points[cursor].time) {
+            // Seeked backwards: find the segment again
+            auto it = std::upper_bound(points.begin(), points.end(), time,
+                                       [](double t, const Point& p) { return t < p.time; });
+            cursor = static_cast<size_t>(it - points.begin()) - 1;
+        } else {
+            while (time > points[cursor + 1].time) {
+                ++cursor;
+            }
+        }
+
+        return interpolate(points[cursor], points[cursor + 1], time);
+    }
+
+    // Calls fn(time) for every point strictly inside (from, to). Meant to
+    // follow valueAt(from), which leaves the cursor just before them.
+    template <typename Fn>
+    void forEachPointWithin(double from, double to, Fn&& fn) const {
+        for (size_t i = cursor; i < points.size() && points[i].time < to; ++i) {
+            if (points[i].time > from) {
+                fn(points[i].time);
+            }
+        }
+    }
+};
+
+using AutomationLanes = std::vector<AutomationLane>;
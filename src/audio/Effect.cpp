@@ -1,11 +1,16 @@
 #include "Effect.hpp"
 #include "VSTPluginManager.hpp"
+#include "RemotePluginInstance.hpp"
+#include "PluginDatabase.hpp"
+#include "AudioThreadAllocationGuard.hpp"
 #include "../DebugConfig.hpp"
 #include <thread>
 #include <chrono>
 #include <filesystem>
 #include <algorithm>
 #include <mutex>
+#include <cmath>
+#include <limits>
 
 #ifdef _WIN32
 #undef max
@@ -15,6 +20,58 @@
 std::vector<std::unique_ptr<juce::AudioPluginInstance>> Effect::scheduledPlugins;
 std::mutex Effect::cleanupMutex;
 std::unordered_map<std::string, int> Effect::pluginInstanceCount;
+std::atomic<double> Effect::sleepAfterSilenceSeconds { 1.0 };
+std::atomic<bool> Effect::outOfProcess { false };
+
+namespace {
+    // About -100 dBFS; quieter output counts as silence
+    constexpr float sleepSilenceThreshold = 1.0e-5f;
+
+    bool isBufferSilent(const juce::AudioBuffer<float>& buffer) {
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch) {
+            if (buffer.getMagnitude(ch, 0, buffer.getNumSamples()) > sleepSilenceThreshold) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Leaves the audio untouched, so timing it through Effect measures only the wrapper
+    class PassThroughPlugin final : public juce::AudioPluginInstance {
+    public:
+        explicit PassThroughPlugin(const juce::AudioChannelSet& channelSet)
+            : juce::AudioPluginInstance(BusesProperties().withInput("Input", channelSet).withOutput("Output", channelSet)),
+              channels(channelSet) {}
+
+        void fillInPluginDescription(juce::PluginDescription& description) const override {
+            description.name = getName();
+            description.pluginFormatName = "Internal";
+            description.category = "Effect";
+        }
+        const juce::String getName() const override { return "Pass Through"; }
+        bool isBusesLayoutSupported(const BusesLayout& layout) const override {
+            return layout.getMainInputChannelSet() == channels && layout.getMainOutputChannelSet() == channels;
+        }
+        void prepareToPlay(double, int) override {}
+        void releaseResources() override {}
+        void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override {}
+        double getTailLengthSeconds() const override { return 0.0; }
+        bool acceptsMidi() const override { return false; }
+        bool producesMidi() const override { return false; }
+        juce::AudioProcessorEditor* createEditor() override { return nullptr; }
+        bool hasEditor() const override { return false; }
+        int getNumPrograms() override { return 1; }
+        int getCurrentProgram() override { return 0; }
+        void setCurrentProgram(int) override {}
+        const juce::String getProgramName(int) override { return {}; }
+        void changeProgramName(int, const juce::String&) override {}
+        void getStateInformation(juce::MemoryBlock&) override {}
+        void setStateInformation(const void*, int) override {}
+
+    private:
+        juce::AudioChannelSet channels;
+    };
+}
 
 VSTEditorWindow::VSTEditorWindow(const juce::String& name, juce::AudioProcessor* processor, std::function<void()> onClose)
     : juce::DocumentWindow(name, juce::Colours::lightgrey, juce::DocumentWindow::allButtons)
@@ -84,6 +141,11 @@ Effect::~Effect() {
             editorWindow.reset();
         }
         
+        if (isRunningOutOfProcess()) {
+            // Nothing of the plugin lives in this process; this just stops its host
+            plugin.reset();
+        }
+
         if (plugin) {
             try {
                 plugin->suspendProcessing(true);
@@ -197,37 +259,40 @@ bool Effect::loadVST(const std::string& vstPath, double sampleRate) {
         return false;
     }
     
-    juce::AudioPluginFormatManager formatManager;
-    formatManager.addDefaultFormats();
-    
     juce::File vstFile(vstPath);
     if (!vstFile.exists()) {
         std::cerr << "VST file does not exist: " << vstPath << std::endl;
         return false;
     }
     
-    juce::OwnedArray<juce::PluginDescription> descriptions;
-    
-    for (auto* format : formatManager.getFormats()) {
-        format->findAllTypesForFile(descriptions, vstFile.getFullPathName());
-        if (!descriptions.isEmpty()) {
-            break;
-        }
-    }
-    
-    if (descriptions.isEmpty()) {
+    auto& pluginDatabase = PluginDatabase::getInstance();
+    const auto description = pluginDatabase.findDescription(vstPath);
+    if (!description) {
         std::cerr << "No valid plugin found in file: " << vstPath << std::endl;
         return false;
     }
     
-    auto* description = descriptions[0];
     bool isDPFPlugin = description->manufacturerName.toLowerCase().contains("distrho") || 
                        description->manufacturerName.toLowerCase().contains("dpf") ||
                        description->category.toLowerCase().contains("dpf");
     
     juce::String errorMessage;
     
-    plugin = formatManager.createPluginInstance(*description, sampleRate, 512, errorMessage);
+    if (outOfProcess.load() && RemotePluginInstance::isSupported()) {
+        plugin = RemotePluginInstance::create(*description, sampleRate, 512, errorMessage);
+        if (plugin) {
+            pluginDatabase.remember(vstPath, *plugin);
+            name = plugin->getName().toStdString();
+            hasEditorCached = plugin->hasEditor();
+            buildProcessingPlan();
+            return true;
+        }
+        std::cerr << "Failed to host plugin out of process (" << errorMessage.toStdString()
+                  << "), loading it in process" << std::endl;
+        errorMessage.clear();
+    }
+
+    plugin = pluginDatabase.createInstance(*description, sampleRate, 512, errorMessage);
     
     if (!plugin) {
         std::cerr << "Failed to create plugin instance: " << errorMessage.toStdString() << std::endl;
@@ -257,13 +322,29 @@ bool Effect::loadVST(const std::string& vstPath, double sampleRate) {
     }
 
     hasEditorCached = plugin->hasEditor();
+    pluginDatabase.remember(vstPath, *plugin);
+    // Real channel counts from the start, in case a block arrives before prepareToPlay
+    buildProcessingPlan();
 
     return true;
 }
 
 void Effect::prepareToPlay(double sampleRate, int bufferSize) {
     if (!plugin) return;
-    
+
+    preparedSampleRate = sampleRate;
+    preparedBlockSize = bufferSize;
+    if (suspended.load(std::memory_order_acquire)) {
+        // Prepared for real when it resumes
+        return;
+    }
+    preparePlugin();
+}
+
+void Effect::preparePlugin() {
+    const double sampleRate = preparedSampleRate;
+    const int bufferSize = preparedBlockSize;
+
     bool isDPFPlugin = plugin->getName().toLowerCase().contains("dpf") ||
                        name.find("DPF") != std::string::npos ||
                        name.find("DISTRHO") != std::string::npos;
@@ -290,61 +371,163 @@ void Effect::prepareToPlay(double sampleRate, int bufferSize) {
     }
     
     plugin->prepareToPlay(sampleRate, bufferSize);
+
+    const double tailSeconds = plugin->getTailLengthSeconds();
+    tailSamples = std::isinf(tailSeconds) ? std::numeric_limits<double>::infinity()
+                                          : juce::jmax(0.0, tailSeconds) * sampleRate;
+    buildProcessingPlan();
+    wake();
+}
+
+void Effect::buildProcessingPlan() {
+    plan.isSynthesizer = isSynthesizer();
+    plan.pluginInputChannels = plugin->getTotalNumInputChannels();
+    plan.pluginOutputChannels = plugin->getTotalNumOutputChannels();
+    plan.adapterChannels = (std::max)({ plan.pluginInputChannels, plan.pluginOutputChannels, 1 });
+
+    adapterBuffer.setSize(plan.adapterChannels, juce::jmax(1, preparedBlockSize));
+    adapterBuffer.clear();
+    effectMidi.ensureSize(4096);
+    chunkMidi.ensureSize(4096);
+    chunkMidiOut.ensureSize(4096);
+}
+
+void Effect::runPlugin(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer) {
+    const int numSamples = buffer.getNumSamples();
+    const int maxBlock = adapterBuffer.getNumSamples();
+    if (numSamples <= maxBlock) {
+        runPluginBlock(buffer, midiBuffer);
+        return;
+    }
+
+    // The plugin never sees more than it was prepared for, so a larger block goes through in pieces
+    chunkMidiOut.clear();
+    for (int start = 0; start < numSamples; start += maxBlock) {
+        const int length = (std::min)(maxBlock, numSamples - start);
+        juce::AudioBuffer<float> chunk(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, length);
+        chunkMidi.clear();
+        chunkMidi.addEvents(midiBuffer, start, length, -start);
+        runPluginBlock(chunk, chunkMidi);
+        chunkMidiOut.addEvents(chunkMidi, 0, length, start);
+    }
+    midiBuffer.swapWith(chunkMidiOut);
+}
+
+void Effect::runPluginBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer) {
+    const int numSamples = buffer.getNumSamples();
+    const int bufferChannels = buffer.getNumChannels();
+    if (bufferChannels == plan.pluginInputChannels && bufferChannels == plan.pluginOutputChannels) {
+        plugin->processBlock(buffer, midiBuffer);
+        return;
+    }
+
+    // Refers to adapterBuffer's channels, trimmed to this block
+    juce::AudioBuffer<float> adapter(adapterBuffer.getArrayOfWritePointers(), plan.adapterChannels, numSamples);
+    adapter.clear();
+    for (int ch = 0; ch < (std::min)(bufferChannels, plan.pluginInputChannels); ++ch) {
+        adapter.copyFrom(ch, 0, buffer, ch, 0, numSamples);
+    }
+
+    plugin->processBlock(adapter, midiBuffer);
+
+    for (int ch = 0; ch < (std::min)(bufferChannels, plan.pluginOutputChannels); ++ch) {
+        buffer.copyFrom(ch, 0, adapter, ch, 0, numSamples);
+    }
+}
+
+void Effect::setSuspended(bool shouldBeSuspended) {
+    if (!plugin || suspended.load(std::memory_order_acquire) == shouldBeSuspended) {
+        return;
+    }
+
+    if (shouldBeSuspended) {
+        suspended.store(true, std::memory_order_release);
+        plugin->releaseResources();
+    } else {
+        // Nothing processes the plugin until it is ready again
+        preparePlugin();
+        suspended.store(false, std::memory_order_release);
+    }
+}
+
+bool Effect::skipWhileAsleep(juce::AudioBuffer<float>& buffer, bool hasInput) {
+    if (!asleep.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    if (hasInput) {
+        wake();
+        return false;
+    }
+
+    buffer.clear();
+    blocksSkipped.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void Effect::updateSleep(const juce::AudioBuffer<float>& buffer, bool hadInput) {
+    blocksProcessed.fetch_add(1, std::memory_order_relaxed);
+
+    if (hadInput || !isBufferSilent(buffer)) {
+        silentSamples = 0;
+        return;
+    }
+
+    const double sleepAfterSeconds = sleepAfterSilenceSeconds.load(std::memory_order_relaxed);
+    if (sleepAfterSeconds <= 0.0) {
+        return;
+    }
+
+    // The tail may have a quiet stretch (a long delay, a slow swell), so wait out all of it
+    silentSamples += buffer.getNumSamples();
+    if (static_cast<double>(silentSamples) >= juce::jmax(tailSamples, sleepAfterSeconds * preparedSampleRate)) {
+        asleep.store(true, std::memory_order_relaxed);
+        timesSlept.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Effect::wake() {
+    asleep.store(false, std::memory_order_relaxed);
+    silentSamples = 0;
+}
+
+Effect::SleepStats Effect::getSleepStats() const {
+    SleepStats stats;
+    stats.blocksProcessed = blocksProcessed.load(std::memory_order_relaxed);
+    stats.blocksSkipped = blocksSkipped.load(std::memory_order_relaxed);
+    stats.timesSlept = timesSlept.load(std::memory_order_relaxed);
+    stats.asleep = asleep.load(std::memory_order_relaxed);
+    return stats;
 }
 
 void Effect::processAudio(juce::AudioBuffer<float>& buffer) {
     if (!plugin || !isEnabled || scheduledForCleanup) {
         return;
     }
+
+    if (suspended.load(std::memory_order_acquire)) {
+        buffer.clear();
+        return;
+    }
     
-    if (isSynthesizer() && isSilenced()) {
+    if (plan.isSynthesizer && silencedFlag) {
         buffer.clear();
         return;
     }
+
+    if (buffer.getNumChannels() == 0 || buffer.getNumSamples() == 0) {
+        return;
+    }
+
+    const bool hasInput = !isBufferSilent(buffer);
+    if (skipWhileAsleep(buffer, hasInput)) {
+        return;
+    }
     
     try {
-        if (buffer.getNumChannels() == 0 || buffer.getNumSamples() == 0) {
-            return;
-        }
-        
-        int pluginInputChannels = plugin->getTotalNumInputChannels();
-        int pluginOutputChannels = plugin->getTotalNumOutputChannels();
-        int bufferChannels = buffer.getNumChannels();
-        
-        bool isDPFPlugin = plugin->getName().toLowerCase().contains("dpf") ||
-                           name.find("DPF") != std::string::npos ||
-                           name.find("DISTRHO") != std::string::npos;
-        
-        juce::AudioBuffer<float> processBuffer;
-        if (pluginOutputChannels != bufferChannels || pluginInputChannels != bufferChannels) {
-            int maxChannels = (std::max)({pluginInputChannels, pluginOutputChannels, bufferChannels});
-            processBuffer.setSize(maxChannels, buffer.getNumSamples());
-            processBuffer.clear();
-            
-            for (int ch = 0; ch < (std::min)(bufferChannels, pluginInputChannels); ++ch) {
-                processBuffer.copyFrom(ch, 0, buffer, ch, 0, buffer.getNumSamples());
-            }
-            
-            juce::MidiBuffer midiBuffer;
-            
-            if (isDPFPlugin) {
-                midiBuffer.clear();
-            }
-            
-            plugin->processBlock(processBuffer, midiBuffer);
-            
-            for (int ch = 0; ch < (std::min)(bufferChannels, pluginOutputChannels); ++ch) {
-                buffer.copyFrom(ch, 0, processBuffer, ch, 0, buffer.getNumSamples());
-            }
-        } else {
-            juce::MidiBuffer midiBuffer;
-            
-            if (isDPFPlugin) {
-                midiBuffer.clear();
-            }
-            
-            plugin->processBlock(buffer, midiBuffer);
-        }
+        // Plugins may leave MIDI output behind; clearing keeps the storage
+        effectMidi.clear();
+        runPlugin(buffer, effectMidi);
+        updateSleep(buffer, hasInput);
         
     } catch (const std::exception& e) {
         std::cerr << "ERROR: VST '" << name << "' crashed during audio processing: " << e.what() << std::endl;
@@ -360,40 +543,29 @@ void Effect::processAudio(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& mi
         return;
     }
 
-    if (isSynthesizer() && isSilenced()) {
-        buffer.clear(); 
+    if (suspended.load(std::memory_order_acquire)) {
+        buffer.clear();
         return;
     }
-    
-    try {
-        if (buffer.getNumChannels() == 0 || buffer.getNumSamples() == 0) {
-            return;
-        }
-
-        int pluginInputChannels = plugin->getTotalNumInputChannels();
-        int pluginOutputChannels = plugin->getTotalNumOutputChannels();
-        int bufferChannels = buffer.getNumChannels();
 
-        juce::AudioBuffer<float> processBuffer;
-        if (pluginOutputChannels != bufferChannels || pluginInputChannels != bufferChannels) {
-            
-            int maxChannels = (std::max)({pluginInputChannels, pluginOutputChannels, bufferChannels});
-            processBuffer.setSize(maxChannels, buffer.getNumSamples());
-            processBuffer.clear();
- 
-            for (int ch = 0; ch < (std::min)(bufferChannels, pluginInputChannels); ++ch) {
-                processBuffer.copyFrom(ch, 0, buffer, ch, 0, buffer.getNumSamples());
-            }
+    if (plan.isSynthesizer && silencedFlag) {
+        buffer.clear(); 
+        return;
+    }
 
-            plugin->processBlock(processBuffer, midiBuffer);
+    if (buffer.getNumChannels() == 0 || buffer.getNumSamples() == 0) {
+        return;
+    }
 
-            for (int ch = 0; ch < (std::min)(bufferChannels, pluginOutputChannels); ++ch) {
-                buffer.copyFrom(ch, 0, processBuffer, ch, 0, buffer.getNumSamples());
-            }
-        } else {
-            
-            plugin->processBlock(buffer, midiBuffer);
-        }
+    // Any MIDI wakes a sleeping instrument, even one that only changes a controller
+    const bool hasInput = !midiBuffer.isEmpty() || !isBufferSilent(buffer);
+    if (skipWhileAsleep(buffer, hasInput)) {
+        return;
+    }
+    
+    try {
+        runPlugin(buffer, midiBuffer);
+        updateSleep(buffer, hasInput);
         
     } catch (const std::exception& e) {
         std::cerr << "ERROR: VST '" << name << "' crashed during audio processing: " << e.what() << std::endl;
@@ -419,6 +591,11 @@ void Effect::openWindow() {
         return;
     }
     
+    if (auto* remote = dynamic_cast<RemotePluginInstance*>(plugin.get())) {
+        remote->showEditor();
+        return;
+    }
+
     if (editorWindow) {
         editorWindow.reset();
         std::this_thread::sleep_for(std::chrono::milliseconds(50));
@@ -446,6 +623,10 @@ void Effect::openWindow() {
     }
 }
 
+bool Effect::isRunningOutOfProcess() const {
+    return dynamic_cast<const RemotePluginInstance*>(plugin.get()) != nullptr;
+}
+
 void Effect::setParameter(int index, float value) {
     if (!plugin) return;
     
@@ -489,7 +670,7 @@ int Effect::getNumParameters() const {
 }
 
 void Effect::resetBuffers() {
-    if (!plugin) return;
+    if (!plugin || suspended.load(std::memory_order_acquire)) return;
     
     try {
         if (isSynthesizer()) {
@@ -550,6 +731,19 @@ void Effect::setPlayHead(juce::AudioPlayHead* playHead) {
     }
 }
 
+void Effect::setNonRealtime(bool isNonRealtime) {
+    if (!plugin) {
+        return;
+    }
+    
+    // Lets plugins switch to their offline quality while exporting
+    plugin->setNonRealtime(isNonRealtime);
+}
+
+double Effect::getTailLengthSeconds() const {
+    return plugin ? plugin->getTailLengthSeconds() : 0.0;
+}
+
 bool Effect::isSynthesizer() const {
     if (!plugin) return false;
 
@@ -557,25 +751,7 @@ bool Effect::isSynthesizer() const {
         return isSynthesizerCached;
     }
 
-    bool acceptsMidi = plugin->acceptsMidi();
-
-    int audioInputChannels = plugin->getTotalNumInputChannels();
-    int audioOutputChannels = plugin->getTotalNumOutputChannels();
-
-    bool hasAudioOutput = audioOutputChannels > 0;
-    bool hasMinimalAudioInput = audioInputChannels <= 0;
-
-    bool isInstrumentCategory = false;
-    try {
-        juce::String category = plugin->getPluginDescription().category.toLowerCase();
-        isInstrumentCategory = category.contains("instrument") || 
-                              category.contains("synth") || 
-                              category.contains("generator");
-    } catch (...) {
-        isInstrumentCategory = false;
-    }
-
-    bool isSynth = acceptsMidi && hasAudioOutput && (hasMinimalAudioInput || isInstrumentCategory);
+    bool isSynth = PluginDatabase::isSynthesizer(*plugin);
 
     isSynthesizerCached = isSynth;
     synthesizerCached = true;
@@ -584,54 +760,9 @@ bool Effect::isSynthesizer() const {
 }
 
 bool Effect::isVSTSynthesizer(const std::string& vstPath) {
-    auto& vstManager = VSTPluginManager::getInstance();
-    if (!vstManager.isValidVSTFile(vstPath)) {
-        return false;
-    }
-
-    juce::AudioPluginFormatManager formatManager;
-    formatManager.addDefaultFormats();
-    
-    juce::File vstFile(vstPath);
-    if (!vstFile.exists()) {
-        return false;
-    }
-    
-    juce::OwnedArray<juce::PluginDescription> descriptions;
-    for (auto* format : formatManager.getFormats()) {
-        format->findAllTypesForFile(descriptions, vstFile.getFullPathName());
-        if (!descriptions.isEmpty()) {
-            break;
-        }
-    }
-    
-    if (descriptions.isEmpty()) {
-        return false;
-    }
-    
-    auto* description = descriptions[0];
-    
-    juce::String errorMessage;
-    auto plugin = formatManager.createPluginInstance(*description, 44100.0, 512, errorMessage);
-    
-    if (!plugin) {
-        return false;
-    }
-    
-    bool acceptsMidi = plugin->acceptsMidi();
-    int audioInputChannels = plugin->getTotalNumInputChannels();
-    int audioOutputChannels = plugin->getTotalNumOutputChannels();
-    bool hasAudioOutput = audioOutputChannels > 0;
-    bool hasMinimalAudioInput = audioInputChannels <= 0;
-    
-    juce::String category = plugin->getPluginDescription().category.toLowerCase();
-    bool isInstrumentCategory = category.contains("instrument") || 
-                               category.contains("synth") || 
-                               category.contains("generator");
-    
-    bool isSynth = acceptsMidi && hasAudioOutput && (hasMinimalAudioInput || isInstrumentCategory);
-    
-    return isSynth;
+    // Instantiates the plugin only the first time this file is seen
+    const auto entry = PluginDatabase::getInstance().find(vstPath);
+    return entry && entry->isSynthesizer;
 }
 
 void Effect::scheduleForCleanup() {
@@ -729,3 +860,53 @@ void Effect::cleanupScheduledPlugins() {
     
     cleanupInProgress = false;
 }
+
+std::vector<Effect::BenchmarkResult> Effect::runBenchmark(int numBlocks) {
+    constexpr double sampleRate = 48000.0;
+    numBlocks = juce::jmax(1, numBlocks);
+
+    std::vector<BenchmarkResult> results;
+    for (const bool adapted : { false, true }) {
+        for (const int blockSize : { 64, 512 }) {
+            // Tracks always hand over stereo; a mono plugin goes through the adapter
+            Effect effect;
+            effect.name = "Pass Through";
+            effect.plugin = std::make_unique<PassThroughPlugin>(adapted ? juce::AudioChannelSet::mono()
+                                                                        : juce::AudioChannelSet::stereo());
+            effect.prepareToPlay(sampleRate, blockSize);
+
+            // Noise, so the plugin never goes to sleep
+            juce::AudioBuffer<float> buffer(2, blockSize);
+            juce::Random random(42);
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch) {
+                for (int i = 0; i < blockSize; ++i) {
+                    buffer.setSample(ch, i, random.nextFloat() * 2.0f - 1.0f);
+                }
+            }
+            juce::MidiBuffer midi;
+
+            auto nanosPerBlock = [numBlocks](auto&& processBlock) {
+                const double startMs = juce::Time::getMillisecondCounterHiRes();
+                for (int block = 0; block < numBlocks; ++block) {
+                    processBlock();
+                }
+                return (juce::Time::getMillisecondCounterHiRes() - startMs) * 1.0e6 / numBlocks;
+            };
+
+            BenchmarkResult result;
+            result.layout = adapted ? "mono (adapted)" : "stereo";
+            result.blockSize = blockSize;
+            result.pluginNanosPerBlock = nanosPerBlock([&] { effect.plugin->processBlock(buffer, midi); });
+
+            AudioThreadAllocationGuard::resetCounters();
+            {
+                AudioThreadAllocationGuard::ScopedAudioThreadAllocationCheck allocationCheck;
+                result.effectNanosPerBlock = nanosPerBlock([&] { effect.processAudio(buffer); });
+            }
+            result.allocations = AudioThreadAllocationGuard::getAllocationCount();
+            results.push_back(result);
+        }
+    }
+
+    return results;
+}
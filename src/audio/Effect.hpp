@@ -1,10 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <juce_audio_processors/juce_audio_processors.h>
 #include "VSTEditorWindow.hpp"
+#include "StateHashNode.hpp"
 
 class Effect {
 public:
@@ -39,14 +42,46 @@ public:
     void resetBuffers();
     void setBpm(double bpm);
     void setPlayHead(juce::AudioPlayHead* playHead);
+    void setNonRealtime(bool isNonRealtime);
     
     void setSilenced(bool silenced) { silencedFlag = silenced; }
     bool isSilenced() const { return silencedFlag; }
 
-    inline void enable() { isEnabled = true; }
-    inline void disable() { isEnabled = false; }
+    // Sleep: once the plugin's output has stayed silent, with no audio or MIDI
+    // coming in, for its reported tail (and at least the sleep-after-silence
+    // time), processBlock is skipped until input arrives again
+    struct SleepStats {
+        std::uint64_t blocksProcessed = 0;
+        std::uint64_t blocksSkipped = 0;
+        std::uint64_t timesSlept = 0;
+        bool asleep = false;
+    };
+    SleepStats getSleepStats() const;
+    bool isAsleep() const { return asleep.load(std::memory_order_relaxed); }
+
+    // Suspending releases the plugin's resources and stops all processing,
+    // e.g. while its track plays a frozen render; resuming prepares it again
+    void setSuspended(bool shouldBeSuspended);
+    bool isSuspended() const { return suspended.load(std::memory_order_acquire); }
+
+    // Applies to every plugin; 0 or less never sleeps
+    static void setSleepAfterSilence(double seconds) { sleepAfterSilenceSeconds.store(seconds); }
+    static double getSleepAfterSilence() { return sleepAfterSilenceSeconds.load(); }
+
+    // Plugins loaded from now on run in their own host process where that is
+    // supported (see RemotePluginInstance), so a crashing plugin can't take
+    // MULO down with it
+    static void setOutOfProcess(bool shouldRunOutOfProcess) { outOfProcess.store(shouldRunOutOfProcess); }
+    static bool isOutOfProcess() { return outOfProcess.load(); }
+    bool isRunningOutOfProcess() const;
+
+    inline void enable() { setEnabled(true); }
+    inline void disable() { setEnabled(false); }
     inline bool enabled() const { return isEnabled; }
 
+    // The owning track's effects node, invalidated when the effect is switched on or off
+    void setStateNode(StateHashNode* node) { stateNode = node; }
+
     const std::string& getName() const { return name; }
     const std::string& getVSTPath() const { return vstPath; }
     
@@ -54,12 +89,26 @@ public:
     int getIndex() const { return index; }
     
     bool isSynthesizer() const;
+    // As reported by the plugin; may be infinite
+    double getTailLengthSeconds() const;
     static bool isVSTSynthesizer(const std::string& vstPath);
     
     void scheduleForCleanup();
     static void cleanupScheduledPlugins();
     bool isScheduledForCleanup() const { return scheduledForCleanup; }
 
+    struct BenchmarkResult {
+        std::string layout;            // plugin channels, e.g. "stereo" or "mono (adapted)"
+        int blockSize;
+        double pluginNanosPerBlock;    // processBlock called directly
+        double effectNanosPerBlock;    // the same plugin through processAudio
+        std::uint64_t allocations;     // in processAudio; counted in MULO_DEBUG_AUDIO_ALLOCATIONS builds only
+    };
+
+    // Times processAudio against a bare processBlock on a pass-through plugin,
+    // so the difference is the wrapper's own cost. Used by `MULO --benchmark-effect`
+    static std::vector<BenchmarkResult> runBenchmark(int numBlocks = 200000);
+
 private:
     std::unique_ptr<juce::AudioPluginInstance> plugin;
     std::string name;
@@ -71,6 +120,53 @@ private:
     mutable bool isSynthesizerCached = false;
     bool scheduledForCleanup = false;
     int index = -1;
+    StateHashNode* stateNode = nullptr;
+
+    void setEnabled(bool shouldBeEnabled) {
+        if (isEnabled != shouldBeEnabled) {
+            isEnabled = shouldBeEnabled;
+            if (stateNode) stateNode->invalidate();
+        }
+    }
+
+    // True when the block can be skipped; the buffer is then cleared
+    bool skipWhileAsleep(juce::AudioBuffer<float>& buffer, bool hasInput);
+    void updateSleep(const juce::AudioBuffer<float>& buffer, bool hadInput);
+    void wake();
+    // prepareToPlay for the stored rate and block size
+    void preparePlugin();
+
+    // Worked out once per prepare, so processing a block never has to look at
+    // the plugin's name or channel layout again
+    struct ProcessingPlan {
+        bool isSynthesizer = false;
+        int pluginInputChannels = 0;
+        int pluginOutputChannels = 0;
+        int adapterChannels = 0; // of adapterBuffer
+    };
+    void buildProcessingPlan();
+    // processBlock, in prepared-size pieces when the block is larger than that
+    void runPlugin(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer);
+    // processBlock, through adapterBuffer when the buffer's channels don't match the plugin's
+    void runPluginBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer);
+
+    ProcessingPlan plan;
+    juce::AudioBuffer<float> adapterBuffer; // sized for the prepared block
+    juce::MidiBuffer effectMidi;            // what the audio-only processAudio hands the plugin
+    juce::MidiBuffer chunkMidi;             // one piece's events, rebased to its start
+    juce::MidiBuffer chunkMidiOut;          // the pieces' events put back together
+
+    std::atomic<bool> asleep { false };
+    juce::int64 silentSamples = 0;
+    double tailSamples = 0.0; // infinite tails never sleep
+    double preparedSampleRate = 44100.0;
+    int preparedBlockSize = 512;
+    std::atomic<bool> suspended { false };
+    std::atomic<std::uint64_t> blocksProcessed { 0 };
+    std::atomic<std::uint64_t> blocksSkipped { 0 };
+    std::atomic<std::uint64_t> timesSlept { 0 };
+    static std::atomic<double> sleepAfterSilenceSeconds;
+    static std::atomic<bool> outOfProcess;
     
     static std::vector<std::unique_ptr<juce::AudioPluginInstance>> scheduledPlugins;
     static std::mutex cleanupMutex;
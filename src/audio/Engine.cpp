@@ -1,15 +1,70 @@
 #include "Engine.hpp"
 #include "AudioTrack.hpp"
 #include "MIDITrack.hpp"
+#include "RemotePluginInstance.hpp"
 #include "Track.hpp"
+#include "StateHasher.hpp"
 #include "../DebugConfig.hpp"
 #include <chrono>
 #include <algorithm>
 #include <cctype>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <thread>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
 
+namespace {
+    // How much of each device callback remote plugins may spend waiting on their hosts
+    constexpr double remotePluginShareOfBlock = 0.8;
+
+    // The longest play() waits for streaming clips to be cued
+    constexpr double maxStreamCueWaitMs = 200.0;
+
+    // A compact document packs the values for a version 2 project; JSON keeps
+    // one {index, value} object per parameter
+    void writeEffectParameters(const Effect& effect, json& effectJson, bool compact) {
+        const int numParams = effect.getNumParameters();
+        if (compact) {
+            std::vector<float> values;
+            values.reserve(static_cast<size_t>(numParams));
+            for (int p = 0; p < numParams; ++p) {
+                values.push_back(effect.getParameter(p));
+            }
+            effectJson["parameterValues"] = json::binary(ProjectFile::packParameters(values));
+            return;
+        }
+
+        auto& parameters = effectJson["parameters"];
+        for (int p = 0; p < numParams; ++p) {
+            json paramJson;
+            paramJson["index"] = p;
+            paramJson["value"] = effect.getParameter(p);
+            parameters.push_back(paramJson);
+        }
+    }
+
+    // Saved parameters in either of the forms writeEffectParameters writes
+    std::vector<std::pair<int, float>> readEffectParameters(const json& effectData) {
+        std::vector<std::pair<int, float>> parameters;
+        if (effectData.contains("parameterValues") && effectData["parameterValues"].is_binary()) {
+            const auto values = ProjectFile::unpackParameters(effectData["parameterValues"].get_binary());
+            for (size_t p = 0; p < values.size(); ++p) {
+                parameters.emplace_back(static_cast<int>(p), values[p]);
+            }
+        } else if (effectData.contains("parameters") && effectData["parameters"].is_array()) {
+            for (const auto& paramData : effectData["parameters"]) {
+                if (paramData.contains("index") && paramData.contains("value")) {
+                    parameters.emplace_back(paramData["index"].get<int>(), paramData["value"].get<float>());
+                }
+            }
+        }
+        return parameters;
+    }
+}
+
 Engine::Engine() {
     formatManager.registerBasicFormats();
     playHead = std::make_unique<EnginePlayHead>();
@@ -40,6 +95,10 @@ Engine::Engine() {
         deviceManager.addMidiInputDeviceCallback(deviceInfo.identifier, this);
     }
 
+    // Clip and effect edits on the tracks we render take the callback lock
+    trackRenderHost.lock = &deviceManager.getAudioCallbackLock();
+    trackRenderHost.retireEffect = [this](std::unique_ptr<Effect> effect) { retireEffect(std::move(effect)); };
+
     masterTrack = std::make_unique<AudioTrack>(formatManager);
     masterTrack->setName("Master");
     selectedTrackName = "Master";
@@ -49,12 +108,16 @@ Engine::Engine() {
     while (!exeDir.isRoot() && !exeDir.getChildFile("assets").isDirectory()) {
         exeDir = exeDir.getParentDirectory();
     }
-    juce::File soundsDir = exeDir.getChildFile("assets").getChildFile("sounds");
+    assetsDirectory = exeDir.getChildFile("assets");
+    juce::File soundsDir = assetsDirectory.getChildFile("sounds");
     metronomeDownbeatFile = soundsDir.getChildFile(metronomeDownbeatSample);
     metronomeUpbeatFile = soundsDir.getChildFile(metronomeUpbeatSample);
+    updateSampleIndexRoots();
     
     auto [timeSigNum, timeSigDen] = getTimeSignature();
     playHead->updatePosition(0.0, 120.0, false, sampleRate, timeSigNum, timeSigDen);
+
+    publishRenderState();
 }
 
 bool Engine::configureAudioDevice(double desiredSampleRate, int bufferSize) {
@@ -90,6 +153,9 @@ bool Engine::configureAudioDevice(double desiredSampleRate, int bufferSize) {
 }
 
 Engine::~Engine() {
+    // The export thread renders straight from our tracks
+    exportRenderer.reset();
+
     auto midiInputs = juce::MidiInput::getAvailableDevices();
     for (const auto& deviceInfo : midiInputs) {
         deviceManager.removeMidiInputDeviceCallback(deviceInfo.identifier, this);
@@ -98,6 +164,206 @@ Engine::~Engine() {
     
     deviceManager.closeAudioDevice();
     deviceManager.removeAudioCallback(this);
+
+    // No callbacks can run any more, so every render state can be freed here
+    adoptPendingRenderStates();
+    if (renderState) {
+        delete renderState;
+        renderState = nullptr;
+        --statesInFlight;
+    }
+    reclaimRetiredState();
+}
+
+void Engine::setRenderThreadCount(int numThreads) {
+    if (numThreads < 0) {
+        numThreads = juce::jmax(0, juce::SystemStats::getNumCpus() - 1);
+    }
+
+    if (numThreads != renderPool->getNumThreads()) {
+        replaceRenderPool(numThreads, renderPool->isUsingRealtimePriority());
+    }
+}
+
+int Engine::getRenderThreadCount() const {
+    return renderPool->getNumThreads();
+}
+
+void Engine::setRealtimeRenderPriority(bool shouldUseRealtime) {
+    if (shouldUseRealtime != renderPool->isUsingRealtimePriority()) {
+        replaceRenderPool(renderPool->getNumThreads(), shouldUseRealtime);
+    }
+}
+
+void Engine::replaceRenderPool(int numThreads, bool useRealtimePriority) {
+    // The workers start here, outside the lock; the callback only waits for the pointer swap
+    auto newPool = std::make_unique<TrackRenderPool>();
+    newPool->setUseRealtimePriority(useRealtimePriority);
+    newPool->setBlockTiming(currentBufferSize, sampleRate);
+    newPool->setNumThreads(numThreads);
+
+    {
+        const juce::ScopedLock lock(deviceManager.getAudioCallbackLock());
+        std::swap(renderPool, newPool);
+    }
+    // The old pool's workers are joined as it goes out of scope, after the lock
+}
+
+void Engine::publishRenderState() {
+    reclaimRetiredState();
+    // Tracks added, removed or replaced
+    compositionStateNode.invalidate();
+
+    auto state = std::make_unique<RenderState>();
+    state->generation = ++publishedGeneration;
+
+    if (currentComposition) {
+        state->tracks.reserve(currentComposition->tracks.size());
+        for (const auto& track : currentComposition->tracks) {
+            if (track) {
+                track->setRenderHost(&trackRenderHost);
+                state->tracks.push_back(track.get());
+            }
+        }
+        state->bpm = currentComposition->bpm;
+        state->timeSigNumerator = currentComposition->timeSigNumerator;
+        state->timeSigDenominator = currentComposition->timeSigDenominator;
+    }
+    for (auto* track : { masterTrack.get(), metronomeTrack.get() }) {
+        if (track) track->setRenderHost(&trackRenderHost);
+    }
+    state->masterTrack = masterTrack.get();
+    state->metronomeTrack = metronomeTrack.get();
+    state->selectedTrack = getSelectedTrackPtr();
+
+    state->trackBuffers.resize(state->tracks.size());
+    for (auto& buffer : state->trackBuffers) {
+        buffer.setSize(2, juce::jmax(1, currentBufferSize));
+    }
+    state->tracksToRender.reserve(state->tracks.size());
+
+    if (!audioDeviceRunning.load(std::memory_order_acquire)) {
+        // Nothing is calling back, so the state can be installed directly
+        const juce::ScopedLock lock(deviceManager.getAudioCallbackLock());
+        if (!audioDeviceRunning.load(std::memory_order_acquire)) {
+            unpublishedState.reset();
+            adoptPendingRenderStates();
+            ++statesInFlight;
+            adoptRenderState(state.release());
+            reclaimRetiredState();
+            return;
+        }
+    }
+
+    // A state that never reached the audio thread is simply superseded
+    unpublishedState = std::move(state);
+    flushUnpublishedState();
+}
+
+void Engine::flushUnpublishedState() {
+    // Waits for the audio thread to hand states back rather than overfill the return queue
+    if (unpublishedState && statesInFlight < maxStatesInFlight && renderStateQueue.push(unpublishedState.get())) {
+        unpublishedState.release();
+        ++statesInFlight;
+    }
+}
+
+void Engine::retireTrack(std::unique_ptr<Track> track) {
+    if (track) {
+        track->setStateParent(nullptr);
+        track->setRenderHost(nullptr);
+        retiredTracks.emplace_back(publishedGeneration + 1, std::move(track));
+    }
+}
+
+void Engine::retireEffect(std::unique_ptr<Effect> effect) {
+    if (effect) {
+        // Render states don't point at effects and the chain changed under the
+        // callback lock, so the state already published is the one to wait for;
+        // waiting for the next would keep a removed plugin open until some
+        // unrelated edit publishes one
+        effect->setStateNode(nullptr);
+        retiredEffects.emplace_back(publishedGeneration, std::move(effect));
+    }
+}
+
+void Engine::reclaimRetiredState() {
+    RenderState* finishedState = nullptr;
+    while (retiredStateQueue.pop(finishedState)) {
+        delete finishedState;
+        --statesInFlight;
+    }
+    flushUnpublishedState();
+
+    // Publish automation and MIDI edited since the last frame
+    if (currentComposition) {
+        for (const auto& track : currentComposition->tracks) {
+            if (!track) continue;
+            track->reclaimAutomation();
+            if (auto* midiTrack = dynamic_cast<MIDITrack*>(track.get())) {
+                midiTrack->reclaimMIDISchedule(currentComposition->bpm);
+            }
+        }
+    }
+    if (masterTrack) masterTrack->reclaimAutomation();
+    if (metronomeTrack) metronomeTrack->reclaimAutomation();
+    finishPendingLoad();
+    reportLoadProgress();
+
+    // An export may still be rendering a removed track
+    if (isExporting()) {
+        return;
+    }
+
+    finishPendingFreeze();
+    thawStaleTracks();
+
+    const auto consumed = consumedGeneration.load(std::memory_order_acquire);
+    retiredTracks.erase(std::remove_if(retiredTracks.begin(), retiredTracks.end(),
+                                       [consumed](const auto& retired) { return retired.first <= consumed; }),
+                        retiredTracks.end());
+    retiredEffects.erase(std::remove_if(retiredEffects.begin(), retiredEffects.end(),
+                                        [consumed](const auto& retired) { return retired.first <= consumed; }),
+                         retiredEffects.end());
+}
+
+std::vector<Engine::PluginSleepInfo> Engine::getPluginSleepStats() const {
+    std::vector<PluginSleepInfo> infos;
+
+    auto addTrack = [&infos](const Track* track) {
+        if (!track) return;
+        for (const auto& effect : track->getEffects()) {
+            if (effect) {
+                infos.push_back({ track->getName(), effect->getName(), effect->getSleepStats() });
+            }
+        }
+    };
+
+    if (currentComposition) {
+        for (const auto& track : currentComposition->tracks) {
+            addTrack(track.get());
+        }
+    }
+    addTrack(masterTrack.get());
+    return infos;
+}
+
+void Engine::adoptRenderState(RenderState* newState) {
+    if (renderState) {
+        // Never full: the publisher keeps no more states in flight than the queue holds plus this one
+        const bool handedBack = retiredStateQueue.push(renderState);
+        jassert(handedBack);
+        juce::ignoreUnused(handedBack);
+    }
+    renderState = newState;
+    consumedGeneration.store(newState->generation, std::memory_order_release);
+}
+
+void Engine::adoptPendingRenderStates() {
+    RenderState* incomingState = nullptr;
+    while (renderStateQueue.pop(incomingState)) {
+        adoptRenderState(incomingState);
+    }
 }
 
 void Engine::setMetronomeEnabled(bool enabled) {
@@ -108,6 +374,7 @@ void Engine::generateMetronomeTrack() {
     if (!currentComposition) {
         currentComposition = std::make_unique<Composition>();
     }
+    retireTrack(std::move(metronomeTrack));
     metronomeTrack = std::make_unique<AudioTrack>(formatManager);
     metronomeTrack->setName("__metronome__");
     metronomeTrack->prepareToPlay(sampleRate, currentBufferSize);
@@ -129,25 +396,30 @@ void Engine::generateMetronomeTrack() {
     if (!hasClips) {
         projectLength = 4 * barLength;
     }
+    // Both clicks are looked up once, not once per beat
+    const bool hasDownbeat = metronomeDownbeatFile.existsAsFile();
+    const bool hasUpbeat = metronomeUpbeatFile.existsAsFile();
+    auto& fileInfo = AudioFileInfoCache::getInstance();
+    const double downbeatLength = hasDownbeat ? fileInfo.getLengthInSeconds(metronomeDownbeatFile, 0.1) : 0.0;
+    const double upbeatLength = hasUpbeat ? fileInfo.getLengthInSeconds(metronomeUpbeatFile, 0.1) : 0.0;
+
     int numBars = static_cast<int>(std::ceil(projectLength / barLength));
     for (int bar = 0; bar < numBars; ++bar) {
         double barStart = bar * barLength;
         for (int beat = 0; beat < num; ++beat) {
             double beatTime = barStart + beat * beatLength;
-            const juce::File& sampleFile = (beat == 0) ? metronomeDownbeatFile : metronomeUpbeatFile;
-            if (sampleFile.existsAsFile()) {
-                double lengthSeconds = 0.1;
-                if (auto* reader = formatManager.createReaderFor(sampleFile)) {
-                    lengthSeconds = static_cast<double>(reader->lengthInSamples) / reader->sampleRate;
-                    delete reader;
-                }
+            if (beat == 0 ? hasDownbeat : hasUpbeat) {
+                const juce::File& sampleFile = (beat == 0) ? metronomeDownbeatFile : metronomeUpbeatFile;
+                const double lengthSeconds = (beat == 0) ? downbeatLength : upbeatLength;
                 metronomeTrack->addClip({sampleFile, beatTime, 0.0, lengthSeconds, 1.0f});
             }
         }
     }
+
+    publishRenderState();
 }
 
-void Engine::exportMaster(const std::string& filePath) {
+OfflineRenderer::Job Engine::makeExportJob(ExportSampleFormat format) {
     double startTime = std::numeric_limits<double>::max();
     double endTime = 0.0;
 
@@ -170,69 +442,77 @@ void Engine::exportMaster(const std::string& filePath) {
     }
     if (startTime == std::numeric_limits<double>::max()) startTime = 0.0;
 
-    int sampleRate = static_cast<int>(getSampleRate());
-    int numChannels = 2;
-    int startSample = static_cast<int>(startTime * sampleRate);
-    int endSample = static_cast<int>(endTime * sampleRate);
-    int totalSamples = endSample - startSample;
+    OfflineRenderer::Job job;
+    job.startSeconds = startTime;
+    job.endSeconds = endTime;
+    job.sampleRate = getSampleRate();
+    job.blockSize = currentBufferSize > 0 ? currentBufferSize : 512; // what the plugins were prepared for
+    job.format = format;
+    job.masterTrack = masterTrack.get();
+    // Clip and effect edits swap under this lock, so they land between blocks
+    job.trackLock = &deviceManager.getAudioCallbackLock();
+
+    bool anyTrackSoloed = false;
+    for (const auto& track : currentComposition->tracks) {
+        if (track && track->isSolo()) {
+            anyTrackSoloed = true;
+            break;
+        }
+    }
+    for (const auto& track : currentComposition->tracks) {
+        if (track) {
+            bool shouldPlay = !anyTrackSoloed ? !track->isMuted() : track->isSolo();
+            if (shouldPlay) {
+                job.tracks.push_back(track.get());
+            }
+        }
+    }
 
-    juce::AudioBuffer<float> outputBuffer(numChannels, totalSamples);
+    const double bpm = getBpm();
+    const auto [timeSigNum, timeSigDen] = getTimeSignature();
+    job.onBlockStart = [this, bpm, timeSigNum, timeSigDen, rate = job.sampleRate](double position) {
+        playHead->updatePosition(position, bpm, true, rate, timeSigNum, timeSigDen);
+    };
+    job.onFinished = [this](const ExportProgress&) {
+        offlineRenderActive.store(false, std::memory_order_release);
+    };
 
-    setPosition(startTime);
+    return job;
+}
 
-    int blockSize = 512;
-    for (int pos = 0; pos < totalSamples; pos += blockSize) {
-        int samplesToProcess = std::min(blockSize, totalSamples - pos);
-        juce::AudioBuffer<float> tempMixBuffer(numChannels, samplesToProcess);
-        tempMixBuffer.clear();
+bool Engine::startExport(OfflineRenderer::Job job) {
+    if (playing) {
+        pause();
+    }
 
-        if (currentComposition) {
-            bool anyTrackSoloed = false;
-            for (const auto& track : currentComposition->tracks) {
-                if (track && track->isSolo()) {
-                    anyTrackSoloed = true;
-                    break;
-                }
-            }
-            for (const auto& track : currentComposition->tracks) {
-                if (track) {
-                    bool shouldPlay = !anyTrackSoloed ? !track->isMuted() : track->isSolo();
-                    if (shouldPlay) {
-                        juce::AudioBuffer<float> trackBuffer(numChannels, samplesToProcess);
-                        trackBuffer.clear();
-                        track->process(positionSeconds, trackBuffer, samplesToProcess, sampleRate);
-                        track->processEffects(trackBuffer);
-                        for (int ch = 0; ch < numChannels; ++ch) {
-                            tempMixBuffer.addFrom(ch, 0, trackBuffer, ch, 0, samplesToProcess);
-                        }
-                    }
-                }
-            }
-        }
+    // Take the tracks away from the device between blocks
+    {
+        const juce::ScopedLock lock(deviceManager.getAudioCallbackLock());
+        offlineRenderActive.store(true, std::memory_order_release);
+    }
 
-        if (masterTrack && !masterTrack->isMuted()) {
-            masterTrack->processEffects(tempMixBuffer);
-            float masterGain = juce::Decibels::decibelsToGain(masterTrack->getVolume());
-            float masterPan = masterTrack->getPan();
-            float panL = std::cos((masterPan + 1.0f) * juce::MathConstants<float>::pi * 0.25f);
-            float panR = std::sin((masterPan + 1.0f) * juce::MathConstants<float>::pi * 0.25f);
-            if (numChannels >= 2) {
-                tempMixBuffer.applyGain(0, 0, samplesToProcess, masterGain * panL);
-                tempMixBuffer.applyGain(1, 0, samplesToProcess, masterGain * panR);
-                for (int ch = 2; ch < numChannels; ++ch)
-                    tempMixBuffer.applyGain(ch, 0, samplesToProcess, masterGain);
-            } else if (numChannels == 1) {
-                tempMixBuffer.applyGain(0, 0, samplesToProcess, masterGain);
-            }
-        }
+    if (!exportRenderer) {
+        exportRenderer = std::make_unique<OfflineRenderer>();
+    }
+
+    const auto outputPath = job.outputFile.getFullPathName();
+    [[maybe_unused]] const auto lengthSeconds = job.endSeconds - job.startSeconds;
+    if (!exportRenderer->start(std::move(job))) {
+        offlineRenderActive.store(false, std::memory_order_release);
+        std::cerr << "Failed to start export to " << outputPath << std::endl;
+        return false;
+    }
 
-        // Copy to output
-        for (int ch = 0; ch < numChannels; ++ch)
-            outputBuffer.copyFrom(ch, pos, tempMixBuffer, ch, 0, samplesToProcess);
-        positionSeconds += samplesToProcess / static_cast<double>(sampleRate);
+    DEBUG_PRINT("Exporting " << lengthSeconds << "s to " << outputPath);
+    return true;
+}
+
+bool Engine::exportMaster(const std::string& directory, ExportSampleFormat format) {
+    if (!currentComposition || isExporting()) {
+        return false;
     }
 
-    juce::String basePath = juce::String(filePath);
+    juce::String basePath = juce::String(directory);
     if (!basePath.endsWithChar('/') && !basePath.endsWithChar('\\'))
         basePath += juce::File::getSeparatorString();
     juce::String fileName = currentComposition->name;
@@ -240,312 +520,454 @@ void Engine::exportMaster(const std::string& filePath) {
         fileName += ".wav";
     juce::File outFile(basePath + fileName);
     outFile = outFile.getNonexistentSibling();
-    outFile.getParentDirectory().createDirectory();
 
-    juce::WavAudioFormat wavFormat;
-    std::unique_ptr<juce::FileOutputStream> stream(outFile.createOutputStream());
-    if (stream) {
-        std::unique_ptr<juce::AudioFormatWriter> writer(
-            wavFormat.createWriterFor(stream.get(), sampleRate, numChannels, 16, {}, 0));
-        if (writer) {
-            writer->writeFromAudioSampleBuffer(outputBuffer, 0, totalSamples);
+    auto job = makeExportJob(format);
+    job.outputFile = outFile;
+    return startExport(std::move(job));
+}
+
+bool Engine::exportStems(const std::string& directory, ExportSampleFormat format) {
+    if (!currentComposition || isExporting()) {
+        return false;
+    }
+
+    // <directory>/<composition> Stems/ holds Master.wav and one file per track
+    juce::File stemDirectory = juce::File(directory)
+        .getChildFile(juce::File::createLegalFileName(currentComposition->name + " Stems"))
+        .getNonexistentSibling();
+
+    auto job = makeExportJob(format);
+    job.outputFile = stemDirectory.getChildFile("Master.wav");
+
+    juce::StringArray usedNames { "master" };
+    for (size_t i = 0; i < job.tracks.size(); ++i) {
+        auto stemName = juce::File::createLegalFileName(job.tracks[i]->getName());
+        if (stemName.isEmpty() || usedNames.contains(stemName.toLowerCase())) {
+            stemName = juce::String(static_cast<int>(i) + 1) + " " + stemName;
         }
-        stream.release();
+        usedNames.add(stemName.toLowerCase());
+        job.stemFiles.push_back(stemDirectory.getChildFile(stemName.trim() + ".wav"));
     }
+
+    return startExport(std::move(job));
 }
 
-// Directory management
-void Engine::setVSTDirectory(const std::string& directory) {
-    vstDirectory = directory;
+void Engine::cancelExport() {
+    if (exportRenderer) {
+        exportRenderer->cancel();
+    }
+    offlineRenderActive.store(false, std::memory_order_release);
 }
 
-void Engine::setSampleDirectory(const std::string& directory) {
-    sampleDirectory = directory;
+bool Engine::freezeTrack(const std::string& trackName) {
+    if (!currentComposition || isExporting() || pendingFreeze) {
+        return false;
+    }
+
+    Track* track = getTrackByName(trackName);
+    if (!track || track->isFrozen()) {
+        return false;
+    }
+
+    // From the first clip to the end of the last, plus room for the plugins' tails
+    double startTime = std::numeric_limits<double>::max();
+    double endTime = 0.0;
+    auto addClipRange = [&startTime, &endTime](double clipStart, double clipDuration) {
+        startTime = std::min(startTime, clipStart);
+        endTime = std::max(endTime, clipStart + clipDuration);
+    };
+    if (auto* midiTrack = dynamic_cast<MIDITrack*>(track)) {
+        for (const auto& clip : midiTrack->getMIDIClips()) addClipRange(clip.startTime, clip.duration);
+    } else {
+        for (const auto& clip : track->getClips()) addClipRange(clip.startTime, clip.duration);
+    }
+    if (endTime <= startTime) {
+        return false;
+    }
+
+    constexpr double minTailSeconds = 2.0;
+    constexpr double maxTailSeconds = 30.0;
+    double tailSeconds = 0.0;
+    for (const auto& effect : track->getEffects()) {
+        if (effect && effect->enabled()) {
+            const double effectTail = effect->getTailLengthSeconds();
+            tailSeconds += std::isfinite(effectTail) ? std::max(0.0, effectTail) : maxTailSeconds;
+        }
+    }
+    endTime += juce::jlimit(minTailSeconds, maxTailSeconds, tailSeconds);
+
+    const auto fingerprint = computeFreezeFingerprint(*track);
+    const auto file = juce::File::getSpecialLocation(juce::File::tempDirectory)
+        .getChildFile("MULO Freeze")
+        .getChildFile(juce::File::createLegalFileName(trackName) + "-"
+                      + juce::String::toHexString(static_cast<juce::int64>(fingerprint)) + ".wav");
+
+    // A muted track renders nothing
+    const bool wasMuted = track->isMuted();
+    if (wasMuted) {
+        track->toggleMute();
+    }
+
+    // Float so the render plays back bit for bit what the chain produced
+    auto job = makeExportJob(ExportSampleFormat::Float32);
+    job.tracks = { track };
+    job.masterTrack = nullptr;
+    job.startSeconds = startTime;
+    job.endSeconds = endTime;
+    job.outputFile = file;
+
+    pendingFreeze = PendingFreeze{ trackName, file, startTime, endTime, fingerprint, wasMuted };
+    if (!startExport(std::move(job))) {
+        pendingFreeze.reset();
+        if (wasMuted) {
+            track->toggleMute();
+        }
+        return false;
+    }
+    return true;
 }
 
-std::string Engine::getVSTDirectory() const {
-    return vstDirectory;
+void Engine::unfreezeTrack(const std::string& trackName) {
+    if (pendingFreeze && pendingFreeze->trackName == trackName) {
+        if (pendingFreeze->clip) {
+            dropPendingFreeze(); // rendered, still loading
+        } else {
+            cancelExport(); // finishPendingFreeze drops it
+        }
+        return;
+    }
+
+    if (Track* track = getTrackByName(trackName)) {
+        thawTrack(*track);
+    }
 }
 
-std::string Engine::getSampleDirectory() const {
-    return sampleDirectory;
+bool Engine::isTrackFrozen(const std::string& trackName) {
+    const Track* track = getTrackByName(trackName);
+    return track && track->isFrozen();
 }
 
-void Engine::markStateChanged() {
-    lastStateChangeTimestamp = std::chrono::duration_cast<std::chrono::seconds>(
-        std::chrono::system_clock::now().time_since_epoch());
-    
-    // Update state hash for efficient change detection
-    lastStateHash = getStateHash();
+std::uint64_t Engine::computeFreezeFingerprint(const Track& track) const {
+    // MIDI and tempo-synced plugins render differently at another tempo
+    StateHasher hasher;
+    hasher.add(track.computeFreezeFingerprint());
+    hasher.add(getBpm());
+    return hasher.get();
 }
 
-std::string Engine::getStateHash() const {
-    if (!currentComposition) {
-        return "empty";
+void Engine::finishPendingFreeze() {
+    if (!pendingFreeze) {
+        return;
     }
-    
-    std::string hashSource = currentComposition->name + 
-                           std::to_string(currentComposition->bpm) + 
-                           std::to_string(currentComposition->tracks.size());
-    
-    for (const auto& track : currentComposition->tracks) {
-        if (track) {
-            hashSource += track->getName();
-            hashSource += std::to_string(static_cast<int>(track->getType()));
-            
-            const auto& clips = track->getClips();
-            hashSource += std::to_string(clips.size());
-            for (const auto& clip : clips) {
-                hashSource += clip.sourceFile.getFileName().toStdString();
-                hashSource += std::to_string(clip.startTime);
-                hashSource += std::to_string(clip.duration);
-            }
-            
-            if (track->getType() == Track::TrackType::MIDI) {
-                auto* midiTrack = dynamic_cast<MIDITrack*>(track.get());
-                if (midiTrack) {
-                    const auto& midiClips = midiTrack->getMIDIClips();
-                    hashSource += std::to_string(midiClips.size());
-                    for (const auto& clip : midiClips) {
-                        hashSource += std::to_string(clip.startTime);
-                        hashSource += std::to_string(clip.duration);
-                        hashSource += std::to_string(clip.midiData.getNumEvents());
-                    }
-                }
-            }
+
+    auto& freeze = *pendingFreeze;
+    Track* track = currentComposition ? getTrackByName(freeze.trackName) : nullptr;
+
+    if (!freeze.clip) {
+        // The render has just finished
+        if (track && freeze.wasMuted && !track->isMuted()) {
+            track->toggleMute();
         }
-    }
-    
-    // Simple hash (for collaboration change detection, not cryptographic security)
-    std::hash<std::string> hasher;
-    return std::to_string(hasher(hashSource));
-}
 
-juce::File Engine::findSampleFile(const std::string& sampleName) const {
-    DEBUG_PRINT("findSampleFile called with: '" + sampleName + "'");
-    
-    if (sampleName.empty()) {
-        DEBUG_PRINT("Empty sample name, returning empty file");
-        return juce::File();
+        // Cancelled, failed, or the track was edited or removed while it rendered
+        const auto progress = getExportProgress();
+        if (!track || progress.cancelled || progress.failed || !freeze.file.existsAsFile()
+            || computeFreezeFingerprint(*track) != freeze.fingerprint) {
+            dropPendingFreeze();
+            return;
+        }
+
+        freeze.clip = std::make_unique<AudioClip>(freeze.file, freeze.startSeconds, 0.0,
+                                                  freeze.endSeconds - freeze.startSeconds, 1.0f);
     }
 
-    if (!sampleDirectory.empty()) {
-        juce::File directory(sampleDirectory);
-        DEBUG_PRINT("Checking user directory: " + directory.getFullPathName().toStdString());
-        if (directory.exists() && directory.isDirectory()) {
-            DEBUG_PRINT("User directory exists and is valid");
-            // First try quick exact match in root directory
-            juce::File exactFile = directory.getChildFile(sampleName);
-            if (exactFile.existsAsFile()) {
-                DEBUG_PRINT("Found exact file in user root directory: " + exactFile.getFullPathName().toStdString());
-                return exactFile;
-            }
-            
-            // Quick extension tries in root directory
-            std::vector<std::string> extensions = {".wav", ".mp3", ".flac", ".ogg", ".aiff", ".m4a"};
-            for (const auto& ext : extensions) {
-                juce::File file = directory.getChildFile(sampleName + ext);
-                if (file.existsAsFile()) {
-                    return file;
-                }
-            }
-            
-            juce::Array<juce::File> allFiles;
-            directory.findChildFiles(allFiles, juce::File::findFiles, true);
-            DEBUG_PRINT("Found " + std::to_string(allFiles.size()) + " files in user directory recursively");
-            
-            for (const auto& file : allFiles) {
-                if (file.getFileName().toStdString() == sampleName) {
-                    DEBUG_PRINT("Found exact match: " + file.getFullPathName().toStdString());
-                    return file;
-                }
-            }
-            
-            for (const auto& ext : extensions) {
-                std::string targetWithExt = sampleName + ext;
-                for (const auto& file : allFiles) {
-                    if (file.getFileName().toStdString() == targetWithExt) {
-                        DEBUG_PRINT("Found file with extension: " + file.getFullPathName().toStdString());
-                        return file;
-                    }
-                }
-            }
-            
-            for (const auto& file : allFiles) {
-                std::string fileName = file.getFileName().toStdString();
-                std::string targetName = sampleName;
-                std::transform(fileName.begin(), fileName.end(), fileName.begin(), ::tolower);
-                std::transform(targetName.begin(), targetName.end(), targetName.begin(), ::tolower);
-                if (fileName == targetName) {
-                    DEBUG_PRINT("Found case-insensitive match: " + file.getFullPathName().toStdString());
-                    return file;
-                }
-                
-                for (const auto& ext : extensions) {
-                    std::string targetWithExt = targetName + ext;
-                    if (fileName == targetWithExt) {
-                        DEBUG_PRINT("Found case-insensitive match with extension: " + file.getFullPathName().toStdString());
-                        return file;
-                    }
-                }
-            }
-            DEBUG_PRINT("No match found in user directory");
-        } else {
-            DEBUG_PRINT("User directory does not exist or is not a directory");
+    // Decoded by the sample pool, or streamed if it's long; asked again each
+    // frame so a change of sample rate starts a fresh load
+    freeze.clip->requestAudioData(formatManager, sampleRate);
+    if (!freeze.clip->pollAudioData(sampleRate)) {
+        if (freeze.clip->hasAudioFailed()) {
+            dropPendingFreeze();
         }
-    } else {
-        DEBUG_PRINT("No user sample directory set");
+        return;
     }
 
-    DEBUG_PRINT("Searching in assets/sounds directory");
-    juce::File exeFile = juce::File::getSpecialLocation(juce::File::SpecialLocationType::currentExecutableFile);
-    juce::File exeDir = exeFile.getParentDirectory();
-    while (!exeDir.isRoot() && !exeDir.getChildFile("assets").isDirectory()) {
-        exeDir = exeDir.getParentDirectory();
+    // Edited or removed while the render loaded
+    if (!track || computeFreezeFingerprint(*track) != freeze.fingerprint) {
+        dropPendingFreeze();
+        return;
     }
-    juce::File soundsDir = exeDir.getChildFile("assets").getChildFile("sounds");
-    DEBUG_PRINT("Assets sounds directory: " + soundsDir.getFullPathName().toStdString());
-    if (soundsDir.exists() && soundsDir.isDirectory()) {
-        DEBUG_PRINT("Assets sounds directory exists and is valid");
-        // Quick exact match in root assets/sounds directory
-        juce::File exactFile = soundsDir.getChildFile(sampleName);
-        if (exactFile.existsAsFile()) {
-            DEBUG_PRINT("Found exact file in assets root: " + exactFile.getFullPathName().toStdString());
-            return exactFile;
-        }
-        
-        // Quick extension tries in root assets/sounds directory
-        std::vector<std::string> extensions = {".wav", ".mp3", ".flac", ".ogg", ".aiff", ".m4a"};
-        for (const auto& ext : extensions) {
-            juce::File file = soundsDir.getChildFile(sampleName + ext);
-            if (file.existsAsFile()) {
-                return file;
-            }
+
+    {
+        const juce::ScopedLock lock(deviceManager.getAudioCallbackLock());
+        track->setFrozenClip(std::move(freeze.clip), freeze.fingerprint);
+        for (auto& effect : track->getEffects()) {
+            if (effect) effect->setSuspended(true);
         }
-        
-        // Comprehensive recursive search
-        juce::Array<juce::File> allFiles;
-        soundsDir.findChildFiles(allFiles, juce::File::findFiles, true); // true = recursive search
-        DEBUG_PRINT("Found " + std::to_string(allFiles.size()) + " files in assets/sounds recursively");
-        
-        // First pass: exact filename match
-        for (const auto& file : allFiles) {
-            if (file.getFileName().toStdString() == sampleName) {
-                DEBUG_PRINT("Found exact match in assets: " + file.getFullPathName().toStdString());
-                return file;
-            }
+    }
+
+    DEBUG_PRINT("[Engine] Froze " << freeze.trackName << " to " << freeze.file.getFullPathName());
+    pendingFreeze.reset();
+}
+
+void Engine::dropPendingFreeze() {
+    if (!pendingFreeze) {
+        return;
+    }
+
+    // The clip goes first, it may hold the file open
+    pendingFreeze->clip.reset();
+    pendingFreeze->file.deleteFile();
+    DEBUG_PRINT("[Engine] Dropped freeze of " << pendingFreeze->trackName);
+    pendingFreeze.reset();
+}
+
+void Engine::thawTrack(Track& track) {
+    if (!track.isFrozen()) {
+        return;
+    }
+
+    // The plugins are prepared again before the track goes back to them
+    for (auto& effect : track.getEffects()) {
+        if (effect) effect->setSuspended(false);
+    }
+
+    std::unique_ptr<AudioClip> frozen;
+    {
+        const juce::ScopedLock lock(deviceManager.getAudioCallbackLock());
+        frozen = track.setFrozenClip(nullptr, 0);
+    }
+
+    const auto file = frozen->sourceFile;
+    frozen.reset();
+    file.deleteFile();
+    DEBUG_PRINT("[Engine] Unfroze " << track.getName());
+}
+
+void Engine::thawStaleTracks() {
+    if (!currentComposition) {
+        return;
+    }
+
+    // Brings every track's cached hash up to date first, so the changed
+    // subtrees are still reported to takeChangedStateSubtrees
+    getStateHash();
+    const bool bpmChanged = getBpm() != freezeCheckedBpm;
+    freezeCheckedBpm = getBpm();
+
+    // Only a track whose inputs moved is fingerprinted again
+    for (const auto& track : currentComposition->tracks) {
+        if (!track || !track->isFrozen()) {
+            continue;
         }
-        
-        // Second pass: filename with extensions
-        for (const auto& ext : extensions) {
-            std::string targetWithExt = sampleName + ext;
-            for (const auto& file : allFiles) {
-                if (file.getFileName().toStdString() == targetWithExt) {
-                    DEBUG_PRINT("Found file with extension in assets: " + file.getFullPathName().toStdString());
-                    return file;
-                }
-            }
+        const bool inputsChanged = track->takeFreezeInputsChanged();
+        if ((inputsChanged || bpmChanged) && computeFreezeFingerprint(*track) != track->getFreezeFingerprint()) {
+            thawTrack(*track);
         }
-        
-        // Third pass: case-insensitive search
-        for (const auto& file : allFiles) {
-            std::string fileName = file.getFileName().toStdString();
-            std::string targetName = sampleName;
-            std::transform(fileName.begin(), fileName.end(), fileName.begin(), ::tolower);
-            std::transform(targetName.begin(), targetName.end(), targetName.begin(), ::tolower);
-            if (fileName == targetName) {
-                DEBUG_PRINT("Found case-insensitive match in assets: " + file.getFullPathName().toStdString());
-                return file;
-            }
-            
-            // Also check with extensions in case-insensitive way
-            for (const auto& ext : extensions) {
-                std::string targetWithExt = targetName + ext;
-                if (fileName == targetWithExt) {
-                    DEBUG_PRINT("Found case-insensitive match with extension in assets: " + file.getFullPathName().toStdString());
-                    return file;
+    }
+}
+
+std::unordered_map<std::string, juce::File> Engine::resolveSampleFiles(const json& composition) const {
+    std::vector<std::string> names;
+    auto addName = [&names](const json& clipData) {
+        if (clipData.is_object() && clipData.contains("file") && clipData["file"].is_string()) {
+            names.push_back(clipData["file"].get<std::string>());
+        }
+    };
+    if (composition.contains("tracks") && composition["tracks"].is_array()) {
+        for (const auto& trackData : composition["tracks"]) {
+            if (trackData.contains("referenceClip")) {
+                addName(trackData["referenceClip"]);
+            }
+            if (trackData.contains("clips") && trackData["clips"].is_array()) {
+                for (const auto& clipData : trackData["clips"]) {
+                    addName(clipData);
                 }
             }
         }
-        DEBUG_PRINT("No match found in assets/sounds");
-    } else {
-        DEBUG_PRINT("Assets sounds directory does not exist or is not a directory");
     }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    names.erase(std::remove(names.begin(), names.end(), std::string()), names.end());
 
-    // 3. Try assets/test_samples folder as fallback for project samples
-    DEBUG_PRINT("Searching in assets/test_samples directory");
-    juce::File testSamplesDir = exeDir.getChildFile("assets").getChildFile("test_samples");
-    DEBUG_PRINT("Test samples directory: " + testSamplesDir.getFullPathName().toStdString());
-    if (testSamplesDir.exists() && testSamplesDir.isDirectory()) {
-        DEBUG_PRINT("Test samples directory exists and is valid");
-        // Quick exact match in test_samples directory
-        juce::File exactFile = testSamplesDir.getChildFile(sampleName);
-        if (exactFile.existsAsFile()) {
-            DEBUG_PRINT("Found exact file in test_samples: " + exactFile.getFullPathName().toStdString());
-            return exactFile;
+    std::vector<juce::File> files(names.size());
+    std::atomic<size_t> nextName { 0 };
+    auto resolve = [&] {
+        for (size_t i = nextName.fetch_add(1); i < names.size(); i = nextName.fetch_add(1)) {
+            files[i] = findSampleFile(names[i]);
         }
-        
-        // Quick extension tries in test_samples directory
-        std::vector<std::string> extensions = {".wav", ".mp3", ".flac", ".ogg", ".aiff", ".m4a"};
-        for (const auto& ext : extensions) {
-            juce::File file = testSamplesDir.getChildFile(sampleName + ext);
-            if (file.existsAsFile()) {
-                DEBUG_PRINT("Found file with extension in test_samples: " + file.getFullPathName().toStdString());
-                return file;
-            }
+    };
+
+    const int numThreads = juce::jmin(static_cast<int>(names.size()), juce::jlimit(1, 8, juce::SystemStats::getNumCpus()));
+    std::vector<std::thread> workers;
+    for (int i = 1; i < numThreads; ++i) {
+        workers.emplace_back(resolve);
+    }
+    resolve();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    std::unordered_map<std::string, juce::File> resolved;
+    resolved.reserve(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        resolved.emplace(names[i], files[i]);
+    }
+    DEBUG_PRINT("[Engine] Resolved " << names.size() << " sample files on " << juce::jmax(1, numThreads) << " threads");
+    return resolved;
+}
+
+Engine::LoadProgress Engine::getLoadProgress() {
+    LoadProgress progress;
+    if (pendingLoad.valid()) {
+        progress.reading = true;
+        progress.loading = true;
+        return progress;
+    }
+    if (!currentComposition) {
+        return progress;
+    }
+
+    auto count = [&progress](const AudioClip& clip) {
+        ++progress.clipsTotal;
+        if (clip.isAudioPending()) {
+            return;
         }
-        
-        // Comprehensive recursive search
-        juce::Array<juce::File> allFiles;
-        testSamplesDir.findChildFiles(allFiles, juce::File::findFiles, true); // true = recursive search
-        DEBUG_PRINT("Found " + std::to_string(allFiles.size()) + " files in test_samples recursively");
-        
-        // First pass: exact filename match
-        for (const auto& file : allFiles) {
-            if (file.getFileName().toStdString() == sampleName) {
-                DEBUG_PRINT("Found exact match in test_samples: " + file.getFullPathName().toStdString());
-                return file;
-            }
+        if (clip.hasAudioFailed()) {
+            ++progress.clipsFailed;
+        } else {
+            ++progress.clipsReady;
         }
-        
-        // Second pass: filename with extensions
-        for (const auto& ext : extensions) {
-            std::string targetWithExt = sampleName + ext;
-            for (const auto& file : allFiles) {
-                if (file.getFileName().toStdString() == targetWithExt) {
-                    DEBUG_PRINT("Found file with extension in test_samples: " + file.getFullPathName().toStdString());
-                    return file;
-                }
-            }
+    };
+    for (const auto& track : currentComposition->tracks) {
+        if (!track) continue;
+        for (const auto& clip : track->getClips()) {
+            count(clip);
         }
-        
-        // Third pass: case-insensitive search
-        for (const auto& file : allFiles) {
-            std::string fileName = file.getFileName().toStdString();
-            std::string targetName = sampleName;
-            std::transform(fileName.begin(), fileName.end(), fileName.begin(), ::tolower);
-            std::transform(targetName.begin(), targetName.end(), targetName.begin(), ::tolower);
-            if (fileName == targetName) {
-                DEBUG_PRINT("Found case-insensitive match in test_samples: " + file.getFullPathName().toStdString());
-                return file;
-            }
-            
-            // Also check with extensions in case-insensitive way
-            for (const auto& ext : extensions) {
-                std::string targetWithExt = targetName + ext;
-                if (fileName == targetWithExt) {
-                    DEBUG_PRINT("Found case-insensitive match with extension in test_samples: " + file.getFullPathName().toStdString());
-                    return file;
-                }
-            }
+        if (auto* referenceClip = track->getReferenceClip()) {
+            count(*referenceClip);
         }
-        DEBUG_PRINT("No match found in test_samples");
-    } else {
-        DEBUG_PRINT("Test samples directory does not exist or is not a directory");
     }
 
-    DEBUG_PRINT("File not found anywhere: '" + sampleName + "'");
-    return juce::File();
+    progress.loading = progress.clipsReady + progress.clipsFailed < progress.clipsTotal;
+    return progress;
+}
+
+void Engine::reportLoadProgress() {
+    if (loadStartedMs <= 0.0) {
+        return;
+    }
+
+    const auto progress = getLoadProgress();
+    if (progress.loading) {
+        return;
+    }
+
+    DEBUG_PRINT("[Engine] Song fully playable " << juce::roundToInt(juce::Time::getMillisecondCounterHiRes() - loadStartedMs)
+                << " ms after load: " << progress.clipsReady << " clips ready, " << progress.clipsFailed << " failed");
+    loadStartedMs = 0.0;
+}
+
+// Directory management
+void Engine::setVSTDirectory(const std::string& directory) {
+    vstDirectory = directory;
+}
+
+void Engine::setSampleDirectory(const std::string& directory) {
+    sampleDirectory = directory;
+    updateSampleIndexRoots();
+}
+
+void Engine::updateSampleIndexRoots() {
+    std::vector<juce::File> roots;
+    if (!sampleDirectory.empty()) {
+        roots.push_back(juce::File(sampleDirectory));
+    }
+    roots.push_back(assetsDirectory.getChildFile("sounds"));
+    roots.push_back(assetsDirectory.getChildFile("test_samples"));
+    sampleIndex.setRoots(roots);
+}
+
+std::string Engine::getVSTDirectory() const {
+    return vstDirectory;
+}
+
+std::string Engine::getSampleDirectory() const {
+    return sampleDirectory;
+}
+
+void Engine::markStateChanged() {
+    lastStateChangeTimestamp = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    
+    // Rehashed the next time anyone asks
+    compositionStateNode.invalidate();
+}
+
+std::string Engine::getStateHash() const {
+    if (!currentComposition) {
+        return "empty";
+    }
+    return std::to_string(compositionStateNode.get([this] { return computeStateHash(); }));
+}
+
+std::uint64_t Engine::computeStateHash() const {
+    StateHasher settings;
+    settings.add(currentComposition->name);
+    settings.add(currentComposition->bpm);
+    settings.add(currentComposition->timeSigNumerator);
+    settings.add(currentComposition->timeSigDenominator);
+    settings.add(currentComposition->tracks.size());
+    for (const auto& track : currentComposition->tracks) {
+        if (track) settings.add(track->getName());
+    }
+    if (settings.get() != compositionSettingsHash) {
+        compositionSettingsHash = settings.get();
+        changedStateSubtrees.insert("composition");
+    }
+
+    StateHasher hasher;
+    hasher.add(settings.get());
+    auto addTrack = [this, &hasher](const Track& track, const std::string& path) {
+        // Tracks join the tree here, so one added by any route is covered
+        track.setStateParent(&compositionStateNode);
+        std::vector<std::string> changed;
+        hasher.add(track.getStateHash(&changed));
+        for (const auto& subtree : changed) {
+            changedStateSubtrees.insert(path + "/" + subtree);
+        }
+    };
+    if (masterTrack) {
+        addTrack(*masterTrack, "master");
+    }
+    for (const auto& track : currentComposition->tracks) {
+        if (track) addTrack(*track, "tracks/" + track->getName());
+    }
+    return hasher.get();
+}
+
+std::vector<std::string> Engine::takeChangedStateSubtrees() {
+    getStateHash();
+    std::vector<std::string> changed(changedStateSubtrees.begin(), changedStateSubtrees.end());
+    changedStateSubtrees.clear();
+    return changed;
+}
+
+juce::File Engine::findSampleFile(const std::string& sampleName) const {
+    DEBUG_PRINT("findSampleFile called with: '" + sampleName + "'");
+    
+    if (sampleName.empty()) {
+        DEBUG_PRINT("Empty sample name, returning empty file");
+        return juce::File();
+    }
+
+    // The user's sample directory first, then assets/sounds, then assets/test_samples
+    juce::File file = sampleIndex.find(sampleName);
+    if (file == juce::File()) {
+        DEBUG_PRINT("File not found anywhere: '" + sampleName + "'");
+    } else {
+        DEBUG_PRINT("Found sample file: " + file.getFullPathName().toStdString());
+    }
+    return file;
 }
 
 juce::File Engine::findVSTFile(const std::string& vstName) const {
@@ -680,7 +1102,7 @@ void Engine::play() {
                         if (clip.startTime <= currentPlayheadTime + 0.1 && clip.getEndTime() >= currentPlayheadTime) {
                             // Check if this clip has MIDI events at its beginning relative to playhead
                             for (const auto& event : clip.midiData) {
-                                double eventTimeInClip = event.samplePosition / 44100.0;
+                                double eventTimeInClip = MIDIClip::ticksToSeconds(event.samplePosition, currentComposition->bpm);
                                 double absoluteEventTime = clip.startTime + eventTimeInClip;
                                 // Check if event happens within 0.1 seconds of current playhead
                                 if (absoluteEventTime >= currentPlayheadTime && absoluteEventTime <= currentPlayheadTime + 0.1) {
@@ -735,6 +1157,7 @@ void Engine::play() {
         DEBUG_PRINT("Synthesizer buffer clearing complete. Silencing for " << SYNTH_SILENCE_CYCLES << " audio cycles.");
     }
     
+    cueStreams(true);
     playing = true;
 }
 
@@ -754,6 +1177,7 @@ void Engine::pause() {
 void Engine::stop() {
     playing = false;
     positionSeconds = 0.0;
+    cueStreams(false);
     
     // Send "All Notes Off" (MIDI CC 123) to all synthesizers to prevent stuck notes
     if (currentComposition) {
@@ -770,6 +1194,32 @@ void Engine::stop() {
 
 void Engine::setPosition(double s) {
     positionSeconds = juce::jmax(0.0, s);
+    cueStreams(false);
+}
+
+void Engine::cueStreams(bool waitForDisk) {
+    // The offline renderer is reading the streams at its own position
+    if (!currentComposition || isExporting()) {
+        return;
+    }
+
+    const double deadlineMs = juce::Time::getMillisecondCounterHiRes() + (waitForDisk ? maxStreamCueWaitMs : 0.0);
+    for (;;) {
+        bool allCued = true;
+        {
+            const juce::ScopedLock lock(deviceManager.getAudioCallbackLock());
+            for (const auto& track : currentComposition->tracks) {
+                if (track) {
+                    allCued = track->cueStreams(positionSeconds, sampleRate) && allCued;
+                }
+            }
+        }
+
+        if (allCued || juce::Time::getMillisecondCounterHiRes() >= deadlineMs) {
+            return;
+        }
+        juce::Thread::sleep(2);
+    }
 }
 
 double Engine::getPosition() const {
@@ -795,6 +1245,11 @@ bool Engine::hasSavedPosition() const {
 
 void Engine::newComposition(const std::string& name) {
     stop();
+    if (currentComposition) {
+        for (auto& track : currentComposition->tracks) {
+            retireTrack(std::move(track));
+        }
+    }
     currentComposition = std::make_unique<Composition>();
     currentComposition->name = name;
     
@@ -809,22 +1264,84 @@ void Engine::newComposition(const std::string& name) {
 
 void Engine::loadComposition(const std::string& path) {
     stop();
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open composition file: " << path << "\n";
+
+    const auto composition = readCompositionFile(path);
+    if (!composition.state.is_null()) {
+        loadReadComposition(composition);
+    }
+}
+
+void Engine::beginLoadComposition(const std::string& path) {
+    if (pendingLoad.valid()) {
+        DEBUG_PRINT("[Engine] Still reading the last project; ignoring " << path);
         return;
     }
+    pendingLoad = std::async(std::launch::async, [path] { return readCompositionFile(path); });
+}
 
-    // Read entire file content
-    std::ostringstream buffer;
-    buffer << file.rdbuf();
-    file.close();
-    
-    std::string content = buffer.str();
-    
-    // Use loadState to parse the JSON format
-    DEBUG_PRINT("Loading project file: " << path);
-    load(content);
+void Engine::finishPendingLoad() {
+    if (!pendingLoad.valid() || pendingLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+
+    const auto composition = pendingLoad.get();
+    if (composition.state.is_null()) {
+        return;
+    }
+    stop();
+    loadReadComposition(composition);
+    generateMetronomeTrack();
+}
+
+void Engine::loadReadComposition(const ReadComposition& composition) {
+    loadingProject = composition.file.get();
+    loadState(composition.state);
+    loadingProject = nullptr;
+}
+
+Engine::ReadComposition Engine::readCompositionFile(const std::string& path) {
+    // Runs on the loader thread, where nothing would catch a throw short of
+    // finishPendingLoad's get(), so a damaged file is reported here instead
+    ReadComposition composition;
+    try {
+        const auto projectFile = juce::File::getCurrentWorkingDirectory().getChildFile(path);
+        if (ProjectFile::isBinaryProject(projectFile)) {
+            auto project = std::make_unique<ProjectFile>(projectFile);
+            if (!project->isValid()) {
+                std::cerr << "Failed to read composition file: " << path << "\n";
+                return composition;
+            }
+            DEBUG_PRINT("Loading version " << project->getVersion() << " project file: " << path);
+            composition.state = project->readState();
+            composition.file = std::move(project);
+            return composition;
+        }
+
+        // Version 1 projects are JSON text
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open composition file: " << path << "\n";
+            return composition;
+        }
+
+        std::ostringstream buffer;
+        buffer << file.rdbuf();
+
+        DEBUG_PRINT("Loading project file: " << path);
+        composition.state = json::parse(buffer.str());
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to read composition file: " << path << ": " << e.what() << "\n";
+        composition = {};
+    }
+    return composition;
+}
+
+const json& Engine::getSavedTrackValue(const json& trackData, const std::string& key) const {
+    static const json empty;
+    if (trackData.contains(key)) {
+        return trackData[key];
+    }
+    return loadingProject ? loadingProject->getTrackValue(trackData, key) : empty;
 }
 
 void Engine::saveComposition(const std::string&) {}
@@ -912,15 +1429,12 @@ void Engine::addTrack(const std::string& name, const std::string& samplePath) {
 
     if (!samplePath.empty() && uniqueName != "Master") {
         juce::File sampleFile(samplePath);
-        double lengthSeconds = 2.0;
-        if (auto* reader = formatManager.createReaderFor(sampleFile)) {
-            lengthSeconds = static_cast<double>(reader->lengthInSamples) / reader->sampleRate;
-            delete reader;
-        }
+        const double lengthSeconds = AudioFileInfoCache::getInstance().getLengthInSeconds(sampleFile, 2.0);
         t->setReferenceClip({sampleFile, 0.0, 0.0, lengthSeconds, 1.0f});
     }
 
     currentComposition->tracks.push_back(std::move(t));
+    publishRenderState();
 }
 
 std::string Engine::addMIDITrack(const std::string& name) {
@@ -947,7 +1461,11 @@ std::string Engine::addMIDITrack(const std::string& name) {
     midiTrack->setName(uniqueName);
     midiTrack->prepareToPlay(sampleRate, currentBufferSize);
     
-    currentComposition->tracks.push_back(std::move(midiTrack));
+    {
+        juce::ScopedLock lock(engineStateLock);
+        currentComposition->tracks.push_back(std::move(midiTrack));
+        publishRenderState();
+    }
     
     DEBUG_PRINT("Added MIDI track '" << uniqueName << "'");
     return uniqueName;
@@ -957,7 +1475,9 @@ void Engine::removeTrack(int idx) {
     juce::ScopedLock lock(engineStateLock);
     
     if (currentComposition && idx >= 0 && idx < currentComposition->tracks.size()) {
+        retireTrack(std::move(currentComposition->tracks[idx]));
         currentComposition->tracks.erase(currentComposition->tracks.begin() + idx);
+        publishRenderState();
         markStateChanged();
     }
 }
@@ -969,8 +1489,9 @@ void Engine::removeTrackByName(const std::string& name) {
         DEBUG_PRINT("Removing track: " << name);
         for (int i = 0; i < currentComposition->tracks.size(); i++) {
             if (currentComposition->tracks[i]->getName() == name) {
-                auto& track = currentComposition->tracks[i];
+                retireTrack(std::move(currentComposition->tracks[i]));
                 currentComposition->tracks.erase(currentComposition->tracks.begin() + i);
+                publishRenderState();
                 markStateChanged();
                 break;
             }
@@ -1027,6 +1548,7 @@ void Engine::setSelectedTrack(const std::string& trackName) {
     // Validate that the track exists (including Master track)
     if (trackName == "Master") {
         selectedTrackName = trackName;
+        publishRenderState();
         return;
     }
     
@@ -1035,6 +1557,7 @@ void Engine::setSelectedTrack(const std::string& trackName) {
         for (const auto& track : currentComposition->tracks) {
             if (track->getName() == trackName) {
                 selectedTrackName = trackName;
+                publishRenderState();
                 return;
             }
         }
@@ -1076,11 +1599,21 @@ void Engine::audioDeviceIOCallbackWithContext(
     float* const* outputChannelData, int numOutputChannels,
     int numSamples, const juce::AudioIODeviceCallbackContext&
 ) {
-    // Try to acquire lock without blocking audio thread
-    if (!engineStateLock.tryEnter()) {
-        // If we can't get the lock, output silence to avoid audio glitches
-        for (int channel = 0; channel < numOutputChannels; ++channel) {
-            juce::FloatVectorOperations::clear(outputChannelData[channel], numSamples);
+    AudioThreadAllocationGuard::ScopedAudioThreadAllocationCheck allocationCheck;
+
+    // Pick up whatever the message thread published since the last block.
+    // Replaced states go back through retiredStateQueue to be freed there.
+    adoptPendingRenderStates();
+    auto* const state = renderState;
+
+    // Remote plugins share most of the block between them; the rest is for mixing
+    RemotePluginInstance::setRealtimeDeadline(juce::Time::getMillisecondCounterHiRes()
+                                              + remotePluginShareOfBlock * 1000.0 * numSamples / juce::jmax(1.0, sampleRate));
+
+    // The offline renderer is driving the tracks and plugins right now
+    if (offlineRenderActive.load(std::memory_order_acquire)) {
+        for (int ch = 0; ch < numOutputChannels; ++ch) {
+            juce::FloatVectorOperations::clear(outputChannelData[ch], numSamples);
         }
         return;
     }
@@ -1096,10 +1629,10 @@ void Engine::audioDeviceIOCallbackWithContext(
         if (synthSilenceCountdown == 0) {
             // Re-enable all synthesizers after silence period
             DEBUG_PRINT("Re-enabling synthesizers after silence period");
-            if (currentComposition) {
-                for (const auto& track : currentComposition->tracks) {
-                    if (track && track->getType() == Track::TrackType::MIDI) {
-                        auto midiTrack = dynamic_cast<MIDITrack*>(track.get());
+            if (state) {
+                for (auto* track : state->tracks) {
+                    if (track->getType() == Track::TrackType::MIDI) {
+                        auto midiTrack = dynamic_cast<MIDITrack*>(track);
                         if (midiTrack) {
                             for (const auto& effect : midiTrack->getEffects()) {
                                 if (effect && effect->enabled() && effect->isSynthesizer()) {
@@ -1110,8 +1643,8 @@ void Engine::audioDeviceIOCallbackWithContext(
                     }
                 }
                 // Also handle master track synthesizers
-                if (masterTrack) {
-                    for (const auto& effect : masterTrack->getEffects()) {
+                if (state->masterTrack) {
+                    for (const auto& effect : state->masterTrack->getEffects()) {
                         if (effect && effect->enabled() && effect->isSynthesizer()) {
                             effect->setSilenced(false);
                         }
@@ -1130,20 +1663,17 @@ void Engine::audioDeviceIOCallbackWithContext(
             DEBUG_PRINT("Processing real-time MIDI messages");
             
             // Update AudioPlayHead with current tempo for real-time MIDI processing
-            if (playHead && currentComposition) {
-                double currentBpm = currentComposition->bpm;
-                auto [timeSigNum, timeSigDen] = getTimeSignature();
-                playHead->updatePosition(positionSeconds, currentBpm, false, sampleRate, timeSigNum, timeSigDen);
+            if (playHead && state) {
+                playHead->updatePosition(positionSeconds, state->bpm, false, sampleRate, state->timeSigNumerator, state->timeSigDenominator);
             }
             
-            auto selectedTrack = getSelectedTrackPtr();
+            auto selectedTrack = state ? state->selectedTrack : nullptr;
             if (selectedTrack) {
                 auto midiTrack = dynamic_cast<MIDITrack*>(selectedTrack);
                 if (midiTrack) {
                     DEBUG_PRINT("Sending MIDI to track: " << midiTrack->getName());
                     // Process real-time MIDI through the selected MIDI track
-                    juce::AudioBuffer<float> realtimeBuffer(numOutputChannels, numSamples);
-                    realtimeBuffer.clear();
+                    auto realtimeBuffer = mixScratch.get(RealtimeScratch, numOutputChannels, numSamples);
                     
                     // Process MIDI directly without any processing modifications
                     for (const auto& effect : midiTrack->getEffects()) {
@@ -1167,27 +1697,25 @@ void Engine::audioDeviceIOCallbackWithContext(
     }
 
     // 0.5. Process synthesizers continuously to maintain audio (only when NOT playing to avoid interference)
-    if (!playing && currentComposition) {
+    if (!playing && state) {
         // Update play head even when not playing so synthesizers have correct tempo
-        double currentBpm = getBpm();
         double sampleRate = getSampleRate();
-        auto [timeSigNum, timeSigDen] = getTimeSignature();
-        playHead->updatePosition(positionSeconds, currentBpm, playing, sampleRate, timeSigNum, timeSigDen);
+        playHead->updatePosition(positionSeconds, state->bpm, playing, sampleRate, state->timeSigNumerator, state->timeSigDenominator);
         
-        juce::AudioBuffer<float> synthBuffer(numOutputChannels, numSamples);
+        auto synthBuffer = mixScratch.get(SynthScratch, numOutputChannels, numSamples);
         juce::MidiBuffer emptyMidiBuffer; // Empty MIDI buffer for continuous processing
         
         // Get selected track to avoid double processing
-        auto selectedTrack = getSelectedTrackPtr();
+        auto selectedTrack = state->selectedTrack;
         
-        for (const auto& track : currentComposition->tracks) {
-            if (track && track->getType() == Track::TrackType::MIDI) {
-                auto midiTrack = dynamic_cast<MIDITrack*>(track.get());
+        for (auto* track : state->tracks) {
+            if (track->getType() == Track::TrackType::MIDI) {
+                auto midiTrack = dynamic_cast<MIDITrack*>(track);
                 if (midiTrack && (!midiTrack->isMuted())) {
                     
                     // Skip the selected track if we just processed real-time MIDI for it
                     // This prevents double processing and audio conflicts
-                    if (processedRealtimeMidi && track.get() == selectedTrack) {
+                    if (processedRealtimeMidi && track == selectedTrack) {
                         DEBUG_PRINT("Skipping continuous synthesis for selected track to avoid conflicts");
                         continue;
                     }
@@ -1212,56 +1740,71 @@ void Engine::audioDeviceIOCallbackWithContext(
     }
 
     // 1. Process main composition if the transport is playing.
-    if (playing && currentComposition)
+    if (playing && state)
     {
         // Update play head with current position and tempo
-        double currentBpm = getBpm();
         double sampleRate = getSampleRate();
-        auto [timeSigNum, timeSigDen] = getTimeSignature();
-        playHead->updatePosition(positionSeconds, currentBpm, playing, sampleRate, timeSigNum, timeSigDen);
+        playHead->updatePosition(positionSeconds, state->bpm, playing, sampleRate, state->timeSigNumerator, state->timeSigDenominator);
         
-        juce::AudioBuffer<float> trackBuffer(numOutputChannels, numSamples);
         bool anyTrackSoloed = false;
-        for (const auto& track : currentComposition->tracks) {
-            if (track && track->isSolo()) {
+        for (auto* track : state->tracks) {
+            if (track->isSolo()) {
                 anyTrackSoloed = true;
                 break;
             }
         }
-        for (const auto& track : currentComposition->tracks) {
-            if (track) {
-                bool shouldPlay = !anyTrackSoloed ? !track->isMuted() : track->isSolo();
-                if (shouldPlay) {
-                    // Create a fresh buffer for each track to avoid cross-contamination
-                    juce::AudioBuffer<float> isolatedTrackBuffer(2, numSamples);
-                    isolatedTrackBuffer.clear();
-                    
-                    track->applyAutomation(positionSeconds);
-                    track->process(positionSeconds, isolatedTrackBuffer, numSamples, sampleRate);
-                                 
-                    // Check for audio output from this track
-                    float trackPeak = 0.0f;
-                    for (int ch = 0; ch < 2; ++ch) {
-                        for (int i = 0; i < numSamples; ++i) {
-                            trackPeak = std::max(trackPeak, std::abs(isolatedTrackBuffer.getSample(ch, i)));
-                        }
-                    }
-                    if (trackPeak > 0.001f) { // Only log if there's significant audio
-                        DEBUG_PRINT("Track '" << track->getName() << "' peak: " << trackPeak);
-                    }
-                    
-                    // Mix the stereo track buffer into the output buffer
-                    for (int ch = 0; ch < numOutputChannels; ++ch) {
-                        int sourceChannel = ch % 2; // Map multi-channel outputs to stereo sources
-                        tempMixBuffer.addFrom(ch, 0, isolatedTrackBuffer, sourceChannel, 0, numSamples);
-                    }
-                }
+
+        auto& tracksToRender = state->tracksToRender;
+        tracksToRender.clear();
+        for (auto* track : state->tracks) {
+            bool shouldPlay = !anyTrackSoloed ? !track->isMuted() : track->isSolo();
+            if (shouldPlay) {
+                tracksToRender.push_back(track);
+            }
+        }
+
+        // Each track renders into its own buffer, so tracks can run on any thread
+        const double blockPosition = positionSeconds;
+        auto renderTrack = [state, blockPosition, numSamples, sampleRate](int index) {
+            AudioThreadAllocationGuard::ScopedAudioThreadAllocationCheck allocationCheck;
+
+            auto* track = state->tracksToRender[static_cast<size_t>(index)];
+            auto& isolatedTrackBuffer = state->trackBuffers[static_cast<size_t>(index)];
+            if (isolatedTrackBuffer.getNumSamples() < numSamples) {
+                isolatedTrackBuffer.setSize(2, numSamples, false, false, true);
+            }
+
+            juce::AudioBuffer<float> trackView(isolatedTrackBuffer.getArrayOfWritePointers(), 2, numSamples);
+            trackView.clear();
+
+            track->applyAutomation(blockPosition, numSamples, sampleRate);
+            track->process(blockPosition, trackView, numSamples, sampleRate);
+        };
+        renderPool->run(static_cast<int>(tracksToRender.size()), renderTrack);
+
+        // Sum in track order so the mix is identical regardless of thread count
+        for (size_t i = 0; i < tracksToRender.size(); ++i) {
+            const auto& isolatedTrackBuffer = state->trackBuffers[i];
+
+#ifdef MULO_DEBUG
+            float trackPeak = 0.0f;
+            for (int ch = 0; ch < 2; ++ch) {
+                trackPeak = std::max(trackPeak, isolatedTrackBuffer.getMagnitude(ch, 0, numSamples));
+            }
+            if (trackPeak > 0.001f) { // Only log if there's significant audio
+                DEBUG_PRINT("Track '" << tracksToRender[i]->getName() << "' peak: " << trackPeak);
+            }
+#endif
+
+            // Mix the stereo track buffer into the output buffer
+            for (int ch = 0; ch < numOutputChannels; ++ch) {
+                int sourceChannel = ch % 2; // Map multi-channel outputs to stereo sources
+                tempMixBuffer.addFrom(ch, 0, isolatedTrackBuffer, sourceChannel, 0, numSamples);
             }
         }
-        if (metronomeTrack) {
-            juce::AudioBuffer<float> metronomeBuffer(numOutputChannels, numSamples);
-            metronomeBuffer.clear();
-            metronomeTrack->process(positionSeconds, metronomeBuffer, numSamples, sampleRate);
+        if (auto* metronome = state->metronomeTrack) {
+            auto metronomeBuffer = mixScratch.get(MetronomeScratch, numOutputChannels, numSamples);
+            metronome->process(positionSeconds, metronomeBuffer, numSamples, sampleRate);
             
             // Only mix into output if metronome is enabled
             if (metronomeEnabled) {
@@ -1276,7 +1819,7 @@ void Engine::audioDeviceIOCallbackWithContext(
     // 2. Process and mix the one-shot preview sound (ALWAYS).
     if (previewSource && previewTransport.isPlaying())
     {
-        juce::AudioBuffer<float> previewBuffer(numOutputChannels, numSamples); // stack-allocated
+        auto previewBuffer = mixScratch.get(PreviewScratch, numOutputChannels, numSamples);
         juce::AudioSourceChannelInfo previewInfo(&previewBuffer, 0, numSamples);
         previewTransport.getNextAudioBlock(previewInfo);
         for (int ch = 0; ch < numOutputChannels; ++ch) {
@@ -1285,11 +1828,12 @@ void Engine::audioDeviceIOCallbackWithContext(
     }
 
     // 3. Apply master track effects and gain to the final mix.
-    if (masterTrack && !masterTrack->isMuted())
+    auto* const master = state ? state->masterTrack : nullptr;
+    if (master && !master->isMuted())
     {
-        masterTrack->processEffects(tempMixBuffer);
-        float masterGain = juce::Decibels::decibelsToGain(masterTrack->getVolume());
-        float masterPan = masterTrack->getPan();
+        master->processEffects(tempMixBuffer);
+        float masterGain = juce::Decibels::decibelsToGain(master->getVolume());
+        float masterPan = master->getPan();
         float panL = std::cos((masterPan + 1.0f) * juce::MathConstants<float>::pi * 0.25f);
         float panR = std::sin((masterPan + 1.0f) * juce::MathConstants<float>::pi * 0.25f);
         if (numOutputChannels >= 2) {
@@ -1307,15 +1851,19 @@ void Engine::audioDeviceIOCallbackWithContext(
     for (int ch = 0; ch < numOutputChannels; ++ch) {
         out.copyFrom(ch, 0, tempMixBuffer, ch, 0, numSamples);
     }
-    
-    // Release the engine state lock
-    engineStateLock.exit();
 }
 
 std::string Engine::getStateString() const {
     if (!currentComposition) {
         return "{}";
     }
+    return getState(false).dump(2); // Pretty print with 2-space indentation
+}
+
+json Engine::getState(bool compact) const {
+    if (!currentComposition) {
+        return json::object();
+    }
     
     json engineState;
     engineState["engineState"]["version"] = "1.0";
@@ -1359,14 +1907,7 @@ std::string Engine::getStateString() const {
                 effectJson["index"] = effect->getIndex();
                 
                 // Effect parameters
-                auto& parameters = effectJson["parameters"];
-                int numParams = effect->getNumParameters();
-                for (int p = 0; p < numParams; ++p) {
-                    json paramJson;
-                    paramJson["index"] = p;
-                    paramJson["value"] = effect->getParameter(p);
-                    parameters.push_back(paramJson);
-                }
+                writeEffectParameters(*effect, effectJson, compact);
                 masterEffects.push_back(effectJson);
             }
         }
@@ -1508,20 +2049,23 @@ std::string Engine::getStateString() const {
                     clipJson["velocity"] = clip.velocity;
                     clipJson["channel"] = clip.channel;
                     clipJson["transpose"] = clip.transpose;
+                    clipJson["ticksPerQuarterNote"] = MIDIClip::ticksPerQuarterNote;
                     
                     DEBUG_PRINT("    Serialized MIDI clip at " + std::to_string(clip.startTime) + 
                                " with " + std::to_string(clip.midiData.getNumEvents()) + " MIDI events");
                     
                     // Serialize MIDI data if present
-                    if (!clip.midiData.isEmpty()) {
+                    if (compact) {
+                        clipJson["midiData"] = json::binary(ProjectFile::packMidi(clip.midiData));
+                    } else if (!clip.midiData.isEmpty()) {
                         auto& midiDataJson = clipJson["midiData"];
                         juce::MidiBuffer::Iterator iterator(clip.midiData);
                         juce::MidiMessage message;
-                        int samplePosition;
+                        int tick;
                         
-                        while (iterator.getNextEvent(message, samplePosition)) {
+                        while (iterator.getNextEvent(message, tick)) {
                             json eventJson;
-                            eventJson["samplePosition"] = samplePosition;
+                            eventJson["tick"] = tick;
                             eventJson["rawData"] = std::vector<uint8_t>(message.getRawData(), 
                                                                        message.getRawData() + message.getRawDataSize());
                             midiDataJson.push_back(eventJson);
@@ -1554,14 +2098,7 @@ std::string Engine::getStateString() const {
                 effectJson["isSynthesizer"] = effect->isSynthesizer();
                 
                 // Effect parameters
-                auto& parameters = effectJson["parameters"];
-                int numParams = effect->getNumParameters();
-                for (int p = 0; p < numParams; ++p) {
-                    json paramJson;
-                    paramJson["index"] = p;
-                    paramJson["value"] = effect->getParameter(p);
-                    parameters.push_back(paramJson);
-                }
+                writeEffectParameters(*effect, effectJson, compact);
                 
                 // Add to appropriate array based on type
                 if (effect->isSynthesizer()) {
@@ -1648,11 +2185,20 @@ std::string Engine::getStateString() const {
     }
     DEBUG_PRINT("SERIALIZATION: Total clips being serialized: " + std::to_string(totalClips));
 
-    return engineState.dump(2); // Pretty print with 2-space indentation
+    return engineState;
 }
 
 void Engine::save(const std::string& path) const {
     DEBUG_PRINT("Engine::save called with path: " << path);
+
+    // JSON stays the export format; everything else is saved as a version 2 project
+    const auto projectFile = juce::File::getCurrentWorkingDirectory().getChildFile(path);
+    if (!projectFile.hasFileExtension("json")) {
+        if (ProjectFile::write(getState(true), projectFile)) {
+            DEBUG_PRINT("Engine state written to file: " << path);
+        }
+        return;
+    }
     
     std::string stateString = getStateString();
     
@@ -1669,8 +2215,6 @@ void Engine::save(const std::string& path) const {
 }
 
 void Engine::load(const std::string& stateData) {
-    juce::ScopedLock lock(engineStateLock);
-    
     if (stateData.empty()) {
         DEBUG_PRINT("Engine::loadState called with empty state string");
         return;
@@ -1678,20 +2222,73 @@ void Engine::load(const std::string& stateData) {
     
     DEBUG_PRINT("Engine::loadState called with state size: " + std::to_string(stateData.size()));
     
-    // Mark that state is changing
-    markStateChanged();
-    
+    json parsedState;
     try {
-        json parsedState = json::parse(stateData);
-        
-        if (!parsedState.contains("engineState")) {
-            DEBUG_PRINT("ERROR: No engineState section found in JSON");
-            return;
-        }
-        
-        const auto& engineState = parsedState["engineState"];
-        
-        // Skip playback state - keep local playback state independent
+        parsedState = json::parse(stateData);
+    } catch (const json::parse_error& e) {
+        DEBUG_PRINT("JSON parse error in loadState: " + std::string(e.what()));
+        return;
+    }
+    loadState(parsedState);
+}
+
+std::vector<std::uint8_t> Engine::getStateBinary() const {
+    if (!currentComposition) {
+        return {};
+    }
+    return json::to_msgpack(getState(true));
+}
+
+void Engine::loadStateBinary(const std::vector<std::uint8_t>& state) {
+    json parsedState;
+    try {
+        parsedState = json::from_msgpack(state);
+    } catch (const json::exception& e) {
+        DEBUG_PRINT("MessagePack error in loadStateBinary: " + std::string(e.what()));
+        return;
+    }
+    loadState(parsedState);
+}
+
+void Engine::applyState(const std::string& stateData) {
+    json parsedState;
+    try {
+        parsedState = json::parse(stateData);
+    } catch (const json::parse_error& e) {
+        DEBUG_PRINT("JSON parse error in applyState: " + std::string(e.what()));
+        return;
+    }
+    patchState(parsedState);
+}
+
+void Engine::applyStateBinary(const std::vector<std::uint8_t>& state) {
+    json parsedState;
+    try {
+        parsedState = json::from_msgpack(state);
+    } catch (const json::exception& e) {
+        DEBUG_PRINT("MessagePack error in applyStateBinary: " + std::string(e.what()));
+        return;
+    }
+    patchState(parsedState);
+}
+
+void Engine::loadState(const json& parsedState) {
+    juce::ScopedLock lock(engineStateLock);
+    
+    // Mark that state is changing
+    markStateChanged();
+    
+    try {
+        loadStartedMs = juce::Time::getMillisecondCounterHiRes();
+        
+        if (!parsedState.contains("engineState")) {
+            DEBUG_PRINT("ERROR: No engineState section found in JSON");
+            return;
+        }
+        
+        const auto& engineState = parsedState["engineState"];
+        
+        // Skip playback state - keep local playback state independent
         // This allows each user to have their own playback position, selected track, etc.
         
         // Load audio settings
@@ -1735,9 +2332,23 @@ void Engine::load(const std::string& stateData) {
             // Load master track
             if (composition.contains("masterTrack")) {
                 const auto& masterTrackData = composition["masterTrack"];
+                const bool replacesMasterEffects = masterTrackData.contains("effects") && masterTrackData["effects"].is_array();
                 
-                if (!masterTrack) {
-                    masterTrack = std::make_unique<AudioTrack>(formatManager);
+                // Swap in a fresh master rather than clearing its chain in place;
+                // the audio thread keeps the old one until the new state is published
+                if (!masterTrack || replacesMasterEffects) {
+                    auto freshMaster = std::make_unique<AudioTrack>(formatManager);
+                    if (masterTrack) {
+                        freshMaster->setName(masterTrack->getName());
+                        freshMaster->setVolume(masterTrack->getVolume());
+                        freshMaster->setPan(masterTrack->getPan());
+                        if (masterTrack->isMuted()) {
+                            freshMaster->toggleMute();
+                        }
+                        freshMaster->setSolo(masterTrack->isSolo());
+                        retireTrack(std::move(masterTrack));
+                    }
+                    masterTrack = std::move(freshMaster);
                 }
                 
                 if (masterTrackData.contains("name")) {
@@ -1760,8 +2371,7 @@ void Engine::load(const std::string& stateData) {
                 }
                 
                 // Load master track effects
-                if (masterTrackData.contains("effects") && masterTrackData["effects"].is_array()) {
-                    masterTrack->clearEffects();
+                if (replacesMasterEffects) {
                     for (const auto& effectData : masterTrackData["effects"]) {
                         if (effectData.contains("vstName")) {
                             std::string vstName = effectData["vstName"].get<std::string>();
@@ -1784,15 +2394,7 @@ void Engine::load(const std::string& stateData) {
                                 }
                                 
                                 // Extract parameters
-                                if (effectData.contains("parameters") && effectData["parameters"].is_array()) {
-                                    for (const auto& paramData : effectData["parameters"]) {
-                                        if (paramData.contains("index") && paramData.contains("value")) {
-                                            int paramIndex = paramData["index"].get<int>();
-                                            float paramValue = paramData["value"].get<float>();
-                                            pendingEffect.parameters.emplace_back(paramIndex, paramValue);
-                                        }
-                                    }
-                                }
+                                pendingEffect.parameters = readEffectParameters(effectData);
                                 
                                 pendingEffects.push_back(pendingEffect);
                                 DEBUG_PRINT("Queued effect for deferred loading: " + vstName + " for Master track");
@@ -1804,8 +2406,7 @@ void Engine::load(const std::string& stateData) {
                 }
                 
                 // Store master track automation data
-                if (masterTrackData.contains("automation")) {
-                    const auto& automationJson = masterTrackData["automation"];
+                if (const auto& automationJson = getSavedTrackValue(masterTrackData, "automation"); automationJson.is_object()) {
                     for (const auto& [effectName, parameterMap] : automationJson.items()) {
                         for (const auto& [parameterName, pointsArray] : parameterMap.items()) {
                             if (pointsArray.is_array()) {
@@ -1838,509 +2439,996 @@ void Engine::load(const std::string& stateData) {
                 }
             }
             
+            // Every file lookup up front and in parallel; a lookup may wait for the sample index's first scan
+            const auto resolvedSampleFiles = resolveSampleFiles(composition);
+            auto findResolvedSampleFile = [this, &resolvedSampleFiles](const std::string& fileName) {
+                auto it = resolvedSampleFiles.find(fileName);
+                return it != resolvedSampleFiles.end() ? it->second : findSampleFile(fileName);
+            };
+            
             // Load tracks
             if (composition.contains("tracks") && composition["tracks"].is_array()) {
+                for (auto& oldTrack : currentComposition->tracks) {
+                    retireTrack(std::move(oldTrack));
+                }
                 currentComposition->tracks.clear();
                 
                 for (const auto& trackData : composition["tracks"]) {
                     if (!trackData.contains("name")) continue;
                     
-                    std::string trackName = trackData["name"].get<std::string>();
-                    std::string trackType = trackData.value("type", "audio"); // Default to audio for backward compatibility
-                    DEBUG_PRINT("Loading track: '" + trackName + "' of type: '" + trackType + "'");
-                    
-                    std::unique_ptr<Track> track;
-                    if (trackType == "midi") {
-                        track = std::make_unique<MIDITrack>();
+                    auto track = buildTrackFromState(trackData, findResolvedSampleFile);
+                    DEBUG_PRINT("Track loaded and finalized: " + track->getName());
+                    currentComposition->tracks.push_back(std::move(track));
+                }
+            }
+        }
+        
+        // Prepare master track for playback
+        if (masterTrack) {
+            masterTrack->prepareToPlay(sampleRate, currentBufferSize);
+        }
+        
+        DEBUG_PRINT("Engine state loaded successfully using nlohmann::json");
+        DEBUG_PRINT("Composition: " + (currentComposition ? currentComposition->name : "null"));
+        DEBUG_PRINT("Tracks loaded: " + std::to_string(currentComposition ? currentComposition->tracks.size() : 0));
+        DEBUG_PRINT("Selected track: " + selectedTrackName);
+        
+        applyPendingEffectsAndAutomation();
+
+        // Send BPM to all loaded synthesizers after project load
+        sendBpmToSynthesizers();
+        
+        // Debug: Count total clips loaded across all tracks
+        int totalClipsLoaded = 0;
+        for (const auto& t : currentComposition->tracks) {
+            totalClipsLoaded += t->getClips().size();
+        }
+        DEBUG_PRINT("*** LOAD COMPLETE: Total clips loaded across all tracks: " + std::to_string(totalClipsLoaded));
+        
+    } catch (const json::parse_error& e) {
+        DEBUG_PRINT("JSON parse error in loadState: " + std::string(e.what()));
+    } catch (const json::exception& e) {
+        DEBUG_PRINT("JSON error in loadState: " + std::string(e.what()));
+    } catch (const std::exception& e) {
+        DEBUG_PRINT("Error in loadState: " + std::string(e.what()));
+    }
+
+    publishRenderState();
+}
+
+std::unique_ptr<Track> Engine::buildTrackFromState(const json& trackData, const std::function<juce::File(const std::string&)>& findResolvedSampleFile) {
+    std::string trackName = trackData["name"].get<std::string>();
+    std::string trackType = trackData.value("type", "audio"); // Default to audio for backward compatibility
+    DEBUG_PRINT("Loading track: '" + trackName + "' of type: '" + trackType + "'");
+    
+    std::unique_ptr<Track> track;
+    if (trackType == "midi") {
+        track = std::make_unique<MIDITrack>();
+    } else {
+        track = std::make_unique<AudioTrack>(formatManager);
+    }
+    
+    track->setName(trackName);
+    
+    if (trackData.contains("volume")) {
+        track->setVolume(trackData["volume"].get<float>());
+    }
+    if (trackData.contains("pan")) {
+        track->setPan(trackData["pan"].get<float>());
+    }
+    if (trackData.contains("muted")) {
+        bool shouldMute = trackData["muted"].get<bool>();
+        if (shouldMute != track->isMuted()) {
+            track->toggleMute();
+        }
+    }
+    if (trackData.contains("soloed")) {
+        track->setSolo(trackData["soloed"].get<bool>());
+    }
+    
+    // Load reference clip
+    if (trackData.contains("referenceClip") && !trackData["referenceClip"].is_null()) {
+        const auto& refClipData = trackData["referenceClip"];
+        if (refClipData.contains("file")) {
+            std::string fileName = refClipData["file"].get<std::string>();
+            juce::File file = findResolvedSampleFile(fileName);
+            
+            if (file.existsAsFile()) {
+                AudioClip refClip;
+                refClip.sourceFile = file;
+                if (refClipData.contains("startTime")) {
+                    refClip.startTime = refClipData["startTime"].get<double>();
+                }
+                if (refClipData.contains("offset")) {
+                    refClip.offset = refClipData["offset"].get<double>();
+                }
+                if (refClipData.contains("duration")) {
+                    refClip.duration = refClipData["duration"].get<double>();
+                }
+                if (refClipData.contains("volume")) {
+                    refClip.volume = refClipData["volume"].get<float>();
+                }
+                
+                // Only audio tracks can have reference clips
+                if (trackType == "audio") {
+                    auto* audioTrack = dynamic_cast<AudioTrack*>(track.get());
+                    if (audioTrack) {
+                        audioTrack->setReferenceClip(refClip);
+                    }
+                }
+            } else {
+                DEBUG_PRINT("Reference clip file not found: " + fileName);
+            }
+        }
+    }
+    
+    // Load clips - handle both audio and MIDI
+    if (trackData.contains("clips") && trackData["clips"].is_array()) {
+        DEBUG_PRINT("Loading " + std::to_string(trackData["clips"].size()) + " clips for track: " + trackName);
+        for (const auto& clipData : trackData["clips"]) {
+            if (trackType == "audio") {
+                // Load audio clip
+        if (clipData.contains("file")) {
+            std::string fileName = clipData["file"].get<std::string>();
+            DEBUG_PRINT("Loading audio clip file: '" + fileName + "'");
+            juce::File file = findResolvedSampleFile(fileName);
+            
+            if (file.existsAsFile()) {
+                DEBUG_PRINT("Successfully found audio clip file: " + file.getFullPathName().toStdString());
+                AudioClip clip;
+                        clip.sourceFile = file;
+                        if (clipData.contains("startTime")) {
+                            clip.startTime = clipData["startTime"].get<double>();
+                        }
+                        if (clipData.contains("offset")) {
+                            clip.offset = clipData["offset"].get<double>();
+                        }
+                        if (clipData.contains("duration")) {
+                            clip.duration = clipData["duration"].get<double>();
+                        }
+                        if (clipData.contains("volume")) {
+                            clip.volume = clipData["volume"].get<float>();
+                        }
+                        
+                        track->addClip(clip);
+                        DEBUG_PRINT("Successfully added audio clip to track: " + trackName);
                     } else {
-                        track = std::make_unique<AudioTrack>(formatManager);
+                        DEBUG_PRINT("Audio clip file not found: " + fileName);
                     }
+                }
+            } else if (trackType == "midi") {
+                // Load MIDI clip
+                auto* midiTrack = dynamic_cast<MIDITrack*>(track.get());
+                if (midiTrack) {
+                    DEBUG_PRINT("Loading MIDI clip for track: " + trackName);
+                    midiTrack->addMIDIClip(readMIDIClipState(clipData, findResolvedSampleFile));
+                    DEBUG_PRINT("Successfully added MIDI clip to track: " + trackName);
+                }
+            }
+        }
+    }
+    
+    // Load track effects
+    if (trackData.contains("effects") && trackData["effects"].is_array()) {
+        for (const auto& effectData : trackData["effects"]) {
+            if (effectData.contains("vstName") || effectData.contains("vstPath")) {
+                std::string vstName = effectData.value("vstName", "");
+                std::string vstPath = effectData.value("vstPath", "");
+                DEBUG_PRINT("Loading track effect: '" + vstName + "' for track: " + trackName);
+                
+                // Find VST file
+                juce::File vstFile;
+                if (!vstPath.empty() && juce::File(vstPath).existsAsFile()) {
+                    vstFile = juce::File(vstPath);
+                } else if (!vstName.empty()) {
+                    vstFile = findVSTFile(vstName);
+                }
+                
+                if (vstFile.exists()) {
+                    DEBUG_PRINT("Successfully found track effect file: " + vstFile.getFullPathName().toStdString());
+                    // Store effect for deferred loading
+                    PendingEffect pendingEffect;
+                    pendingEffect.trackName = trackName;
+                    pendingEffect.vstPath = vstFile.getFullPathName().toStdString();
+                    pendingEffect.enabled = effectData.value("enabled", true);
+                    pendingEffect.index = effectData.value("index", 0);
                     
-                    track->setName(trackName);
+                    // Extract parameters
+                    pendingEffect.parameters = readEffectParameters(effectData);
                     
-                    if (trackData.contains("volume")) {
-                        track->setVolume(trackData["volume"].get<float>());
-                    }
-                    if (trackData.contains("pan")) {
-                        track->setPan(trackData["pan"].get<float>());
-                    }
-                    if (trackData.contains("muted")) {
-                        bool shouldMute = trackData["muted"].get<bool>();
-                        if (shouldMute != track->isMuted()) {
-                            track->toggleMute();
-                        }
-                    }
-                    if (trackData.contains("soloed")) {
-                        track->setSolo(trackData["soloed"].get<bool>());
-                    }
+                    pendingEffects.push_back(pendingEffect);
+                } else {
+                    DEBUG_PRINT("Effect file not found: " + vstName + " / " + vstPath);
+                }
+            }
+        }
+    }
+    
+    // Check if track has synthesizers to load
+    if (trackData.contains("synthesizers") && trackData["synthesizers"].is_array()) {
+        auto& synthArray = trackData["synthesizers"];
+        DEBUG_PRINT("Found synthesizers array for track: '" + trackName + "' with " + std::to_string(synthArray.size()) + " synthesizers");
+        
+        // Load synthesizers onto this track (not create new tracks)
+        for (const auto& synthData : synthArray) {
+            if (synthData.contains("vstName") || synthData.contains("vstPath")) {
+                std::string vstName = synthData.value("vstName", "");
+                std::string vstPath = synthData.value("vstPath", "");
+                DEBUG_PRINT("Loading synthesizer '" + vstName + "' onto track: '" + trackName + "'");
+                
+                // Find VST file
+                juce::File vstFile;
+                if (!vstPath.empty() && juce::File(vstPath).existsAsFile()) {
+                    vstFile = juce::File(vstPath);
+                } else if (!vstName.empty()) {
+                    vstFile = findVSTFile(vstName);
+                }
+                
+                if (vstFile.exists()) {
+                    DEBUG_PRINT("Successfully found synthesizer file: " + vstFile.getFullPathName().toStdString());
                     
-                    // Load reference clip
-                    if (trackData.contains("referenceClip") && !trackData["referenceClip"].is_null()) {
-                        const auto& refClipData = trackData["referenceClip"];
-                        if (refClipData.contains("file")) {
-                            std::string fileName = refClipData["file"].get<std::string>();
-                            juce::File file = findSampleFile(fileName);
+                    // Load the synthesizer onto this track
+                    if (track && track.get()) {
+                        if (Effect* synthEffect = track->addEffect(vstFile.getFullPathName().toStdString())) {
+                            DEBUG_PRINT("Successfully loaded synthesizer '" + vstName + "' onto track '" + trackName + "'");
                             
-                            if (file.existsAsFile()) {
-                                AudioClip refClip;
-                                refClip.sourceFile = file;
-                                if (refClipData.contains("startTime")) {
-                                    refClip.startTime = refClipData["startTime"].get<double>();
-                                }
-                                if (refClipData.contains("offset")) {
-                                    refClip.offset = refClipData["offset"].get<double>();
-                                }
-                                if (refClipData.contains("duration")) {
-                                    refClip.duration = refClipData["duration"].get<double>();
-                                }
-                                if (refClipData.contains("volume")) {
-                                    refClip.volume = refClipData["volume"].get<float>();
-                                }
-                                
-                                // Only audio tracks can have reference clips
-                                if (trackType == "audio") {
-                                    auto* audioTrack = dynamic_cast<AudioTrack*>(track.get());
-                                    if (audioTrack) {
-                                        audioTrack->setReferenceClip(refClip);
-                                    }
-                                }
+                            // Set enabled state
+                            if (synthData.value("enabled", true)) {
+                                synthEffect->enable();
                             } else {
-                                DEBUG_PRINT("Reference clip file not found: " + fileName);
+                                synthEffect->disable();
                             }
-                        }
-                    }
-                    
-                    // Load clips - handle both audio and MIDI
-                    if (trackData.contains("clips") && trackData["clips"].is_array()) {
-                        DEBUG_PRINT("Loading " + std::to_string(trackData["clips"].size()) + " clips for track: " + trackName);
-                        for (const auto& clipData : trackData["clips"]) {
-                            if (trackType == "audio") {
-                                // Load audio clip
-                        if (clipData.contains("file")) {
-                            std::string fileName = clipData["file"].get<std::string>();
-                            DEBUG_PRINT("Loading audio clip file: '" + fileName + "'");
-                            juce::File file = findSampleFile(fileName);
                             
-                            if (file.existsAsFile()) {
-                                DEBUG_PRINT("Successfully found audio clip file: " + file.getFullPathName().toStdString());
-                                AudioClip clip;
-                                        clip.sourceFile = file;
-                                        if (clipData.contains("startTime")) {
-                                            clip.startTime = clipData["startTime"].get<double>();
-                                        }
-                                        if (clipData.contains("offset")) {
-                                            clip.offset = clipData["offset"].get<double>();
-                                        }
-                                        if (clipData.contains("duration")) {
-                                            clip.duration = clipData["duration"].get<double>();
-                                        }
-                                        if (clipData.contains("volume")) {
-                                            clip.volume = clipData["volume"].get<float>();
-                                        }
-                                        
-                                        track->addClip(clip);
-                                        DEBUG_PRINT("Successfully added audio clip to track: " + trackName);
-                                    } else {
-                                        DEBUG_PRINT("Audio clip file not found: " + fileName);
-                                    }
-                                }
-                            } else if (trackType == "midi") {
-                                // Load MIDI clip
-                                auto* midiTrack = dynamic_cast<MIDITrack*>(track.get());
-                                if (midiTrack) {
-                                    MIDIClip midiClip;
-                                    DEBUG_PRINT("Loading MIDI clip for track: " + trackName);
-                                    
-                                    if (clipData.contains("file") && !clipData["file"].get<std::string>().empty()) {
-                                        std::string fileName = clipData["file"].get<std::string>();
-                                        juce::File file = findSampleFile(fileName);
-                                        if (file.existsAsFile()) {
-                                            midiClip.sourceFile = file;
-                                            midiClip.loadFromFile(file);
-                                        }
-                                    }
-                                    
-                                    if (clipData.contains("startTime")) {
-                                        midiClip.startTime = clipData["startTime"].get<double>();
-                                    }
-                                    if (clipData.contains("offset")) {
-                                        midiClip.offset = clipData["offset"].get<double>();
-                                    }
-                                    if (clipData.contains("duration")) {
-                                        midiClip.duration = clipData["duration"].get<double>();
-                                    }
-                                    if (clipData.contains("velocity")) {
-                                        midiClip.velocity = clipData["velocity"].get<float>();
-                                    }
-                                    if (clipData.contains("channel")) {
-                                        midiClip.channel = clipData["channel"].get<int>();
-                                    }
-                                    if (clipData.contains("transpose")) {
-                                        midiClip.transpose = clipData["transpose"].get<int>();
-                                    }
-                                    
-                                    // Load MIDI data
-                                    if (clipData.contains("midiData") && clipData["midiData"].is_array()) {
-                                        midiClip.midiData.clear();
-                                        DEBUG_PRINT("Loading " + std::to_string(clipData["midiData"].size()) + " MIDI events");
-                                        for (const auto& eventData : clipData["midiData"]) {
-                                            if (eventData.contains("samplePosition") && eventData.contains("rawData")) {
-                                                int samplePosition = eventData["samplePosition"].get<int>();
-                                                std::vector<uint8_t> rawData = eventData["rawData"].get<std::vector<uint8_t>>();
-                                                
-                                                if (!rawData.empty()) {
-                                                    juce::MidiMessage message(rawData.data(), static_cast<int>(rawData.size()));
-                                                    midiClip.midiData.addEvent(message, samplePosition);
-                                                }
-                                            }
-                                        }
-                                    }
-                                    
-                                    midiTrack->addMIDIClip(midiClip);
-                                    DEBUG_PRINT("Successfully added MIDI clip to track: " + trackName);
-                                }
-                            }
-                        }
-                    }
-                    
-                    // Load track effects
-                    if (trackData.contains("effects") && trackData["effects"].is_array()) {
-                        for (const auto& effectData : trackData["effects"]) {
-                            if (effectData.contains("vstName") || effectData.contains("vstPath")) {
-                                std::string vstName = effectData.value("vstName", "");
-                                std::string vstPath = effectData.value("vstPath", "");
-                                DEBUG_PRINT("Loading track effect: '" + vstName + "' for track: " + trackName);
-                                
-                                // Find VST file
-                                juce::File vstFile;
-                                if (!vstPath.empty() && juce::File(vstPath).existsAsFile()) {
-                                    vstFile = juce::File(vstPath);
-                                } else if (!vstName.empty()) {
-                                    vstFile = findVSTFile(vstName);
-                                }
-                                
-                                if (vstFile.exists()) {
-                                    DEBUG_PRINT("Successfully found track effect file: " + vstFile.getFullPathName().toStdString());
-                                    // Store effect for deferred loading
-                                    PendingEffect pendingEffect;
-                                    pendingEffect.trackName = trackName;
-                                    pendingEffect.vstPath = vstFile.getFullPathName().toStdString();
-                                    pendingEffect.enabled = effectData.value("enabled", true);
-                                    pendingEffect.index = effectData.value("index", 0);
-                                    
-                                    // Extract parameters
-                                    if (effectData.contains("parameters") && effectData["parameters"].is_array()) {
-                                        for (const auto& paramData : effectData["parameters"]) {
-                                            if (paramData.contains("index") && paramData.contains("value")) {
-                                                int paramIndex = paramData["index"].get<int>();
-                                                float paramValue = paramData["value"].get<float>();
-                                                pendingEffect.parameters.emplace_back(paramIndex, paramValue);
-                                            }
-                                        }
-                                    }
-                                    
-                                    pendingEffects.push_back(pendingEffect);
-                                } else {
-                                    DEBUG_PRINT("Effect file not found: " + vstName + " / " + vstPath);
-                                }
-                            }
-                        }
-                    }
-                    
-                    // Check if track has synthesizers to load
-                    if (trackData.contains("synthesizers") && trackData["synthesizers"].is_array()) {
-                        auto& synthArray = trackData["synthesizers"];
-                        DEBUG_PRINT("Found synthesizers array for track: '" + trackName + "' with " + std::to_string(synthArray.size()) + " synthesizers");
-                        
-                        // Load synthesizers onto this track (not create new tracks)
-                        for (const auto& synthData : synthArray) {
-                            if (synthData.contains("vstName") || synthData.contains("vstPath")) {
-                                std::string vstName = synthData.value("vstName", "");
-                                std::string vstPath = synthData.value("vstPath", "");
-                                DEBUG_PRINT("Loading synthesizer '" + vstName + "' onto track: '" + trackName + "'");
-                                
-                                // Find VST file
-                                juce::File vstFile;
-                                if (!vstPath.empty() && juce::File(vstPath).existsAsFile()) {
-                                    vstFile = juce::File(vstPath);
-                                } else if (!vstName.empty()) {
-                                    vstFile = findVSTFile(vstName);
-                                }
-                                
-                                if (vstFile.exists()) {
-                                    DEBUG_PRINT("Successfully found synthesizer file: " + vstFile.getFullPathName().toStdString());
-                                    
-                                    // Load the synthesizer onto this track
-                                    if (track && track.get()) {
-                                        if (Effect* synthEffect = track->addEffect(vstFile.getFullPathName().toStdString())) {
-                                            DEBUG_PRINT("Successfully loaded synthesizer '" + vstName + "' onto track '" + trackName + "'");
-                                            
-                                            // Set enabled state
-                                            if (synthData.value("enabled", true)) {
-                                                synthEffect->enable();
-                                            } else {
-                                                synthEffect->disable();
-                                            }
-                                            
-                                            // Apply saved parameters
-                                            if (synthData.contains("parameters") && synthData["parameters"].is_array()) {
-                                                for (const auto& paramData : synthData["parameters"]) {
-                                                    if (paramData.contains("index") && paramData.contains("value")) {
-                                                        int paramIndex = paramData["index"].get<int>();
-                                                        float paramValue = paramData["value"].get<float>();
-                                                        synthEffect->setParameter(paramIndex, paramValue);
-                                                    }
-                                                }
-                                            }
-                                        } else {
-                                            DEBUG_PRINT("Failed to load synthesizer '" + vstName + "' onto track '" + trackName + "'");
-                                        }
-                                    } else {
-                                        DEBUG_PRINT("Track pointer is invalid for synthesizer loading");
-                                    }
-                                } else {
-                                    DEBUG_PRINT("Synthesizer file not found: " + vstName + " / " + vstPath);
-                                }
+                            // Apply saved parameters
+                            for (const auto& [paramIndex, paramValue] : readEffectParameters(synthData)) {
+                                synthEffect->setParameter(paramIndex, paramValue);
                             }
+                        } else {
+                            DEBUG_PRINT("Failed to load synthesizer '" + vstName + "' onto track '" + trackName + "'");
                         }
                     } else {
-                        DEBUG_PRINT("No synthesizers array found for track: '" + trackName + "'");
+                        DEBUG_PRINT("Track pointer is invalid for synthesizer loading");
                     }
-                    
-                    // Store automation data for deferred loading after effects are processed
-                    if (trackData.contains("automation")) {
-                        const auto& automationJson = trackData["automation"];
-                        for (const auto& [effectName, parameterMap] : automationJson.items()) {
-                            for (const auto& [parameterName, pointsArray] : parameterMap.items()) {
-                                if (pointsArray.is_array()) {
-                                    // Collect all points for this parameter first
-                                    std::vector<Track::AutomationPoint> points;
-                                    for (const auto& pointJson : pointsArray) {
-                                        if (pointJson.contains("time") && pointJson.contains("value")) {
-                                            Track::AutomationPoint point;
-                                            point.time = pointJson["time"].get<double>();
-                                            point.value = pointJson["value"].get<float>();
-                                            point.curve = pointJson.value("curve", 0.0f);
-                                            points.push_back(point);
-                                        }
-                                    }
-                                    
-                                    if (!points.empty() && 
-                                        (points.size() > 1 || (points.size() == 1 && points[0].time >= 0.0))) {
-                                        PendingAutomation pendingAuto;
-                                        pendingAuto.trackName = trackName;
-                                        pendingAuto.effectName = effectName;
-                                        pendingAuto.parameterName = parameterName;
-                                        pendingAuto.points = points;
-                                        pendingAutomation.push_back(pendingAuto);
-                                        DEBUG_PRINT("Stored pending automation for track '" + trackName + 
-                                                   "', effect '" + effectName + "', parameter '" + parameterName + 
-                                                   "' with " + std::to_string(points.size()) + " points");
-                                    }
-                                }
-                            }
+                } else {
+                    DEBUG_PRINT("Synthesizer file not found: " + vstName + " / " + vstPath);
+                }
+            }
+        }
+    } else {
+        DEBUG_PRINT("No synthesizers array found for track: '" + trackName + "'");
+    }
+    
+    // Store automation data for deferred loading after effects are processed
+    if (const auto& automationJson = getSavedTrackValue(trackData, "automation"); automationJson.is_object()) {
+        for (const auto& [effectName, parameterMap] : automationJson.items()) {
+            for (const auto& [parameterName, pointsArray] : parameterMap.items()) {
+                if (pointsArray.is_array()) {
+                    // Collect all points for this parameter first
+                    std::vector<Track::AutomationPoint> points;
+                    for (const auto& pointJson : pointsArray) {
+                        if (pointJson.contains("time") && pointJson.contains("value")) {
+                            Track::AutomationPoint point;
+                            point.time = pointJson["time"].get<double>();
+                            point.value = pointJson["value"].get<float>();
+                            point.curve = pointJson.value("curve", 0.0f);
+                            points.push_back(point);
                         }
                     }
                     
-                    // Load automated parameters order (for UI consistency)
-                    if (trackData.contains("automatedParameters") && trackData["automatedParameters"].is_array()) {
-                        // The automation points are already loaded above, this would be for order preservation
-                        // Current Track API doesn't support reordering, but points are loaded correctly
+                    if (!points.empty() && 
+                        (points.size() > 1 || (points.size() == 1 && points[0].time >= 0.0))) {
+                        PendingAutomation pendingAuto;
+                        pendingAuto.trackName = trackName;
+                        pendingAuto.effectName = effectName;
+                        pendingAuto.parameterName = parameterName;
+                        pendingAuto.points = points;
+                        pendingAutomation.push_back(pendingAuto);
+                        DEBUG_PRINT("Stored pending automation for track '" + trackName + 
+                                   "', effect '" + effectName + "', parameter '" + parameterName + 
+                                   "' with " + std::to_string(points.size()) + " points");
                     }
+                }
+            }
+        }
+    }
+    
+    // Load automated parameters order (for UI consistency)
+    if (trackData.contains("automatedParameters") && trackData["automatedParameters"].is_array()) {
+        // The automation points are already loaded above, this would be for order preservation
+        // Current Track API doesn't support reordering, but points are loaded correctly
+    }
+    
+    // Prepare track for playback
+    track->prepareToPlay(sampleRate, currentBufferSize);
+    
+    // Debug: Count clips on this track
+    int clipCount = 0;
+    if (track->getType() == Track::TrackType::Audio) {
+        clipCount = track->getClips().size();
+    } else if (track->getType() == Track::TrackType::MIDI) {
+        auto* midiTrack = dynamic_cast<MIDITrack*>(track.get());
+        if (midiTrack) {
+            clipCount = midiTrack->getMIDIClips().size();
+        }
+    }
+    DEBUG_PRINT("LOADING: Track '" + trackName + "' loaded with " + std::to_string(clipCount) + " clips");
+    
+    return track;
+}
+
+MIDIClip Engine::readMIDIClipState(const json& clipData, const std::function<juce::File(const std::string&)>& findResolvedSampleFile) const {
+    MIDIClip midiClip;
+    if (clipData.contains("file") && !clipData["file"].get<std::string>().empty()) {
+        std::string fileName = clipData["file"].get<std::string>();
+        juce::File file = findResolvedSampleFile(fileName);
+        if (file.existsAsFile()) {
+            midiClip.sourceFile = file;
+            midiClip.loadFromFile(file);
+        }
+    }
+    
+    if (clipData.contains("startTime")) {
+        midiClip.startTime = clipData["startTime"].get<double>();
+    }
+    if (clipData.contains("offset")) {
+        midiClip.offset = clipData["offset"].get<double>();
+    }
+    if (clipData.contains("duration")) {
+        midiClip.duration = clipData["duration"].get<double>();
+    }
+    if (clipData.contains("velocity")) {
+        midiClip.velocity = clipData["velocity"].get<float>();
+    }
+    if (clipData.contains("channel")) {
+        midiClip.channel = clipData["channel"].get<int>();
+    }
+    if (clipData.contains("transpose")) {
+        midiClip.transpose = clipData["transpose"].get<int>();
+    }
+    
+    // Load MIDI data
+    if (clipData.contains("midiData") && clipData["midiData"].is_array()) {
+        midiClip.midiData.clear();
+        DEBUG_PRINT("Loading " + std::to_string(clipData["midiData"].size()) + " MIDI events");
+        const int savedTicksPerQuarterNote = juce::jmax(1, clipData.value("ticksPerQuarterNote", MIDIClip::ticksPerQuarterNote));
+        for (const auto& eventData : clipData["midiData"]) {
+            if (!eventData.contains("rawData")) continue;
+
+            int tick = 0;
+            if (eventData.contains("tick")) {
+                tick = static_cast<int>(std::lround(eventData["tick"].get<double>() * MIDIClip::ticksPerQuarterNote / savedTicksPerQuarterNote));
+            } else if (eventData.contains("samplePosition")) {
+                // Older projects stored positions as samples at 44.1 kHz
+                tick = MIDIClip::secondsToTicks(eventData["samplePosition"].get<int>() / 44100.0, currentComposition->bpm);
+            } else {
+                continue;
+            }
+
+            std::vector<uint8_t> rawData = eventData["rawData"].get<std::vector<uint8_t>>();
+            if (!rawData.empty()) {
+                juce::MidiMessage message(rawData.data(), static_cast<int>(rawData.size()));
+                midiClip.midiData.addEvent(message, tick);
+            }
+        }
+    } else if (clipData.contains("midiData") && clipData["midiData"].is_binary()) {
+        // Packed by a version 2 project
+        midiClip.midiData.clear();
+        const int savedTicksPerQuarterNote = juce::jmax(1, clipData.value("ticksPerQuarterNote", MIDIClip::ticksPerQuarterNote));
+        ProjectFile::forEachMidiEvent(clipData["midiData"].get_binary(), [&](int savedTick, const std::uint8_t* data, int size) {
+            const int tick = static_cast<int>(std::lround(static_cast<double>(savedTick) * MIDIClip::ticksPerQuarterNote / savedTicksPerQuarterNote));
+            midiClip.midiData.addEvent(data, size, tick);
+        });
+    } else if (loadingProject && clipData.contains("midiRange")) {
+        // Left in a version 2 project by ProjectFile::readState
+        midiClip.midiData.clear();
+        const int savedTicksPerQuarterNote = juce::jmax(1, clipData.value("ticksPerQuarterNote", MIDIClip::ticksPerQuarterNote));
+        loadingProject->forEachClipMidiEvent(clipData, [&](int savedTick, const std::uint8_t* data, int size) {
+            const int tick = static_cast<int>(std::lround(static_cast<double>(savedTick) * MIDIClip::ticksPerQuarterNote / savedTicksPerQuarterNote));
+            midiClip.midiData.addEvent(data, size, tick);
+        });
+    }
+    
+    return midiClip;
+}
+
+void Engine::applyPendingEffectsAndAutomation() {
+    // Process pending effects and synthesizers
+    DEBUG_PRINT("Processing " + std::to_string(pendingEffects.size()) + " pending effects");
+    for (const auto& pendingEffect : pendingEffects) {
+        // Classified from the plugin database, so the plugin is only instantiated once, below
+        const auto pluginEntry = PluginDatabase::getInstance().find(pendingEffect.vstPath);
+        if (pluginEntry) {
+            bool isSynth = pluginEntry->isSynthesizer;
+            
+            if (isSynth) {
+                // Create a new track for synthesizer
+                DEBUG_PRINT("Creating new track for synthesizer: " + pendingEffect.vstPath);
+                if (currentComposition) {
+                    auto newTrack = std::make_unique<AudioTrack>(formatManager);
+                    newTrack->setName(pendingEffect.trackName);
+                    newTrack->prepareToPlay(sampleRate, currentBufferSize);
                     
-                    // Prepare track for playback and add to composition
-                    track->prepareToPlay(sampleRate, currentBufferSize);
-                    
-                    // Debug: Count clips on this track
-                    int clipCount = 0;
-                    if (track->getType() == Track::TrackType::Audio) {
-                        clipCount = track->getClips().size();
-                    } else if (track->getType() == Track::TrackType::MIDI) {
-                        auto* midiTrack = dynamic_cast<MIDITrack*>(track.get());
-                        if (midiTrack) {
-                            clipCount = midiTrack->getMIDIClips().size();
+                    // Load the synthesizer as an effect on the new track
+                    auto synthEffect = newTrack->addEffect(pendingEffect.vstPath);
+                    if (synthEffect) {
+                        if (pendingEffect.enabled) {
+                            synthEffect->enable();
+                        } else {
+                            synthEffect->disable();
+                        }
+                        // Apply parameters
+                        for (const auto& param : pendingEffect.parameters) {
+                            synthEffect->setParameter(param.first, param.second);
                         }
                     }
-                    DEBUG_PRINT("LOADING: Track '" + trackName + "' loaded with " + std::to_string(clipCount) + " clips");
                     
-                    currentComposition->tracks.push_back(std::move(track));
-                    DEBUG_PRINT("Track loaded and finalized: " + trackName);
+                    currentComposition->tracks.push_back(std::move(newTrack));
                 }
-            }
-        }
-        
-        // Prepare master track for playback
-        if (masterTrack) {
-            masterTrack->prepareToPlay(sampleRate, currentBufferSize);
-        }
-        
-        DEBUG_PRINT("Engine state loaded successfully using nlohmann::json");
-        DEBUG_PRINT("Composition: " + (currentComposition ? currentComposition->name : "null"));
-        DEBUG_PRINT("Tracks loaded: " + std::to_string(currentComposition ? currentComposition->tracks.size() : 0));
-        DEBUG_PRINT("Selected track: " + selectedTrackName);
-        
-        // Process pending effects and synthesizers
-        DEBUG_PRINT("Processing " + std::to_string(pendingEffects.size()) + " pending effects");
-        for (const auto& pendingEffect : pendingEffects) {
-            // Check if this VST is a synthesizer by loading it temporarily
-            juce::File vstFile(pendingEffect.vstPath);
-            auto tempEffect = std::make_unique<Effect>();
-            if (tempEffect->loadVST(pendingEffect.vstPath)) {
-                bool isSynth = tempEffect->isSynthesizer();
-                tempEffect.reset(); // Clean up temporary effect
-                
-                if (isSynth) {
-                    // Create a new track for synthesizer
-                    DEBUG_PRINT("Creating new track for synthesizer: " + pendingEffect.vstPath);
-                    if (currentComposition) {
-                        auto newTrack = std::make_unique<AudioTrack>(formatManager);
-                        newTrack->setName(pendingEffect.trackName);
-                        newTrack->prepareToPlay(sampleRate, currentBufferSize);
-                        
-                        // Load the synthesizer as an effect on the new track
-                        auto synthEffect = newTrack->addEffect(pendingEffect.vstPath);
-                        if (synthEffect) {
+            } else {
+                // Regular effect - add to existing track
+                if (pendingEffect.trackName == "Master") {
+                    // Load effect on master track
+                    if (masterTrack) {
+                        DEBUG_PRINT("Loading effect on master track: " + pendingEffect.vstPath);
+                        auto effect = masterTrack->addEffect(pendingEffect.vstPath);
+                        if (effect) {
                             if (pendingEffect.enabled) {
-                                synthEffect->enable();
+                                effect->enable();
                             } else {
-                                synthEffect->disable();
+                                effect->disable();
                             }
                             // Apply parameters
                             for (const auto& param : pendingEffect.parameters) {
-                                synthEffect->setParameter(param.first, param.second);
+                                effect->setParameter(param.first, param.second);
                             }
                         }
-                        
-                        currentComposition->tracks.push_back(std::move(newTrack));
                     }
                 } else {
-                    // Regular effect - add to existing track
-                    if (pendingEffect.trackName == "Master") {
-                        // Load effect on master track
-                        if (masterTrack) {
-                            DEBUG_PRINT("Loading effect on master track: " + pendingEffect.vstPath);
-                            auto effect = masterTrack->addEffect(pendingEffect.vstPath);
-                            if (effect) {
-                                if (pendingEffect.enabled) {
-                                    effect->enable();
-                                } else {
-                                    effect->disable();
-                                }
-                                // Apply parameters
-                                for (const auto& param : pendingEffect.parameters) {
-                                    effect->setParameter(param.first, param.second);
-                                }
-                            }
-                        }
-                    } else {
-                        // Find the track and load effect
-                        if (currentComposition) {
-                            for (auto& track : currentComposition->tracks) {
-                                if (track && track->getName() == pendingEffect.trackName) {
-                                    DEBUG_PRINT("Loading effect on track '" + pendingEffect.trackName + "': " + pendingEffect.vstPath);
-                                    auto effect = track->addEffect(pendingEffect.vstPath);
-                                    if (effect) {
-                                        if (pendingEffect.enabled) {
-                                            effect->enable();
-                                        } else {
-                                            effect->disable();
-                                        }
-                                        // Apply parameters
-                                        for (const auto& param : pendingEffect.parameters) {
-                                            effect->setParameter(param.first, param.second);
-                                        }
+                    // Find the track and load effect
+                    if (currentComposition) {
+                        for (auto& track : currentComposition->tracks) {
+                            if (track && track->getName() == pendingEffect.trackName) {
+                                DEBUG_PRINT("Loading effect on track '" + pendingEffect.trackName + "': " + pendingEffect.vstPath);
+                                auto effect = track->addEffect(pendingEffect.vstPath);
+                                if (effect) {
+                                    if (pendingEffect.enabled) {
+                                        effect->enable();
+                                    } else {
+                                        effect->disable();
+                                    }
+                                    // Apply parameters
+                                    for (const auto& param : pendingEffect.parameters) {
+                                        effect->setParameter(param.first, param.second);
                                     }
-                                    break;
                                 }
+                                break;
                             }
                         }
                     }
                 }
-            } else {
-                DEBUG_PRINT("Failed to load VST for pending effect: " + pendingEffect.vstPath);
             }
+        } else {
+            DEBUG_PRINT("Failed to load VST for pending effect: " + pendingEffect.vstPath);
         }
-        pendingEffects.clear();
+    }
+    pendingEffects.clear();
+    
+    // Process pending automation after all effects are loaded
+    DEBUG_PRINT("Processing " + std::to_string(pendingAutomation.size()) + " pending automation entries");
+    for (const auto& pendingAuto : pendingAutomation) {
+        Track* targetTrack = nullptr;
         
-        // Process pending automation after all effects are loaded
-        DEBUG_PRINT("Processing " + std::to_string(pendingAutomation.size()) + " pending automation entries");
-        for (const auto& pendingAuto : pendingAutomation) {
-            Track* targetTrack = nullptr;
-            
-            if (pendingAuto.trackName == "Master") {
-                targetTrack = masterTrack.get();
-            } else {
-                // Find the track
-                if (currentComposition) {
-                    for (auto& track : currentComposition->tracks) {
-                        if (track && track->getName() == pendingAuto.trackName) {
-                            targetTrack = track.get();
-                            break;
-                        }
+        if (pendingAuto.trackName == "Master") {
+            targetTrack = masterTrack.get();
+        } else {
+            // Find the track
+            if (currentComposition) {
+                for (auto& track : currentComposition->tracks) {
+                    if (track && track->getName() == pendingAuto.trackName) {
+                        targetTrack = track.get();
+                        break;
                     }
                 }
             }
+        }
+        
+        if (targetTrack) {
+            DEBUG_PRINT("Applying automation to track '" + pendingAuto.trackName + 
+                       "', effect '" + pendingAuto.effectName + "', parameter '" + pendingAuto.parameterName + 
+                       "' with " + std::to_string(pendingAuto.points.size()) + " points");
             
-            if (targetTrack) {
-                DEBUG_PRINT("Applying automation to track '" + pendingAuto.trackName + 
-                           "', effect '" + pendingAuto.effectName + "', parameter '" + pendingAuto.parameterName + 
-                           "' with " + std::to_string(pendingAuto.points.size()) + " points");
-                
-                for (const auto& point : pendingAuto.points) {
-                    targetTrack->addAutomationPoint(pendingAuto.effectName, pendingAuto.parameterName, point);
+            for (const auto& point : pendingAuto.points) {
+                targetTrack->addAutomationPoint(pendingAuto.effectName, pendingAuto.parameterName, point);
+            }
+        } else {
+            DEBUG_PRINT("WARNING: Could not find track '" + pendingAuto.trackName + "' for automation");
+        }
+    }
+    pendingAutomation.clear();
+}
+
+void Engine::patchState(const json& parsedState) {
+    // Nothing live to patch yet
+    if (!currentComposition || !masterTrack || !parsedState.contains("engineState")
+        || !parsedState["engineState"].contains("composition")) {
+        loadState(parsedState);
+        return;
+    }
+
+    juce::ScopedLock lock(engineStateLock);
+    markStateChanged();
+
+    [[maybe_unused]] const double startMs = juce::Time::getMillisecondCounterHiRes();
+    int tracksPatched = 0;
+    int tracksBuilt = 0;
+    int tracksRetired = 0;
+    // Live tracks not yet matched; whatever is left here after a throw goes
+    // back into the composition, since the published render state still
+    // points at it
+    std::vector<std::unique_ptr<Track>> liveTracks;
+
+    try {
+        const auto& composition = parsedState["engineState"]["composition"];
+
+        if (composition.contains("name")) {
+            currentComposition->name = composition["name"].get<std::string>();
+        }
+
+        bool tempoChanged = false;
+        if (composition.contains("bpm") && composition["bpm"].get<double>() != currentComposition->bpm) {
+            currentComposition->bpm = composition["bpm"].get<double>();
+            tempoChanged = true;
+        }
+        if (composition.contains("timeSignature")) {
+            const auto& timeSig = composition["timeSignature"];
+            const int numerator = timeSig.value("numerator", currentComposition->timeSigNumerator);
+            const int denominator = timeSig.value("denominator", currentComposition->timeSigDenominator);
+            if (numerator != currentComposition->timeSigNumerator || denominator != currentComposition->timeSigDenominator) {
+                currentComposition->timeSigNumerator = numerator;
+                currentComposition->timeSigDenominator = denominator;
+                tempoChanged = true;
+            }
+        }
+
+        if (composition.contains("masterTrack")) {
+            patchTrack(*masterTrack, composition["masterTrack"]);
+        }
+
+        if (composition.contains("tracks") && composition["tracks"].is_array()) {
+            // Tracks are matched by name and type and kept, in the document's
+            // order; only the ones that are new are built
+            liveTracks = std::move(currentComposition->tracks);
+            currentComposition->tracks.clear();
+            auto findFile = [this](const std::string& fileName) { return findSampleFile(fileName); };
+
+            for (const auto& trackData : composition["tracks"]) {
+                if (!trackData.contains("name")) continue;
+
+                const auto trackName = trackData["name"].get<std::string>();
+                const auto trackType = trackData.value("type", "audio") == "midi" ? Track::TrackType::MIDI : Track::TrackType::Audio;
+                auto live = std::find_if(liveTracks.begin(), liveTracks.end(), [&](const std::unique_ptr<Track>& track) {
+                    return track && track->getName() == trackName && track->getType() == trackType;
+                });
+
+                if (live != liveTracks.end()) {
+                    patchTrack(**live, trackData);
+                    currentComposition->tracks.push_back(std::move(*live));
+                    ++tracksPatched;
+                } else {
+                    currentComposition->tracks.push_back(buildTrackFromState(trackData, findFile));
+                    ++tracksBuilt;
                 }
-            } else {
-                DEBUG_PRINT("WARNING: Could not find track '" + pendingAuto.trackName + "' for automation");
             }
+
+            for (auto& track : liveTracks) {
+                if (track) {
+                    retireTrack(std::move(track));
+                    ++tracksRetired;
+                }
+            }
+
+            applyPendingEffectsAndAutomation();
         }
-        pendingAutomation.clear();
-        
-        // Send BPM to all loaded synthesizers after project load
-        sendBpmToSynthesizers();
-        
-        // Debug: Count total clips loaded across all tracks
-        int totalClipsLoaded = 0;
-        for (const auto& t : currentComposition->tracks) {
-            totalClipsLoaded += t->getClips().size();
+
+        if (tempoChanged) {
+            generateMetronomeTrack();
+            sendBpmToSynthesizers();
         }
-        DEBUG_PRINT("*** LOAD COMPLETE: Total clips loaded across all tracks: " + std::to_string(totalClipsLoaded));
-        
-    } catch (const json::parse_error& e) {
-        DEBUG_PRINT("JSON parse error in loadState: " + std::string(e.what()));
     } catch (const json::exception& e) {
-        DEBUG_PRINT("JSON error in loadState: " + std::string(e.what()));
+        DEBUG_PRINT("JSON error in patchState: " + std::string(e.what()));
     } catch (const std::exception& e) {
-        DEBUG_PRINT("Error in loadState: " + std::string(e.what()));
+        DEBUG_PRINT("Error in patchState: " + std::string(e.what()));
+    }
+
+    for (auto& track : liveTracks) {
+        if (track) {
+            currentComposition->tracks.push_back(std::move(track));
+        }
+    }
+
+    DEBUG_PRINT("[Engine] Patched state in " + std::to_string(juce::Time::getMillisecondCounterHiRes() - startMs)
+                + " ms: " + std::to_string(tracksPatched) + " tracks kept, " + std::to_string(tracksBuilt)
+                + " built, " + std::to_string(tracksRetired) + " removed");
+
+    publishRenderState();
+}
+
+void Engine::patchTrack(Track& track, const json& trackData) {
+    // Everything the render thread reads from the live track changes under
+    // the callback lock; anything slow is done before taking it
+    {
+        const juce::ScopedLock audioLock(deviceManager.getAudioCallbackLock());
+        if (trackData.contains("name") && trackData["name"].get<std::string>() != track.getName()) {
+            track.setName(trackData["name"].get<std::string>());
+        }
+        if (trackData.contains("volume") && trackData["volume"].get<float>() != track.getVolume()) {
+            track.setVolume(trackData["volume"].get<float>());
+        }
+        if (trackData.contains("pan") && trackData["pan"].get<float>() != track.getPan()) {
+            track.setPan(trackData["pan"].get<float>());
+        }
+        if (trackData.contains("muted") && trackData["muted"].get<bool>() != track.isMuted()) {
+            track.toggleMute();
+        }
+        if (trackData.contains("soloed")) {
+            track.setSolo(trackData["soloed"].get<bool>());
+        }
+    }
+
+    if (auto* audioTrack = dynamic_cast<AudioTrack*>(&track)) {
+        if (trackData.contains("clips") && trackData["clips"].is_array()) {
+            patchAudioClips(*audioTrack, trackData["clips"]);
+        }
+
+        if (trackData.contains("referenceClip") && trackData["referenceClip"].is_object()) {
+            const auto& refClipData = trackData["referenceClip"];
+            const auto fileName = refClipData.value("file", "");
+            const double startTime = refClipData.value("startTime", 0.0);
+            const double offset = refClipData.value("offset", 0.0);
+            const double duration = refClipData.value("duration", 0.0);
+            const float volume = refClipData.value("volume", 1.f);
+            const auto* refClip = audioTrack->getReferenceClip();
+            if (!refClip || refClip->sourceFile.getFileName().toStdString() != fileName || refClip->startTime != startTime
+                || refClip->offset != offset || refClip->duration != duration || refClip->volume != volume) {
+                juce::File file = findSampleFile(fileName);
+                if (file.existsAsFile()) {
+                    audioTrack->setReferenceClip(AudioClip(file, startTime, offset, duration, volume));
+                }
+            }
+        }
+    } else if (auto* midiTrack = dynamic_cast<MIDITrack*>(&track)) {
+        if (trackData.contains("clips") && trackData["clips"].is_array()) {
+            patchMIDIClips(*midiTrack, trackData["clips"]);
+        }
+    }
+
+    // Synthesizers are saved apart from the effects but load first
+    if (trackData.contains("effects") || trackData.contains("synthesizers")) {
+        json chain = json::array();
+        for (const char* key : { "synthesizers", "effects" }) {
+            if (trackData.contains(key) && trackData[key].is_array()) {
+                for (const auto& effectData : trackData[key]) {
+                    chain.push_back(effectData);
+                }
+            }
+        }
+        patchEffects(track, chain);
+    }
+
+    if (trackData.contains("automation") && trackData["automation"].is_object()) {
+        patchAutomation(track, trackData["automation"]);
+    }
+}
+
+void Engine::patchAudioClips(AudioTrack& track, const json& clipsData) {
+    auto sameClip = [](const AudioClip& clip, const json& clipData) {
+        return clip.sourceFile.getFileName().toStdString() == clipData.value("file", "")
+            && clip.startTime == clipData.value("startTime", 0.0) && clip.offset == clipData.value("offset", 0.0)
+            && clip.duration == clipData.value("duration", 0.0) && clip.volume == clipData.value("volume", 1.f);
+    };
+
+    const auto& liveClips = track.getClips();
+    bool unchanged = liveClips.size() == clipsData.size();
+    for (size_t i = 0; unchanged && i < liveClips.size(); ++i) {
+        unchanged = sameClip(liveClips[i], clipsData[i]);
+    }
+    if (unchanged) {
+        return;
+    }
+
+    // Rebuilt on the side in the document's order. A clip over the same
+    // stretch of the same file is copied from the live one, which shares its
+    // decoded audio, so moving a clip never decodes anything.
+    const auto& previousClips = liveClips;
+    std::vector<bool> reused(previousClips.size(), false);
+    std::vector<AudioClip> newClips;
+    newClips.reserve(clipsData.size());
+
+    for (const auto& clipData : clipsData) {
+        if (!clipData.contains("file")) continue;
+
+        const auto fileName = clipData["file"].get<std::string>();
+        const double startTime = clipData.value("startTime", 0.0);
+        const double offset = clipData.value("offset", 0.0);
+        const double duration = clipData.value("duration", 0.0);
+        const float volume = clipData.value("volume", 1.f);
+
+        auto previous = std::find_if(previousClips.begin(), previousClips.end(), [&](const AudioClip& clip) {
+            return !reused[static_cast<size_t>(&clip - previousClips.data())]
+                && clip.sourceFile.getFileName().toStdString() == fileName
+                && clip.offset == offset && clip.duration == duration;
+        });
+
+        if (previous != previousClips.end()) {
+            reused[static_cast<size_t>(previous - previousClips.begin())] = true;
+            AudioClip clip(*previous);
+            clip.startTime = startTime;
+            clip.volume = volume;
+            newClips.push_back(std::move(clip));
+        } else {
+            juce::File file = findSampleFile(fileName);
+            if (file.existsAsFile()) {
+                newClips.emplace_back(file, startTime, offset, duration, volume);
+            } else {
+                DEBUG_PRINT("Audio clip file not found: " + fileName);
+            }
+        }
+    }
+
+    track.requestClipAudio(newClips);
+    {
+        const juce::ScopedLock audioLock(deviceManager.getAudioCallbackLock());
+        track.swapClips(newClips);
+    }
+    // newClips now holds the old clips, freed here on the message thread
+}
+
+void Engine::patchMIDIClips(MIDITrack& track, const json& clipsData) {
+    // Read without opening their files: the saved events replace a file's
+    // anyway, and only the names are needed to compare
+    auto noFile = [](const std::string&) { return juce::File(); };
+    std::vector<MIDIClip> incoming;
+    std::vector<std::string> fileNames;
+    for (const auto& clipData : clipsData) {
+        incoming.push_back(readMIDIClipState(clipData, noFile));
+        fileNames.push_back(clipData.value("file", ""));
+    }
+
+    const auto& liveClips = track.getMIDIClips();
+    bool unchanged = liveClips.size() == incoming.size();
+    for (size_t i = 0; unchanged && i < liveClips.size(); ++i) {
+        const auto& live = liveClips[i];
+        const auto& clip = incoming[i];
+        unchanged = live.sourceFile.getFileName().toStdString() == fileNames[i]
+            && live.startTime == clip.startTime && live.offset == clip.offset && live.duration == clip.duration
+            && live.velocity == clip.velocity && live.channel == clip.channel && live.transpose == clip.transpose
+            && live.midiData.data == clip.midiData.data;
+    }
+    if (unchanged) {
+        return;
+    }
+
+    // The render thread only reads the schedule compiled from the clips, which
+    // reaches it through its own queue, so the clips need no callback lock
+    track.clearMIDIClips();
+    for (size_t i = 0; i < incoming.size(); ++i) {
+        if (!fileNames[i].empty()) {
+            incoming[i].sourceFile = findSampleFile(fileNames[i]);
+        }
+        track.addMIDIClip(incoming[i]);
+    }
+}
+
+void Engine::patchEffects(Track& track, const json& chain) {
+    auto pluginFileName = [](const std::string& path) { return juce::File(path).getFileName().toStdString(); };
+    auto savedFileName = [&](const json& effectData) {
+        const auto vstName = effectData.value("vstName", "");
+        return vstName.empty() ? pluginFileName(effectData.value("vstPath", "")) : vstName;
+    };
+
+    // Each saved effect keeps the first live instance of the same plugin,
+    // wherever it is in the chain; live instances nothing keeps are removed
+    auto& effects = track.getEffects();
+    constexpr size_t none = std::numeric_limits<size_t>::max();
+    std::vector<size_t> keptIndex(chain.size(), none);
+    std::vector<bool> keep(effects.size(), false);
+    for (size_t i = 0; i < chain.size(); ++i) {
+        const auto wanted = savedFileName(chain[i]);
+        for (size_t j = 0; j < effects.size(); ++j) {
+            if (!keep[j] && effects[j] && pluginFileName(effects[j]->getVSTPath()) == wanted) {
+                keep[j] = true;
+                keptIndex[i] = j;
+                break;
+            }
+        }
+    }
+
+    // Missing plugins are loaded and prepared before the render thread is
+    // held up; one that can't be found is left out of the chain
+    std::vector<std::unique_ptr<Effect>> loaded(chain.size());
+    for (size_t i = 0; i < chain.size(); ++i) {
+        if (keptIndex[i] != none) continue;
+
+        const auto vstName = chain[i].value("vstName", "");
+        const auto vstPath = chain[i].value("vstPath", "");
+        juce::File vstFile;
+        if (!vstPath.empty() && juce::File(vstPath).existsAsFile()) {
+            vstFile = juce::File(vstPath);
+        } else if (!vstName.empty()) {
+            vstFile = findVSTFile(vstName);
+        }
+        if (vstFile.exists()) {
+            loaded[i] = track.createEffect(vstFile.getFullPathName().toStdString());
+        }
+        if (!loaded[i]) {
+            DEBUG_PRINT("Effect file not found: " + vstName + " / " + vstPath);
+        }
+    }
+
+    // The chain as it will be, as positions in the live chain
+    std::vector<size_t> order;
+    bool sameChain = true;
+    for (size_t i = 0; i < chain.size(); ++i) {
+        if (keptIndex[i] != none) {
+            sameChain = sameChain && keptIndex[i] == order.size();
+            order.push_back(keptIndex[i]);
+        } else if (loaded[i]) {
+            sameChain = false;
+            order.push_back(none);
+        }
+    }
+    sameChain = sameChain && order.size() == effects.size();
+
+    std::vector<Effect*> chainEffects(chain.size(), nullptr);
+    if (sameChain) {
+        for (size_t i = 0; i < chain.size(); ++i) {
+            if (keptIndex[i] != none) chainEffects[i] = effects[keptIndex[i]].get();
+        }
+    } else {
+        std::vector<std::unique_ptr<Effect>> removed;
+        {
+            const juce::ScopedLock audioLock(deviceManager.getAudioCallbackLock());
+            std::vector<std::unique_ptr<Effect>> newEffects;
+            newEffects.reserve(order.size());
+            for (size_t i = 0; i < chain.size(); ++i) {
+                if (keptIndex[i] != none) {
+                    newEffects.push_back(std::move(effects[keptIndex[i]]));
+                } else if (loaded[i]) {
+                    newEffects.push_back(std::move(loaded[i]));
+                } else {
+                    continue;
+                }
+                chainEffects[i] = newEffects.back().get();
+            }
+            removed = track.swapEffects(std::move(newEffects));
+        }
+        // A block already handed to the render pool may still run through
+        // these, so they go once it has picked up the published chain
+        for (auto& effect : removed) {
+            retireEffect(std::move(effect));
+        }
+    }
+
+    for (size_t i = 0; i < chain.size(); ++i) {
+        const auto& effectData = chain[i];
+        Effect* effect = chainEffects[i];
+        if (!effect) continue;
+
+        const bool enabled = effectData.value("enabled", true);
+        if (enabled != effect->enabled()) {
+            if (enabled) {
+                effect->enable();
+            } else {
+                effect->disable();
+            }
+        }
+        for (const auto& [index, value] : readEffectParameters(effectData)) {
+            if (index < effect->getNumParameters() && effect->getParameter(index) != value) {
+                effect->setParameter(index, value);
+            }
+        }
+    }
+}
+
+void Engine::patchAutomation(Track& track, const json& automation) {
+    using Points = std::vector<Track::AutomationPoint>;
+    auto samePoints = [](const Points& a, const Points& b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const auto& p, const auto& q) {
+            return p.time == q.time && p.value == q.value && p.curve == q.curve;
+        });
+    };
+
+    // The lanes as saved, which leaves out the default point before 0 s
+    std::map<std::pair<std::string, std::string>, Points> wanted;
+    for (const auto& [effectName, parameterMap] : automation.items()) {
+        for (const auto& [parameterName, pointsArray] : parameterMap.items()) {
+            if (!pointsArray.is_array()) continue;
+            Points points;
+            for (const auto& pointJson : pointsArray) {
+                if (pointJson.contains("time") && pointJson.contains("value")) {
+                    points.push_back({ pointJson["time"].get<double>(), pointJson["value"].get<float>(),
+                                       pointJson.value("curve", 0.0f) });
+                }
+            }
+            if (points.size() > 1 || (points.size() == 1 && points[0].time >= 0.0)) {
+                wanted[{ effectName, parameterName }] = std::move(points);
+            }
+        }
+    }
+
+    std::vector<std::pair<std::string, std::string>> stale;
+    for (const auto& [effectName, parameterMap] : track.getAutomationData()) {
+        for (const auto& [parameterName, points] : parameterMap) {
+            Points saved;
+            std::copy_if(points.begin(), points.end(), std::back_inserter(saved),
+                         [](const Track::AutomationPoint& point) { return point.time >= 0.0; });
+            auto it = wanted.find({ effectName, parameterName });
+            if (it == wanted.end()) {
+                if (!saved.empty()) {
+                    stale.emplace_back(effectName, parameterName);
+                }
+            } else if (samePoints(saved, it->second)) {
+                wanted.erase(it);
+            }
+        }
+    }
+
+    if (stale.empty() && wanted.empty()) {
+        return;
+    }
+
+    // MIDI tracks read their lanes while rendering
+    const juce::ScopedLock audioLock(deviceManager.getAudioCallbackLock());
+    for (const auto& [effectName, parameterName] : stale) {
+        track.clearAutomationParameter(effectName, parameterName);
+    }
+    for (const auto& [lane, points] : wanted) {
+        track.clearAutomationParameter(lane.first, lane.second);
+        for (const auto& point : points) {
+            track.addAutomationPoint(lane.first, lane.second, point);
+        }
     }
 }
 
 void Engine::audioDeviceAboutToStart(juce::AudioIODevice* device) {
     sampleRate = device->getCurrentSampleRate();
     currentBufferSize = device->getCurrentBufferSizeSamples();
-    tempMixBuffer.setSize(device->getOutputChannelNames().size(), currentBufferSize);
+    const int numDeviceOutputs = juce::jmax(2, device->getOutputChannelNames().size());
+    tempMixBuffer.setSize(numDeviceOutputs, currentBufferSize);
     tempMixBuffer.clear();
+    mixScratch.prepare(numDeviceOutputs, currentBufferSize, NumMixScratchSlots);
     positionSeconds = 0.0;
     
     DEBUG_PRINT("Engine: Device starting - sample rate: " << sampleRate << "Hz, buffer: " << currentBufferSize);
     
-    // Prepare master track
-    if (masterTrack) {
-        masterTrack->prepareToPlay(sampleRate, currentBufferSize);
-    }
-    
-    // Prepare all composition tracks
-    if (currentComposition) {
-        for (auto& track : currentComposition->tracks) {
-            if (track) {
-                track->prepareToPlay(sampleRate, currentBufferSize);
+    // Called with the device's callback lock held, so the render state can be
+    // brought up to date and resized here without racing a block
+    adoptPendingRenderStates();
+    if (renderState) {
+        if (renderState->masterTrack) {
+            renderState->masterTrack->prepareToPlay(sampleRate, currentBufferSize);
+        }
+        for (auto* track : renderState->tracks) {
+            track->prepareToPlay(sampleRate, currentBufferSize);
+            if (const auto* frozen = track->getFrozenClip()) {
+                frozen->requestAudioData(formatManager, sampleRate);
+            }
+        }
+        for (auto& buffer : renderState->trackBuffers) {
+            if (buffer.getNumSamples() < currentBufferSize) {
+                buffer.setSize(2, currentBufferSize, false, true, true);
             }
         }
     }
+
+    renderPool->setBlockTiming(currentBufferSize, sampleRate);
+    audioDeviceRunning.store(true, std::memory_order_release);
     
     DBG("Device about to start with SR: " << sampleRate << ", buffer: " << currentBufferSize);
 }
 
 void Engine::audioDeviceStopped() {
+    audioDeviceRunning.store(false, std::memory_order_release);
     tempMixBuffer.setSize(0, 0);
 }
 
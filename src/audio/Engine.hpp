@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <functional>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -9,9 +10,24 @@
 #include <iomanip>
 #include <chrono>
 #include <atomic>
+#include <optional>
+#include <future>
+#include <unordered_map>
+#include <set>
 #include <nlohmann/json.hpp>
 
 #include "Composition.hpp"
+#include "TrackRenderPool.hpp"
+#include "OfflineRenderer.hpp"
+#include "SpscQueue.hpp"
+#include "AudioScratchArena.hpp"
+#include "AudioThreadAllocationGuard.hpp"
+#include "PluginDatabase.hpp"
+#include "SampleLibraryIndex.hpp"
+#include "WaveformPeaks.hpp"
+#include "AudioFileInfoCache.hpp"
+#include "ProjectFile.hpp"
+#include "StateHashNode.hpp"
 #include "../DebugConfig.hpp"
 
 class EnginePlayHead : public juce::AudioPlayHead {
@@ -81,7 +97,37 @@ public:
     const std::vector<PendingAutomation>& getPendingAutomation() const { return pendingAutomation; }
     void clearPendingAutomation() { pendingAutomation.clear(); }
 
-    void exportMaster(const std::string& filePath);
+    // Renders the song to <directory>/<composition name>.wav on a background
+    // thread and returns straight away. Playback is paused and the device
+    // outputs silence until the export finishes or is cancelled.
+    bool exportMaster(const std::string& directory, ExportSampleFormat format = ExportSampleFormat::Int24);
+    // Same render pass, but also writes every audible track post-fader to
+    // <directory>/<composition name> Stems/, next to Master.wav
+    bool exportStems(const std::string& directory, ExportSampleFormat format = ExportSampleFormat::Int24);
+    void cancelExport();
+    bool isExporting() const { return exportRenderer && exportRenderer->isRendering(); }
+    ExportProgress getExportProgress() const { return exportRenderer ? exportRenderer->getProgress() : ExportProgress{}; }
+
+    // Renders the track post-fader, with its plugins and automation, into a
+    // cached file in the temp directory, then plays that back and suspends
+    // the plugins. Runs like an export, so playback pauses until it is done.
+    // Any later edit to the track, or a tempo change, unfreezes it.
+    bool freezeTrack(const std::string& trackName);
+    void unfreezeTrack(const std::string& trackName);
+    bool isTrackFrozen(const std::string& trackName);
+    bool isFreezing() const { return pendingFreeze.has_value(); }
+
+    // load() returns as soon as the song's tracks, clips and plugins are in
+    // place; clip audio is then decoded on the sample pool's threads and each
+    // clip plays as soon as its own audio is in. This is how far that has got.
+    struct LoadProgress {
+        int clipsTotal = 0;
+        int clipsReady = 0;
+        int clipsFailed = 0;  // unreadable; they stay silent
+        bool reading = false; // the project file is still being read and parsed
+        bool loading = false; // reading, or some clip is still decoding
+    };
+    LoadProgress getLoadProgress();
     
     // Playback control
     void play();
@@ -98,6 +144,10 @@ public:
     // Composition management
     void newComposition(const std::string& name = "untitled");
     void loadComposition(const std::string& path);
+    // Reads and parses the project file on a background thread and returns
+    // at once; the song replaces the current one on the message thread, from
+    // reclaimRetiredState, once it is parsed. Adds the metronome track too.
+    void beginLoadComposition(const std::string& path);
     void saveComposition(const std::string& path);
     std::pair<int, int> getTimeSignature() const;
     double getBpm() const;
@@ -113,6 +163,10 @@ public:
     Track* getTrackByName(const std::string& name);
     std::vector<std::unique_ptr<Track>>& getAllTracks();
     Track* getMasterTrack();
+
+    // Held by the audio thread for every block, render workers included.
+    // Take it to change what a live track renders from, briefly.
+    juce::CriticalSection& getAudioCallbackLock() { return deviceManager.getAudioCallbackLock(); }
     
     void setSelectedTrack(const std::string& trackName);
     std::string getSelectedTrack() const;
@@ -129,10 +183,20 @@ public:
     juce::File findSampleFile(const std::string& sampleName) const;
     juce::File findVSTFile(const std::string& vstName) const;
     
-    // State management
+    // State management. save() writes a version 2 project, or JSON text when
+    // the path ends in .json; getStateString is always JSON
     void save(const std::string& path = "untitled.mpf") const;
     std::string getStateString() const;
     void load(const std::string& state);
+    // The same document as MessagePack with MIDI and parameter values packed
+    // as binary, which is what collaboration sends when a whole project has to go
+    std::vector<std::uint8_t> getStateBinary() const;
+    void loadStateBinary(const std::vector<std::uint8_t>& state);
+    // Brings the open project to a state received from elsewhere, changing
+    // only what differs: tracks, clips and plugin instances that are still
+    // there are kept, with their decoded audio. Loads it if nothing is open.
+    void applyState(const std::string& state);
+    void applyStateBinary(const std::vector<std::uint8_t>& state);
     
     // Audio device callbacks
     void audioDeviceIOCallbackWithContext(const float* const* inputChannelData, int numInputChannels, float* const* outputChannelData, int numOutputChannels, int numSamples, const juce::AudioIODeviceCallbackContext& context) override;
@@ -153,6 +217,58 @@ public:
     
     bool configureAudioDevice(double sampleRate, int bufferSize = 256);
 
+    // Parallel track rendering. 0 renders every track on the device thread,
+    // a negative count picks one worker per spare CPU core.
+    void setRenderThreadCount(int numThreads);
+    int getRenderThreadCount() const;
+    void setRealtimeRenderPriority(bool shouldUseRealtime);
+
+    // Audio clips longer than this many seconds stream from disk (0 disables)
+    inline void setClipStreamingThreshold(double seconds) { AudioClip::setStreamingThreshold(seconds); }
+
+    // Decoded clip audio is shared through the process-wide SamplePool
+    inline void setSamplePoolBudgetMB(int megabytes) {
+        SamplePool::getInstance().setMemoryBudget(static_cast<std::size_t>(juce::jmax(0, megabytes)) * 1024 * 1024);
+    }
+    inline SamplePool::Stats getSamplePoolStats() const { return SamplePool::getInstance().getStats(); }
+
+    // Sample-rate conversion used when clips are decoded ("draft", "normal" or "high")
+    inline void setResamplerQuality(const std::string& name) {
+        SamplePool::getInstance().setResamplerQuality(Resampler::getQualityFromName(name));
+    }
+
+    // Idle plugins stop processing after this many seconds of silence (0 never sleeps)
+    inline void setPluginSleepAfterSilence(double seconds) { Effect::setSleepAfterSilence(seconds); }
+
+    // Plugins loaded after this run in their own host process (Linux only)
+    inline void setPluginsOutOfProcess(bool enabled) { Effect::setOutOfProcess(enabled); }
+
+    // Where what is known about each plugin file is kept between runs
+    inline void setPluginDatabaseFile(const std::string& path) {
+        PluginDatabase::getInstance().setFile(juce::File(path));
+    }
+    // Where the sample library index is kept between runs
+    inline void setSampleIndexFile(const std::string& path) { sampleIndex.setCacheFile(juce::File(path)); }
+    // Where waveform peaks go for audio in folders that can't be written to
+    inline void setWaveformPeaksDirectory(const std::string& path) {
+        WaveformPeaks::getInstance().setFallbackDirectory(juce::File(path));
+    }
+
+    struct PluginSleepInfo {
+        std::string trackName;
+        std::string pluginName;
+        Effect::SleepStats stats;
+    };
+    // How often each plugin on every track, the master included, has slept
+    std::vector<PluginSleepInfo> getPluginSleepStats() const;
+
+    // Heap allocations seen on the audio thread (MULO_DEBUG_AUDIO_ALLOCATIONS builds only)
+    std::uint64_t getAudioThreadAllocationCount() const { return AudioThreadAllocationGuard::getAllocationCount(); }
+
+    // Frees tracks and render states the audio thread has finished with.
+    // Message thread only; called after every structural edit and once per UI frame.
+    void reclaimRetiredState();
+
     std::vector<float> generateWaveformPeaks(const juce::File& audioFile, float duration, float peakResolution = 0.05f);
 
     void playSound(const std::string& filePath, float volume);
@@ -187,14 +303,155 @@ private:
     double savedPosition = 0.0;
     bool hasSaved = false;
 
+    // Cues every streaming clip to the playhead. With waitForDisk, play()
+    // gives the disk reader a moment to fill them so it doesn't open on an
+    // underrun.
+    void cueStreams(bool waitForDisk);
+
     juce::AudioBuffer<float> tempMixBuffer;
     std::unique_ptr<Track> masterTrack;
+
+    // Replaced whole rather than resized, so its workers are never started
+    // or joined with the callback locked
+    std::unique_ptr<TrackRenderPool> renderPool = std::make_unique<TrackRenderPool>();
+    void replaceRenderPool(int numThreads, bool useRealtimePriority);
+
+    // Lent to every track we render; see Track::RenderHost
+    Track::RenderHost trackRenderHost;
+
+    // Set while an OfflineRenderer owns the tracks; the callback stays silent
+    std::unique_ptr<OfflineRenderer> exportRenderer;
+    std::atomic<bool> offlineRenderActive { false };
+
+    OfflineRenderer::Job makeExportJob(ExportSampleFormat format);
+    bool startExport(OfflineRenderer::Job job);
+
+    // The freeze render in flight; once the renderer is done its clip loads
+    // off the message thread, and reclaimRetiredState installs it when ready,
+    // or drops it if the track changed in the meantime
+    struct PendingFreeze {
+        std::string trackName;
+        juce::File file;
+        double startSeconds = 0.0;
+        double endSeconds = 0.0;
+        std::uint64_t fingerprint = 0;
+        bool wasMuted = false;
+        std::unique_ptr<AudioClip> clip; // set once the render is done
+    };
+    std::optional<PendingFreeze> pendingFreeze;
+    // The tempo thawStaleTracks last checked the frozen tracks against
+    double freezeCheckedBpm = 0.0;
+
+    std::uint64_t computeFreezeFingerprint(const Track& track) const;
+    void finishPendingFreeze();
+    void dropPendingFreeze();
+    void thawTrack(Track& track);
+    // Unfreezes every frozen track that has been edited since it was rendered
+    void thawStaleTracks();
+
+    // The document getStateString writes. Compact packs MIDI and parameter
+    // values into binary for ProjectFile, which JSON text can't hold.
+    nlohmann::json getState(bool compact) const;
+    // load() once the state is parsed, or read from a version 2 project
+    void loadState(const nlohmann::json& parsedState);
+    // One track of a loaded document. Its effects and automation are queued
+    // for applyPendingEffectsAndAutomation; synthesizers are loaded at once.
+    std::unique_ptr<Track> buildTrackFromState(const nlohmann::json& trackData,
+                                               const std::function<juce::File(const std::string&)>& findResolvedSampleFile);
+    MIDIClip readMIDIClipState(const nlohmann::json& clipData,
+                               const std::function<juce::File(const std::string&)>& findResolvedSampleFile) const;
+    void applyPendingEffectsAndAutomation();
+
+    // applyState once the state is parsed
+    void patchState(const nlohmann::json& parsedState);
+    void patchTrack(Track& track, const nlohmann::json& trackData);
+    void patchAudioClips(AudioTrack& track, const nlohmann::json& clipsData);
+    void patchMIDIClips(MIDITrack& track, const nlohmann::json& clipsData);
+    // Synthesizers then effects, in the order they should end up in
+    void patchEffects(Track& track, const nlohmann::json& chain);
+    void patchAutomation(Track& track, const nlohmann::json& automation);
+
+    // Every sample file a saved composition's clips name, looked up in
+    // parallel before any track is built, keyed by the saved name
+    std::unordered_map<std::string, juce::File> resolveSampleFiles(const nlohmann::json& composition) const;
+    // Logs how long the last load took to become fully playable
+    void reportLoadProgress();
+    double loadStartedMs = 0.0; // 0 once the last load's clips are all in
+
+    // A project file as read, state null if it can't be. A version 2 file
+    // stays open in `file`: its MIDI and automation are read from it as
+    // each track is built.
+    struct ReadComposition {
+        nlohmann::json state;
+        std::unique_ptr<ProjectFile> file;
+    };
+    static ReadComposition readCompositionFile(const std::string& path);
+    // loadState, reading what the document left in its file from there
+    void loadReadComposition(const ReadComposition& composition);
+    // Loads the song beginLoadComposition parsed, once it is ready
+    void finishPendingLoad();
+    std::future<ReadComposition> pendingLoad;
+    // The file loadReadComposition is loading from, while it is
+    ProjectFile* loadingProject = nullptr;
+    // A key of a saved track, from the track or else from loadingProject
+    const nlohmann::json& getSavedTrackValue(const nlohmann::json& trackData, const std::string& key) const;
+
+    // What the audio thread renders. Built on the message thread after every
+    // structural edit, handed over through renderStateQueue and handed back
+    // through retiredStateQueue once the callback has moved on to a newer one.
+    struct RenderState {
+        juce::uint64 generation = 0;
+        std::vector<Track*> tracks;
+        Track* masterTrack = nullptr;
+        Track* metronomeTrack = nullptr;
+        Track* selectedTrack = nullptr;
+        double bpm = 120.0;
+        int timeSigNumerator = 4;
+        int timeSigDenominator = 4;
+
+        // Per-track render targets, one per track, summed in track order
+        std::vector<juce::AudioBuffer<float>> trackBuffers;
+        std::vector<Track*> tracksToRender;
+    };
+
+    // At most maxStatesInFlight states are handed over and not yet freed.
+    // All but the one being rendered can sit in the return queue, so the
+    // audio thread always has room to hand a state back.
+    static constexpr std::size_t renderStateQueueSize = 64;
+    static constexpr std::size_t maxStatesInFlight = renderStateQueueSize;
+    SpscQueue<RenderState*, renderStateQueueSize> renderStateQueue;
+    SpscQueue<RenderState*, renderStateQueueSize> retiredStateQueue;
+    RenderState* renderState = nullptr; // owned by the audio thread
+    std::unique_ptr<RenderState> unpublishedState; // waiting for room in renderStateQueue
+    std::size_t statesInFlight = 0; // message thread only
+    juce::uint64 publishedGeneration = 0;
+    std::atomic<juce::uint64> consumedGeneration { 0 };
+    std::atomic<bool> audioDeviceRunning { false };
+
+    // Tracks removed from the composition, kept alive until the audio thread
+    // has adopted the render state (generation) that no longer contains them
+    std::vector<std::pair<juce::uint64, std::unique_ptr<Track>>> retiredTracks;
+    // Effects taken out of a live chain, kept alive until the audio thread is
+    // on the state published when they were removed, and while an export runs
+    std::vector<std::pair<juce::uint64, std::unique_ptr<Effect>>> retiredEffects;
+
+    void publishRenderState();
+    void flushUnpublishedState();
+    void retireTrack(std::unique_ptr<Track> track);
+    void retireEffect(std::unique_ptr<Effect> effect);
+    void adoptRenderState(RenderState* newState);
+    void adoptPendingRenderStates();
+
+    // Scratch buffers for the callback's own temporaries (synth, realtime MIDI, metronome, preview)
+    enum MixScratchSlot { SynthScratch, RealtimeScratch, MetronomeScratch, PreviewScratch, NumMixScratchSlots };
+    AudioScratchArena mixScratch;
     std::string selectedTrackName;
     
     juce::MidiBuffer incomingMidiBuffer;
     juce::CriticalSection midiInputLock;
     
-    // Thread safety for engine state changes
+    // Serialises structural edits between non-audio threads. The audio thread
+    // never takes it; it only sees published RenderStates.
     juce::CriticalSection engineStateLock;
     
     int synthSilenceCountdown = 0;
@@ -202,14 +459,30 @@ private:
     
     std::string vstDirectory;
     std::string sampleDirectory;
+    juce::File assetsDirectory;
+    // Answers findSampleFile without walking the sample directories
+    SampleLibraryIndex sampleIndex;
+    void updateSampleIndexRoots();
     std::vector<PendingEffect> pendingEffects;
     std::vector<PendingAutomation> pendingAutomation;
     
     // State change tracking
     mutable std::chrono::seconds lastStateChangeTimestamp;
-    mutable std::string lastStateHash;
     void markStateChanged();
 
+    // Root of the state hash tree: the composition's own settings and track
+    // list, over the tree each track keeps
+    mutable StateHashNode compositionStateNode;
+    mutable std::uint64_t compositionSettingsHash = 0;
+    // Paths whose hash has changed, until takeChangedStateSubtrees
+    mutable std::set<std::string> changedStateSubtrees;
+    std::uint64_t computeStateHash() const;
+
 public:
+    // Cached until something in the project is edited
     std::string getStateHash() const;
+    // What has changed since the last call: "composition" for the song
+    // settings and track list, "tracks/<name>/<subtree>" and
+    // "master/<subtree>" for the subtrees of Track::getStateHash
+    std::vector<std::string> takeChangedStateSubtrees();
 };
\ No newline at end of file
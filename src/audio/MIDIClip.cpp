@@ -1,6 +1,5 @@
 #include "MIDIClip.hpp"
 #include "../DebugConfig.hpp"
-#include <set>
 
 MIDIClip::MIDIClip() 
     : startTime(0.0), offset(0.0), duration(0.0), velocity(1.0f), channel(1), transpose(0) {}
@@ -19,12 +18,11 @@ MIDIClip::MIDIClip(const juce::File& sourceFile, double startTime, double offset
     }
 }
 
-void MIDIClip::addNote(int noteNumber, float noteVelocity, double noteStartTime, double noteDuration) {
+void MIDIClip::addNote(int noteNumber, float noteVelocity, double noteStartTime, double noteDuration, double bpm) {
     if (noteStartTime < 0 || noteStartTime >= duration) return;
     
-    int sampleRate = 44100; // Default sample rate for timing calculations
-    int startSample = std::round(noteStartTime * sampleRate);
-    int endSample = std::round((noteStartTime + noteDuration) * sampleRate);
+    int startTick = secondsToTicks(noteStartTime, bpm);
+    int endTick = secondsToTicks(noteStartTime + noteDuration, bpm);
     
     // Apply transpose
     int transposedNote = juce::jlimit(0, 127, noteNumber + transpose);
@@ -34,37 +32,35 @@ void MIDIClip::addNote(int noteNumber, float noteVelocity, double noteStartTime,
     
     // Note on
     juce::MidiMessage noteOn = juce::MidiMessage::noteOn(channel, transposedNote, static_cast<juce::uint8>(scaledVelocity));
-    midiData.addEvent(noteOn, startSample);
+    midiData.addEvent(noteOn, startTick);
     
     // Note off
     juce::MidiMessage noteOff = juce::MidiMessage::noteOff(channel, transposedNote, static_cast<juce::uint8>(0));
-    midiData.addEvent(noteOff, endSample);
+    midiData.addEvent(noteOff, endTick);
     
     DEBUG_PRINT("Added MIDI note: " << transposedNote << " vel:" << scaledVelocity 
                 << " start:" << noteStartTime << " dur:" << noteDuration);
 }
 
-void MIDIClip::addControlChange(int controller, int value, double time) {
+void MIDIClip::addControlChange(int controller, int value, double time, double bpm) {
     if (time < 0 || time >= duration) return;
     
-    int sampleRate = 44100;
-    int sample = static_cast<int>(time * sampleRate);
+    int tick = secondsToTicks(time, bpm);
     
     juce::MidiMessage cc = juce::MidiMessage::controllerEvent(channel, controller, 
                                                              juce::jlimit(0, 127, value));
-    midiData.addEvent(cc, sample);
+    midiData.addEvent(cc, tick);
     
     DEBUG_PRINT("Added MIDI CC: controller=" << controller << " value=" << value << " time=" << time);
 }
 
-void MIDIClip::addProgramChange(int program, double time) {
+void MIDIClip::addProgramChange(int program, double time, double bpm) {
     if (time < 0 || time >= duration) return;
     
-    int sampleRate = 44100;
-    int sample = static_cast<int>(time * sampleRate);
+    int tick = secondsToTicks(time, bpm);
     
     juce::MidiMessage pc = juce::MidiMessage::programChange(channel, juce::jlimit(0, 127, program));
-    midiData.addEvent(pc, sample);
+    midiData.addEvent(pc, tick);
     
     DEBUG_PRINT("Added MIDI Program Change: program=" << program << " time=" << time);
 }
@@ -74,108 +70,6 @@ void MIDIClip::clear() {
     DEBUG_PRINT("Cleared MIDI clip data");
 }
 
-void MIDIClip::fillMidiBuffer(juce::MidiBuffer& buffer, double clipStartTime, double clipEndTime, 
-                          double sampleRate, int startSample, bool hasGaplessTransition) const {   
-    if (isEmpty()) {
-        return;
-    }
-    
-    // Calculate the range within this clip
-    double localStartTime = juce::jmax(0.0, clipStartTime - startTime + offset);
-    double localEndTime = juce::jmin(duration, clipEndTime - startTime + offset);
-    
-    if (localStartTime >= localEndTime) return;
-    
-    int localStartSample = static_cast<int>(localStartTime * sampleRate);
-    int localEndSample = static_cast<int>(localEndTime * sampleRate);
-    
-    std::set<int> activeNotes;
-    std::set<int> allNotesPlayedInClip;
-    
-    double actualClipEnd = startTime + duration;
-    bool isAtClipEnd = (clipEndTime >= actualClipEnd);
-    
-    if (isAtClipEnd) {
-        for (const auto& event : midiData) {
-            double eventTimeRelativeToClip = event.samplePosition / sampleRate;
-            
-            if (eventTimeRelativeToClip >= 0.0 && eventTimeRelativeToClip <= duration) {
-                juce::MidiMessage message = event.getMessage();
-                if (message.isNoteOn() && message.getVelocity() > 0) {
-                    int noteNumber = message.getNoteNumber();
-
-                    if (transpose != 0) {
-                        noteNumber = juce::jlimit(0, 127, noteNumber + transpose);
-                    }
-                    allNotesPlayedInClip.insert(noteNumber);
-                    DEBUG_PRINT("MIDIClip: Note " << noteNumber << " was played in clip");
-                }
-            }
-        }
-        DEBUG_PRINT("MIDIClip: Found " << allNotesPlayedInClip.size() << " different notes played in clip (duration=" << duration << ")");
-    }
-    
-    // Iterate through MIDI events in the time range
-    for (const auto& event : midiData) {
-        int eventSample = event.samplePosition;
-        
-        if (eventSample >= localStartSample && eventSample < localEndSample) {
-            // Calculate the output sample position
-            int outputSample = startSample + (eventSample - localStartSample);
-            
-            // Apply velocity scaling and transpose if needed
-            juce::MidiMessage message = event.getMessage();
-            
-            if (message.isNoteOnOrOff()) {
-                int noteNumber = message.getNoteNumber();
-                int channel = message.getChannel();
-                
-                // Apply transpose
-                if (transpose != 0) {
-                    noteNumber = juce::jlimit(0, 127, noteNumber + transpose);
-                }
-                
-                if (message.isNoteOn()) {
-                    activeNotes.insert(noteNumber);
-                    
-                    // Apply velocity scaling
-                    int newVelocity = juce::jlimit(0, 127, 
-                        static_cast<int>(message.getVelocity() * velocity));
-                    message = juce::MidiMessage::noteOn(channel, noteNumber, 
-                                                      static_cast<juce::uint8>(newVelocity));
-                } else {
-                    activeNotes.erase(noteNumber);
-                    message = juce::MidiMessage::noteOff(channel, noteNumber);
-                }
-            }
-            
-            buffer.addEvent(message, outputSample);
-        }
-    }
-    
-    // If we're at the end of the clip, send note-offs for ALL notes that were played in this clip
-    if (isAtClipEnd && !allNotesPlayedInClip.empty()) {
-        if (hasGaplessTransition) {
-            for (int noteNumber : allNotesPlayedInClip) {
-                juce::MidiMessage noteOff = juce::MidiMessage::noteOff(1, noteNumber);
-                buffer.addEvent(noteOff, 0);
-            }
-        } else {
-            // For normal clip endings, send note-offs at the exact clip boundary
-            double exactClipEndTime = startTime + duration;
-            double exactBufferStartTime = clipStartTime;
-            double clipEndRelativeToBuffer = exactClipEndTime - exactBufferStartTime;
-            int exactClipEndSample = static_cast<int>(clipEndRelativeToBuffer * sampleRate);
-            
-            // Send note-off for ALL notes that were played in this clip
-            for (int noteNumber : allNotesPlayedInClip) {
-                juce::MidiMessage noteOff = juce::MidiMessage::noteOff(1, noteNumber);
-                buffer.addEvent(noteOff, exactClipEndSample);
-            }
-        }
-    }
-}
-
 bool MIDIClip::loadFromFile(const juce::File& file) {
     if (!file.exists() || !file.hasFileExtension("mid") && !file.hasFileExtension("midi")) {
         DEBUG_PRINT("Invalid MIDI file: " << file.getFullPathName().toStdString());
@@ -194,8 +88,13 @@ bool MIDIClip::loadFromFile(const juce::File& file) {
         return false;
     }
     
-    // Convert to a single track with absolute timing
-    midiFile.convertTimestampTicksToSeconds();
+    // Musical-time files map straight onto our tick grid; timecode files
+    // only have seconds, which are placed at the default tempo
+    const short timeFormat = midiFile.getTimeFormat();
+    const bool hasMusicalTime = timeFormat > 0;
+    if (!hasMusicalTime) {
+        midiFile.convertTimestampTicksToSeconds();
+    }
     
     midiData.clear();
     
@@ -208,9 +107,11 @@ bool MIDIClip::loadFromFile(const juce::File& file) {
             if (event->message.isNoteOnOrOff() || event->message.isController() || 
                 event->message.isProgramChange()) {
                 
-                // Convert time to samples (assuming 44.1kHz for now)
-                int sampleTime = static_cast<int>(event->message.getTimeStamp() * 44100.0);
-                midiData.addEvent(event->message, sampleTime);
+                const double timeStamp = event->message.getTimeStamp();
+                int tick = hasMusicalTime
+                    ? static_cast<int>(std::lround(timeStamp * ticksPerQuarterNote / timeFormat))
+                    : secondsToTicks(timeStamp, defaultTempo);
+                midiData.addEvent(event->message, tick);
             }
         }
     }
@@ -226,14 +127,14 @@ bool MIDIClip::saveToFile(const juce::File& file) const {
     juce::MidiFile midiFile;
     juce::MidiMessageSequence sequence;
     
-    // Convert our buffer to a MIDI sequence
+    // Our ticks are the file's ticks
     for (const auto& event : midiData) {
-        double timeSeconds = event.samplePosition / 44100.0; // Convert back to seconds
-        sequence.addEvent(juce::MidiMessage(event.getMessage()), timeSeconds);
+        sequence.addEvent(juce::MidiMessage(event.getMessage()), static_cast<double>(event.samplePosition));
     }
+    sequence.updateMatchedPairs();
     
     midiFile.addTrack(sequence);
-    midiFile.setSmpteTimeFormat(25, 40); // 25fps, 40 ticks per frame
+    midiFile.setTicksPerQuarterNote(ticksPerQuarterNote);
     
     juce::FileOutputStream fileStream(file);
     if (!fileStream.openedOk()) {
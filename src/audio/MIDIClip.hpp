@@ -3,7 +3,23 @@
 #include <juce_core/juce_core.h>
 #include <juce_audio_basics/juce_audio_basics.h>
 
+#include <cmath>
+
 struct MIDIClip {
+    // Event positions in midiData are musical ticks, not samples, so MIDI
+    // follows the tempo and plays in time at any device rate. Converting to
+    // samples is left to the track's compiled schedule.
+    static constexpr int ticksPerQuarterNote = 960;
+    // Tempo for MIDI files that carry timecode rather than musical time
+    static constexpr double defaultTempo = 120.0;
+
+    static double ticksToSeconds(double ticks, double bpm) {
+        return ticks * 60.0 / (bpm * ticksPerQuarterNote);
+    }
+    static int secondsToTicks(double seconds, double bpm) {
+        return static_cast<int>(std::lround(seconds * bpm * ticksPerQuarterNote / 60.0));
+    }
+
     juce::File sourceFile;
     double startTime;
     double offset;
@@ -12,7 +28,7 @@ struct MIDIClip {
     int channel;
     int transpose;
     
-    // MIDI data storage
+    // MIDI data storage, positioned in ticks from the start of the clip
     juce::MidiBuffer midiData;
     
     MIDIClip();
@@ -20,14 +36,12 @@ struct MIDIClip {
     MIDIClip(const juce::File& sourceFile, double startTime, double offset, double duration, 
              int channel = 1, float velocity = 1.0f, int transpose = 0);
     
-    void addNote(int noteNumber, float velocity, double startTime, double duration);
-    void addControlChange(int controller, int value, double time);
-    void addProgramChange(int program, double time);
+    // Times are seconds into the clip, placed on the tick grid at bpm
+    void addNote(int noteNumber, float velocity, double startTime, double duration, double bpm);
+    void addControlChange(int controller, int value, double time, double bpm);
+    void addProgramChange(int program, double time, double bpm);
     void clear();
     
-    void fillMidiBuffer(juce::MidiBuffer& buffer, double clipStartTime, double clipEndTime, 
-                       double sampleRate, int startSample, bool hasGaplessTransition = false) const;
-    
     bool loadFromFile(const juce::File& file);
     bool saveToFile(const juce::File& file) const;
     
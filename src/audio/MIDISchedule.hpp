@@ -0,0 +1,48 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+// MIDISchedule - every event of a MIDI track's clips compiled into one
+// time-sorted array at the device sample rate, with transpose, clip velocity
+// and the clip-end note-offs already applied. Events on the same sample are
+// ordered note-offs first, then by clip. Playback walks the array with a
+// cursor kept from the previous block, so a block costs only the events it
+// emits; a seek falls back to a binary search. Built on the message thread,
+// then owned by whichever thread renders the track.
+struct MIDISchedule {
+    struct Event {
+        juce::int64 samplePosition; // absolute, at sampleRate
+        juce::uint32 dataOffset;    // raw message bytes, in data
+        juce::uint32 size;
+    };
+
+    double sampleRate = 44100.0;
+    std::vector<Event> events;
+    std::vector<juce::uint8> data;
+
+    size_t cursor = 0;
+    juce::int64 nextSample = -1; // where the last block ended
+
+    // Calls fn(event, bytes) for every event in [startSample, endSample).
+    // Never allocates.
+    template <typename Fn>
+    void forEachEventIn(juce::int64 startSample, juce::int64 endSample, Fn&& fn) {
+        // Block positions come from seconds, so allow for a sample of rounding
+        // between consecutive blocks; anything further is a seek
+        if (std::abs(startSample - nextSample) > 1) {
+            auto it = std::lower_bound(events.begin(), events.end(), startSample,
+                                       [](const Event& e, juce::int64 s) { return e.samplePosition < s; });
+            cursor = static_cast<size_t>(it - events.begin());
+        }
+
+        while (cursor < events.size() && events[cursor].samplePosition < endSample) {
+            const auto& event = events[cursor++];
+            fn(event, data.data() + event.dataOffset);
+        }
+        nextSample = endSample;
+    }
+};
@@ -1,103 +1,77 @@
 #include "MIDITrack.hpp"
 #include "AudioClip.hpp"
+#include "StateHasher.hpp"
 #include "../DebugConfig.hpp"
 #include <juce_audio_basics/juce_audio_basics.h>
 
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+
 MIDITrack::MIDITrack() : Track() {}
 
+MIDITrack::~MIDITrack() {
+    // Nothing renders a track that is being destroyed
+    delete activeSchedule;
+
+    MIDISchedule* schedule = nullptr;
+    while (scheduleQueue.pop(schedule)) {
+        delete schedule;
+    }
+    while (retiredScheduleQueue.pop(schedule)) {
+        delete schedule;
+    }
+}
+
 void MIDITrack::process(double playheadSeconds, juce::AudioBuffer<float>& outputBuffer, int numSamples, double sampleRate) {
     outputBuffer.clear();
-    
-    juce::MidiBuffer midiBuffer;
-    
-    double bufferDuration = numSamples / sampleRate;
-    double endTime = playheadSeconds + bufferDuration;
-    
-    std::vector<std::tuple<int, juce::MidiMessage, size_t>> allEvents;
+    blockMidi.clear();
 
-    std::set<double> clipsStartingInBuffer;
-    for (const auto& clip : midiClips) {
-        double clipStartTime = clip.startTime;
-        if (clipStartTime > playheadSeconds && clipStartTime <= endTime) {
-            clipsStartingInBuffer.insert(clipStartTime);
+    MIDISchedule* incoming = nullptr;
+    while (scheduleQueue.pop(incoming)) {
+        if (activeSchedule && !retiredScheduleQueue.push(activeSchedule)) {
+            // Cannot happen while the return queue is deeper than the publish queue
+            jassertfalse;
         }
+        activeSchedule = incoming;
     }
-    
-    for (size_t clipIndex = 0; clipIndex < midiClips.size(); ++clipIndex) {
-        auto& clip = midiClips[clipIndex];
-        
-        if (clip.overlapsRange(playheadSeconds, endTime)) {
-            juce::MidiBuffer clipBuffer;
-            
-            // Check if this clip ends exactly when another clip starts
-            bool hasGaplessTransition = false;
-            double clipEndTime = clip.startTime + clip.duration;
-            if (clipsStartingInBuffer.count(clipEndTime) > 0) {
-                hasGaplessTransition = true;
-            }
-            
-            clip.fillMidiBuffer(clipBuffer, playheadSeconds, endTime, sampleRate, 0, hasGaplessTransition);
-            
-            // Extract events from the clip buffer
-            for (const auto& event : clipBuffer) {
-                allEvents.emplace_back(event.samplePosition, event.getMessage(), clipIndex);
-            }
-        }
+
+    if (processFrozen(playheadSeconds, outputBuffer, numSamples, sampleRate)) {
+        return;
     }
-    
-    // Sort events by sample position
-    std::sort(allEvents.begin(), allEvents.end(), 
-              [](const auto& a, const auto& b) {
-                  int sampleA = std::get<0>(a);
-                  int sampleB = std::get<0>(b);
-                  if (sampleA != sampleB) return sampleA < sampleB;
-                  
-                  // At the same sample time, handle note transitions carefully
-                  const auto& msgA = std::get<1>(a);
-                  const auto& msgB = std::get<1>(b);
-                  bool aIsNoteOn = msgA.isNoteOn() && msgA.getVelocity() > 0;
-                  bool bIsNoteOn = msgB.isNoteOn() && msgB.getVelocity() > 0;
-                  bool aIsNoteOff = msgA.isNoteOff();
-                  bool bIsNoteOff = msgB.isNoteOff();
-                  
-                  // For same note at same sample: note-off before note-on (seamless transition)
-                  if (aIsNoteOff && bIsNoteOn && msgA.getNoteNumber() == msgB.getNoteNumber()) {
-                      return true; // note-off first for same note
-                  }
-                  if (bIsNoteOff && aIsNoteOn && msgB.getNoteNumber() == msgA.getNoteNumber()) {
-                      return false; // note-off first for same note
-                  }
-                  
-                  // Otherwise, standard priority: note-offs before note-ons
-                  if (aIsNoteOff != bIsNoteOff) return aIsNoteOff;
-                  return std::get<2>(a) < std::get<2>(b); // then by clip index
-              });
-    
-    // Add sorted events to the main buffer, handling conflicts
-    std::set<int> activeNotes; 
-    for (const auto& event : allEvents) {
-        int samplePos = std::get<0>(event);
-        juce::MidiMessage message = std::get<1>(event);
-        
-        if (message.isNoteOn() && message.getVelocity() > 0) {
-            int note = message.getNoteNumber();
-            // If note is already active, send note-off first
-            if (activeNotes.count(note)) {
-                midiBuffer.addEvent(juce::MidiMessage::noteOff(message.getChannel(), note), samplePos);
+
+    if (activeSchedule) {
+        const double scheduleRate = activeSchedule->sampleRate;
+        const auto blockStart = static_cast<juce::int64>(std::llround(playheadSeconds * scheduleRate));
+        const auto blockEnd = static_cast<juce::int64>(std::llround((playheadSeconds + numSamples / sampleRate) * scheduleRate));
+        const double toBlockSamples = sampleRate / scheduleRate;
+
+        // A note started again while still sounding in this block is ended first
+        std::bitset<128> activeNotes;
+
+        activeSchedule->forEachEventIn(blockStart, blockEnd, [&](const MIDISchedule::Event& event, const juce::uint8* bytes) {
+            const int samplePos = juce::jlimit(0, numSamples - 1,
+                                               static_cast<int>((event.samplePosition - blockStart) * toBlockSamples));
+            const int status = bytes[0] & 0xf0;
+            const bool isNoteOn = status == 0x90 && event.size >= 3 && bytes[2] > 0;
+            const bool isNoteOff = status == 0x80 || (status == 0x90 && event.size >= 3 && bytes[2] == 0);
+
+            if (isNoteOn) {
+                const int note = bytes[1] & 0x7f;
+                if (activeNotes[static_cast<size_t>(note)]) {
+                    const juce::uint8 noteOff[] = { static_cast<juce::uint8>(0x80 | (bytes[0] & 0x0f)), bytes[1], 0 };
+                    blockMidi.addEvent(noteOff, 3, samplePos);
+                }
+                activeNotes.set(static_cast<size_t>(note));
+            } else if (isNoteOff) {
+                activeNotes.reset(static_cast<size_t>(bytes[1] & 0x7f));
             }
-            activeNotes.insert(note);
-            midiBuffer.addEvent(message, samplePos);
-        } else if (message.isNoteOff()) {
-            int note = message.getNoteNumber();
-            activeNotes.erase(note);
-            midiBuffer.addEvent(message, samplePos);
-        } else {
-            midiBuffer.addEvent(message, samplePos);
-        }
+            blockMidi.addEvent(bytes, static_cast<int>(event.size), samplePos);
+        });
     }
-    
+
     // Process effects, passing MIDI data to synthesizers
-    processEffectsWithMidi(outputBuffer, midiBuffer);
+    processEffectsWithMidi(outputBuffer, blockMidi);
     
     // Apply track volume and mute
     // Apply track-level automation: volume and pan (use first automation point if present)
@@ -115,17 +89,16 @@ void MIDITrack::process(double playheadSeconds, juce::AudioBuffer<float>& output
         }
     }
 
-    if (muted) {
-        outputBuffer.clear();
-    } else {
-        float trackGain = juce::Decibels::decibelsToGain(volumeDb);
-        outputBuffer.applyGain(trackGain);
-    }
+    applyTrackGain(outputBuffer, numSamples);
 }
 
 void MIDITrack::prepareToPlay(double sampleRate, int bufferSize) {
     currentSampleRate = sampleRate;
     currentBufferSize = bufferSize;
+    scratchBuffers.prepare(2, bufferSize, 1);
+    prepareAutomation(bufferSize);
+    segmentMidi.ensureSize(8192);
+    blockMidi.ensureSize(8192);
     
     // Prepare all effects
     for (auto& effect : effects) {
@@ -147,6 +120,9 @@ AudioClip* MIDITrack::getReferenceClip() { return nullptr; }
 
 void MIDITrack::clearMIDIClips() {
     midiClips.clear();
+    clipCaches.clear();
+    scheduleDirty = true;
+    clipsStateNode.invalidate();
 }
 
 const std::vector<MIDIClip>& MIDITrack::getMIDIClips() const {
@@ -155,36 +131,212 @@ const std::vector<MIDIClip>& MIDITrack::getMIDIClips() const {
 
 void MIDITrack::addMIDIClip(const MIDIClip& clip) {
     midiClips.push_back(clip);
+    clipCaches.emplace_back();
+    scheduleDirty = true;
+    clipsStateNode.invalidate();
 }
 
 void MIDITrack::removeMIDIClip(size_t index) {
     if (index < midiClips.size()) {
         midiClips.erase(midiClips.begin() + index);
+        clipCaches.erase(clipCaches.begin() + index);
+        scheduleDirty = true;
+        clipsStateNode.invalidate();
     }
 }
 
 MIDIClip* MIDITrack::getMIDIClip(size_t index) {
     if (index < midiClips.size()) {
+        markClipChanged(index);
         return &midiClips[index];
     }
     return nullptr;
 }
 
+bool MIDITrack::markMIDIClipChanged(const MIDIClip* clip) {
+    for (size_t i = 0; i < midiClips.size(); ++i) {
+        if (&midiClips[i] == clip) {
+            markClipChanged(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void MIDITrack::markClipChanged(size_t index) {
+    clipCaches[index].fingerprintDirty = true;
+    clipCaches[index].eventsDirty = true;
+    scheduleDirty = true;
+    clipsStateNode.invalidate();
+}
+
 size_t MIDITrack::getMIDIClipCount() const {
     return midiClips.size();
 }
 
-void MIDITrack::processEffectsWithMidi(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer) {
-    for (size_t i = 0; i < effects.size(); ++i) {
-        const auto& effect = effects[i];
-        if (effect && effect->enabled()) {
-            if (effect->isSynthesizer()) {
-                effect->processAudio(buffer, midiBuffer);
+void MIDITrack::hashFreezeContent(StateHasher& hasher) const {
+    hasher.add(computeClipFingerprint());
+}
+
+void MIDITrack::hashClipState(StateHasher& hasher) const {
+    hasher.add(computeClipFingerprint());
+    for (const auto& clip : midiClips) {
+        hasher.add(clip.sourceFile.getFileName().toStdString());
+    }
+}
+
+std::uint64_t MIDITrack::computeClipFingerprint() const {
+    // The clip fields and event bytes the schedule is compiled from; only
+    // clips marked changed since the last call are hashed again
+    StateHasher hasher;
+    for (size_t i = 0; i < midiClips.size(); ++i) {
+        auto& cache = clipCaches[i];
+        if (cache.fingerprintDirty) {
+            const auto& clip = midiClips[i];
+            StateHasher clipHasher;
+            clipHasher.add(clip.startTime);
+            clipHasher.add(clip.offset);
+            clipHasher.add(clip.duration);
+            clipHasher.add(clip.velocity);
+            clipHasher.add(clip.channel);
+            clipHasher.add(clip.transpose);
+            const int dataSize = clip.midiData.data.size();
+            clipHasher.add(dataSize);
+            clipHasher.add(clip.midiData.data.begin(), static_cast<size_t>(dataSize));
+            cache.fingerprint = clipHasher.get();
+            cache.fingerprintDirty = false;
+        }
+        hasher.add(cache.fingerprint);
+    }
+    return hasher.get();
+}
+
+std::vector<MIDITrack::CompiledEvent> MIDITrack::compileClipEvents(const MIDIClip& clip, double sampleRate, double bpm) {
+    std::vector<CompiledEvent> events;
+
+    auto toSample = [sampleRate](double seconds) {
+        return static_cast<juce::int64>(std::llround(seconds * sampleRate));
+    };
+
+    // Per channel and pitch, so each note ends on the channel it started on
+    std::bitset<16 * 128> notesPlayed;
+    for (const auto& event : clip.midiData) {
+        // The part of the clip on the timeline is [offset, duration) in clip time
+        const double clipTime = MIDIClip::ticksToSeconds(event.samplePosition, bpm);
+        if (clipTime < 0.0 || clipTime < clip.offset || clipTime >= clip.duration) {
+            continue;
+        }
+
+        juce::MidiMessage message = event.getMessage();
+        if (message.isNoteOnOrOff()) {
+            const int noteNumber = juce::jlimit(0, 127, message.getNoteNumber() + clip.transpose);
+            if (message.isNoteOn()) {
+                const int newVelocity = juce::jlimit(0, 127, static_cast<int>(message.getVelocity() * clip.velocity));
+                message = juce::MidiMessage::noteOn(message.getChannel(), noteNumber, static_cast<juce::uint8>(newVelocity));
+                notesPlayed.set(static_cast<size_t>((message.getChannel() - 1) * 128 + noteNumber));
             } else {
-                effect->processAudio(buffer);
+                message = juce::MidiMessage::noteOff(message.getChannel(), noteNumber);
+            }
+        }
+
+        events.push_back({ toSample(clip.startTime - clip.offset + clipTime), message.isNoteOff(), message });
+    }
+
+    // End every note the clip played where the clip ends
+    const auto clipEnd = toSample(clip.getEndTime());
+    for (int channel = 1; channel <= 16; ++channel) {
+        for (int note = 0; note < 128; ++note) {
+            if (notesPlayed[static_cast<size_t>((channel - 1) * 128 + note)]) {
+                events.push_back({ clipEnd, true, juce::MidiMessage::noteOff(channel, note) });
             }
         }
     }
+    return events;
+}
+
+std::unique_ptr<MIDISchedule> MIDITrack::compileMIDISchedule(double sampleRate, double bpm, bool timingChanged) {
+    struct PendingEvent {
+        const CompiledEvent* event;
+        size_t clipIndex;
+    };
+    std::vector<PendingEvent> pending;
+
+    for (size_t clipIndex = 0; clipIndex < midiClips.size(); ++clipIndex) {
+        auto& cache = clipCaches[clipIndex];
+        if (cache.eventsDirty || timingChanged) {
+            cache.events = compileClipEvents(midiClips[clipIndex], sampleRate, bpm);
+            cache.eventsDirty = false;
+        }
+        for (const auto& event : cache.events) {
+            pending.push_back({ &event, clipIndex });
+        }
+    }
+
+    // Note-offs first on a shared sample, so a clip can start a note exactly where another ends it
+    std::stable_sort(pending.begin(), pending.end(), [](const PendingEvent& a, const PendingEvent& b) {
+        if (a.event->samplePosition != b.event->samplePosition) return a.event->samplePosition < b.event->samplePosition;
+        if (a.event->isNoteOff != b.event->isNoteOff) return a.event->isNoteOff;
+        return a.clipIndex < b.clipIndex;
+    });
+
+    auto schedule = std::make_unique<MIDISchedule>();
+    schedule->sampleRate = sampleRate;
+    schedule->events.reserve(pending.size());
+    for (const auto& entry : pending) {
+        const auto& message = entry.event->message;
+        const auto size = static_cast<juce::uint32>(message.getRawDataSize());
+        schedule->events.push_back({ entry.event->samplePosition, static_cast<juce::uint32>(schedule->data.size()), size });
+        schedule->data.insert(schedule->data.end(), message.getRawData(), message.getRawData() + size);
+    }
+    return schedule;
+}
+
+void MIDITrack::reclaimMIDISchedule(double bpm) {
+    MIDISchedule* finished = nullptr;
+    while (retiredScheduleQueue.pop(finished)) {
+        delete finished;
+    }
+
+    if (bpm <= 0.0) {
+        return;
+    }
+
+    const bool timingChanged = currentSampleRate != scheduleSampleRate || bpm != scheduleTempo;
+    if (scheduleDirty || timingChanged) {
+        unpublishedSchedule = compileMIDISchedule(currentSampleRate, bpm, timingChanged);
+        scheduleDirty = false;
+        scheduleSampleRate = currentSampleRate;
+        scheduleTempo = bpm;
+    }
+
+    if (unpublishedSchedule && scheduleQueue.push(unpublishedSchedule.get())) {
+        unpublishedSchedule.release();
+    }
+}
+
+void MIDITrack::processEffectsWithMidi(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer) {
+    forEachAutomationSegment(buffer.getNumSamples(), [this, &buffer, &midiBuffer](int start, int length) {
+        juce::AudioBuffer<float> segment(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, length);
+
+        // Whole block: hand the synth the buffer as is. Sub-block: only its events, rebased to 0.
+        juce::MidiBuffer* segmentEvents = &midiBuffer;
+        if (length != buffer.getNumSamples()) {
+            segmentMidi.clear();
+            segmentMidi.addEvents(midiBuffer, start, length, -start);
+            segmentEvents = &segmentMidi;
+        }
+
+        for (size_t i = 0; i < effects.size(); ++i) {
+            const auto& effect = effects[i];
+            if (effect && effect->enabled()) {
+                if (effect->isSynthesizer()) {
+                    effect->processAudio(segment, *segmentEvents);
+                } else {
+                    effect->processAudio(segment);
+                }
+            }
+        }
+    });
 }
 
 void MIDITrack::sendAllNotesOff() {
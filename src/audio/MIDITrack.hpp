@@ -2,6 +2,10 @@
 
 #include "Track.hpp"
 #include "MIDIClip.hpp"
+#include "MIDISchedule.hpp"
+#include "SpscQueue.hpp"
+
+#include <cstdint>
 
 // Forward declaration
 class AudioClip;
@@ -10,7 +14,7 @@ class AudioClip;
 class MIDITrack : public Track {
 public:
     MIDITrack();
-    ~MIDITrack() override = default;
+    ~MIDITrack() override;
 
     // Track type identification
     TrackType getType() const override { return TrackType::MIDI; }
@@ -31,19 +35,71 @@ public:
     const std::vector<MIDIClip>& getMIDIClips() const;
     void addMIDIClip(const MIDIClip& clip);
     void removeMIDIClip(size_t index);
+    // Marks the clip changed, as the caller is taken to be about to edit it
     MIDIClip* getMIDIClip(size_t index);
     size_t getMIDIClipCount() const;
+    // Editors that keep a clip pointer call this after each edit through it;
+    // false if the clip isn't one of this track's
+    bool markMIDIClipChanged(const MIDIClip* clip);
+    // Changes whenever any clip's timing or events do
+    std::uint64_t getMIDIClipFingerprint() const { return computeClipFingerprint(); }
     
     // MIDI control methods
     void sendAllNotesOff();
     void sendMIDIMessage(const juce::MidiMessage& message);
 
+    // Frees schedules the render thread has swapped out and, if the clips,
+    // the tempo or the device rate changed since the last call, compiles and
+    // publishes a new one. Message thread only; the engine calls it every frame.
+    void reclaimMIDISchedule(double bpm);
+
 private:
     // MIDI-specific data members
     std::vector<MIDIClip> midiClips;
     
     // Temporary empty AudioClip vector for compatibility
     std::vector<AudioClip> emptyClips;
+
+    // Events of one automation segment, rebased to its start; sized in prepareToPlay
+    juce::MidiBuffer segmentMidi;
+
+    // The current block's events, rebuilt by process(); sized in prepareToPlay
+    juce::MidiBuffer blockMidi;
+
+    // Compiled clips, handed to the render thread like the automation lanes.
+    // Clips are edited in place through getMIDIClip() and the editors'
+    // pointers, which mark them changed; only changed clips are hashed and
+    // compiled again.
+    SpscQueue<MIDISchedule*, 8> scheduleQueue;
+    SpscQueue<MIDISchedule*, 16> retiredScheduleQueue;
+    MIDISchedule* activeSchedule = nullptr;        // render thread
+    std::unique_ptr<MIDISchedule> unpublishedSchedule; // waiting for room in scheduleQueue
+    // What the last compiled schedule was built for
+    double scheduleSampleRate = 0.0;
+    double scheduleTempo = 0.0;
+    bool scheduleDirty = true; // clips added, removed or changed since the last compile
+
+    struct CompiledEvent {
+        juce::int64 samplePosition;
+        bool isNoteOff;
+        juce::MidiMessage message;
+    };
+
+    // One per clip, in clip order
+    struct ClipCache {
+        bool fingerprintDirty = true;
+        bool eventsDirty = true;
+        std::uint64_t fingerprint = 0;
+        std::vector<CompiledEvent> events; // at scheduleSampleRate and scheduleTempo
+    };
+    mutable std::vector<ClipCache> clipCaches;
+
+    void markClipChanged(size_t index);
+    static std::vector<CompiledEvent> compileClipEvents(const MIDIClip& clip, double sampleRate, double bpm);
+    std::unique_ptr<MIDISchedule> compileMIDISchedule(double sampleRate, double bpm, bool timingChanged);
+    std::uint64_t computeClipFingerprint() const;
+    void hashFreezeContent(StateHasher& hasher) const override;
+    void hashClipState(StateHasher& hasher) const override;
     
     // MIDI-specific effect processing
     void processEffectsWithMidi(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer);
@@ -0,0 +1,283 @@
+#include "OfflineRenderer.hpp"
+#include "AudioTrack.hpp"
+#include "TrackRenderPool.hpp"
+#include "../DebugConfig.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+    constexpr int numOutputChannels = 2;
+
+    // Roughly two seconds of audio queued between the renderer and the disk
+    constexpr double writerBufferSeconds = 2.0;
+}
+
+OfflineRenderer::OfflineRenderer() : juce::Thread("MULO Export") {}
+
+OfflineRenderer::~OfflineRenderer() {
+    cancel();
+}
+
+int OfflineRenderer::getBitsPerSample(ExportSampleFormat format) {
+    switch (format) {
+        case ExportSampleFormat::Int16:   return 16;
+        case ExportSampleFormat::Float32: return 32; // WAV writes 32-bit as IEEE float
+        case ExportSampleFormat::Int24:
+        default:                          return 24;
+    }
+}
+
+bool OfflineRenderer::start(Job newJob) {
+    if (isThreadRunning()) {
+        return false;
+    }
+
+    job = std::move(newJob);
+    job.blockSize = juce::jmax(1, job.blockSize);
+    if (!job.trackLock) {
+        job.trackLock = &ownTrackLock;
+    }
+
+    // Stems map one to one onto tracks
+    jassert(job.stemFiles.empty() || job.stemFiles.size() == job.tracks.size());
+    if (job.stemFiles.size() != job.tracks.size()) {
+        job.stemFiles.clear();
+    }
+
+    samplesRendered.store(0);
+    samplesTotal.store(std::max<juce::int64>(0, static_cast<juce::int64>((job.endSeconds - job.startSeconds) * job.sampleRate)));
+    startTimeMs.store(juce::Time::getMillisecondCounterHiRes());
+    finishTimeMs.store(0.0);
+    wasCancelled.store(false);
+    hasFailed.store(false);
+    {
+        const juce::ScopedLock sl(outputPathLock);
+        outputPath = job.outputFile.getFullPathName();
+    }
+
+    return startThread(juce::Thread::Priority::high);
+}
+
+void OfflineRenderer::cancel() {
+    if (isThreadRunning()) {
+        wasCancelled.store(true);
+        stopThread(10000);
+    }
+}
+
+ExportProgress OfflineRenderer::getProgress() const {
+    ExportProgress progress;
+    progress.running = isThreadRunning();
+    progress.cancelled = wasCancelled.load();
+    progress.failed = hasFailed.load();
+    {
+        const juce::ScopedLock sl(outputPathLock);
+        progress.outputPath = outputPath.toStdString();
+    }
+
+    const auto rendered = samplesRendered.load();
+    const auto total = samplesTotal.load();
+    progress.fraction = total > 0 ? static_cast<double>(rendered) / static_cast<double>(total) : 1.0;
+
+    const double endMs = finishTimeMs.load() > 0.0 ? finishTimeMs.load() : juce::Time::getMillisecondCounterHiRes();
+    const double elapsedSeconds = (endMs - startTimeMs.load()) / 1000.0;
+    if (elapsedSeconds > 0.0 && job.sampleRate > 0.0) {
+        progress.realtimeFactor = (static_cast<double>(rendered) / job.sampleRate) / elapsedSeconds;
+    }
+    return progress;
+}
+
+void OfflineRenderer::run() {
+    // Clips still decoding in the background would otherwise render as silence.
+    // Locked a track at a time so the device callback isn't held up for all of them.
+    for (auto* track : job.tracks) {
+        if (auto* audioTrack = dynamic_cast<AudioTrack*>(track)) {
+            const juce::ScopedLock lock(*job.trackLock);
+            audioTrack->preloadAllClips(job.sampleRate);
+        }
+    }
+
+    auto forEachEffect = [this](auto&& fn) {
+        const juce::ScopedLock lock(*job.trackLock);
+        for (auto* track : job.tracks) {
+            for (auto& effect : track->getEffects()) {
+                if (effect) fn(*effect);
+            }
+        }
+        if (job.masterTrack) {
+            for (auto& effect : job.masterTrack->getEffects()) {
+                if (effect) fn(*effect);
+            }
+        }
+    };
+    forEachEffect([](Effect& effect) { effect.setNonRealtime(true); });
+
+    bool success = true;
+    outputs.clear();
+    outputs.resize(1 + job.stemFiles.size());
+    outputs[0].file = job.outputFile;
+    for (size_t i = 0; i < job.stemFiles.size(); ++i) {
+        outputs[i + 1].file = job.stemFiles[i];
+    }
+    for (auto& output : outputs) {
+        success = success && openOutput(output);
+    }
+
+    if (success) {
+        success = renderToOutputs(samplesTotal.load());
+    }
+    closeOutputs();
+
+    forEachEffect([](Effect& effect) { effect.setNonRealtime(false); });
+
+    if (!success) {
+        // A cancelled or failed export should not leave truncated files behind
+        for (const auto& output : outputs) {
+            if (output.created) {
+                output.file.deleteFile();
+            }
+        }
+        hasFailed.store(!wasCancelled.load());
+    }
+    outputs.clear();
+    finishTimeMs.store(juce::Time::getMillisecondCounterHiRes());
+
+    const auto progress = getProgress();
+    DEBUG_PRINT("[OfflineRenderer] " << (success ? "Exported " : "Export stopped: ") << progress.outputPath
+                << " at " << progress.realtimeFactor << "x realtime");
+
+    if (job.onFinished) {
+        job.onFinished(progress);
+    }
+}
+
+bool OfflineRenderer::openOutput(Output& output) {
+    output.file.getParentDirectory().createDirectory();
+
+    std::unique_ptr<juce::FileOutputStream> stream(output.file.createOutputStream());
+    if (!stream) {
+        std::cerr << "Failed to open " << output.file.getFullPathName() << " for export" << std::endl;
+        return false;
+    }
+    output.created = true;
+
+    juce::WavAudioFormat wavFormat;
+    std::unique_ptr<juce::AudioFormatWriter> writer(
+        wavFormat.createWriterFor(stream.get(), job.sampleRate, numOutputChannels, getBitsPerSample(job.format), {}, 0));
+    if (!writer) {
+        return false;
+    }
+    stream.release(); // the writer owns it now
+
+    // One disk thread per file so a slow stem never holds up the others
+    output.thread = std::make_unique<juce::TimeSliceThread>("MULO Export Writer");
+    output.thread->startThread();
+    output.writer = std::make_unique<juce::AudioFormatWriter::ThreadedWriter>(
+        writer.release(), *output.thread, juce::roundToInt(writerBufferSeconds * job.sampleRate));
+    return true;
+}
+
+void OfflineRenderer::closeOutputs() {
+    for (auto& output : outputs) {
+        output.writer.reset(); // flushes whatever is still queued
+        if (output.thread) {
+            output.thread->stopThread(5000);
+            output.thread.reset();
+        }
+    }
+}
+
+bool OfflineRenderer::writeBlock(Output& output, const juce::AudioBuffer<float>& buffer, int numSamples) {
+    // The writer thread drains the queue; wait for room rather than drop audio
+    while (!output.writer->write(buffer.getArrayOfReadPointers(), numSamples)) {
+        if (threadShouldExit()) {
+            return false;
+        }
+        wait(1);
+    }
+    return true;
+}
+
+bool OfflineRenderer::renderToOutputs(juce::int64 totalSamples) {
+    mixBuffer.setSize(numOutputChannels, job.blockSize);
+    trackBuffers.resize(job.tracks.size());
+    for (auto& buffer : trackBuffers) {
+        buffer.setSize(numOutputChannels, job.blockSize);
+    }
+
+    // Offline rendering runs at normal priority; it shouldn't compete with the device thread
+    TrackRenderPool pool;
+    pool.setUseRealtimePriority(false);
+    pool.setNumThreads(job.numThreads < 0 ? juce::jmax(0, juce::SystemStats::getNumCpus() - 1) : job.numThreads);
+
+    auto renderTrack = [this](int index) {
+        const auto i = static_cast<size_t>(index);
+        job.tracks[i]->applyAutomation(renderPosition, renderNumSamples, job.sampleRate);
+        job.tracks[i]->process(renderPosition, trackBuffers[i], renderNumSamples, job.sampleRate);
+    };
+
+    for (juce::int64 pos = 0; pos < totalSamples; pos += job.blockSize) {
+        if (threadShouldExit()) {
+            return false;
+        }
+
+        renderNumSamples = static_cast<int>(std::min(static_cast<juce::int64>(job.blockSize), totalSamples - pos));
+        renderPosition = job.startSeconds + static_cast<double>(pos) / job.sampleRate;
+
+        for (auto& buffer : trackBuffers) {
+            buffer.setSize(numOutputChannels, renderNumSamples, false, false, true);
+            buffer.clear();
+        }
+
+        // Edits wait for the block rather than free what it is reading; the
+        // writers are fed after the lock is dropped
+        {
+            const juce::ScopedLock lock(*job.trackLock);
+            if (job.onBlockStart) {
+                job.onBlockStart(renderPosition);
+            }
+            pool.run(static_cast<int>(job.tracks.size()), renderTrack);
+            mixBlock(renderNumSamples);
+        }
+
+        // Stems are the track buffers as rendered, i.e. after the track fader
+        for (size_t i = 1; i < outputs.size(); ++i) {
+            if (!writeBlock(outputs[i], trackBuffers[i - 1], renderNumSamples)) {
+                return false;
+            }
+        }
+
+        if (!writeBlock(outputs[0], mixBuffer, renderNumSamples)) {
+            return false;
+        }
+
+        samplesRendered.store(pos + renderNumSamples);
+    }
+
+    return true;
+}
+
+void OfflineRenderer::mixBlock(int numSamples) {
+    mixBuffer.setSize(numOutputChannels, numSamples, false, false, true);
+    mixBuffer.clear();
+
+    // Sum in track order so the file matches what the device callback plays
+    for (const auto& buffer : trackBuffers) {
+        for (int ch = 0; ch < numOutputChannels; ++ch) {
+            mixBuffer.addFrom(ch, 0, buffer, ch, 0, numSamples);
+        }
+    }
+
+    auto* master = job.masterTrack;
+    if (master && !master->isMuted()) {
+        master->processEffects(mixBuffer);
+        float masterGain = juce::Decibels::decibelsToGain(master->getVolume());
+        float masterPan = master->getPan();
+        float panL = std::cos((masterPan + 1.0f) * juce::MathConstants<float>::pi * 0.25f);
+        float panR = std::sin((masterPan + 1.0f) * juce::MathConstants<float>::pi * 0.25f);
+        mixBuffer.applyGain(0, 0, numSamples, masterGain * panL);
+        mixBuffer.applyGain(1, 0, numSamples, masterGain * panR);
+    }
+}
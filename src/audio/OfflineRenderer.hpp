@@ -0,0 +1,100 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include "Track.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class ExportSampleFormat { Int16, Int24, Float32 };
+
+struct ExportProgress {
+    double fraction = 0.0;       // 0..1 of the song rendered
+    double realtimeFactor = 0.0; // seconds of audio rendered per wall-clock second
+    bool running = false;
+    bool cancelled = false;
+    bool failed = false;
+    std::string outputPath;
+};
+
+// OfflineRenderer - renders a song to disk on its own thread, faster than
+// realtime. Tracks are fanned out over a TrackRenderPool block by block and
+// each mixed block is streamed to a ThreadedWriter, so the song never has to
+// fit in memory. With stem files set, every track's post-fader output is
+// written alongside the master in the same pass, each file on its own
+// writer thread.
+class OfflineRenderer : public juce::Thread {
+public:
+    struct Job {
+        std::vector<Track*> tracks;  // already filtered for mute/solo
+        Track* masterTrack = nullptr;
+        double startSeconds = 0.0;
+        double endSeconds = 0.0;
+        double sampleRate = 44100.0;
+        int blockSize = 512;
+        int numThreads = -1;         // negative: one per spare core
+        juce::File outputFile;       // the master mix
+        std::vector<juce::File> stemFiles; // empty, or one per entry in tracks
+        ExportSampleFormat format = ExportSampleFormat::Int24;
+
+        // Called on the render thread before every block, e.g. to move the plugins' play head
+        std::function<void(double positionSeconds)> onBlockStart;
+        // Called on the render thread once the file is closed (or deleted)
+        std::function<void(const ExportProgress&)> onFinished;
+        // Held whenever the render thread touches the tracks, one block at a
+        // time. The engine passes its audio callback lock, which every edit
+        // that swaps out a track's clips or effects takes too.
+        juce::CriticalSection* trackLock = nullptr;
+    };
+
+    OfflineRenderer();
+    ~OfflineRenderer() override;
+
+    // False if a render is already running
+    bool start(Job newJob);
+    void cancel();
+    bool isRendering() const { return isThreadRunning(); }
+
+    ExportProgress getProgress() const;
+
+    static int getBitsPerSample(ExportSampleFormat format);
+
+    void run() override;
+
+private:
+    struct Output {
+        juce::File file;
+        bool created = false;
+        std::unique_ptr<juce::TimeSliceThread> thread;
+        std::unique_ptr<juce::AudioFormatWriter::ThreadedWriter> writer;
+    };
+
+    bool openOutput(Output& output);
+    void closeOutputs();
+    bool writeBlock(Output& output, const juce::AudioBuffer<float>& buffer, int numSamples);
+    bool renderToOutputs(juce::int64 totalSamples);
+    void mixBlock(int numSamples);
+
+    Job job;
+    juce::CriticalSection ownTrackLock; // for a job without a trackLock
+    double renderPosition = 0.0;
+    int renderNumSamples = 0;
+    juce::AudioBuffer<float> mixBuffer;
+    std::vector<juce::AudioBuffer<float>> trackBuffers;
+    std::vector<Output> outputs; // master first, then one per stem
+
+    std::atomic<juce::int64> samplesRendered { 0 };
+    std::atomic<juce::int64> samplesTotal { 0 };
+    std::atomic<double> startTimeMs { 0.0 };
+    std::atomic<double> finishTimeMs { 0.0 };
+    std::atomic<bool> wasCancelled { false };
+    std::atomic<bool> hasFailed { false };
+    juce::String outputPath;
+    mutable juce::CriticalSection outputPathLock;
+};
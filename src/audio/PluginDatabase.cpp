@@ -0,0 +1,229 @@
+#include "PluginDatabase.hpp"
+#include "VSTPluginManager.hpp"
+#include "../DebugConfig.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <fstream>
+
+using json = nlohmann::json;
+
+namespace {
+    // Bumped when an entry's meaning changes, which drops every saved entry
+    constexpr int databaseVersion = 1;
+}
+
+PluginDatabase::PluginDatabase() {
+    formatManager.addDefaultFormats();
+}
+
+bool PluginDatabase::isSynthesizer(juce::AudioPluginInstance& plugin) {
+    const bool acceptsMidi = plugin.acceptsMidi();
+    const bool hasAudioOutput = plugin.getTotalNumOutputChannels() > 0;
+    const bool hasMinimalAudioInput = plugin.getTotalNumInputChannels() <= 0;
+
+    const juce::String category = plugin.getPluginDescription().category.toLowerCase();
+    const bool isInstrumentCategory = category.contains("instrument")
+                                   || category.contains("synth")
+                                   || category.contains("generator");
+
+    return acceptsMidi && hasAudioOutput && (hasMinimalAudioInput || isInstrumentCategory);
+}
+
+PluginDatabase::FileStamp PluginDatabase::getFileStamp(const juce::File& file) {
+    FileStamp stamp;
+    if (!file.isDirectory()) {
+        stamp.modified = file.getLastModificationTime().toMilliseconds();
+        stamp.size = file.getSize();
+        return stamp;
+    }
+
+    // A bundle (.vst3, .component) changes inside, not at its top level
+    stamp.modified = file.getLastModificationTime().toMilliseconds();
+    for (const auto& entry : juce::RangedDirectoryIterator(file, true, "*", juce::File::findFiles)) {
+        stamp.modified = std::max<std::int64_t>(stamp.modified, entry.getModificationTime().toMilliseconds());
+        stamp.size += entry.getFileSize();
+    }
+    return stamp;
+}
+
+PluginDatabase::Entry PluginDatabase::describe(const juce::PluginDescription& description, juce::AudioPluginInstance& plugin) {
+    Entry entry;
+    entry.description = description;
+    entry.isSynthesizer = isSynthesizer(plugin);
+    entry.hasEditor = plugin.hasEditor();
+    entry.acceptsMidi = plugin.acceptsMidi();
+    entry.numInputChannels = plugin.getTotalNumInputChannels();
+    entry.numOutputChannels = plugin.getTotalNumOutputChannels();
+    return entry;
+}
+
+std::optional<juce::PluginDescription> PluginDatabase::scanFile(const juce::File& file) {
+    juce::OwnedArray<juce::PluginDescription> descriptions;
+    for (auto* format : formatManager.getFormats()) {
+        format->findAllTypesForFile(descriptions, file.getFullPathName());
+        if (!descriptions.isEmpty()) {
+            return *descriptions[0];
+        }
+    }
+    return std::nullopt;
+}
+
+const PluginDatabase::StoredEntry* PluginDatabase::findFresh(const std::string& key, const FileStamp& stamp) const {
+    auto it = entries.find(key);
+    return it != entries.end() && it->second.stamp == stamp ? &it->second : nullptr;
+}
+
+std::optional<PluginDatabase::Entry> PluginDatabase::find(const std::string& pluginPath) {
+    if (!VSTPluginManager::getInstance().isValidVSTFile(pluginPath)) {
+        return std::nullopt;
+    }
+    const juce::File pluginFile(pluginPath);
+    if (!pluginFile.exists()) {
+        return std::nullopt;
+    }
+
+    const auto key = pluginFile.getFullPathName().toStdString();
+    const auto stamp = getFileStamp(pluginFile);
+
+    const juce::ScopedLock sl(lock);
+    if (const auto* stored = findFresh(key, stamp)) {
+        ++hits;
+        return stored->entry;
+    }
+
+    const auto description = scanFile(pluginFile);
+    if (!description) {
+        return std::nullopt;
+    }
+
+    juce::String errorMessage;
+    auto plugin = formatManager.createPluginInstance(*description, 44100.0, 512, errorMessage);
+    if (!plugin) {
+        DEBUG_PRINT("[PluginDatabase] Could not probe " << pluginPath << ": " << errorMessage);
+        return std::nullopt;
+    }
+
+    ++probes;
+    const auto entry = describe(*description, *plugin);
+    plugin.reset();
+    store(key, stamp, entry);
+    return entry;
+}
+
+std::optional<juce::PluginDescription> PluginDatabase::findDescription(const std::string& pluginPath) {
+    const juce::File pluginFile(pluginPath);
+    const auto key = pluginFile.getFullPathName().toStdString();
+    const auto stamp = getFileStamp(pluginFile);
+
+    const juce::ScopedLock sl(lock);
+    if (const auto* stored = findFresh(key, stamp)) {
+        ++hits;
+        return stored->entry.description;
+    }
+    return scanFile(pluginFile);
+}
+
+std::unique_ptr<juce::AudioPluginInstance> PluginDatabase::createInstance(const juce::PluginDescription& description,
+                                                                          double sampleRate, int blockSize,
+                                                                          juce::String& errorMessage) {
+    const juce::ScopedLock sl(lock);
+    return formatManager.createPluginInstance(description, sampleRate, blockSize, errorMessage);
+}
+
+void PluginDatabase::remember(const std::string& pluginPath, juce::AudioPluginInstance& plugin) {
+    const juce::File pluginFile(pluginPath);
+    const auto key = pluginFile.getFullPathName().toStdString();
+    const auto stamp = getFileStamp(pluginFile);
+
+    const juce::ScopedLock sl(lock);
+    if (findFresh(key, stamp)) {
+        return;
+    }
+    store(key, stamp, describe(plugin.getPluginDescription(), plugin));
+}
+
+void PluginDatabase::store(const std::string& key, const FileStamp& stamp, const Entry& entry) {
+    entries[key] = { stamp, entry };
+    save();
+}
+
+PluginDatabase::Stats PluginDatabase::getStats() const {
+    const juce::ScopedLock sl(lock);
+    Stats stats;
+    stats.hits = hits;
+    stats.probes = probes;
+    stats.numEntries = static_cast<int>(entries.size());
+    return stats;
+}
+
+void PluginDatabase::setFile(const juce::File& databaseFile) {
+    const juce::ScopedLock sl(lock);
+    file = databaseFile;
+    load();
+}
+
+void PluginDatabase::load() {
+    std::ifstream in(file.getFullPathName().toStdString());
+    if (!in.is_open()) {
+        return;
+    }
+
+    try {
+        json j;
+        in >> j;
+        if (j.value("version", 0) != databaseVersion) {
+            DEBUG_PRINT("[PluginDatabase] Ignoring " << file.getFullPathName() << " from another version");
+            return;
+        }
+
+        for (const auto& plugin : j.at("plugins")) {
+            const auto xml = juce::parseXML(juce::String::fromUTF8(plugin.at("description").get<std::string>().c_str()));
+            StoredEntry stored;
+            if (!xml || !stored.entry.description.loadFromXml(*xml)) {
+                continue;
+            }
+            stored.stamp.modified = plugin.at("modified").get<std::int64_t>();
+            stored.stamp.size = plugin.at("size").get<std::int64_t>();
+            stored.entry.isSynthesizer = plugin.value("isSynthesizer", false);
+            stored.entry.hasEditor = plugin.value("hasEditor", false);
+            stored.entry.acceptsMidi = plugin.value("acceptsMidi", false);
+            stored.entry.numInputChannels = plugin.value("numInputChannels", 0);
+            stored.entry.numOutputChannels = plugin.value("numOutputChannels", 0);
+            entries[plugin.at("path").get<std::string>()] = std::move(stored);
+        }
+        DEBUG_PRINT("[PluginDatabase] Loaded " << entries.size() << " plugins from " << file.getFullPathName());
+    } catch (const json::exception& e) {
+        DEBUG_PRINT("[PluginDatabase] Failed to read " << file.getFullPathName() << ": " << e.what());
+    }
+}
+
+void PluginDatabase::save() const {
+    if (file == juce::File()) {
+        return;
+    }
+
+    json plugins = json::array();
+    for (const auto& [path, stored] : entries) {
+        const auto& entry = stored.entry;
+        plugins.push_back({
+            { "path", path },
+            { "modified", stored.stamp.modified },
+            { "size", stored.stamp.size },
+            { "description", entry.description.createXml()->toString(juce::XmlElement::TextFormat().singleLine()).toStdString() },
+            { "isSynthesizer", entry.isSynthesizer },
+            { "hasEditor", entry.hasEditor },
+            { "acceptsMidi", entry.acceptsMidi },
+            { "numInputChannels", entry.numInputChannels },
+            { "numOutputChannels", entry.numOutputChannels }
+        });
+    }
+    const json j = { { "version", databaseVersion }, { "plugins", plugins } };
+
+    // Written beside the real file and moved over it, so a crash never leaves half a database
+    juce::TemporaryFile temp(file);
+    if (!temp.getFile().replaceWithText(j.dump(2)) || !temp.overwriteTargetFileWithTemporary()) {
+        DEBUG_PRINT("[PluginDatabase] Failed to write " << file.getFullPathName());
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// PluginDatabase - what MULO knows about each plugin file without having to
+// load it: its PluginDescription, whether it is a synthesizer, its default
+// channel layout and whether it has an editor. Entries are keyed by path and
+// remembered across runs in a JSON file; one whose file has changed on disk
+// (modification time or size) is probed again. Probing instantiates the
+// plugin once, in process.
+class PluginDatabase {
+public:
+    struct Entry {
+        juce::PluginDescription description;
+        bool isSynthesizer = false;
+        bool hasEditor = false;
+        bool acceptsMidi = false;
+        int numInputChannels = 0;
+        int numOutputChannels = 0;
+    };
+
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t probes = 0; // plugin instantiated just to describe it
+        int numEntries = 0;
+    };
+
+    static PluginDatabase& getInstance() {
+        static PluginDatabase instance;
+        return instance;
+    }
+
+    // Loads what was saved there before; later entries are saved back to it.
+    // Without a file the database only lasts for this run.
+    void setFile(const juce::File& databaseFile);
+
+    // The cached entry, probing the plugin on a miss. nullopt if it isn't a loadable plugin.
+    std::optional<Entry> find(const std::string& pluginPath);
+
+    // The description alone: cached, or found by asking the formats, which
+    // doesn't instantiate the plugin the way find() does on a miss
+    std::optional<juce::PluginDescription> findDescription(const std::string& pluginPath);
+
+    // Instantiates through the database's own format manager
+    std::unique_ptr<juce::AudioPluginInstance> createInstance(const juce::PluginDescription& description,
+                                                              double sampleRate, int blockSize,
+                                                              juce::String& errorMessage);
+
+    // Records a plugin that was loaded anyway, so it never needs a probe
+    void remember(const std::string& pluginPath, juce::AudioPluginInstance& plugin);
+
+    // The one rule MULO uses to route a plugin to a MIDI track
+    static bool isSynthesizer(juce::AudioPluginInstance& plugin);
+
+    Stats getStats() const;
+
+private:
+    PluginDatabase();
+    PluginDatabase(const PluginDatabase&) = delete;
+    PluginDatabase& operator=(const PluginDatabase&) = delete;
+
+    // What has to match for an entry to still describe the file
+    struct FileStamp {
+        std::int64_t modified = 0;
+        std::int64_t size = 0;
+        bool operator==(const FileStamp& other) const { return modified == other.modified && size == other.size; }
+    };
+    struct StoredEntry {
+        FileStamp stamp;
+        Entry entry;
+    };
+
+    static FileStamp getFileStamp(const juce::File& file);
+    static Entry describe(const juce::PluginDescription& description, juce::AudioPluginInstance& plugin);
+    // Asks every format; nullopt if none of them recognises the file
+    std::optional<juce::PluginDescription> scanFile(const juce::File& file);
+
+    const StoredEntry* findFresh(const std::string& key, const FileStamp& stamp) const;
+    void store(const std::string& key, const FileStamp& stamp, const Entry& entry);
+    void load();
+    void save() const;
+
+    mutable juce::CriticalSection lock;
+    juce::AudioPluginFormatManager formatManager;
+    juce::File file;
+    std::unordered_map<std::string, StoredEntry> entries;
+    std::uint64_t hits = 0;
+    std::uint64_t probes = 0;
+};
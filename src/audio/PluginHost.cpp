@@ -0,0 +1,342 @@
+#include "PluginHost.hpp"
+#include "PluginHostProtocol.hpp"
+#include "VSTEditorWindow.hpp"
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#if JUCE_LINUX
+#include <unistd.h>
+#endif
+
+using PluginHostProtocol::Command;
+
+namespace {
+    // Gives the plugin the play head MULO sent with the block
+    class BlockPlayHead : public juce::AudioPlayHead {
+    public:
+        explicit BlockPlayHead(const PluginHostProtocol::AudioBlock& audioBlock) : block(audioBlock) {}
+
+        juce::Optional<PositionInfo> getPosition() const override {
+            if (!block.hasPosition) {
+                return {};
+            }
+
+            PositionInfo position;
+            position.setIsPlaying(block.isPlaying != 0);
+            position.setBpm(block.bpm);
+            position.setTimeInSeconds(block.timeInSeconds);
+            position.setTimeInSamples(block.timeInSamples);
+            position.setPpqPosition(block.ppqPosition);
+            position.setTimeSignature(TimeSignature { block.timeSigNumerator, block.timeSigDenominator });
+            return position;
+        }
+
+    private:
+        const PluginHostProtocol::AudioBlock& block;
+    };
+
+    class Host : private juce::Thread {
+    public:
+        explicit Host(PluginHostProtocol::Shared& sharedMemory)
+            : juce::Thread("MULO Plugin Host Audio"), shared(sharedMemory), playHead(sharedMemory.audio) {
+            midi.ensureSize(PluginHostProtocol::midiCapacity);
+        }
+
+        ~Host() override {
+            stopAudio();
+        }
+
+        // Message thread
+        bool handle(Command command) {
+            auto& control = shared.control;
+            switch (command) {
+                case Command::Load:
+                    return load();
+
+                case Command::Prepare: {
+                    if (!plugin) return false;
+                    const juce::ScopedLock lock(processLock);
+                    plugin->prepareToPlay(control.sampleRate, control.blockSize);
+                    return true;
+                }
+
+                case Command::Release: {
+                    if (!plugin) return false;
+                    const juce::ScopedLock lock(processLock);
+                    plugin->releaseResources();
+                    return true;
+                }
+
+                case Command::Reset: {
+                    if (!plugin) return false;
+                    const juce::ScopedLock lock(processLock);
+                    plugin->reset();
+                    return true;
+                }
+
+                case Command::SetNonRealtime: {
+                    if (!plugin) return false;
+                    const juce::ScopedLock lock(processLock);
+                    plugin->setNonRealtime(control.flag != 0);
+                    return true;
+                }
+
+                case Command::ShowEditor:
+                    return showEditor();
+
+                case Command::Quit:
+                    stopAudio();
+                    editorWindow.reset();
+                    plugin.reset();
+                    return true;
+
+                case Command::None:
+                    break;
+            }
+            return false;
+        }
+
+    private:
+        bool load() {
+            auto& control = shared.control;
+            const auto size = static_cast<size_t>(juce::jlimit(0, PluginHostProtocol::controlCapacity, control.dataSize));
+            const auto xml = juce::parseXML(juce::String::fromUTF8(control.data, static_cast<int>(size)));
+
+            juce::PluginDescription description;
+            juce::String errorMessage;
+            if (!xml || !description.loadFromXml(*xml)) {
+                errorMessage = "invalid plugin description";
+            } else {
+                juce::AudioPluginFormatManager formatManager;
+                formatManager.addDefaultFormats();
+                plugin = formatManager.createPluginInstance(description, control.sampleRate, control.blockSize, errorMessage);
+            }
+
+            juce::MemoryOutputStream stream;
+            if (!plugin) {
+                stream.writeString(errorMessage);
+                writeControlData(stream);
+                return false;
+            }
+
+            // Settled here once, the same way Effect settles an in-process plugin
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add(juce::AudioChannelSet::stereo());
+            layout.outputBuses.add(juce::AudioChannelSet::stereo());
+            if (!plugin->setBusesLayout(layout)) {
+                layout.inputBuses.clear();
+                layout.outputBuses.clear();
+                layout.inputBuses.add(juce::AudioChannelSet::mono());
+                layout.outputBuses.add(juce::AudioChannelSet::mono());
+                plugin->setBusesLayout(layout);
+            }
+            plugin->setProcessingPrecision(juce::AudioProcessor::singlePrecision);
+            plugin->setPlayHead(&playHead);
+
+            const auto& parameters = plugin->getParameters();
+            stream.writeString(plugin->getName());
+            stream.writeBool(plugin->hasEditor());
+            stream.writeBool(plugin->acceptsMidi());
+            stream.writeBool(plugin->producesMidi());
+            stream.writeDouble(plugin->getTailLengthSeconds());
+            stream.writeInt(plugin->getTotalNumInputChannels());
+            stream.writeInt(plugin->getTotalNumOutputChannels());
+            stream.writeInt(parameters.size());
+            reported.clear();
+            for (auto* parameter : parameters) {
+                stream.writeString(parameter->getName(256));
+                stream.writeFloat(parameter->getDefaultValue());
+                stream.writeFloat(parameter->getValue());
+                reported.push_back(parameter->getValue());
+            }
+            if (!writeControlData(stream)) {
+                plugin.reset();
+                return false;
+            }
+
+            startThread(juce::Thread::Priority::highest);
+            return true;
+        }
+
+        bool writeControlData(const juce::MemoryOutputStream& stream) {
+            auto& control = shared.control;
+            if (stream.getDataSize() > static_cast<size_t>(PluginHostProtocol::controlCapacity)) {
+                control.dataSize = 0;
+                return false;
+            }
+            std::memcpy(control.data, stream.getData(), stream.getDataSize());
+            control.dataSize = static_cast<std::int32_t>(stream.getDataSize());
+            return true;
+        }
+
+        bool showEditor() {
+            if (!plugin || !plugin->hasEditor()) {
+                return false;
+            }
+            if (!editorWindow) {
+                editorWindow = std::make_unique<VSTEditorWindow>(plugin->getName(), plugin.get(), [this] {
+                    juce::MessageManager::callAsync([this] { editorWindow.reset(); });
+                });
+            }
+            editorWindow->setVisible(true);
+            editorWindow->toFront(true);
+            return true;
+        }
+
+        void stopAudio() {
+            signalThreadShouldExit();
+            stopThread(2000);
+        }
+
+        // The audio thread
+        void run() override {
+            auto& block = shared.audio;
+            std::uint32_t lastRequest = block.mailbox.request.load(std::memory_order_acquire);
+            while (!threadShouldExit()) {
+                const auto request = PluginHostProtocol::waitForRequest(block.mailbox, lastRequest, 100.0);
+                if (request == lastRequest) {
+                    continue;
+                }
+                lastRequest = request;
+                process(block);
+                PluginHostProtocol::respond(block.mailbox, request);
+            }
+        }
+
+        void process(PluginHostProtocol::AudioBlock& block) {
+            const int numSamples = juce::jlimit(0, PluginHostProtocol::maxBlockSize, block.numSamples);
+            const int numChannels = juce::jlimit(0, PluginHostProtocol::maxChannels, block.numChannels);
+            const int pluginChannels = juce::jmin(PluginHostProtocol::maxChannels,
+                                                  juce::jmax(numChannels, plugin->getTotalNumInputChannels(),
+                                                             plugin->getTotalNumOutputChannels()));
+            float* channels[PluginHostProtocol::maxChannels];
+            for (int ch = 0; ch < pluginChannels; ++ch) {
+                channels[ch] = block.audio[ch];
+                if (ch >= numChannels) {
+                    std::fill(block.audio[ch], block.audio[ch] + numSamples, 0.0f);
+                }
+            }
+            juce::AudioBuffer<float> buffer(channels, pluginChannels, numSamples);
+
+            PluginHostProtocol::readMidi(block, midi);
+
+            const auto& parameters = plugin->getParameters();
+            const int numChanges = juce::jlimit(0, PluginHostProtocol::maxParameterChanges, block.numParameterChanges);
+            for (int i = 0; i < numChanges; ++i) {
+                const auto& change = block.parameterChanges[i];
+                if (change.index >= 0 && change.index < parameters.size()) {
+                    parameters[change.index]->setValue(change.value);
+                    reported[static_cast<size_t>(change.index)] = change.value;
+                }
+            }
+
+            const juce::ScopedTryLock lock(processLock);
+            if (lock.isLocked()) {
+                plugin->processBlock(buffer, midi);
+            } else {
+                // A control command has the plugin; MULO hears silence for this block
+                buffer.clear();
+                midi.clear();
+            }
+
+            PluginHostProtocol::writeMidi(midi, block);
+
+            // Report what the plugin changed by itself since the last block
+            int numReported = 0;
+            for (int i = 0; i < parameters.size() && numReported < PluginHostProtocol::maxParameterChanges; ++i) {
+                const float value = parameters[i]->getValue();
+                if (value != reported[static_cast<size_t>(i)]) {
+                    reported[static_cast<size_t>(i)] = value;
+                    block.parameterChanges[numReported++] = { i, value };
+                }
+            }
+            block.numParameterChanges = numReported;
+        }
+
+        PluginHostProtocol::Shared& shared;
+        BlockPlayHead playHead;
+        std::unique_ptr<juce::AudioPluginInstance> plugin;
+        std::unique_ptr<VSTEditorWindow> editorWindow;
+        juce::CriticalSection processLock;
+        juce::MidiBuffer midi;
+        std::vector<float> reported; // last value each parameter had on either side
+    };
+
+    // Waits for control commands and runs them on the message thread
+    class ControlThread : public juce::Thread {
+    public:
+        ControlThread(PluginHostProtocol::Shared& sharedMemory, Host& pluginHost)
+            : juce::Thread("MULO Plugin Host Control"), shared(sharedMemory), host(pluginHost) {}
+
+        void run() override {
+#if JUCE_LINUX
+            const auto parent = getppid();
+#endif
+            auto& mailbox = shared.control.mailbox;
+            std::uint32_t lastRequest = mailbox.request.load(std::memory_order_acquire);
+            while (!threadShouldExit()) {
+                const auto request = PluginHostProtocol::waitForRequest(mailbox, lastRequest, 100.0);
+                if (request == lastRequest) {
+#if JUCE_LINUX
+                    // MULO is gone, whether it quit or crashed
+                    if (getppid() != parent) {
+                        juce::MessageManager::getInstance()->stopDispatchLoop();
+                        return;
+                    }
+#endif
+                    continue;
+                }
+                lastRequest = request;
+
+                const auto command = shared.control.command;
+                juce::WaitableEvent done;
+                bool succeeded = false;
+                juce::MessageManager::callAsync([&] {
+                    succeeded = host.handle(command);
+                    done.signal();
+                });
+                done.wait();
+
+                shared.control.succeeded = succeeded ? 1 : 0;
+                PluginHostProtocol::respond(mailbox, request);
+
+                if (command == Command::Quit) {
+                    juce::MessageManager::getInstance()->stopDispatchLoop();
+                    return;
+                }
+            }
+        }
+
+    private:
+        PluginHostProtocol::Shared& shared;
+        Host& host;
+    };
+}
+
+int PluginHost::run(const juce::String& sharedMemoryName) {
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    PluginHostProtocol::SharedMemory memory;
+    if (!memory.open(sharedMemoryName)) {
+        std::cerr << "Plugin host: could not open shared memory " << sharedMemoryName << std::endl;
+        return 1;
+    }
+
+    {
+        Host host(*memory.get());
+        ControlThread control(*memory.get(), host);
+        control.startThread();
+
+        juce::MessageManager::getInstance()->runDispatchLoop();
+
+        control.stopThread(2000);
+        host.handle(Command::Quit);
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+// PluginHost - the other end of RemotePluginInstance. `MULO --plugin-host
+// <name>` runs this instead of the application: it opens the shared memory
+// MULO created, loads the plugin it is asked for and processes blocks for it
+// until told to quit or MULO itself goes away.
+namespace PluginHost {
+    // Returns the process exit code
+    int run(const juce::String& sharedMemoryName);
+}
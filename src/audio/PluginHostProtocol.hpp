@@ -0,0 +1,276 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if JUCE_LINUX
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#endif
+
+// PluginHostProtocol - the memory MULO shares with a plugin host process
+// (`MULO --plugin-host <name>`), one mapping per hosted plugin. Audio blocks
+// and control commands each go through their own mailbox: the sender fills
+// in the payload, bumps `request` and wakes the other side with a futex; the
+// receiver answers by setting `response` to the same number. Only one request
+// per mailbox is ever in flight, so the payload needs no locking of its own.
+// Linux only; elsewhere plugins always run in process.
+namespace PluginHostProtocol {
+    constexpr std::uint32_t magic = 0x4f4c554d; // "MULO"
+    constexpr std::uint32_t version = 1;
+
+    constexpr int maxChannels = 8;
+    constexpr int maxBlockSize = 8192;
+    constexpr int midiCapacity = 64 * 1024;
+    constexpr int maxParameterChanges = 1024;
+    constexpr int controlCapacity = 4 * 1024 * 1024;
+
+    enum class Command : std::uint32_t {
+        None,
+        Load,           // data: PluginDescription XML in, plugin info out
+        Prepare,        // sampleRate, blockSize
+        Release,
+        Reset,
+        SetNonRealtime, // flag
+        ShowEditor,
+        Quit
+    };
+
+    using Word = std::atomic<std::uint32_t>;
+    static_assert(Word::is_always_lock_free && sizeof(Word) == sizeof(std::uint32_t),
+                  "futexes need a plain 32-bit word");
+
+    struct Mailbox {
+        Word request { 0 };
+        Word response { 0 };
+    };
+
+    struct ParameterChange {
+        std::int32_t index;
+        float value;
+    };
+
+    struct AudioBlock {
+        Mailbox mailbox;
+        std::int32_t numChannels;
+        std::int32_t numSamples;
+
+        // The DAW's play head for this block
+        std::int32_t hasPosition;
+        std::int32_t isPlaying;
+        double bpm;
+        double timeInSeconds;
+        std::int64_t timeInSamples;
+        double ppqPosition;
+        std::int32_t timeSigNumerator;
+        std::int32_t timeSigDenominator;
+
+        // Edits to apply before the block; in the answer, the plugin's own edits
+        std::int32_t numParameterChanges;
+        ParameterChange parameterChanges[maxParameterChanges];
+
+        // MIDI in, then MIDI out, as [int32 sample][int32 size][bytes] records
+        std::int32_t midiBytes;
+        std::uint8_t midi[midiCapacity];
+
+        float audio[maxChannels][maxBlockSize];
+    };
+
+    struct Control {
+        Mailbox mailbox;
+        Command command;
+        std::int32_t succeeded;
+        double sampleRate;
+        std::int32_t blockSize;
+        std::int32_t flag;
+        std::int32_t dataSize;
+        char data[controlCapacity];
+    };
+
+    struct Shared {
+        std::uint32_t magic;
+        std::uint32_t version;
+        Control control;
+        AudioBlock audio;
+    };
+
+    // Sleeps while word still holds expected, for at most timeoutMs
+    inline void waitWhileEqual(Word& word, std::uint32_t expected, double timeoutMs) {
+#if JUCE_LINUX
+        timespec timeout;
+        timeout.tv_sec = static_cast<time_t>(timeoutMs / 1000.0);
+        timeout.tv_nsec = static_cast<long>(std::fmod(timeoutMs, 1000.0) * 1.0e6);
+        // Not FUTEX_PRIVATE_FLAG: the word lives in memory shared between processes
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+#else
+        juce::ignoreUnused(word, expected);
+        juce::Thread::sleep(juce::jmax(1, static_cast<int>(timeoutMs)));
+#endif
+    }
+
+    inline void wakeAll(Word& word) {
+#if JUCE_LINUX
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+        juce::ignoreUnused(word);
+#endif
+    }
+
+    // Sender side: posts the next request and wakes the receiver
+    inline std::uint32_t post(Mailbox& mailbox) {
+        const auto request = mailbox.request.load(std::memory_order_relaxed) + 1;
+        mailbox.request.store(request, std::memory_order_release);
+        wakeAll(mailbox.request);
+        return request;
+    }
+
+    // Sender side: false if request is still unanswered after timeoutMs
+    inline bool waitForResponse(Mailbox& mailbox, std::uint32_t request, double timeoutMs) {
+        const double deadline = juce::Time::getMillisecondCounterHiRes() + timeoutMs;
+        for (;;) {
+            const auto response = mailbox.response.load(std::memory_order_acquire);
+            if (response == request) {
+                return true;
+            }
+            const double remaining = deadline - juce::Time::getMillisecondCounterHiRes();
+            if (remaining <= 0.0) {
+                return false;
+            }
+            waitWhileEqual(mailbox.response, response, juce::jmin(remaining, 50.0));
+        }
+    }
+
+    // Receiver side: the newest request, or lastRequest if none came within timeoutMs
+    inline std::uint32_t waitForRequest(Mailbox& mailbox, std::uint32_t lastRequest, double timeoutMs) {
+        auto request = mailbox.request.load(std::memory_order_acquire);
+        if (request == lastRequest) {
+            waitWhileEqual(mailbox.request, lastRequest, timeoutMs);
+            request = mailbox.request.load(std::memory_order_acquire);
+        }
+        return request;
+    }
+
+    // Receiver side
+    inline void respond(Mailbox& mailbox, std::uint32_t request) {
+        mailbox.response.store(request, std::memory_order_release);
+        wakeAll(mailbox.response);
+    }
+
+    // Never allocates as long as the MidiBuffer has room
+    inline void writeMidi(const juce::MidiBuffer& midiBuffer, AudioBlock& block) {
+        std::int32_t offset = 0;
+        for (const auto metadata : midiBuffer) {
+            const std::int32_t header[2] = { metadata.samplePosition, metadata.numBytes };
+            if (offset + static_cast<std::int32_t>(sizeof(header)) + metadata.numBytes > midiCapacity) {
+                break;
+            }
+            std::memcpy(block.midi + offset, header, sizeof(header));
+            std::memcpy(block.midi + offset + sizeof(header), metadata.data, static_cast<size_t>(metadata.numBytes));
+            offset += static_cast<std::int32_t>(sizeof(header)) + metadata.numBytes;
+        }
+        block.midiBytes = offset;
+    }
+
+    inline void readMidi(const AudioBlock& block, juce::MidiBuffer& midiBuffer) {
+        midiBuffer.clear();
+        const std::int32_t end = juce::jlimit(0, midiCapacity, block.midiBytes);
+        std::int32_t offset = 0;
+        while (offset + 8 <= end) {
+            std::int32_t header[2];
+            std::memcpy(header, block.midi + offset, sizeof(header));
+            offset += static_cast<std::int32_t>(sizeof(header));
+            if (header[1] <= 0 || offset + header[1] > end) {
+                break;
+            }
+            midiBuffer.addEvent(block.midi + offset, header[1], header[0]);
+            offset += header[1];
+        }
+    }
+
+    // The mapping itself: created by MULO, opened by the host
+    class SharedMemory {
+    public:
+        SharedMemory() = default;
+        ~SharedMemory() { close(); }
+
+        SharedMemory(const SharedMemory&) = delete;
+        SharedMemory& operator=(const SharedMemory&) = delete;
+
+        bool create(const juce::String& name) {
+#if JUCE_LINUX
+            path = "/dev/shm/" + name;
+            fd = ::open(path.toRawUTF8(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd < 0 || ftruncate(fd, sizeof(Shared)) != 0 || !map()) {
+                close();
+                return false;
+            }
+            owner = true;
+
+            // Fresh pages read as zero, which is every field's starting value
+            shared->magic = magic;
+            shared->version = version;
+            return true;
+#else
+            juce::ignoreUnused(name);
+            return false;
+#endif
+        }
+
+        bool open(const juce::String& name) {
+#if JUCE_LINUX
+            path = "/dev/shm/" + name;
+            fd = ::open(path.toRawUTF8(), O_RDWR);
+            if (fd < 0 || !map() || shared->magic != magic || shared->version != version) {
+                close();
+                return false;
+            }
+            return true;
+#else
+            juce::ignoreUnused(name);
+            return false;
+#endif
+        }
+
+        void close() {
+#if JUCE_LINUX
+            if (shared) munmap(shared, sizeof(Shared));
+            if (fd >= 0) ::close(fd);
+            if (owner) ::unlink(path.toRawUTF8());
+#endif
+            shared = nullptr;
+            fd = -1;
+            owner = false;
+        }
+
+        Shared* get() const { return shared; }
+
+    private:
+        bool map() {
+#if JUCE_LINUX
+            void* address = mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (address == MAP_FAILED) {
+                return false;
+            }
+            shared = static_cast<Shared*>(address);
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        juce::String path;
+        int fd = -1;
+        bool owner = false;
+        Shared* shared = nullptr;
+    };
+}
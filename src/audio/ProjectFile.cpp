@@ -0,0 +1,624 @@
+#include "ProjectFile.hpp"
+#include "../DebugConfig.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+using json = nlohmann::json;
+
+namespace {
+    constexpr char magic[4] = { 'M', 'U', 'L', 'O' };
+    constexpr int numSections = 6;
+    // Indexed by ProjectFile::Section
+    constexpr char chunkIds[numSections][4] = {
+        { 'S', 'O', 'N', 'G' }, { 'T', 'R', 'A', 'K' }, { 'C', 'L', 'I', 'P' },
+        { 'M', 'I', 'D', 'I' }, { 'A', 'U', 'T', 'O' }, { 'P', 'L', 'U', 'G' }
+    };
+    // magic, version, chunk count, reserved
+    constexpr std::uint64_t headerSize = 16;
+    // id, reserved, offset, size
+    constexpr std::uint64_t chunkEntrySize = 24;
+    // Chunks start on this boundary, so mapped data is aligned for whoever reads it
+    constexpr std::uint64_t chunkAlignment = 16;
+
+    constexpr ProjectFile::Section trackSections[] = {
+        ProjectFile::Section::Tracks, ProjectFile::Section::Clips,
+        ProjectFile::Section::Automation, ProjectFile::Section::Plugins
+    };
+
+    // Which section a key of a track object is kept in
+    ProjectFile::Section getSectionForTrackKey(const std::string& key) {
+        if (key == "clips" || key == "referenceClip") return ProjectFile::Section::Clips;
+        if (key == "automation" || key == "automatedParameters") return ProjectFile::Section::Automation;
+        if (key == "effects" || key == "synthesizers") return ProjectFile::Section::Plugins;
+        return ProjectFile::Section::Tracks;
+    }
+
+    int getIndex(ProjectFile::Section section) {
+        return static_cast<int>(section);
+    }
+
+    template <typename T>
+    void appendLittleEndian(std::vector<std::uint8_t>& bytes, T value) {
+        std::uint8_t raw[sizeof(T)];
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            raw[i] = static_cast<std::uint8_t>((static_cast<std::uint64_t>(value) >> (8 * i)) & 0xff);
+        }
+        bytes.insert(bytes.end(), raw, raw + sizeof(T));
+    }
+
+    void writePadding(juce::MemoryOutputStream& out) {
+        while (out.getPosition() % static_cast<juce::int64>(chunkAlignment) != 0) {
+            out.writeByte(0);
+        }
+    }
+
+    // Moves every clip's packed MIDI into the MIDI chunk, leaving where it went
+    void moveMidiOut(json& clips, std::vector<std::uint8_t>& midiChunk) {
+        if (!clips.is_array()) {
+            return;
+        }
+        for (auto& clip : clips) {
+            if (!clip.is_object() || !clip.contains("midiData") || !clip["midiData"].is_binary()) {
+                continue;
+            }
+            const auto& events = clip["midiData"].get_binary();
+            clip["midiRange"] = { midiChunk.size(), events.size() };
+            midiChunk.insert(midiChunk.end(), events.begin(), events.end());
+            clip.erase("midiData");
+        }
+    }
+
+    // The MIDI events, parameter values and automation of a loaded document,
+    // read the way Engine::load reads them, so both formats are timed to the
+    // same point. project is the file a version 2 document was read from.
+    std::uint64_t consumeState(const json& state, ProjectFile* project = nullptr) {
+        std::uint64_t total = 0;
+        const auto& composition = state.at("engineState").at("composition");
+        for (const auto& track : composition.at("tracks")) {
+            for (const auto& clip : track.value("clips", json::array())) {
+                if (project && project->forEachClipMidiEvent(clip, [&total](int tick, const std::uint8_t*, int size) {
+                        total += static_cast<std::uint64_t>(tick + size);
+                    })) {
+                    continue;
+                }
+                const auto& midiData = clip.at("midiData");
+                if (midiData.is_binary()) {
+                    ProjectFile::forEachMidiEvent(midiData.get_binary(), [&total](int tick, const std::uint8_t*, int size) {
+                        total += static_cast<std::uint64_t>(tick + size);
+                    });
+                } else {
+                    for (const auto& event : midiData) {
+                        const auto rawData = event.at("rawData").get<std::vector<std::uint8_t>>();
+                        total += static_cast<std::uint64_t>(event.at("tick").get<int>()) + rawData.size();
+                    }
+                }
+            }
+            for (const auto& effect : track.value("effects", json::array())) {
+                if (effect.contains("parameterValues")) {
+                    total += ProjectFile::unpackParameters(effect["parameterValues"].get_binary()).size();
+                } else {
+                    for (const auto& parameter : effect.at("parameters")) {
+                        total += parameter.at("index").get<int>() + (parameter.at("value").get<float>() > 0.5f ? 1 : 0);
+                    }
+                }
+            }
+            const auto& automation = project ? project->getTrackValue(track, "automation") : track.at("automation");
+            for (const auto& [effectName, parameters] : automation.items()) {
+                for (const auto& [parameterName, points] : parameters.items()) {
+                    for (const auto& point : points) {
+                        total += point.at("value").get<float>() > 0.5f ? 1 : 0;
+                    }
+                }
+            }
+        }
+        return total;
+    }
+
+    // A project shaped like the ones Engine::getStateString writes: MIDI
+    // tracks with clips of note pairs, a chain of effects and some automation
+    json makeBenchmarkState(bool compact, int numTracks, int numMidiEventsPerTrack, int numParametersPerTrack) {
+        constexpr int numClipsPerTrack = 8;
+        constexpr int numEffectsPerTrack = 4;
+        constexpr int numAutomationPoints = 256;
+
+        json state;
+        auto& engineState = state["engineState"];
+        engineState["version"] = "1.0";
+        engineState["audioSettings"] = { { "sampleRate", 48000.0 }, { "currentBufferSize", 256 } };
+        auto& composition = engineState["composition"];
+        composition["name"] = "benchmark";
+        composition["bpm"] = 120.0;
+        composition["timeSignature"] = { { "numerator", 4 }, { "denominator", 4 } };
+        composition["masterTrack"] = { { "name", "Master" }, { "volume", 0.0 }, { "pan", 0.0 }, { "muted", false },
+                                       { "soloed", false }, { "effects", json::array() }, { "automation", json::object() },
+                                       { "automatedParameters", json::array() } };
+
+        juce::Random random(42);
+        auto& tracks = composition["tracks"];
+        for (int t = 0; t < numTracks; ++t) {
+            json track;
+            track["name"] = "Track " + std::to_string(t + 1);
+            track["type"] = "midi";
+            track["volume"] = 0.0;
+            track["pan"] = 0.0;
+            track["muted"] = false;
+            track["soloed"] = false;
+            track["referenceClip"] = nullptr;
+
+            auto& clips = track["clips"];
+            const int eventsPerClip = numMidiEventsPerTrack / numClipsPerTrack;
+            for (int c = 0; c < numClipsPerTrack; ++c) {
+                json clip;
+                clip["file"] = "";
+                clip["startTime"] = c * 8.0;
+                clip["offset"] = 0.0;
+                clip["duration"] = 8.0;
+                clip["velocity"] = 1.0;
+                clip["channel"] = 1;
+                clip["transpose"] = 0;
+                clip["ticksPerQuarterNote"] = 960;
+
+                juce::MidiBuffer midi;
+                for (int e = 0; e + 1 < eventsPerClip; e += 2) {
+                    const int note = 36 + random.nextInt(48);
+                    const int tick = e * 60;
+                    midi.addEvent(juce::MidiMessage::noteOn(1, note, static_cast<juce::uint8>(1 + random.nextInt(126))), tick);
+                    midi.addEvent(juce::MidiMessage::noteOff(1, note), tick + 60);
+                }
+                if (compact) {
+                    clip["midiData"] = json::binary(ProjectFile::packMidi(midi));
+                } else {
+                    auto& events = clip["midiData"];
+                    events = json::array();
+                    for (const auto metadata : midi) {
+                        events.push_back({ { "tick", metadata.samplePosition },
+                                           { "rawData", std::vector<std::uint8_t>(metadata.data, metadata.data + metadata.numBytes) } });
+                    }
+                }
+                clips.push_back(clip);
+            }
+
+            auto& effects = track["effects"];
+            effects = json::array();
+            for (int f = 0; f < numEffectsPerTrack; ++f) {
+                json effect;
+                effect["name"] = "Effect " + std::to_string(f + 1);
+                effect["vstName"] = "effect.vst3";
+                effect["vstPath"] = "/plugins/effect.vst3";
+                effect["enabled"] = true;
+                effect["index"] = f;
+                effect["isSynthesizer"] = false;
+                std::vector<float> values(static_cast<size_t>(numParametersPerTrack / numEffectsPerTrack));
+                for (auto& value : values) {
+                    value = random.nextFloat();
+                }
+                if (compact) {
+                    effect["parameterValues"] = json::binary(ProjectFile::packParameters(values));
+                } else {
+                    auto& parameters = effect["parameters"];
+                    for (size_t p = 0; p < values.size(); ++p) {
+                        parameters.push_back({ { "index", p }, { "value", values[p] } });
+                    }
+                }
+                effects.push_back(effect);
+            }
+            track["synthesizers"] = json::array();
+
+            auto& points = track["automation"]["Effect 1"]["Gain"];
+            for (int p = 0; p < numAutomationPoints; ++p) {
+                points.push_back({ { "time", p * 0.25 }, { "value", random.nextFloat() }, { "curve", 0.0f } });
+            }
+            track["automatedParameters"] = json::array({ { { "effectName", "Effect 1" }, { "parameterName", "Gain" } } });
+
+            tracks.push_back(track);
+        }
+        return state;
+    }
+}
+
+bool ProjectFile::isBinaryProject(const juce::File& file) {
+    juce::FileInputStream in(file);
+    char header[sizeof(magic)] = {};
+    return in.openedOk() && in.read(header, sizeof(header)) == sizeof(header)
+        && std::memcmp(header, magic, sizeof(magic)) == 0;
+}
+
+std::vector<std::uint8_t> ProjectFile::packMidi(const juce::MidiBuffer& midi) {
+    std::vector<std::uint8_t> packed;
+    packed.reserve(static_cast<size_t>(midi.data.size()) * 2);
+    for (const auto metadata : midi) {
+        if (metadata.numBytes > std::numeric_limits<std::uint16_t>::max()) {
+            jassertfalse;
+            std::cerr << "MIDI event of " << metadata.numBytes << " bytes is too large to save; leaving it out" << std::endl;
+            continue;
+        }
+        appendLittleEndian<std::uint32_t>(packed, static_cast<std::uint32_t>(metadata.samplePosition));
+        appendLittleEndian<std::uint16_t>(packed, static_cast<std::uint16_t>(metadata.numBytes));
+        packed.insert(packed.end(), metadata.data, metadata.data + metadata.numBytes);
+    }
+    return packed;
+}
+
+void ProjectFile::forEachMidiEvent(const std::vector<std::uint8_t>& packed,
+                                   const std::function<void(int tick, const std::uint8_t* data, int size)>& callback) {
+    forEachMidiEvent(packed.data(), packed.size(), callback);
+}
+
+void ProjectFile::forEachMidiEvent(const std::uint8_t* data, size_t packedSize,
+                                   const std::function<void(int tick, const std::uint8_t* data, int size)>& callback) {
+    size_t position = 0;
+    while (position + 6 <= packedSize) {
+        const int tick = static_cast<int>(juce::ByteOrder::littleEndianInt(data + position));
+        const int size = juce::ByteOrder::littleEndianShort(data + position + 4);
+        position += 6;
+        if (position + static_cast<size_t>(size) > packedSize) {
+            break;
+        }
+        if (size > 0) {
+            callback(tick, data + position, size);
+        }
+        position += static_cast<size_t>(size);
+    }
+}
+
+std::vector<std::uint8_t> ProjectFile::packParameters(const std::vector<float>& values) {
+    std::vector<std::uint8_t> packed;
+    packed.reserve(values.size() * sizeof(float));
+    for (const float value : values) {
+        std::uint32_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        appendLittleEndian<std::uint32_t>(packed, bits);
+    }
+    return packed;
+}
+
+std::vector<float> ProjectFile::unpackParameters(const std::vector<std::uint8_t>& packed) {
+    std::vector<float> values(packed.size() / sizeof(float));
+    for (size_t i = 0; i < values.size(); ++i) {
+        const std::uint32_t bits = juce::ByteOrder::littleEndianInt(packed.data() + i * sizeof(float));
+        std::memcpy(&values[i], &bits, sizeof(bits));
+    }
+    return values;
+}
+
+bool ProjectFile::write(json state, const juce::File& file) {
+    if (!state.contains("engineState") || !state["engineState"].is_object()) {
+        DEBUG_PRINT("[ProjectFile] Nothing to write to " << file.getFullPathName());
+        return false;
+    }
+
+    // Split the tracks from the song, then each track's keys by section
+    auto& song = state["engineState"];
+    json masterTrack = json::object();
+    json tracks = json::array();
+    if (song.contains("composition") && song["composition"].is_object()) {
+        auto& composition = song["composition"];
+        if (composition.contains("masterTrack")) {
+            masterTrack = std::move(composition["masterTrack"]);
+            composition.erase("masterTrack");
+        }
+        if (composition.contains("tracks")) {
+            tracks = std::move(composition["tracks"]);
+            composition.erase("tracks");
+        }
+    }
+
+    std::array<json, numSections> documents;
+    for (const auto section : trackSections) {
+        documents[getIndex(section)] = { { "masterTrack", json::object() }, { "tracks", json::array() } };
+    }
+    std::vector<std::uint8_t> midiChunk;
+    auto splitTrack = [&documents, &midiChunk](json& track, auto&& targetFor) {
+        if (!track.is_object()) {
+            return;
+        }
+        for (auto& item : track.items()) {
+            const auto section = getSectionForTrackKey(item.key());
+            auto& target = targetFor(documents[getIndex(section)]);
+            target[item.key()] = std::move(item.value());
+            if (section == Section::Clips && item.key() == "clips") {
+                moveMidiOut(target["clips"], midiChunk);
+            }
+        }
+    };
+
+    splitTrack(masterTrack, [](json& document) -> json& { return document["masterTrack"]; });
+    for (auto& track : tracks) {
+        for (const auto section : trackSections) {
+            documents[getIndex(section)]["tracks"].push_back(json::object());
+        }
+        splitTrack(track, [](json& document) -> json& { return document["tracks"].back(); });
+    }
+
+    std::array<std::vector<std::uint8_t>, numSections> payloads;
+    payloads[getIndex(Section::Song)] = json::to_msgpack(song);
+    for (const auto section : trackSections) {
+        payloads[getIndex(section)] = json::to_msgpack(documents[getIndex(section)]);
+    }
+    payloads[getIndex(Section::Midi)] = std::move(midiChunk);
+
+    juce::MemoryOutputStream out;
+    out.write(magic, sizeof(magic));
+    out.writeInt(formatVersion);
+    out.writeInt(numSections);
+    out.writeInt(0);
+
+    std::uint64_t offset = headerSize + chunkEntrySize * numSections;
+    for (int i = 0; i < numSections; ++i) {
+        offset = (offset + chunkAlignment - 1) / chunkAlignment * chunkAlignment;
+        out.write(chunkIds[i], 4);
+        out.writeInt(0);
+        out.writeInt64(static_cast<juce::int64>(offset));
+        out.writeInt64(static_cast<juce::int64>(payloads[i].size()));
+        offset += payloads[i].size();
+    }
+    for (const auto& payload : payloads) {
+        writePadding(out);
+        out.write(payload.data(), payload.size());
+    }
+
+    // Written beside the real file and moved over it, so a crash never leaves half a project
+    juce::TemporaryFile temp(file);
+    if (!temp.getFile().replaceWithData(out.getData(), out.getDataSize()) || !temp.overwriteTargetFileWithTemporary()) {
+        DEBUG_PRINT("[ProjectFile] Failed to write " << file.getFullPathName());
+        return false;
+    }
+    return true;
+}
+
+ProjectFile::ProjectFile(const juce::File& file)
+    : mappedFile(std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly)) {
+    const auto* data = static_cast<const char*>(mappedFile->getData());
+    const auto fileSize = static_cast<std::uint64_t>(mappedFile->getSize());
+    if (data == nullptr || fileSize < headerSize || std::memcmp(data, magic, sizeof(magic)) != 0) {
+        DEBUG_PRINT("[ProjectFile] " << file.getFullPathName() << " is not a version " << formatVersion << " project");
+        return;
+    }
+
+    juce::MemoryInputStream in(data, static_cast<size_t>(fileSize), false);
+    in.skipNextBytes(sizeof(magic));
+    version = in.readInt();
+    const int numChunks = in.readInt();
+    in.readInt();
+
+    if (version < 2 || version > formatVersion) {
+        DEBUG_PRINT("[ProjectFile] " << file.getFullPathName() << " is version " << version << ", newer than this build reads");
+        return;
+    }
+    if (numChunks < 0 || headerSize + chunkEntrySize * static_cast<std::uint64_t>(numChunks) > fileSize) {
+        DEBUG_PRINT("[ProjectFile] " << file.getFullPathName() << " has a damaged chunk table");
+        return;
+    }
+
+    for (int i = 0; i < numChunks; ++i) {
+        char id[4];
+        in.read(id, sizeof(id));
+        in.readInt();
+        const auto offset = static_cast<std::uint64_t>(in.readInt64());
+        const auto size = static_cast<std::uint64_t>(in.readInt64());
+        if (offset > fileSize || size > fileSize - offset) {
+            DEBUG_PRINT("[ProjectFile] " << file.getFullPathName() << " is truncated");
+            return;
+        }
+        // Chunks this build doesn't know are skipped, so newer files still open
+        for (int section = 0; section < numSections; ++section) {
+            if (std::memcmp(id, chunkIds[section], sizeof(id)) == 0) {
+                chunks[static_cast<size_t>(section)] = { offset, size, true };
+            }
+        }
+    }
+
+    valid = chunks[static_cast<size_t>(getIndex(Section::Song))].present
+         && chunks[static_cast<size_t>(getIndex(Section::Tracks))].present;
+}
+
+const json& ProjectFile::getSection(Section section) {
+    static const json empty;
+    const auto index = static_cast<size_t>(getIndex(section));
+    if (!valid || section == Section::Midi || !chunks[index].present) {
+        return empty;
+    }
+
+    auto& decoded = sections[index];
+    if (!decoded) {
+        const auto* data = static_cast<const std::uint8_t*>(mappedFile->getData()) + chunks[index].offset;
+        try {
+            decoded = json::from_msgpack(data, data + chunks[index].size);
+        } catch (const json::exception& e) {
+            DEBUG_PRINT("[ProjectFile] Failed to decode the " << std::string(chunkIds[index], 4) << " chunk: " << e.what());
+            decoded = json();
+        }
+    }
+    return *decoded;
+}
+
+bool ProjectFile::getMidiRange(const json& clip, std::uint64_t& offset, std::uint64_t& size) const {
+    const auto& chunk = chunks[static_cast<size_t>(getIndex(Section::Midi))];
+    if (!chunk.present || !clip.is_object() || !clip.contains("midiRange")) {
+        return false;
+    }
+    const auto& range = clip["midiRange"];
+    if (!range.is_array() || range.size() != 2 || !range[0].is_number_unsigned() || !range[1].is_number_unsigned()) {
+        return false;
+    }
+    offset = range[0].get<std::uint64_t>();
+    size = range[1].get<std::uint64_t>();
+    return offset <= chunk.size && size <= chunk.size - offset;
+}
+
+bool ProjectFile::forEachClipMidiEvent(const json& clip,
+                                       const std::function<void(int tick, const std::uint8_t* data, int size)>& callback) const {
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+    if (!valid || !getMidiRange(clip, offset, size)) {
+        return false;
+    }
+    const auto& chunk = chunks[static_cast<size_t>(getIndex(Section::Midi))];
+    forEachMidiEvent(static_cast<const std::uint8_t*>(mappedFile->getData()) + chunk.offset + offset,
+                     static_cast<size_t>(size), callback);
+    return true;
+}
+
+const json& ProjectFile::getTrackValue(const json& track, const std::string& key) {
+    static const json empty;
+    if (!track.is_object() || !track.contains(trackIndexKey) || !track[trackIndexKey].is_number_integer()) {
+        return empty;
+    }
+    const auto index = track[trackIndexKey].get<std::int64_t>();
+    const auto& document = getSection(getSectionForTrackKey(key));
+    if (!document.is_object()) {
+        return empty;
+    }
+
+    const json* entry = nullptr;
+    if (index < 0 && document.contains("masterTrack")) {
+        entry = &document["masterTrack"];
+    } else if (index >= 0 && document.contains("tracks") && document["tracks"].is_array()
+               && static_cast<size_t>(index) < document["tracks"].size()) {
+        entry = &document["tracks"][static_cast<size_t>(index)];
+    }
+    if (entry == nullptr || !entry->is_object() || !entry->contains(key)) {
+        return empty;
+    }
+    return (*entry)[key];
+}
+
+json ProjectFile::readState() {
+    if (!valid) {
+        return json::object();
+    }
+
+    getSection(Section::Song);
+    json state;
+    state["engineState"] = std::move(*sections[static_cast<size_t>(getIndex(Section::Song))]);
+    sections[static_cast<size_t>(getIndex(Section::Song))].reset();
+    if (!state["engineState"].is_object()) {
+        return json::object();
+    }
+
+    json masterTrack = json::object();
+    json tracks = json::array();
+    for (const auto section : trackSections) {
+        // Left in the file for getTrackValue
+        if (section == Section::Automation) {
+            continue;
+        }
+        getSection(section);
+        auto& cached = sections[static_cast<size_t>(getIndex(section))];
+        if (!cached || !cached->is_object()) {
+            continue;
+        }
+        json document = std::move(*cached);
+        cached.reset();
+
+        auto merge = [this, section](json& target, json& source) {
+            if (!source.is_object()) {
+                return;
+            }
+            for (auto& item : source.items()) {
+                target[item.key()] = std::move(item.value());
+            }
+            // Events stay in the file; a range that doesn't fit it is dropped here
+            if (section == Section::Clips && target.contains("clips") && target["clips"].is_array()) {
+                for (auto& clip : target["clips"]) {
+                    std::uint64_t offset = 0;
+                    std::uint64_t size = 0;
+                    if (clip.is_object() && clip.contains("midiRange") && !getMidiRange(clip, offset, size)) {
+                        DEBUG_PRINT("[ProjectFile] Skipped a clip's MIDI with a damaged range");
+                        clip.erase("midiRange");
+                    }
+                }
+            }
+        };
+
+        if (document.contains("masterTrack")) {
+            merge(masterTrack, document["masterTrack"]);
+        }
+        if (document.contains("tracks") && document["tracks"].is_array()) {
+            auto& sectionTracks = document["tracks"];
+            while (tracks.size() < sectionTracks.size()) {
+                tracks.push_back(json::object());
+            }
+            for (size_t i = 0; i < sectionTracks.size(); ++i) {
+                merge(tracks[i], sectionTracks[i]);
+            }
+        }
+    }
+
+    masterTrack[trackIndexKey] = -1;
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        tracks[i][trackIndexKey] = static_cast<int>(i);
+    }
+
+    auto& composition = state["engineState"]["composition"];
+    composition["masterTrack"] = std::move(masterTrack);
+    composition["tracks"] = std::move(tracks);
+    return state;
+}
+
+std::vector<ProjectFile::BenchmarkResult> ProjectFile::runBenchmark(int numTracks, int numMidiEventsPerTrack,
+                                                                    int numParametersPerTrack) {
+    constexpr int numRuns = 3;
+    const auto jsonFile = juce::File::createTempFile(".json");
+    const auto binaryFile = juce::File::createTempFile(".mpf");
+
+    auto best = [](double& slot, double startMs) {
+        slot = std::min(slot, juce::Time::getMillisecondCounterHiRes() - startMs);
+    };
+
+    BenchmarkResult jsonResult { "json", std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), 0 };
+    BenchmarkResult binaryResult { "v2", std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), 0 };
+    BenchmarkResult summaryResult { "v2 track list", 0.0, std::numeric_limits<double>::max(), 0 };
+    std::uint64_t jsonTotal = 0;
+    std::uint64_t binaryTotal = 0;
+
+    for (int run = 0; run < numRuns; ++run) {
+        // JSON, the way Engine::save and Engine::loadComposition did it
+        double startMs = juce::Time::getMillisecondCounterHiRes();
+        const auto text = makeBenchmarkState(false, numTracks, numMidiEventsPerTrack, numParametersPerTrack).dump(2);
+        jsonFile.replaceWithData(text.data(), text.size());
+        best(jsonResult.saveMs, startMs);
+
+        startMs = juce::Time::getMillisecondCounterHiRes();
+        juce::MemoryBlock jsonData;
+        jsonFile.loadFileAsData(jsonData);
+        const auto* begin = static_cast<const char*>(jsonData.getData());
+        jsonTotal = consumeState(json::parse(begin, begin + jsonData.getSize()));
+        best(jsonResult.loadMs, startMs);
+
+        // Version 2
+        startMs = juce::Time::getMillisecondCounterHiRes();
+        write(makeBenchmarkState(true, numTracks, numMidiEventsPerTrack, numParametersPerTrack), binaryFile);
+        best(binaryResult.saveMs, startMs);
+
+        startMs = juce::Time::getMillisecondCounterHiRes();
+        {
+            ProjectFile project(binaryFile);
+            binaryTotal = consumeState(project.readState(), &project);
+        }
+        best(binaryResult.loadMs, startMs);
+
+        // What a project browser would read
+        startMs = juce::Time::getMillisecondCounterHiRes();
+        {
+            ProjectFile project(binaryFile);
+            project.getSection(Section::Song);
+            project.getSection(Section::Tracks);
+        }
+        best(summaryResult.loadMs, startMs);
+    }
+
+    jsonResult.fileBytes = jsonFile.getSize();
+    binaryResult.fileBytes = binaryFile.getSize();
+    summaryResult.fileBytes = binaryResult.fileBytes;
+    jsonFile.deleteFile();
+    binaryFile.deleteFile();
+
+    if (jsonTotal != binaryTotal) {
+        DEBUG_PRINT("[ProjectFile] Benchmark formats disagree: " << jsonTotal << " vs " << binaryTotal);
+    }
+    return { jsonResult, binaryResult, summaryResult };
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// ProjectFile - the binary .mpf format, version 2. A short header and chunk
+// table are followed by one chunk per section: song settings, tracks, clips,
+// MIDI, automation and plugin state. Every section but MIDI is MessagePack
+// holding the same document Engine::getStateString writes as JSON, split by
+// key; MIDI events are packed bytes that clips point into. The file is
+// memory-mapped, and each section is decoded the first time it is asked
+// for, so reading a project's name or track list never touches its MIDI.
+// Version 1 projects are the JSON text itself, which stays the interchange
+// and export format.
+class ProjectFile {
+public:
+    static constexpr int formatVersion = 2;
+
+    enum class Section { Song, Tracks, Clips, Midi, Automation, Plugins };
+
+    // True if the file starts like a version 2 project, whatever its extension
+    static bool isBinaryProject(const juce::File& file);
+
+    // Writes a document in the form Engine::load takes, taking it apart as it
+    // goes. MIDI given as packed bytes (packMidi) goes to the MIDI chunk;
+    // everything else is kept as it is.
+    static bool write(nlohmann::json state, const juce::File& file);
+
+    // [int32 tick][uint16 size][bytes] per event, little-endian. An event
+    // too big for its size field is left out with an error rather than cut
+    // short; juce::MidiBuffer refuses those itself, so none should arrive.
+    static std::vector<std::uint8_t> packMidi(const juce::MidiBuffer& midi);
+    static void forEachMidiEvent(const std::vector<std::uint8_t>& packed,
+                                 const std::function<void(int tick, const std::uint8_t* data, int size)>& callback);
+
+    // Little-endian float32 per parameter, in index order
+    static std::vector<std::uint8_t> packParameters(const std::vector<float>& values);
+    static std::vector<float> unpackParameters(const std::vector<std::uint8_t>& packed);
+
+    // Maps the file and reads its chunk table; nothing is decoded yet
+    explicit ProjectFile(const juce::File& file);
+
+    bool isValid() const { return valid; }
+    int getVersion() const { return version; }
+
+    // Decoded on first use and kept. Song is the document without its
+    // tracks; every other section holds "masterTrack" and "tracks" entries
+    // with that section's keys of each track. Midi is null: clips carry
+    // their own events.
+    const nlohmann::json& getSection(Section section);
+
+    // The whole document but its MIDI and automation, in the form
+    // Engine::load takes. Takes the decoded sections with it rather than
+    // copying them. MIDI clips keep a "midiRange" into the MIDI chunk for
+    // forEachClipMidiEvent, and every track is marked with trackIndexKey
+    // for getTrackValue, so those two are only read when a track is built.
+    // Throws nothing; a damaged section or range is logged and left out.
+    nlohmann::json readState();
+
+    // Set on each track readState returns; -1 on the master track
+    static constexpr const char* trackIndexKey = "projectTrackIndex";
+
+    // A key of a track that readState left in the file ("automation",
+    // "automatedParameters"), or null. Its section is decoded on first use.
+    const nlohmann::json& getTrackValue(const nlohmann::json& track, const std::string& key);
+
+    // The events of a clip readState returned, straight from the mapped
+    // file. False if the clip points at no MIDI here.
+    bool forEachClipMidiEvent(const nlohmann::json& clip,
+                              const std::function<void(int tick, const std::uint8_t* data, int size)>& callback) const;
+
+    struct BenchmarkResult {
+        std::string format;
+        double saveMs = 0.0;
+        double loadMs = 0.0;
+        std::int64_t fileBytes = 0;
+    };
+
+    // Saves and loads the same generated project as JSON and as version 2,
+    // each load ending with every MIDI event and parameter in hand. Used by
+    // `MULO --benchmark-project`
+    static std::vector<BenchmarkResult> runBenchmark(int numTracks = 32, int numMidiEventsPerTrack = 10000,
+                                                     int numParametersPerTrack = 2000);
+
+private:
+    struct Chunk {
+        std::uint64_t offset = 0;
+        std::uint64_t size = 0;
+        bool present = false;
+    };
+
+    // Where in the MIDI chunk a clip's events are, if its range is sound
+    bool getMidiRange(const nlohmann::json& clip, std::uint64_t& offset, std::uint64_t& size) const;
+    static void forEachMidiEvent(const std::uint8_t* packed, size_t packedSize,
+                                 const std::function<void(int tick, const std::uint8_t* data, int size)>& callback);
+
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    std::array<Chunk, 6> chunks;
+    std::array<std::optional<nlohmann::json>, 6> sections;
+    int version = 0;
+    bool valid = false;
+};
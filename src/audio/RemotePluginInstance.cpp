@@ -0,0 +1,499 @@
+#include "RemotePluginInstance.hpp"
+#include "../DebugConfig.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#if JUCE_LINUX
+#include <unistd.h>
+#endif
+
+using PluginHostProtocol::Command;
+
+namespace {
+    // Loading can mean scanning sample libraries; preparing is usually quick
+    constexpr double loadTimeoutMs = 60000.0;
+    constexpr double controlTimeoutMs = 10000.0;
+    // Offline renders wait this long for a block before giving up on it
+    constexpr double nonRealtimeBlockTimeoutMs = 10000.0;
+
+    // A plugin that crashes this often is left silent rather than restarted forever
+    constexpr int maxRestartsPerMinute = 5;
+    constexpr int watchdogIntervalMs = 250;
+    // A host stuck on one block for this many blocks is taken to be hung
+    constexpr int hungAfterBlocks = 64;
+    constexpr int nonRealtimeHungAfterBlocks = 2;
+
+    std::atomic<double> realtimeDeadlineMs { 0.0 };
+}
+
+void RemotePluginInstance::setRealtimeDeadline(double deadlineMs) {
+    realtimeDeadlineMs.store(deadlineMs, std::memory_order_relaxed);
+}
+
+class RemotePluginInstance::RemoteParameter : public juce::AudioPluginInstance::Parameter {
+public:
+    RemoteParameter(RemotePluginInstance& ownerToNotify, int parameterIndex, const PluginInfo::Parameter& parameter)
+        : owner(ownerToNotify), index(parameterIndex), name(parameter.name),
+          defaultValue(parameter.defaultValue), value(parameter.value) {}
+
+    float getValue() const override { return value.load(std::memory_order_relaxed); }
+    void setValue(float newValue) override {
+        value.store(newValue, std::memory_order_relaxed);
+        owner.markParameterDirty(index);
+    }
+    // A change the plugin made itself, e.g. from its editor
+    void setValueFromHost(float newValue) { value.store(newValue, std::memory_order_relaxed); }
+
+    float getDefaultValue() const override { return defaultValue; }
+    juce::String getName(int maximumStringLength) const override { return name.substring(0, maximumStringLength); }
+    juce::String getLabel() const override { return {}; }
+    juce::String getParameterID() const override { return juce::String(index); }
+
+private:
+    RemotePluginInstance& owner;
+    const int index;
+    const juce::String name;
+    const float defaultValue;
+    std::atomic<float> value;
+};
+
+struct RemotePluginInstance::Host {
+    PluginHostProtocol::SharedMemory memory;
+    juce::ChildProcess process;
+
+    ~Host() {
+        auto* shared = memory.get();
+        if (shared && process.isRunning()) {
+            shared->control.command = Command::Quit;
+            const auto request = PluginHostProtocol::post(shared->control.mailbox);
+            PluginHostProtocol::waitForResponse(shared->control.mailbox, request, 1000.0);
+        }
+        if (process.isRunning() && !process.waitForProcessToFinish(1000)) {
+            process.kill();
+        }
+    }
+
+    // Waits for the answer in short slices, giving up early if the process dies
+    bool awaitControl(std::uint32_t request, double timeoutMs) {
+        auto& mailbox = memory.get()->control.mailbox;
+        for (double waitedMs = 0.0; waitedMs < timeoutMs; waitedMs += 100.0) {
+            if (PluginHostProtocol::waitForResponse(mailbox, request, 100.0)) {
+                return true;
+            }
+            if (!process.isRunning()) {
+                return false;
+            }
+        }
+        return false;
+    }
+};
+
+bool RemotePluginInstance::isSupported() {
+#if JUCE_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::unique_ptr<RemotePluginInstance::Host> RemotePluginInstance::startHost(const juce::PluginDescription& description,
+                                                                            double sampleRate, int blockSize,
+                                                                            PluginInfo& info, juce::String& errorMessage) {
+    static std::atomic<int> nextHostId { 0 };
+
+    auto host = std::make_unique<Host>();
+#if JUCE_LINUX
+    const juce::String processId(static_cast<int>(getpid()));
+#else
+    const juce::String processId("0");
+#endif
+    const auto name = "mulo-plugin-" + processId + "-" + juce::String(nextHostId.fetch_add(1));
+    if (!host->memory.create(name)) {
+        errorMessage = "could not create shared memory for the plugin host";
+        return nullptr;
+    }
+
+    // The host is this same executable; its output would only fill a pipe nobody reads
+    const auto executable = juce::File::getSpecialLocation(juce::File::currentExecutableFile).getFullPathName();
+    if (!host->process.start(juce::StringArray { executable, "--plugin-host", name }, 0)) {
+        errorMessage = "could not start the plugin host";
+        return nullptr;
+    }
+
+    auto& control = host->memory.get()->control;
+    const auto xml = description.createXml()->toString(juce::XmlElement::TextFormat().singleLine()).toStdString();
+    if (xml.size() >= static_cast<size_t>(PluginHostProtocol::controlCapacity)) {
+        errorMessage = "plugin description too large";
+        return nullptr;
+    }
+    std::memcpy(control.data, xml.data(), xml.size());
+    control.dataSize = static_cast<std::int32_t>(xml.size());
+    control.sampleRate = sampleRate;
+    control.blockSize = blockSize;
+    control.command = Command::Load;
+
+    const auto request = PluginHostProtocol::post(control.mailbox);
+    if (!host->awaitControl(request, loadTimeoutMs)) {
+        errorMessage = host->process.isRunning() ? "the plugin host did not answer" : "the plugin host crashed while loading";
+        return nullptr;
+    }
+
+    juce::MemoryInputStream stream(control.data, static_cast<size_t>(juce::jlimit(0, PluginHostProtocol::controlCapacity, control.dataSize)), false);
+    if (!control.succeeded) {
+        errorMessage = stream.readString();
+        return nullptr;
+    }
+
+    info.name = stream.readString();
+    info.hasEditor = stream.readBool();
+    info.acceptsMidi = stream.readBool();
+    info.producesMidi = stream.readBool();
+    info.tailSeconds = stream.readDouble();
+    info.numInputChannels = stream.readInt();
+    info.numOutputChannels = stream.readInt();
+    info.parameters.resize(static_cast<size_t>(juce::jmax(0, stream.readInt())));
+    for (auto& parameter : info.parameters) {
+        parameter.name = stream.readString();
+        parameter.defaultValue = stream.readFloat();
+        parameter.value = stream.readFloat();
+    }
+
+    return host;
+}
+
+std::unique_ptr<RemotePluginInstance> RemotePluginInstance::create(const juce::PluginDescription& description,
+                                                                   double sampleRate, int blockSize,
+                                                                   juce::String& errorMessage) {
+    if (!isSupported()) {
+        errorMessage = "out-of-process plugins are not supported on this platform";
+        return nullptr;
+    }
+
+    PluginInfo info;
+    auto host = startHost(description, sampleRate, blockSize, info, errorMessage);
+    if (!host) {
+        return nullptr;
+    }
+
+    std::unique_ptr<RemotePluginInstance> instance(new RemotePluginInstance(description, info, std::move(host)));
+    instance->setRateAndBufferSizeDetails(sampleRate, blockSize);
+    instance->hostReady.store(true, std::memory_order_release);
+    instance->startThread();
+    return instance;
+}
+
+RemotePluginInstance::RemotePluginInstance(const juce::PluginDescription& pluginDescription,
+                                           const PluginInfo& pluginInfo, std::unique_ptr<Host> pluginHost)
+    : juce::AudioPluginInstance(getBusesProperties(pluginInfo)),
+      juce::Thread("MULO Plugin Watchdog"),
+      description(pluginDescription),
+      info(pluginInfo),
+      host(std::move(pluginHost)) {
+    const auto numParameters = info.parameters.size();
+    parameterDirty = std::make_unique<std::atomic<bool>[]>(numParameters);
+    for (size_t i = 0; i < numParameters; ++i) {
+        auto parameter = std::make_unique<RemoteParameter>(*this, static_cast<int>(i), info.parameters[i]);
+        remoteParameters.push_back(parameter.get());
+        addHostedParameter(std::move(parameter));
+    }
+}
+
+RemotePluginInstance::~RemotePluginInstance() {
+    stopThread(2000);
+
+    hostReady.store(false);
+    while (audioCallActive.load()) {
+        juce::Thread::yield();
+    }
+
+    const juce::ScopedLock lock(controlLock);
+    host.reset();
+}
+
+juce::AudioProcessor::BusesProperties RemotePluginInstance::getBusesProperties(const PluginInfo& info) {
+    BusesProperties buses;
+    if (info.numInputChannels > 0) {
+        buses = buses.withInput("Input", juce::AudioChannelSet::canonicalChannelSet(info.numInputChannels));
+    }
+    if (info.numOutputChannels > 0) {
+        buses = buses.withOutput("Output", juce::AudioChannelSet::canonicalChannelSet(info.numOutputChannels));
+    }
+    return buses;
+}
+
+void RemotePluginInstance::fillInPluginDescription(juce::PluginDescription& result) const {
+    result = description;
+}
+
+bool RemotePluginInstance::isBusesLayoutSupported(const BusesLayout& layout) const {
+    // The host settled the layout when it loaded the plugin
+    return layout.getMainInputChannels() == info.numInputChannels
+        && layout.getMainOutputChannels() == info.numOutputChannels;
+}
+
+bool RemotePluginInstance::sendControl(Command command, double timeoutMs) {
+    if (!hostReady.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    auto& control = host->memory.get()->control;
+    control.command = command;
+    const auto request = PluginHostProtocol::post(control.mailbox);
+    return host->awaitControl(request, timeoutMs) && control.succeeded != 0;
+}
+
+void RemotePluginInstance::prepareToPlay(double sampleRate, int blockSize) {
+    setRateAndBufferSizeDetails(sampleRate, blockSize);
+
+    const juce::ScopedLock lock(controlLock);
+    prepared = true;
+    preparedSampleRate = sampleRate;
+    preparedBlockSize = blockSize;
+
+    auto& control = host->memory.get()->control;
+    control.sampleRate = sampleRate;
+    control.blockSize = blockSize;
+    if (!sendControl(Command::Prepare, controlTimeoutMs)) {
+        std::cerr << "Plugin host for " << info.name << " failed to prepare" << std::endl;
+    }
+}
+
+void RemotePluginInstance::releaseResources() {
+    const juce::ScopedLock lock(controlLock);
+    prepared = false;
+    sendControl(Command::Release, controlTimeoutMs);
+}
+
+void RemotePluginInstance::reset() {
+    const juce::ScopedLock lock(controlLock);
+    sendControl(Command::Reset, controlTimeoutMs);
+}
+
+void RemotePluginInstance::setNonRealtime(bool isNonRealtime) noexcept {
+    juce::AudioPluginInstance::setNonRealtime(isNonRealtime);
+
+    const juce::ScopedLock lock(controlLock);
+    host->memory.get()->control.flag = isNonRealtime ? 1 : 0;
+    sendControl(Command::SetNonRealtime, controlTimeoutMs);
+}
+
+void RemotePluginInstance::showEditor() {
+    const juce::ScopedLock lock(controlLock);
+    sendControl(Command::ShowEditor, controlTimeoutMs);
+}
+
+RemotePluginInstance::Stats RemotePluginInstance::getStats() const {
+    Stats stats;
+    stats.blocksProcessed = blocksProcessed.load(std::memory_order_relaxed);
+    stats.blocksMissed = blocksMissed.load(std::memory_order_relaxed);
+    stats.restarts = restarts.load(std::memory_order_relaxed);
+    stats.hostRunning = hostReady.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void RemotePluginInstance::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) {
+    const int numSamples = buffer.getNumSamples();
+    const int numChannels = juce::jmin(buffer.getNumChannels(), PluginHostProtocol::maxChannels);
+
+    // Paired with restartHost: either it sees this call, or this call sees the host going away
+    audioCallActive.store(true);
+    auto* shared = hostReady.load() ? host->memory.get() : nullptr;
+
+    auto missBlock = [&] {
+        buffer.clear();
+        midiMessages.clear();
+        blocksMissed.fetch_add(1, std::memory_order_relaxed);
+        audioCallActive.store(false);
+    };
+
+    if (!shared || numSamples > PluginHostProtocol::maxBlockSize) {
+        missBlock();
+        return;
+    }
+    // A host still working on a block it missed must not have the payload changed under it
+    if (shared->audio.mailbox.response.load(std::memory_order_acquire)
+        != shared->audio.mailbox.request.load(std::memory_order_relaxed)) {
+        blocksSinceAnswer.fetch_add(1, std::memory_order_relaxed);
+        missBlock();
+        return;
+    }
+    blocksSinceAnswer.store(0, std::memory_order_relaxed);
+
+    // In realtime every remote plugin shares what is left of the callback; offline, plugins may take much longer
+    double timeoutMs = nonRealtimeBlockTimeoutMs;
+    if (!isNonRealtime()) {
+        const double deadlineMs = realtimeDeadlineMs.load(std::memory_order_relaxed);
+        timeoutMs = deadlineMs > 0.0 ? deadlineMs - juce::Time::getMillisecondCounterHiRes()
+                                     : 1000.0 * numSamples / juce::jmax(1.0, getSampleRate());
+        if (timeoutMs <= 0.0) {
+            missBlock();
+            return;
+        }
+    }
+
+    auto& block = shared->audio;
+    block.numChannels = numChannels;
+    block.numSamples = numSamples;
+    for (int ch = 0; ch < numChannels; ++ch) {
+        std::memcpy(block.audio[ch], buffer.getReadPointer(ch), sizeof(float) * static_cast<size_t>(numSamples));
+    }
+    PluginHostProtocol::writeMidi(midiMessages, block);
+    writeParameterChanges(block);
+    writePlayHead(block);
+
+    const auto request = PluginHostProtocol::post(block.mailbox);
+    if (!PluginHostProtocol::waitForResponse(block.mailbox, request, timeoutMs)) {
+        missBlock();
+        return;
+    }
+
+    for (int ch = 0; ch < numChannels; ++ch) {
+        std::memcpy(buffer.getWritePointer(ch), block.audio[ch], sizeof(float) * static_cast<size_t>(numSamples));
+    }
+    PluginHostProtocol::readMidi(block, midiMessages);
+    readParameterChanges(block);
+
+    blocksProcessed.fetch_add(1, std::memory_order_relaxed);
+    audioCallActive.store(false);
+}
+
+void RemotePluginInstance::markParameterDirty(int index) {
+    if (index >= 0 && index < static_cast<int>(remoteParameters.size())) {
+        parameterDirty[static_cast<size_t>(index)].store(true, std::memory_order_release);
+        anyParameterDirty.store(true, std::memory_order_release);
+    }
+}
+
+void RemotePluginInstance::writeParameterChanges(PluginHostProtocol::AudioBlock& block) {
+    int numChanges = 0;
+    if (anyParameterDirty.exchange(false, std::memory_order_acq_rel)) {
+        for (size_t i = 0; i < remoteParameters.size(); ++i) {
+            if (!parameterDirty[i].load(std::memory_order_acquire)) {
+                continue;
+            }
+            if (numChanges == PluginHostProtocol::maxParameterChanges) {
+                // The rest go with the next block
+                anyParameterDirty.store(true, std::memory_order_release);
+                break;
+            }
+            parameterDirty[i].store(false, std::memory_order_relaxed);
+            block.parameterChanges[numChanges++] = { static_cast<std::int32_t>(i), remoteParameters[i]->getValue() };
+        }
+    }
+    block.numParameterChanges = numChanges;
+}
+
+void RemotePluginInstance::readParameterChanges(const PluginHostProtocol::AudioBlock& block) {
+    const int numChanges = juce::jlimit(0, PluginHostProtocol::maxParameterChanges, block.numParameterChanges);
+    for (int i = 0; i < numChanges; ++i) {
+        const auto& change = block.parameterChanges[i];
+        // A local edit still on its way to the host wins
+        if (change.index >= 0 && change.index < static_cast<int>(remoteParameters.size())
+            && !parameterDirty[static_cast<size_t>(change.index)].load(std::memory_order_acquire)) {
+            remoteParameters[static_cast<size_t>(change.index)]->setValueFromHost(change.value);
+        }
+    }
+}
+
+void RemotePluginInstance::writePlayHead(PluginHostProtocol::AudioBlock& block) {
+    block.hasPosition = 0;
+    auto* playHead = getPlayHead();
+    if (!playHead) {
+        return;
+    }
+
+    const auto position = playHead->getPosition();
+    if (!position) {
+        return;
+    }
+
+    const auto signature = position->getTimeSignature().orFallback(juce::AudioPlayHead::TimeSignature{});
+    block.hasPosition = 1;
+    block.isPlaying = position->getIsPlaying() ? 1 : 0;
+    block.bpm = position->getBpm().orFallback(120.0);
+    block.timeInSeconds = position->getTimeInSeconds().orFallback(0.0);
+    block.timeInSamples = position->getTimeInSamples().orFallback(0);
+    block.ppqPosition = position->getPpqPosition().orFallback(0.0);
+    block.timeSigNumerator = signature.numerator;
+    block.timeSigDenominator = signature.denominator;
+}
+
+void RemotePluginInstance::run() {
+    while (!threadShouldExit()) {
+        wait(watchdogIntervalMs);
+        if (threadShouldExit()) {
+            return;
+        }
+
+        if (hostReady.load(std::memory_order_acquire) && host->process.isRunning()) {
+            const int hungAfter = isNonRealtime() ? nonRealtimeHungAfterBlocks : hungAfterBlocks;
+            if (blocksSinceAnswer.load(std::memory_order_relaxed) < hungAfter) {
+                continue;
+            }
+            // Only this thread replaces the host, so it can't go away under the kill
+            std::cerr << "Plugin host for " << info.name << " stopped answering; restarting it" << std::endl;
+            hostReady.store(false);
+            host->process.kill();
+        }
+
+        if (!restartHost()) {
+            std::cerr << "Plugin host for " << info.name << " keeps crashing; leaving it silent" << std::endl;
+            return;
+        }
+    }
+}
+
+bool RemotePluginInstance::restartHost() {
+    if (hostReady.exchange(false)) {
+        std::cerr << "Plugin host for " << info.name << " exited; restarting it" << std::endl;
+    }
+    while (audioCallActive.load()) {
+        juce::Thread::yield();
+    }
+
+    const double nowMs = juce::Time::getMillisecondCounterHiRes();
+    restartTimesMs.erase(std::remove_if(restartTimesMs.begin(), restartTimesMs.end(),
+                                        [nowMs](double timeMs) { return nowMs - timeMs > 60000.0; }),
+                         restartTimesMs.end());
+    if (static_cast<int>(restartTimesMs.size()) >= maxRestartsPerMinute) {
+        return false;
+    }
+    restartTimesMs.push_back(nowMs);
+
+    const juce::ScopedLock lock(controlLock);
+
+    PluginInfo newInfo;
+    juce::String errorMessage;
+    auto newHost = startHost(description, preparedSampleRate, preparedBlockSize, newInfo, errorMessage);
+    if (!newHost || newInfo.parameters.size() != info.parameters.size()) {
+        // Tried again on the next watchdog tick
+        std::cerr << "Failed to restart the plugin host for " << info.name << ": " << errorMessage << std::endl;
+        return true;
+    }
+
+    host = std::move(newHost);
+    hostReady.store(true, std::memory_order_release);
+
+    auto& control = host->memory.get()->control;
+    if (prepared) {
+        control.sampleRate = preparedSampleRate;
+        control.blockSize = preparedBlockSize;
+        sendControl(Command::Prepare, controlTimeoutMs);
+    }
+    if (isNonRealtime()) {
+        control.flag = 1;
+        sendControl(Command::SetNonRealtime, controlTimeoutMs);
+    }
+
+    // Bring the new instance back to where this one's parameters are
+    for (size_t i = 0; i < remoteParameters.size(); ++i) {
+        parameterDirty[i].store(true, std::memory_order_release);
+    }
+    anyParameterDirty.store(true, std::memory_order_release);
+
+    blocksSinceAnswer.store(0, std::memory_order_relaxed);
+    restarts.fetch_add(1, std::memory_order_relaxed);
+    DEBUG_PRINT("[RemotePluginInstance] Restarted the host for " << info.name);
+    return true;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include "PluginHostProtocol.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// RemotePluginInstance - a plugin loaded in its own host process
+// (`MULO --plugin-host`), so a crash inside it takes down only that process.
+// To Effect it is just another AudioPluginInstance. processBlock copies the
+// block into shared memory, wakes the host and waits for the answer within
+// the same block, so hosting out of process adds no latency; plugins on
+// different tracks run in their own processes in parallel. A block the host
+// misses plays as silence. If the host dies, or stays stuck on one block for
+// too long, a watchdog thread starts a new one, loads the plugin again and
+// restores its parameters.
+class RemotePluginInstance : public juce::AudioPluginInstance, private juce::Thread {
+public:
+    // Linux only for now
+    static bool isSupported();
+
+    // Starts a host and loads the plugin in it. nullptr with errorMessage set on failure.
+    static std::unique_ptr<RemotePluginInstance> create(const juce::PluginDescription& description,
+                                                        double sampleRate, int blockSize,
+                                                        juce::String& errorMessage);
+    ~RemotePluginInstance() override;
+
+    // The editor opens in a window of the host process
+    void showEditor();
+
+    // Audio thread, at the start of each device callback: every remote plugin
+    // in the callback has until this time (juce::Time::getMillisecondCounterHiRes)
+    // to answer, rather than a block's worth of time each. 0 for no deadline.
+    static void setRealtimeDeadline(double deadlineMs);
+
+    struct Stats {
+        std::uint64_t blocksProcessed = 0;
+        std::uint64_t blocksMissed = 0; // played as silence: no host, or it answered late
+        int restarts = 0;
+        bool hostRunning = false;
+    };
+    Stats getStats() const;
+
+    // AudioPluginInstance
+    void fillInPluginDescription(juce::PluginDescription& description) const override;
+    const juce::String getName() const override { return info.name; }
+    bool isBusesLayoutSupported(const BusesLayout& layout) const override;
+    void prepareToPlay(double sampleRate, int blockSize) override;
+    void releaseResources() override;
+    void reset() override;
+    void setNonRealtime(bool isNonRealtime) noexcept override;
+    void processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) override;
+    using juce::AudioPluginInstance::processBlock;
+    double getTailLengthSeconds() const override { return info.tailSeconds; }
+    bool acceptsMidi() const override { return info.acceptsMidi; }
+    bool producesMidi() const override { return info.producesMidi; }
+    juce::AudioProcessorEditor* createEditor() override { return nullptr; }
+    bool hasEditor() const override { return info.hasEditor; }
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram(int) override {}
+    const juce::String getProgramName(int) override { return {}; }
+    void changeProgramName(int, const juce::String&) override {}
+    void getStateInformation(juce::MemoryBlock&) override {}
+    void setStateInformation(const void*, int) override {}
+
+private:
+    // What the host reports once the plugin is loaded
+    struct PluginInfo {
+        juce::String name;
+        bool hasEditor = false;
+        bool acceptsMidi = false;
+        bool producesMidi = false;
+        double tailSeconds = 0.0;
+        int numInputChannels = 0;
+        int numOutputChannels = 0;
+
+        struct Parameter {
+            juce::String name;
+            float defaultValue = 0.0f;
+            float value = 0.0f;
+        };
+        std::vector<Parameter> parameters;
+    };
+
+    class RemoteParameter;
+    struct Host;
+
+    RemotePluginInstance(const juce::PluginDescription& description, const PluginInfo& info, std::unique_ptr<Host> host);
+
+    static BusesProperties getBusesProperties(const PluginInfo& info);
+    static std::unique_ptr<Host> startHost(const juce::PluginDescription& description, double sampleRate,
+                                           int blockSize, PluginInfo& info, juce::String& errorMessage);
+
+    // Message or watchdog thread; false if the host failed or stopped answering
+    bool sendControl(PluginHostProtocol::Command command, double timeoutMs);
+
+    void markParameterDirty(int index);
+    void writeParameterChanges(PluginHostProtocol::AudioBlock& block);
+    void readParameterChanges(const PluginHostProtocol::AudioBlock& block);
+    void writePlayHead(PluginHostProtocol::AudioBlock& block);
+
+    // The watchdog
+    void run() override;
+    bool restartHost();
+
+    const juce::PluginDescription description;
+    const PluginInfo info;
+    std::unique_ptr<Host> host;
+    juce::CriticalSection controlLock;
+
+    std::atomic<bool> hostReady { false };
+    std::atomic<bool> audioCallActive { false };
+    bool prepared = false;
+    double preparedSampleRate = 44100.0;
+    int preparedBlockSize = 512;
+
+    std::vector<RemoteParameter*> remoteParameters; // owned by the AudioProcessor
+    std::unique_ptr<std::atomic<bool>[]> parameterDirty;
+    std::atomic<bool> anyParameterDirty { false };
+
+    std::atomic<std::uint64_t> blocksProcessed { 0 };
+    std::atomic<std::uint64_t> blocksMissed { 0 };
+    // Blocks in a row that found the host still busy with an earlier one
+    std::atomic<int> blocksSinceAnswer { 0 };
+    std::atomic<int> restarts { 0 };
+    std::vector<double> restartTimesMs;
+};
@@ -0,0 +1,297 @@
+#include "Resampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if JUCE_INTEL
+    #include <immintrin.h>
+    #if JUCE_MSVC
+        #define MULO_TARGET_AVX
+    #else
+        #define MULO_TARGET_AVX __attribute__((target("avx")))
+    #endif
+#elif JUCE_ARM && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+    #include <arm_neon.h>
+    #define MULO_USE_NEON 1
+#endif
+
+namespace {
+    using DotProductFunction = float (*)(const float*, const float*, int);
+
+    float dotProductScalar(const float* a, const float* b, int n) {
+        float sum = 0.0f;
+        for (int i = 0; i < n; ++i) {
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+#if JUCE_INTEL
+    float dotProductSSE(const float* a, const float* b, int n) {
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        }
+
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, _mm_add_ps(acc0, acc1));
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + dotProductScalar(a + i, b + i, n - i);
+    }
+
+    // Compiled for AVX regardless of the global flags; only chosen when the CPU has it
+    MULO_TARGET_AVX float dotProductAVX(const float* a, const float* b, int n) {
+        __m256 acc = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        }
+
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, acc);
+        float sum = 0.0f;
+        for (float lane : lanes) {
+            sum += lane;
+        }
+        return sum + dotProductScalar(a + i, b + i, n - i);
+    }
+#elif MULO_USE_NEON
+    float dotProductNEON(const float* a, const float* b, int n) {
+        float32x4_t acc0 = vdupq_n_f32(0.0f);
+        float32x4_t acc1 = vdupq_n_f32(0.0f);
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+            acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        }
+
+        float lanes[4];
+        vst1q_f32(lanes, vaddq_f32(acc0, acc1));
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + dotProductScalar(a + i, b + i, n - i);
+    }
+#endif
+
+    DotProductFunction chooseDotProduct() {
+#if JUCE_INTEL
+        return juce::SystemStats::hasAVX() ? dotProductAVX : dotProductSSE;
+#elif MULO_USE_NEON
+        return dotProductNEON;
+#else
+        return dotProductScalar;
+#endif
+    }
+
+    // Zeroth-order modified Bessel function, for the Kaiser window
+    double besselI0(double x) {
+        double sum = 1.0;
+        double term = 1.0;
+        const double halfX = x * 0.5;
+        for (int k = 1; k < 64; ++k) {
+            term *= (halfX / k) * (halfX / k);
+            sum += term;
+            if (term < sum * 1.0e-12) {
+                break;
+            }
+        }
+        return sum;
+    }
+
+    // The interpolator the clip loader always used
+    class LinearResampler : public Resampler {
+    public:
+        void process(const float* input, int numInputSamples, float* output, int numOutputSamples,
+                     double sourceSamplesPerOutputSample) const override {
+            for (int i = 0; i < numOutputSamples; ++i) {
+                double sourcePos = i * sourceSamplesPerOutputSample;
+                int baseIndex = (int)sourcePos;
+                double fraction = sourcePos - baseIndex;
+
+                if (baseIndex >= 0 && baseIndex < numInputSamples - 1) {
+                    float y0 = input[baseIndex];
+                    float y1 = input[baseIndex + 1];
+                    output[i] = y0 + (float)fraction * (y1 - y0);
+                } else if (baseIndex >= 0 && baseIndex < numInputSamples) {
+                    output[i] = input[baseIndex];
+                } else {
+                    output[i] = 0.0f;
+                }
+            }
+        }
+
+        ResamplerQuality getQuality() const override { return ResamplerQuality::Draft; }
+    };
+
+    // Kaiser-windowed sinc, precomputed as a table of numPhases sub-sample
+    // offsets. Each output sample is one dot product against the nearest phase.
+    class SincResampler : public Resampler {
+    public:
+        SincResampler(ResamplerQuality q, int zeroCrossingTaps, int phases, double beta, double passbandFraction)
+            : quality(q), baseTaps(zeroCrossingTaps), numPhases(phases), kaiserBeta(beta),
+              passband(passbandFraction), dotProduct(chooseDotProduct()) {}
+
+        void process(const float* input, int numInputSamples, float* output, int numOutputSamples,
+                     double sourceSamplesPerOutputSample) const override {
+            // Lower the cutoff (and widen the kernel) when downsampling so nothing aliases
+            const double scale = std::min(1.0, 1.0 / sourceSamplesPerOutputSample);
+            const double cutoff = passband * scale;
+            const int numTaps = std::min(maxTaps, roundUpToMultipleOf8(static_cast<int>(std::ceil(baseTaps / scale))));
+            const int halfTaps = numTaps / 2;
+
+            const auto table = buildTable(numTaps, cutoff);
+
+            // Zero padding on both sides keeps the inner loop branch-free
+            std::vector<float> padded(static_cast<size_t>(numInputSamples + numTaps + halfTaps + 1), 0.0f);
+            std::copy(input, input + numInputSamples, padded.begin() + halfTaps);
+            const auto lastStart = static_cast<juce::int64>(padded.size()) - numTaps;
+
+            for (int i = 0; i < numOutputSamples; ++i) {
+                const double sourcePos = i * sourceSamplesPerOutputSample;
+                auto baseIndex = static_cast<juce::int64>(sourcePos);
+                int phase = static_cast<int>(std::lround((sourcePos - static_cast<double>(baseIndex)) * numPhases));
+                if (phase == numPhases) {
+                    phase = 0;
+                    ++baseIndex;
+                }
+
+                // Taps cover input baseIndex - halfTaps + 1 ... baseIndex + halfTaps
+                const auto start = baseIndex + 1;
+                if (start > lastStart) {
+                    output[i] = 0.0f;
+                    continue;
+                }
+
+                output[i] = dotProduct(padded.data() + start, table.data() + static_cast<size_t>(phase) * numTaps, numTaps);
+            }
+        }
+
+        ResamplerQuality getQuality() const override { return quality; }
+
+    private:
+        static constexpr int maxTaps = 2048;
+
+        static int roundUpToMultipleOf8(int n) { return (n + 7) & ~7; }
+
+        std::vector<float> buildTable(int numTaps, double cutoff) const {
+            std::vector<float> table(static_cast<size_t>(numPhases) * numTaps);
+            const int halfTaps = numTaps / 2;
+            const double windowNorm = 1.0 / besselI0(kaiserBeta);
+
+            for (int phase = 0; phase < numPhases; ++phase) {
+                const double fraction = static_cast<double>(phase) / numPhases;
+                float* row = table.data() + static_cast<size_t>(phase) * numTaps;
+                double sum = 0.0;
+
+                for (int k = 0; k < numTaps; ++k) {
+                    const double t = (k - halfTaps + 1) - fraction;
+                    const double x = cutoff * t;
+                    const double sinc = std::abs(x) < 1.0e-9 ? 1.0 : std::sin(juce::MathConstants<double>::pi * x) / (juce::MathConstants<double>::pi * x);
+                    const double w = t / halfTaps;
+                    const double window = std::abs(w) >= 1.0 ? 0.0 : besselI0(kaiserBeta * std::sqrt(1.0 - w * w)) * windowNorm;
+                    const double value = cutoff * sinc * window;
+                    row[k] = static_cast<float>(value);
+                    sum += value;
+                }
+
+                // Unity gain at DC for every phase
+                if (sum != 0.0) {
+                    for (int k = 0; k < numTaps; ++k) {
+                        row[k] = static_cast<float>(row[k] / sum);
+                    }
+                }
+            }
+
+            return table;
+        }
+
+        const ResamplerQuality quality;
+        const int baseTaps;
+        const int numPhases;
+        const double kaiserBeta;
+        const double passband;
+        const DotProductFunction dotProduct;
+    };
+}
+
+juce::AudioBuffer<float> Resampler::process(const juce::AudioBuffer<float>& source, double sourceRate, double targetRate) const {
+    const int numSourceSamples = source.getNumSamples();
+    const double ratio = targetRate / sourceRate;
+    const int numOutputSamples = static_cast<int>(numSourceSamples * ratio + 0.5);
+
+    juce::AudioBuffer<float> output(source.getNumChannels(), numOutputSamples);
+    output.clear();
+
+    for (int ch = 0; ch < source.getNumChannels(); ++ch) {
+        process(source.getReadPointer(ch), numSourceSamples, output.getWritePointer(ch), numOutputSamples, sourceRate / targetRate);
+    }
+
+    return output;
+}
+
+std::unique_ptr<Resampler> Resampler::create(ResamplerQuality quality) {
+    switch (quality) {
+        case ResamplerQuality::Draft:
+            return std::make_unique<LinearResampler>();
+        case ResamplerQuality::High:
+            // ~90 dB stopband, 64 taps per side pair at unity ratio
+            return std::make_unique<SincResampler>(quality, 64, 1024, 9.0, 0.96);
+        case ResamplerQuality::Normal:
+        default:
+            // ~60 dB stopband, cheap enough for project load
+            return std::make_unique<SincResampler>(ResamplerQuality::Normal, 16, 256, 6.0, 0.91);
+    }
+}
+
+std::string Resampler::getQualityName(ResamplerQuality quality) {
+    switch (quality) {
+        case ResamplerQuality::Draft: return "draft";
+        case ResamplerQuality::High:  return "high";
+        case ResamplerQuality::Normal:
+        default:                      return "normal";
+    }
+}
+
+ResamplerQuality Resampler::getQualityFromName(const std::string& name, ResamplerQuality fallback) {
+    if (name == "draft") return ResamplerQuality::Draft;
+    if (name == "normal") return ResamplerQuality::Normal;
+    if (name == "high") return ResamplerQuality::High;
+    return fallback;
+}
+
+std::vector<Resampler::BenchmarkResult> Resampler::runBenchmark(double sourceRate, double targetRate,
+                                                                double signalSeconds, int numRuns) {
+    const int numSourceSamples = static_cast<int>(signalSeconds * sourceRate);
+    juce::AudioBuffer<float> source(1, numSourceSamples);
+    juce::Random random(42);
+    for (int i = 0; i < numSourceSamples; ++i) {
+        source.setSample(0, i, random.nextFloat() * 2.0f - 1.0f);
+    }
+
+    std::vector<BenchmarkResult> results;
+    for (auto quality : { ResamplerQuality::Draft, ResamplerQuality::Normal, ResamplerQuality::High }) {
+        auto resampler = create(quality);
+
+        double bestSeconds = std::numeric_limits<double>::max();
+        int numOutputSamples = 0;
+        for (int run = 0; run < juce::jmax(1, numRuns); ++run) {
+            const double startMs = juce::Time::getMillisecondCounterHiRes();
+            auto output = resampler->process(source, sourceRate, targetRate);
+            const double elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startMs) / 1000.0;
+            bestSeconds = std::min(bestSeconds, elapsedSeconds);
+            numOutputSamples = output.getNumSamples();
+        }
+        bestSeconds = std::max(bestSeconds, 1.0e-9);
+
+        BenchmarkResult result;
+        result.quality = quality;
+        result.sourceRate = sourceRate;
+        result.targetRate = targetRate;
+        result.outputSamplesPerSecond = numOutputSamples / bestSeconds;
+        result.realtimeFactor = (numOutputSamples / targetRate) / bestSeconds;
+        results.push_back(result);
+    }
+
+    return results;
+}
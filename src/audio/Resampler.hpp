@@ -0,0 +1,47 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class ResamplerQuality { Draft, Normal, High };
+
+// Resampler - converts a whole channel of audio to a new rate in one go.
+// Draft is the old linear interpolator; Normal and High are polyphase
+// windowed-sinc filters whose inner loop runs on SSE/AVX or NEON.
+// Instances are stateless once built and can be shared between threads.
+class Resampler {
+public:
+    virtual ~Resampler() = default;
+
+    // Output sample i is taken at input position i * sourceSamplesPerOutputSample.
+    // Input outside [0, numInputSamples) reads as silence.
+    virtual void process(const float* input, int numInputSamples,
+                         float* output, int numOutputSamples,
+                         double sourceSamplesPerOutputSample) const = 0;
+
+    virtual ResamplerQuality getQuality() const = 0;
+
+    // Resamples every channel of source into a new buffer at targetRate
+    juce::AudioBuffer<float> process(const juce::AudioBuffer<float>& source, double sourceRate, double targetRate) const;
+
+    static std::unique_ptr<Resampler> create(ResamplerQuality quality);
+
+    static std::string getQualityName(ResamplerQuality quality);
+    static ResamplerQuality getQualityFromName(const std::string& name, ResamplerQuality fallback = ResamplerQuality::Normal);
+
+    struct BenchmarkResult {
+        ResamplerQuality quality;
+        double sourceRate;
+        double targetRate;
+        double outputSamplesPerSecond; // per channel
+        double realtimeFactor;         // output audio seconds per wall-clock second
+    };
+
+    // Times every quality mode on the same noise signal. Used by `MULO --benchmark-resampler`
+    static std::vector<BenchmarkResult> runBenchmark(double sourceRate, double targetRate,
+                                                     double signalSeconds = 30.0, int numRuns = 3);
+};
@@ -0,0 +1,508 @@
+#include "SampleLibraryIndex.hpp"
+#include "../DebugConfig.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+#if JUCE_LINUX
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr const char* cacheHeader = "MULO sample index 1";
+    // How long find() waits for a root's first scan before giving up on it
+    constexpr int maxScanWaitMs = 60000;
+    constexpr double cacheSaveIntervalMs = 10000.0;
+
+    std::string toLower(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+        return text;
+    }
+
+    std::string getFileName(const std::string& relativePath) {
+        const auto slash = relativePath.find_last_of("/\\");
+        return slash == std::string::npos ? relativePath : relativePath.substr(slash + 1);
+    }
+
+    // Position in getAudioExtensions(), or -1
+    int getExtensionRank(const std::string& extension) {
+        const auto& extensions = SampleLibraryIndex::getAudioExtensions();
+        const auto it = std::find(extensions.begin(), extensions.end(), extension);
+        return it == extensions.end() ? -1 : static_cast<int>(it - extensions.begin());
+    }
+}
+
+const std::vector<std::string>& SampleLibraryIndex::getAudioExtensions() {
+    static const std::vector<std::string> extensions = { ".wav", ".mp3", ".flac", ".ogg", ".aiff", ".m4a" };
+    return extensions;
+}
+
+void SampleLibraryIndex::Root::add(const std::string& relativePath) {
+    if (relativePath.empty() || indexOf.count(relativePath) != 0) {
+        return;
+    }
+
+    const auto index = static_cast<std::uint32_t>(paths.size());
+    paths.push_back(relativePath);
+    indexOf.emplace(relativePath, index);
+    ++numFiles;
+
+    const auto name = getFileName(relativePath);
+    const auto lowerName = toLower(name);
+    byName[name].push_back(index);
+    byLowerName[lowerName].push_back(index);
+
+    const auto dot = name.rfind('.');
+    if (dot == std::string::npos || dot == 0) {
+        return;
+    }
+    if (getExtensionRank(name.substr(dot)) >= 0) {
+        byStem[name.substr(0, dot)].push_back(index);
+    }
+    if (getExtensionRank(lowerName.substr(dot)) >= 0) {
+        byLowerStem[lowerName.substr(0, dot)].push_back(index);
+    }
+}
+
+void SampleLibraryIndex::Root::remove(const std::string& relativePath) {
+    const auto it = indexOf.find(relativePath);
+    if (it == indexOf.end()) {
+        return;
+    }
+    const auto index = it->second;
+    indexOf.erase(it);
+
+    const auto name = getFileName(relativePath);
+    const auto lowerName = toLower(name);
+    auto drop = [index](std::unordered_map<std::string, Candidates>& map, const std::string& key) {
+        auto entry = map.find(key);
+        if (entry == map.end()) return;
+        auto& candidates = entry->second;
+        candidates.erase(std::remove(candidates.begin(), candidates.end(), index), candidates.end());
+        if (candidates.empty()) map.erase(entry);
+    };
+    drop(byName, name);
+    drop(byLowerName, lowerName);
+    const auto dot = name.rfind('.');
+    if (dot != std::string::npos && dot != 0) {
+        drop(byStem, name.substr(0, dot));
+        drop(byLowerStem, lowerName.substr(0, dot));
+    }
+
+    paths[index].clear();
+    --numFiles;
+}
+
+void SampleLibraryIndex::Root::removeUnder(const std::string& relativeDirectory) {
+    const auto prefix = relativeDirectory + static_cast<char>(juce::File::getSeparatorChar());
+    std::vector<std::string> removed;
+    for (const auto& path : paths) {
+        if (path.compare(0, prefix.size(), prefix) == 0) {
+            removed.push_back(path);
+        }
+    }
+    for (const auto& path : removed) {
+        remove(path);
+    }
+}
+
+juce::File SampleLibraryIndex::Root::lookup(const std::string& sampleName, const std::string& lowerName) const {
+    // The oldest candidate still on disk
+    auto firstExisting = [this](const std::unordered_map<std::string, Candidates>& map, const std::string& key) {
+        const auto entry = map.find(key);
+        if (entry != map.end()) {
+            for (const auto index : entry->second) {
+                const auto file = directory.getChildFile(paths[index]);
+                if (file.existsAsFile()) {
+                    return file;
+                }
+            }
+        }
+        return juce::File();
+    };
+
+    // Among "name.ext" candidates, .wav before .mp3 and so on
+    auto bestExtension = [this](const std::unordered_map<std::string, Candidates>& map, const std::string& key, bool ignoreCase) {
+        juce::File best;
+        int bestRank = -1;
+        const auto entry = map.find(key);
+        if (entry != map.end()) {
+            for (const auto index : entry->second) {
+                const auto name = getFileName(paths[index]);
+                const auto extension = name.substr(name.rfind('.'));
+                const int rank = getExtensionRank(ignoreCase ? toLower(extension) : extension);
+                if (rank >= 0 && (bestRank < 0 || rank < bestRank)) {
+                    const auto file = directory.getChildFile(paths[index]);
+                    if (file.existsAsFile()) {
+                        best = file;
+                        bestRank = rank;
+                    }
+                }
+            }
+        }
+        return best;
+    };
+
+    if (auto file = firstExisting(byName, sampleName); file != juce::File()) return file;
+    if (auto file = bestExtension(byStem, sampleName, false); file != juce::File()) return file;
+    if (auto file = firstExisting(byLowerName, lowerName); file != juce::File()) return file;
+    return bestExtension(byLowerStem, lowerName, true);
+}
+
+SampleLibraryIndex::SampleLibraryIndex() : juce::Thread("MULO Sample Index") {}
+
+SampleLibraryIndex::~SampleLibraryIndex() {
+    stopThread(5000);
+    if (dirty.load()) {
+        saveCache();
+    }
+#if JUCE_LINUX
+    if (inotifyFd >= 0) {
+        ::close(inotifyFd);
+    }
+#endif
+}
+
+void SampleLibraryIndex::setRoots(const std::vector<juce::File>& directories) {
+    {
+        const juce::ScopedLock sl(lock);
+        roots.clear();
+        for (const auto& directory : directories) {
+            if (!directory.isDirectory()) {
+                continue;
+            }
+            auto root = std::make_shared<Root>();
+            root->directory = directory;
+            auto cached = cachedRoots.find(directory.getFullPathName().toStdString());
+            if (cached != cachedRoots.end()) {
+                for (const auto& path : cached->second) {
+                    root->add(path);
+                }
+                root->ready = true;
+            }
+            roots.push_back(std::move(root));
+        }
+    }
+
+    scanFinished.reset();
+    rescanRequested.store(true);
+    if (!isThreadRunning()) {
+        startThread(juce::Thread::Priority::low);
+    } else {
+        notify();
+    }
+}
+
+void SampleLibraryIndex::setCacheFile(const juce::File& file) {
+    const juce::ScopedLock sl(lock);
+    cacheFile = file;
+    loadCache();
+
+    for (auto& root : roots) {
+        auto cached = cachedRoots.find(root->directory.getFullPathName().toStdString());
+        if (!root->ready && cached != cachedRoots.end()) {
+            for (const auto& path : cached->second) {
+                root->add(path);
+            }
+            root->ready = true;
+        }
+    }
+}
+
+juce::File SampleLibraryIndex::find(const std::string& sampleName) const {
+    lookups.fetch_add(1, std::memory_order_relaxed);
+    if (sampleName.empty()) {
+        return {};
+    }
+
+    const auto lowerName = toLower(sampleName);
+    std::vector<std::shared_ptr<Root>> currentRoots;
+    {
+        const juce::ScopedLock sl(lock);
+        currentRoots = roots;
+    }
+
+    for (const auto& root : currentRoots) {
+        // Straight under the root, which also covers paths saved relative to it
+        const auto exactFile = root->directory.getChildFile(sampleName);
+        if (exactFile.existsAsFile()) {
+            return exactFile;
+        }
+        for (const auto& extension : getAudioExtensions()) {
+            const auto file = root->directory.getChildFile(sampleName + extension);
+            if (file.existsAsFile()) {
+                return file;
+            }
+        }
+
+        for (int waitedMs = 0; waitedMs < maxScanWaitMs; waitedMs += 100) {
+            {
+                const juce::ScopedLock sl(lock);
+                if (root->ready) {
+                    break;
+                }
+            }
+            scanFinished.wait(100);
+        }
+
+        const juce::ScopedLock sl(lock);
+        if (auto file = root->lookup(sampleName, lowerName); file != juce::File()) {
+            return file;
+        }
+    }
+    return {};
+}
+
+SampleLibraryIndex::Stats SampleLibraryIndex::getStats() const {
+    const juce::ScopedLock sl(lock);
+    Stats stats;
+    stats.numRoots = static_cast<int>(roots.size());
+    for (const auto& root : roots) {
+        stats.numFiles += root->numFiles;
+    }
+    stats.lookups = lookups.load(std::memory_order_relaxed);
+    stats.scanning = scanning.load();
+    stats.watching = watching.load();
+    return stats;
+}
+
+void SampleLibraryIndex::run() {
+    double lastSaveMs = juce::Time::getMillisecondCounterHiRes();
+    while (!threadShouldExit()) {
+        if (rescanRequested.exchange(false)) {
+            scanAllRoots();
+            lastSaveMs = juce::Time::getMillisecondCounterHiRes();
+        }
+
+        processEvents();
+
+        const double nowMs = juce::Time::getMillisecondCounterHiRes();
+        if (dirty.load() && nowMs - lastSaveMs > cacheSaveIntervalMs) {
+            saveCache();
+            lastSaveMs = nowMs;
+        }
+    }
+}
+
+void SampleLibraryIndex::scanAllRoots() {
+    scanning.store(true);
+    // Waiters block until this scan is done, not just until the last one was
+    scanFinished.reset();
+    [[maybe_unused]] const double startMs = juce::Time::getMillisecondCounterHiRes();
+    resetWatches();
+
+    std::vector<std::shared_ptr<Root>> currentRoots;
+    {
+        const juce::ScopedLock sl(lock);
+        currentRoots = roots;
+    }
+
+    int numFiles = 0;
+    for (const auto& root : currentRoots) {
+        if (threadShouldExit() || rescanRequested.load()) {
+            // The next scan signals scanFinished; doing it now would wake
+            // find() with roots that still aren't ready
+            scanning.store(false);
+            return;
+        }
+
+        auto fresh = scan(root);
+        numFiles += fresh->numFiles;
+
+        const juce::ScopedLock sl(lock);
+        fresh->ready = true;
+        std::swap(*root, *fresh);
+    }
+
+    {
+        // Every root has its own fresh entries now; the cached ones have done their job
+        const juce::ScopedLock sl(lock);
+        cachedRoots.clear();
+    }
+
+    scanning.store(false);
+    scanFinished.signal();
+    DEBUG_PRINT("[SampleLibraryIndex] Indexed " << numFiles << " files in "
+                << juce::roundToInt(juce::Time::getMillisecondCounterHiRes() - startMs) << " ms");
+
+    dirty.store(true);
+    saveCache();
+}
+
+std::shared_ptr<SampleLibraryIndex::Root> SampleLibraryIndex::scan(const std::shared_ptr<Root>& root) {
+    auto fresh = std::make_shared<Root>();
+    fresh->directory = root->directory;
+
+    watchDirectory(root, root->directory);
+    for (const auto& entry : juce::RangedDirectoryIterator(root->directory, true, "*", juce::File::findFilesAndDirectories)) {
+        if (threadShouldExit()) {
+            break;
+        }
+        if (entry.isDirectory()) {
+            watchDirectory(root, entry.getFile());
+        } else {
+            fresh->add(entry.getFile().getRelativePathFrom(root->directory).toStdString());
+        }
+    }
+    return fresh;
+}
+
+void SampleLibraryIndex::resetWatches() {
+    watches.clear();
+#if JUCE_LINUX
+    if (inotifyFd >= 0) {
+        ::close(inotifyFd);
+    }
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    watching.store(inotifyFd >= 0);
+#endif
+}
+
+void SampleLibraryIndex::watchDirectory(const std::shared_ptr<Root>& root, const juce::File& directory) {
+#if JUCE_LINUX
+    if (inotifyFd < 0 || !watching.load()) {
+        return;
+    }
+
+    const int wd = inotify_add_watch(inotifyFd, directory.getFullPathName().toRawUTF8(),
+                                     IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+    if (wd < 0) {
+        // Usually fs.inotify.max_user_watches; the index is then only as fresh as its last scan
+        DEBUG_PRINT("[SampleLibraryIndex] Can't watch " << directory.getFullPathName() << ", changes won't be picked up until the next scan");
+        watching.store(false);
+        return;
+    }
+    watches[wd] = { root, directory };
+#else
+    juce::ignoreUnused(root, directory);
+#endif
+}
+
+void SampleLibraryIndex::processEvents() {
+#if JUCE_LINUX
+    if (inotifyFd < 0) {
+        wait(250);
+        return;
+    }
+
+    pollfd descriptor { inotifyFd, POLLIN, 0 };
+    if (poll(&descriptor, 1, 250) <= 0) {
+        return;
+    }
+
+    alignas(inotify_event) char buffer[16 * 1024];
+    const auto bytesRead = ::read(inotifyFd, buffer, sizeof(buffer));
+    for (ssize_t offset = 0; offset < bytesRead;) {
+        const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+        offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            rescanRequested.store(true);
+            continue;
+        }
+        const auto watch = watches.find(event->wd);
+        if (watch == watches.end()) {
+            continue;
+        }
+        if (event->mask & IN_IGNORED) {
+            watches.erase(watch);
+            continue;
+        }
+        auto root = watch->second.root.lock();
+        if (!root || event->len == 0) {
+            continue;
+        }
+
+        const auto file = watch->second.directory.getChildFile(juce::CharPointer_UTF8(event->name));
+        const auto relativePath = file.getRelativePathFrom(root->directory).toStdString();
+        const bool appeared = (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0;
+
+        if (event->mask & IN_ISDIR) {
+            if (appeared) {
+                // Whatever was moved in with it never raised events of its own
+                watchDirectory(root, file);
+                std::vector<std::string> added;
+                for (const auto& entry : juce::RangedDirectoryIterator(file, true, "*", juce::File::findFilesAndDirectories)) {
+                    if (entry.isDirectory()) {
+                        watchDirectory(root, entry.getFile());
+                    } else {
+                        added.push_back(entry.getFile().getRelativePathFrom(root->directory).toStdString());
+                    }
+                }
+                const juce::ScopedLock sl(lock);
+                for (const auto& path : added) {
+                    root->add(path);
+                }
+            } else {
+                const juce::ScopedLock sl(lock);
+                root->removeUnder(relativePath);
+            }
+        } else {
+            const juce::ScopedLock sl(lock);
+            if (appeared) {
+                root->add(relativePath);
+            } else {
+                root->remove(relativePath);
+            }
+        }
+        dirty.store(true);
+    }
+#else
+    wait(250);
+#endif
+}
+
+void SampleLibraryIndex::loadCache() {
+    cachedRoots.clear();
+    if (!cacheFile.existsAsFile()) {
+        return;
+    }
+
+    juce::FileInputStream in(cacheFile);
+    if (!in.openedOk() || in.readNextLine() != cacheHeader) {
+        return;
+    }
+
+    std::vector<std::string>* current = nullptr;
+    while (!in.isExhausted()) {
+        const auto line = in.readNextLine();
+        if (line.startsWithChar('>')) {
+            current = &cachedRoots[line.substring(1).toStdString()];
+        } else if (current && line.isNotEmpty()) {
+            current->push_back(line.toStdString());
+        }
+    }
+    DEBUG_PRINT("[SampleLibraryIndex] Loaded " << cachedRoots.size() << " cached roots from " << cacheFile.getFullPathName());
+}
+
+void SampleLibraryIndex::saveCache() const {
+    juce::File file;
+    juce::MemoryOutputStream out;
+    {
+        const juce::ScopedLock sl(lock);
+        file = cacheFile;
+        if (file == juce::File()) {
+            return;
+        }
+
+        out << cacheHeader << "\n";
+        for (const auto& root : roots) {
+            if (!root->ready) continue;
+            out << ">" << root->directory.getFullPathName() << "\n";
+            for (const auto& path : root->paths) {
+                if (!path.empty()) {
+                    out << juce::String(path) << "\n";
+                }
+            }
+        }
+    }
+
+    juce::TemporaryFile temp(file);
+    if (temp.getFile().replaceWithData(out.getData(), out.getDataSize()) && temp.overwriteTargetFileWithTemporary()) {
+        dirty.store(false);
+    } else {
+        DEBUG_PRINT("[SampleLibraryIndex] Failed to write " << file.getFullPathName());
+    }
+}
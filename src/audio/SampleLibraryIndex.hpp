@@ -0,0 +1,95 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// SampleLibraryIndex - every file under the sample directories, indexed by
+// file name, lower-case name and name without its audio extension, so a
+// saved clip's file is found without walking the library. Roots are scanned
+// on a background thread and kept current with inotify on Linux; the index
+// is saved to a cache file, so after a restart lookups are answered from it
+// until the fresh scan finishes. A cached path that no longer exists is
+// never returned.
+class SampleLibraryIndex : private juce::Thread {
+public:
+    // Tried in this order for "name" + extension lookups, as findSampleFile always did
+    static const std::vector<std::string>& getAudioExtensions();
+
+    SampleLibraryIndex();
+    ~SampleLibraryIndex() override;
+
+    // Searched in this order. Changing them starts a fresh scan.
+    void setRoots(const std::vector<juce::File>& directories);
+    // Where the index is kept between runs
+    void setCacheFile(const juce::File& file);
+
+    // Any thread. For each root in turn: the name directly under it, then
+    // anywhere below it by exact name, by name plus an audio extension, and
+    // the same two ignoring case. Waits for a root's first scan if there is
+    // nothing cached for it yet.
+    juce::File find(const std::string& sampleName) const;
+
+    struct Stats {
+        int numRoots = 0;
+        int numFiles = 0;
+        std::uint64_t lookups = 0;
+        bool scanning = false;
+        bool watching = false; // inotify is keeping the index current
+    };
+    Stats getStats() const;
+
+private:
+    // Indices into Root::paths, oldest first; the first one that still exists wins
+    using Candidates = std::vector<std::uint32_t>;
+
+    struct Root {
+        juce::File directory;
+        std::vector<std::string> paths; // relative to directory; empty once removed
+        std::unordered_map<std::string, std::uint32_t> indexOf;
+        std::unordered_map<std::string, Candidates> byName, byStem, byLowerName, byLowerStem;
+        int numFiles = 0;
+        bool ready = false; // scanned this run, or loaded from the cache
+
+        void add(const std::string& relativePath);
+        void remove(const std::string& relativePath);
+        // Everything under a removed directory
+        void removeUnder(const std::string& relativeDirectory);
+        juce::File lookup(const std::string& sampleName, const std::string& lowerName) const;
+    };
+
+    void run() override;
+    // Builds a fresh index of the root, watching every directory it meets
+    std::shared_ptr<Root> scan(const std::shared_ptr<Root>& root);
+    void scanAllRoots();
+    void watchDirectory(const std::shared_ptr<Root>& root, const juce::File& directory);
+    void processEvents();
+    void resetWatches();
+
+    void loadCache();
+    void saveCache() const;
+
+    mutable juce::CriticalSection lock;
+    std::vector<std::shared_ptr<Root>> roots;
+    juce::File cacheFile;
+    std::unordered_map<std::string, std::vector<std::string>> cachedRoots; // from the cache file, by root path
+    std::atomic<bool> rescanRequested { false };
+    std::atomic<bool> scanning { false };
+    mutable std::atomic<bool> dirty { false }; // changed since the cache was last written
+    mutable juce::WaitableEvent scanFinished { true };
+    mutable std::atomic<std::uint64_t> lookups { 0 };
+
+    // Scan thread only
+    int inotifyFd = -1;
+    struct Watch {
+        std::weak_ptr<Root> root;
+        juce::File directory;
+    };
+    std::unordered_map<int, Watch> watches;
+    std::atomic<bool> watching { false };
+};
@@ -0,0 +1,206 @@
+#include "SamplePool.hpp"
+#include "../DebugConfig.hpp"
+
+#include <cmath>
+
+SamplePool::SamplePool()
+    : resampler(Resampler::create(ResamplerQuality::Normal)),
+      decodeThreads(juce::ThreadPoolOptions{}
+                        .withThreadName("MULO Sample Decoder")
+                        .withNumberOfThreads(juce::jmax(1, juce::SystemStats::getNumCpus() / 2))) {
+    formatManager.registerBasicFormats();
+}
+
+SamplePool::~SamplePool() {
+    decodeThreads.removeAllJobs(true, 5000);
+}
+
+std::string SamplePool::makeKey(const juce::File& sourceFile, double offset, double duration, double targetSampleRate) const {
+    // Modification time is part of the key so an edited file is decoded afresh
+    return sourceFile.getFullPathName().toStdString()
+        + "|" + std::to_string(sourceFile.getLastModificationTime().toMilliseconds())
+        + "|" + std::to_string(std::llround(offset * 1.0e6))
+        + "|" + std::to_string(std::llround(duration * 1.0e6))
+        + "|" + std::to_string(std::llround(targetSampleRate))
+        + "|" + Resampler::getQualityName(resamplerQuality.load(std::memory_order_relaxed));
+}
+
+SamplePool::PendingHandle SamplePool::findOrStart(const std::string& key, bool& isNew) {
+    const juce::ScopedLock sl(lock);
+    isNew = false;
+
+    auto entry = entries.find(key);
+    if (entry != entries.end()) {
+        ++hits;
+        lru.splice(lru.begin(), lru, entry->second.lruPosition);
+
+        auto pending = std::make_shared<PendingBuffer>();
+        pending->buffer = entry->second.buffer;
+        pending->ready.store(true, std::memory_order_release);
+        pending->finished.signal();
+        return pending;
+    }
+
+    // Someone is already decoding this range; share their result
+    auto running = inFlight.find(key);
+    if (running != inFlight.end()) {
+        ++hits;
+        return running->second;
+    }
+
+    auto pending = std::make_shared<PendingBuffer>();
+    inFlight.emplace(key, pending);
+    isNew = true;
+    return pending;
+}
+
+void SamplePool::runDecode(const PendingHandle& pending, const std::string& key,
+                           const juce::File& sourceFile, double offset, double duration, double targetSampleRate) {
+    std::shared_ptr<const Resampler> decodeResampler;
+    {
+        const juce::ScopedLock sl(lock);
+        decodeResampler = resampler;
+    }
+
+    auto decoded = decode(sourceFile, offset, duration, targetSampleRate, *decodeResampler);
+
+    {
+        const juce::ScopedLock sl(lock);
+        ++misses;
+
+        if (decoded) {
+            Entry entry;
+            entry.bytes = static_cast<std::size_t>(decoded->getNumChannels()) * static_cast<std::size_t>(decoded->getNumSamples()) * sizeof(float);
+            entry.buffer = SharedBuffer(std::move(decoded));
+            lru.push_front(key);
+            entry.lruPosition = lru.begin();
+            bytesResident += entry.bytes;
+
+            pending->buffer = entry.buffer;
+            entries.emplace(key, std::move(entry));
+        }
+
+        inFlight.erase(key);
+        pending->ready.store(true, std::memory_order_release);
+        evictUnusedOverBudget(budgetBytes);
+    }
+
+    pending->finished.signal();
+}
+
+SamplePool::SharedBuffer SamplePool::acquire(const juce::File& sourceFile, double offset, double duration, double targetSampleRate) {
+    const auto key = makeKey(sourceFile, offset, duration, targetSampleRate);
+
+    bool isNew = false;
+    auto pending = findOrStart(key, isNew);
+    if (isNew) {
+        runDecode(pending, key, sourceFile, offset, duration, targetSampleRate);
+    } else {
+        pending->finished.wait();
+    }
+    return pending->buffer;
+}
+
+SamplePool::PendingHandle SamplePool::request(const juce::File& sourceFile, double offset, double duration, double targetSampleRate) {
+    const auto key = makeKey(sourceFile, offset, duration, targetSampleRate);
+
+    bool isNew = false;
+    auto pending = findOrStart(key, isNew);
+    if (isNew) {
+        decodeThreads.addJob([this, pending, key, sourceFile, offset, duration, targetSampleRate] {
+            runDecode(pending, key, sourceFile, offset, duration, targetSampleRate);
+        });
+    }
+    return pending;
+}
+
+std::unique_ptr<juce::AudioBuffer<float>> SamplePool::decode(const juce::File& sourceFile, double offset, double duration,
+                                                             double targetSampleRate, const Resampler& decodeResampler) {
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(sourceFile));
+    if (!reader) {
+        return nullptr;
+    }
+
+    double sourceSampleRate = reader->sampleRate;
+
+    juce::int64 sourceStartSample = static_cast<juce::int64>(offset * sourceSampleRate);
+    juce::int64 sourceEndSample = static_cast<juce::int64>((offset + duration) * sourceSampleRate);
+    juce::int64 numSourceSamples = sourceEndSample - sourceStartSample;
+
+    if (numSourceSamples <= 0) {
+        return nullptr;
+    }
+
+    auto sourceBuffer = std::make_unique<juce::AudioBuffer<float>>(reader->numChannels, (int)numSourceSamples);
+    sourceBuffer->clear();
+    reader->read(sourceBuffer.get(), 0, (int)numSourceSamples, sourceStartSample, true, true);
+
+    if (std::abs(sourceSampleRate - targetSampleRate) <= 0.1) {
+        return sourceBuffer;
+    }
+
+    return std::make_unique<juce::AudioBuffer<float>>(decodeResampler.process(*sourceBuffer, sourceSampleRate, targetSampleRate));
+}
+
+void SamplePool::setResamplerQuality(ResamplerQuality quality) {
+    const juce::ScopedLock sl(lock);
+    resamplerQuality.store(quality, std::memory_order_relaxed);
+    resampler = Resampler::create(quality);
+    DEBUG_PRINT("[SamplePool] Resampler quality set to " << Resampler::getQualityName(quality));
+}
+
+ResamplerQuality SamplePool::getResamplerQuality() const {
+    return resamplerQuality.load(std::memory_order_relaxed);
+}
+
+void SamplePool::evictUnusedOverBudget(std::size_t budget) {
+    // Walk from the least recently used end; buffers a clip still holds stay put
+    auto it = lru.end();
+    while (bytesResident > budget && it != lru.begin()) {
+        --it;
+        auto entry = entries.find(*it);
+        if (entry->second.buffer.use_count() > 1) {
+            continue;
+        }
+
+        bytesResident -= entry->second.bytes;
+        entries.erase(entry);
+        it = lru.erase(it);
+        ++evictions;
+    }
+}
+
+void SamplePool::setMemoryBudget(std::size_t bytes) {
+    const juce::ScopedLock sl(lock);
+    budgetBytes = bytes;
+    evictUnusedOverBudget(budgetBytes);
+    DEBUG_PRINT("[SamplePool] Memory budget set to " << (budgetBytes / (1024 * 1024)) << " MB");
+}
+
+std::size_t SamplePool::getMemoryBudget() const {
+    const juce::ScopedLock sl(lock);
+    return budgetBytes;
+}
+
+void SamplePool::releaseUnused() {
+    const juce::ScopedLock sl(lock);
+    evictUnusedOverBudget(0);
+}
+
+SamplePool::Stats SamplePool::getStats() const {
+    const juce::ScopedLock sl(lock);
+
+    Stats stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    stats.bytesResident = bytesResident;
+    stats.budgetBytes = budgetBytes;
+    stats.numEntries = static_cast<int>(entries.size());
+    for (const auto& [key, entry] : entries) {
+        if (entry.buffer.use_count() > 1) {
+            stats.bytesInUse += entry.bytes;
+        }
+    }
+    return stats;
+}
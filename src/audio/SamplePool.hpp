@@ -0,0 +1,108 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "Resampler.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// SamplePool - process-wide cache of decoded clip audio. Each (file, offset
+// range, target rate) is decoded once and handed out as a shared, immutable
+// buffer, so copies of a clip cost nothing. Buffers no clip is using are
+// evicted least-recently-used first once the pool grows past its budget.
+// Decoding and resampling run on the pool's own background threads.
+class SamplePool {
+public:
+    using SharedBuffer = std::shared_ptr<const juce::AudioBuffer<float>>;
+
+    // A decode that may still be running. Once `ready` reads true, `buffer`
+    // is final (nullptr if the file couldn't be read) and safe to copy from
+    // any thread, including the audio thread.
+    struct PendingBuffer {
+        std::atomic<bool> ready { false };
+        SharedBuffer buffer;
+        juce::WaitableEvent finished { true };
+    };
+    using PendingHandle = std::shared_ptr<PendingBuffer>;
+
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;
+        std::size_t bytesResident = 0;
+        std::size_t bytesInUse = 0;
+        std::size_t budgetBytes = 0;
+        int numEntries = 0;
+    };
+
+    static SamplePool& getInstance() {
+        static SamplePool instance;
+        return instance;
+    }
+
+    // Returns the decoded range [offset, offset + duration) of sourceFile at
+    // targetSampleRate, decoding it on a miss. nullptr if it can't be read.
+    // Blocks until the audio is available.
+    SharedBuffer acquire(const juce::File& sourceFile, double offset, double duration, double targetSampleRate);
+
+    // Same as acquire() but returns straight away; misses are decoded on a
+    // background thread and the handle becomes ready when they finish.
+    PendingHandle request(const juce::File& sourceFile, double offset, double duration, double targetSampleRate);
+
+    // Applies to decodes started after the call; buffers already pooled are kept
+    void setResamplerQuality(ResamplerQuality quality);
+    ResamplerQuality getResamplerQuality() const;
+
+    void setMemoryBudget(std::size_t bytes);
+    std::size_t getMemoryBudget() const;
+
+    // Drops every buffer no clip is holding on to
+    void releaseUnused();
+
+    Stats getStats() const;
+
+private:
+    SamplePool();
+    ~SamplePool();
+    SamplePool(const SamplePool&) = delete;
+    SamplePool& operator=(const SamplePool&) = delete;
+
+    struct Entry {
+        SharedBuffer buffer;
+        std::size_t bytes = 0;
+        std::list<std::string>::iterator lruPosition;
+    };
+
+    std::string makeKey(const juce::File& sourceFile, double offset, double duration, double targetSampleRate) const;
+    std::unique_ptr<juce::AudioBuffer<float>> decode(const juce::File& sourceFile, double offset, double duration,
+                                                     double targetSampleRate, const Resampler& decodeResampler);
+    // Looks the key up, or registers a new in-flight decode. Sets isNew when
+    // the caller is responsible for running it.
+    PendingHandle findOrStart(const std::string& key, bool& isNew);
+    void runDecode(const PendingHandle& pending, const std::string& key,
+                   const juce::File& sourceFile, double offset, double duration, double targetSampleRate);
+    void evictUnusedOverBudget(std::size_t budget);
+
+    mutable juce::CriticalSection lock;
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<std::string, PendingHandle> inFlight;
+    std::atomic<ResamplerQuality> resamplerQuality { ResamplerQuality::Normal };
+    std::shared_ptr<const Resampler> resampler;
+    std::list<std::string> lru; // most recently used at the front
+    std::size_t bytesResident = 0;
+    std::size_t budgetBytes = std::size_t(1024) * 1024 * 1024;
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+
+    // The pool's own readers, so background decodes never depend on an engine's lifetime
+    juce::AudioFormatManager formatManager;
+    juce::ThreadPool decodeThreads;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// SpscQueue - bounded single-producer/single-consumer ring. push() may only be
+// called from one thread and pop() from one other thread; neither blocks nor
+// allocates, so either end can live on the audio thread.
+// Holds at most Capacity - 1 items.
+template <typename T, std::size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool push(const T& item) {
+        const auto write = writeIndex.load(std::memory_order_relaxed);
+        const auto next = (write + 1) & mask;
+        if (next == readIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        items[write] = item;
+        writeIndex.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        const auto read = readIndex.load(std::memory_order_relaxed);
+        if (read == writeIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = items[read];
+        readIndex.store((read + 1) & mask, std::memory_order_release);
+        return true;
+    }
+
+    bool isEmpty() const {
+        return readIndex.load(std::memory_order_acquire) == writeIndex.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr std::size_t mask = Capacity - 1;
+
+    std::array<T, Capacity> items {};
+    alignas(64) std::atomic<std::size_t> writeIndex { 0 };
+    alignas(64) std::atomic<std::size_t> readIndex { 0 };
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+// StateHashNode - one node of the hash tree kept over what a project saves:
+// the composition, each track, and each track's settings, clips, effects
+// and automation. Whatever edits the state a node covers invalidates it,
+// and with it every node above; a node is only rehashed when its hash is
+// asked for while invalid, so asking an unchanged project costs nothing.
+// Message thread only.
+class StateHashNode {
+public:
+    StateHashNode() = default;
+    StateHashNode(const StateHashNode&) = delete;
+    StateHashNode& operator=(const StateHashNode&) = delete;
+
+    // Invalidating this node invalidates parent too
+    void setParent(StateHashNode* newParent) { parent = newParent; }
+
+    void invalidate() {
+        for (auto* node = this; node != nullptr; node = node->parent) {
+            node->valid = false;
+        }
+    }
+
+    // The cached hash, or what compute() returns for it while invalid
+    template <typename Compute>
+    std::uint64_t get(Compute&& compute) {
+        if (!valid) {
+            const std::uint64_t fresh = compute();
+            if (fresh != hash) {
+                hash = fresh;
+                ++changeCount;
+            }
+            valid = true;
+        }
+        return hash;
+    }
+
+    // Bumped every time a rehash comes out different
+    std::uint64_t getChangeCount() const { return changeCount; }
+
+private:
+    StateHashNode* parent = nullptr;
+    std::uint64_t hash = 0;
+    std::uint64_t changeCount = 0;
+    bool valid = false;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+// StateHasher - 64-bit FNV-1a over the raw bytes of whatever is added. Used
+// to notice that state edited in place has changed since it was last
+// compiled or rendered; not for anything that has to survive a restart.
+class StateHasher {
+public:
+    void add(const void* bytes, std::size_t size) {
+        const auto* p = static_cast<const unsigned char*>(bytes);
+        for (std::size_t i = 0; i < size; ++i) {
+            hash = (hash ^ p[i]) * 1099511628211ull;
+        }
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_trivially_copyable_v<T>>>
+    void add(const T& value) {
+        add(&value, sizeof(value));
+    }
+
+    void add(const std::string& text) {
+        const auto size = text.size();
+        add(size);
+        add(text.data(), size);
+    }
+
+    std::uint64_t get() const { return hash; }
+
+private:
+    std::uint64_t hash = 14695981039346656037ull;
+};
@@ -1,8 +1,27 @@
 #include "Track.hpp"
+#include "AudioClip.hpp"
+#include "StateHasher.hpp"
 #include "../DebugConfig.hpp"
 #include <juce_dsp/juce_dsp.h>
 
+#include <algorithm>
+#include <tuple>
+
+namespace {
+    // dest[i] = start + (end - start) * i / n, kept branch-free so it vectorises
+    void fillLinearRamp(float* dest, float start, float end, int numSamples) {
+        const float step = (end - start) / static_cast<float>(numSamples);
+        for (int i = 0; i < numSamples; ++i) {
+            dest[i] = start + step * static_cast<float>(i);
+        }
+    }
+}
+
 Track::Track() {
+    for (auto* node : { &settingsStateNode, &clipsStateNode, &effectsStateNode, &automationStateNode }) {
+        node->setParent(&stateNode);
+    }
+
     // Initialize built-in automation parameters
     float normalizedVolume = volumeSliderToAutomation(decibelsToFloat(volumeDb));
     float normalizedPan = (pan + 1.0f) * 0.5f;
@@ -14,11 +33,38 @@ Track::Track() {
     hasActivePotentialAutomation = true;
 }
 
-void Track::setName(const std::string& n) { name = n; }
+Track::~Track() {
+    // Nothing renders a track that is being destroyed
+    delete activeAutomation;
+
+    AutomationLanes* lanes = nullptr;
+    while (automationQueue.pop(lanes)) {
+        delete lanes;
+    }
+    while (retiredAutomationQueue.pop(lanes)) {
+        delete lanes;
+    }
+
+    // A frozen render is only ever a cache of this track
+    if (frozenClip) {
+        const auto file = frozenClip->sourceFile;
+        frozenClip.reset();
+        file.deleteFile();
+    }
+}
+
+void Track::setName(const std::string& n) {
+    if (name != n) {
+        name = n;
+        settingsStateNode.invalidate();
+    }
+}
 std::string Track::getName() const { return name; }
 void Track::setVolume(float db) { 
-    if (std::abs(db - volumeDb) > 0.001f) {
+    if (std::abs(db - faderVolumeDb) > 0.001f) {
         volumeDb = db;
+        faderVolumeDb = db;
+        settingsStateNode.invalidate();
 
         // Update automation data
         float sliderValue = decibelsToFloat(volumeDb);
@@ -26,6 +72,9 @@ void Track::setVolume(float db) {
         
         if (!automationData["Track"]["Volume"].empty()) {
             automationData["Track"]["Volume"][0].value = normalizedVolume;
+            if (automationData["Track"]["Volume"][0].time >= 0.0) {
+                automationChanged();
+            }
         } else {
             automationData["Track"]["Volume"].emplace_back(-1.0, normalizedVolume, 0.5f);
         }
@@ -40,12 +89,17 @@ float Track::getVolume() const { return volumeDb; }
 void Track::setPan(float p) { 
     float newPan = juce::jlimit(-1.f, 1.f, p);
     
-    if (std::abs(newPan - pan) > 0.001f) {
+    if (std::abs(newPan - faderPan) > 0.001f) {
         pan = newPan;
+        faderPan = newPan;
+        settingsStateNode.invalidate();
         float normalizedPan = (pan + 1.0f) * 0.5f;
                 
         if (!automationData["Track"]["Pan"].empty()) {
             automationData["Track"]["Pan"][0].value = normalizedPan;
+            if (automationData["Track"]["Pan"][0].time >= 0.0) {
+                automationChanged();
+            }
         } else {
             automationData["Track"]["Pan"].emplace_back(-1.0, normalizedPan, 0.5f);
         }
@@ -56,62 +110,91 @@ void Track::setPan(float p) {
 }
 float Track::getPan() const { return pan; }
 
-Effect* Track::addEffect(const std::string& vstPath) {
+std::unique_ptr<Effect> Track::createEffect(const std::string& vstPath) const {
     auto effect = std::make_unique<Effect>();
-    if (effect->loadVST(vstPath)) {
-        if (currentSampleRate > 0 && currentBufferSize > 0) {
-            effect->prepareToPlay(currentSampleRate, currentBufferSize);
-        }
-        
-        effects.push_back(std::move(effect));
-        updateEffectIndices();
-        
-        Effect* addedEffect = effects.back().get();
-        
-        if (addedEffect && addedEffect->isSynthesizer()) {
-        }
+    if (!effect->loadVST(vstPath)) {
+        return nullptr;
+    }
+    if (currentSampleRate > 0 && currentBufferSize > 0) {
+        effect->prepareToPlay(currentSampleRate, currentBufferSize);
+    }
+    return effect;
+}
 
-        // All Parameters
-        const auto params = addedEffect->getAllParameters();
-        int i = 0;
-        for (const auto param : params) {
-            std::string name = param->getName(256).toStdString();
-            
-            if (name.find("CC") != std::string::npos) // Filter out any parameter containing "CC"
-                continue;
+Effect* Track::addEffect(const std::string& vstPath) {
+    auto effect = createEffect(vstPath);
+    if (!effect) {
+        return nullptr;
+    }
 
-            float value = param->getValue();
-            std::string effectKey = addedEffect->getName() + "_" + std::to_string(effects.size() - 1);
-            automationData[effectKey][name].emplace_back(-1.0, value, 0.5f);
-            if (i == addedEffect->getNumParameters() - 1)
-                break;
+    effect->setStateNode(&effectsStateNode);
+    editRendered([this, &effect] { effects.push_back(std::move(effect)); });
+    updateEffectIndices();
+
+    Effect* addedEffect = effects.back().get();
+    addRestingAutomation(*addedEffect, effects.size() - 1);
+    return addedEffect;
+}
 
-            ++i;
+std::vector<std::unique_ptr<Effect>> Track::swapEffects(std::vector<std::unique_ptr<Effect>> newEffects) {
+    effects.swap(newEffects);
+    for (auto& effect : effects) {
+        if (effect) effect->setStateNode(&effectsStateNode);
+    }
+    updateEffectIndices();
+    for (size_t i = 0; i < effects.size(); ++i) {
+        if (effects[i]) addRestingAutomation(*effects[i], i);
+    }
+    return newEffects;
+}
+
+void Track::addRestingAutomation(Effect& effect, size_t index) {
+    const auto params = effect.getAllParameters();
+    const std::string effectKey = effect.getName() + "_" + std::to_string(index);
+    int i = 0;
+    for (const auto param : params) {
+        std::string name = param->getName(256).toStdString();
+
+        if (name.find("CC") != std::string::npos) // Filter out any parameter containing "CC"
+            continue;
+
+        auto& points = automationData[effectKey][name];
+        if (std::none_of(points.begin(), points.end(), [](const AutomationPoint& point) { return point.time < 0.0; })) {
+            points.emplace_back(-1.0, param->getValue(), 0.5f);
         }
-        
-        return addedEffect;
+        if (i == effect.getNumParameters() - 1)
+            break;
+
+        ++i;
     }
-    return nullptr;
 }
 
 bool Track::removeEffect(int index) {
-    if (index >= 0 && index < effects.size()) {
-        effects.erase(effects.begin() + index);
-        updateEffectIndices();
-        return true;
+    if (index < 0 || index >= static_cast<int>(effects.size())) {
+        return false;
     }
-    return false;
+
+    std::vector<std::unique_ptr<Effect>> removed;
+    editRendered([this, index, &removed] {
+        removed.push_back(std::move(effects[static_cast<size_t>(index)]));
+        effects.erase(effects.begin() + index);
+    });
+    updateEffectIndices();
+    retireEffects(std::move(removed));
+    return true;
 }
 
 bool Track::removeEffect(const std::string& name) {
-    for (auto it = effects.begin(); it != effects.end(); ++it) {
-        if ((*it)->getName() == name) {
-            effects.erase(it);
-            updateEffectIndices();
-            return true;
+    const int index = getEffectIndex(name);
+    return index >= 0 && removeEffect(index);
+}
+
+void Track::retireEffects(std::vector<std::unique_ptr<Effect>> removed) {
+    if (renderHost && renderHost->retireEffect) {
+        for (auto& effect : removed) {
+            renderHost->retireEffect(std::move(effect));
         }
     }
-    return false;
 }
 
 Effect* Track::getEffect(int index) {
@@ -140,11 +223,15 @@ int Track::getEffectIndex(const std::string& name) const {
 }
 
 void Track::processEffects(juce::AudioBuffer<float>& buffer) {
-    for (const auto& effect : effects) {
-        if (effect && effect->enabled()) {
-            effect->processAudio(buffer);
+    forEachAutomationSegment(buffer.getNumSamples(), [this, &buffer](int start, int length) {
+        // Referencing view, no allocation for up to 32 channels
+        juce::AudioBuffer<float> segment(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, length);
+        for (const auto& effect : effects) {
+            if (effect && effect->enabled()) {
+                effect->processAudio(segment);
+            }
         }
-    }
+    });
 }
 
 bool Track::moveEffect(int fromIndex, int toIndex) {
@@ -154,16 +241,22 @@ bool Track::moveEffect(int fromIndex, int toIndex) {
         return false;
     }
     
-    std::unique_ptr<Effect> effect = std::move(effects[fromIndex]);
-    effects.erase(effects.begin() + fromIndex);
-    effects.insert(effects.begin() + toIndex, std::move(effect));
+    editRendered([this, fromIndex, toIndex] {
+        std::unique_ptr<Effect> effect = std::move(effects[fromIndex]);
+        effects.erase(effects.begin() + fromIndex);
+        effects.insert(effects.begin() + toIndex, std::move(effect));
+    });
     updateEffectIndices();
     
     return true;
 }
 
 void Track::clearEffects() {
-    effects.clear();
+    std::vector<std::unique_ptr<Effect>> removed;
+    editRendered([this, &removed] { removed.swap(effects); });
+    retireEffects(std::move(removed));
+    effectsStateNode.invalidate();
+    automationChanged();
 }
 
 void Track::updateEffectIndices() {
@@ -172,6 +265,227 @@ void Track::updateEffectIndices() {
             effects[i]->setIndex(static_cast<int>(i));
         }
     }
+    effectsStateNode.invalidate();
+
+    // Effect lanes are keyed by chain position
+    automationChanged();
+}
+
+std::unique_ptr<AutomationLanes> Track::compileAutomation() const {
+    auto lanes = std::make_unique<AutomationLanes>();
+
+    auto addLane = [&lanes](const std::vector<AutomationPoint>& source, AutomationLane::Target target,
+                            int effectIndex, int parameterIndex) {
+        AutomationLane lane;
+        lane.target = target;
+        lane.effectIndex = effectIndex;
+        lane.parameterIndex = parameterIndex;
+
+        // Points before zero hold the parameter's resting value and are not on the timeline
+        for (const auto& point : source) {
+            if (point.time >= 0.0) {
+                lane.points.push_back({ point.time, point.value, point.curve });
+            }
+        }
+        if (lane.points.empty()) {
+            return;
+        }
+
+        std::stable_sort(lane.points.begin(), lane.points.end(),
+                         [](const AutomationLane::Point& a, const AutomationLane::Point& b) { return a.time < b.time; });
+        lanes->push_back(std::move(lane));
+    };
+
+    auto trackIt = automationData.find("Track");
+    if (trackIt != automationData.end()) {
+        auto volumeIt = trackIt->second.find("Volume");
+        if (volumeIt != trackIt->second.end()) {
+            addLane(volumeIt->second, AutomationLane::Target::TrackVolume, -1, -1);
+        }
+        auto panIt = trackIt->second.find("Pan");
+        if (panIt != trackIt->second.end()) {
+            addLane(panIt->second, AutomationLane::Target::TrackPan, -1, -1);
+        }
+    }
+
+    // Resolve "<effect>_<index>" / parameter name keys to indices once, here
+    for (size_t i = 0; i < effects.size(); ++i) {
+        const auto& effect = effects[i];
+        if (!effect) continue;
+
+        auto it = automationData.find(effect->getName() + "_" + std::to_string(i));
+        if (it == automationData.end()) continue;
+
+        const auto& params = effect->getAllParameters();
+        for (int p = 0; p < params.size(); ++p) {
+            auto* ap = params[p];
+            if (!ap) continue;
+
+            auto pit = it->second.find(ap->getName(256).toStdString());
+            if (pit != it->second.end()) {
+                addLane(pit->second, AutomationLane::Target::EffectParameter, static_cast<int>(i), p);
+            }
+        }
+    }
+
+    return lanes;
+}
+
+void Track::reclaimAutomation() {
+    AutomationLanes* finished = nullptr;
+    while (retiredAutomationQueue.pop(finished)) {
+        delete finished;
+    }
+
+    if (automationDirty) {
+        unpublishedAutomation = compileAutomation();
+        automationDirty = false;
+    }
+
+    if (unpublishedAutomation && automationQueue.push(unpublishedAutomation.get())) {
+        unpublishedAutomation.release();
+    }
+}
+
+void Track::applyAutomation(double positionSeconds, int numSamples, double sampleRate) {
+    AutomationLanes* incoming = nullptr;
+    while (automationQueue.pop(incoming)) {
+        if (activeAutomation && !retiredAutomationQueue.push(activeAutomation)) {
+            // Cannot happen while the return queue is deeper than the publish queue
+            jassertfalse;
+        }
+        activeAutomation = incoming;
+    }
+
+    automationRampsActive = false;
+    numAutomationSplits = 0;
+    automationBlockStart = positionSeconds;
+    automationSampleRate = sampleRate;
+    automationBlockSamples = numSamples;
+
+    if (!activeAutomation) {
+        return;
+    }
+
+    const double blockEnd = positionSeconds + numSamples / sampleRate;
+    AutomationLane* volumeLane = nullptr;
+    AutomationLane* panLane = nullptr;
+
+    for (auto& lane : *activeAutomation) {
+        const float automatedValue = lane.valueAt(positionSeconds);
+
+        switch (lane.target) {
+            case AutomationLane::Target::TrackVolume:
+                volumeDb = floatToDecibels(automationToVolumeSlider(automatedValue));
+                volumeLane = &lane;
+                break;
+
+            case AutomationLane::Target::TrackPan:
+                pan = juce::jlimit(-1.0f, 1.0f, (automatedValue * 2.0f) - 1.0f);
+                panLane = &lane;
+                break;
+
+            case AutomationLane::Target::EffectParameter:
+                // The chain may have changed since these lanes were compiled
+                if (lane.effectIndex < static_cast<int>(effects.size()) && effects[static_cast<size_t>(lane.effectIndex)]) {
+                    effects[static_cast<size_t>(lane.effectIndex)]->setParameter(lane.parameterIndex, automatedValue);
+                    lane.forEachPointWithin(positionSeconds, blockEnd, [&](double time) {
+                        addAutomationSplit(static_cast<int>(std::lround((time - positionSeconds) * sampleRate)));
+                    });
+                }
+                break;
+        }
+    }
+
+    // Without room for the ramps the block falls back to the start values
+    if ((volumeLane || panLane) && numSamples <= automationRamps.getNumSamples()) {
+        fillAutomationRamps(volumeLane, panLane, positionSeconds, numSamples, sampleRate);
+        automationRampsActive = true;
+    }
+}
+
+void Track::prepareAutomation(int maxBlockSize) {
+    automationRamps.setSize(NumAutomationRamps, juce::jmax(1, maxBlockSize), false, true, true);
+}
+
+void Track::fillAutomationRamps(AutomationLane* volumeLane, AutomationLane* panLane,
+                                double positionSeconds, int numSamples, double sampleRate) {
+    auto gainsAt = [this, volumeLane, panLane](double time, float* gains) {
+        const float gain = volumeLane
+            ? juce::Decibels::decibelsToGain(floatToDecibels(automationToVolumeSlider(volumeLane->valueAt(time))))
+            : juce::Decibels::decibelsToGain(volumeDb);
+        const float p = panLane ? juce::jlimit(-1.0f, 1.0f, panLane->valueAt(time) * 2.0f - 1.0f) : pan;
+
+        gains[GainRamp] = gain;
+        gains[MonoLeftRamp] = std::sqrt((1.0f - p) / 2.0f) * gain;
+        gains[MonoRightRamp] = std::sqrt((1.0f + p) / 2.0f) * gain;
+        gains[StereoLeftRamp] = gain * (1.0f - juce::jmax(0.0f, p));
+        gains[StereoRightRamp] = gain * (1.0f + juce::jmin(0.0f, p));
+    };
+
+    // Exact values every automationRampStep samples, straight lines in between
+    float from[NumAutomationRamps];
+    float to[NumAutomationRamps];
+    gainsAt(positionSeconds, from);
+
+    for (int start = 0; start < numSamples; start += automationRampStep) {
+        const int length = juce::jmin(automationRampStep, numSamples - start);
+        gainsAt(positionSeconds + (start + length) / sampleRate, to);
+
+        for (int ramp = 0; ramp < NumAutomationRamps; ++ramp) {
+            fillLinearRamp(automationRamps.getWritePointer(ramp, start), from[ramp], to[ramp], length);
+            from[ramp] = to[ramp];
+        }
+    }
+}
+
+void Track::addAutomationSplit(int sampleOffset) {
+    if (sampleOffset <= 0 || sampleOffset >= automationBlockSamples || numAutomationSplits >= maxAutomationSplits) {
+        return;
+    }
+
+    // Keep the offsets sorted and unique; there are only ever a handful
+    int i = 0;
+    while (i < numAutomationSplits && automationSplits[static_cast<size_t>(i)] < sampleOffset) {
+        ++i;
+    }
+    if (i < numAutomationSplits && automationSplits[static_cast<size_t>(i)] == sampleOffset) {
+        return;
+    }
+
+    for (int j = numAutomationSplits; j > i; --j) {
+        automationSplits[static_cast<size_t>(j)] = automationSplits[static_cast<size_t>(j - 1)];
+    }
+    automationSplits[static_cast<size_t>(i)] = sampleOffset;
+    ++numAutomationSplits;
+}
+
+void Track::setEffectAutomation(double positionSeconds) {
+    if (!activeAutomation) {
+        return;
+    }
+
+    for (auto& lane : *activeAutomation) {
+        if (lane.target == AutomationLane::Target::EffectParameter
+            && lane.effectIndex < static_cast<int>(effects.size()) && effects[static_cast<size_t>(lane.effectIndex)]) {
+            effects[static_cast<size_t>(lane.effectIndex)]->setParameter(lane.parameterIndex, lane.valueAt(positionSeconds));
+        }
+    }
+}
+
+void Track::applyTrackGain(juce::AudioBuffer<float>& buffer, int numSamples) {
+    if (muted) {
+        buffer.clear();
+        return;
+    }
+
+    if (automationRampsActive && numSamples == automationBlockSamples) {
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch) {
+            applyAutomationRamp(buffer, ch, GainRamp, 0, numSamples);
+        }
+    } else {
+        buffer.applyGain(0, numSamples, juce::Decibels::decibelsToGain(volumeDb));
+    }
 }
 
 void Track::updateParameterTracking() {
@@ -200,6 +514,7 @@ void Track::updateParameterTracking() {
             if (std::abs(currentValue - lastValue) > 0.001f) {
                 potentialAutomation = {effectKey, paramName};
                 hasActivePotentialAutomation = true;
+                parametersMovedSinceFreezeCheck = true;
                 lastParameterValues[effectKey][paramName] = currentValue;
                 return;
             }
@@ -264,3 +579,183 @@ void Track::clearPotentialAutomation() {
 bool Track::hasPotentialAutomation() const {
     return hasActivePotentialAutomation || (!potentialAutomation.first.empty() && !potentialAutomation.second.empty());
 }
+
+std::unique_ptr<AudioClip> Track::setFrozenClip(std::unique_ptr<AudioClip> clip, std::uint64_t fingerprint) {
+    std::swap(frozenClip, clip);
+    freezeFingerprint = frozenClip ? fingerprint : 0;
+    return clip;
+}
+
+std::vector<std::pair<int, int>> Track::getAutomatedEffectParameters() const {
+    std::vector<std::pair<int, int>> automated;
+    for (const auto& lane : *compileAutomation()) {
+        if (lane.target == AutomationLane::Target::EffectParameter) {
+            automated.emplace_back(lane.effectIndex, lane.parameterIndex);
+        }
+    }
+    return automated;
+}
+
+std::uint64_t Track::computeFreezeFingerprint() const {
+    StateHasher hasher;
+
+    // The compiled lanes say what playback will do, independent of map order
+    const auto lanes = compileAutomation();
+    bool volumeAutomated = false;
+    bool panAutomated = false;
+    for (const auto& lane : *lanes) {
+        volumeAutomated = volumeAutomated || lane.target == AutomationLane::Target::TrackVolume;
+        panAutomated = panAutomated || lane.target == AutomationLane::Target::TrackPan;
+        hasher.add(lane.target);
+        hasher.add(lane.effectIndex);
+        hasher.add(lane.parameterIndex);
+        for (const auto& point : lane.points) {
+            hasher.add(point);
+        }
+    }
+
+    if (!volumeAutomated) hasher.add(faderVolumeDb);
+    if (!panAutomated) hasher.add(faderPan);
+
+    for (size_t i = 0; i < effects.size(); ++i) {
+        const auto& effect = effects[i];
+        if (!effect) continue;
+
+        hasher.add(effect->getVSTPath());
+        hasher.add(effect->enabled());
+        for (int p = 0; p < effect->getNumParameters(); ++p) {
+            const bool automated = std::any_of(lanes->begin(), lanes->end(), [i, p](const AutomationLane& lane) {
+                return lane.effectIndex == static_cast<int>(i) && lane.parameterIndex == p;
+            });
+            if (!automated) {
+                hasher.add(effect->getParameter(p));
+            }
+        }
+    }
+
+    hashFreezeContent(hasher);
+    return hasher.get();
+}
+
+bool Track::takeFreezeInputsChanged() {
+    const auto stateHash = getStateHash();
+    const bool changed = parametersMovedSinceFreezeCheck || stateHash != freezeCheckedStateHash;
+    freezeCheckedStateHash = stateHash;
+    parametersMovedSinceFreezeCheck = false;
+    return changed;
+}
+
+std::uint64_t Track::getStateHash(std::vector<std::string>* changedSubtrees) const {
+    return stateNode.get([this, changedSubtrees] {
+        StateHasher hasher;
+        auto addSubtree = [&hasher, changedSubtrees](StateHashNode& node, const char* subtreeName, auto&& hashContent) {
+            const auto changesBefore = node.getChangeCount();
+            hasher.add(node.get([&hashContent] {
+                StateHasher subtreeHasher;
+                hashContent(subtreeHasher);
+                return subtreeHasher.get();
+            }));
+            if (changedSubtrees && node.getChangeCount() != changesBefore) {
+                changedSubtrees->push_back(subtreeName);
+            }
+        };
+
+        addSubtree(settingsStateNode, "settings", [this](StateHasher& h) {
+            h.add(name);
+            h.add(getType());
+            h.add(faderVolumeDb);
+            h.add(faderPan);
+            h.add(muted);
+            h.add(soloed);
+        });
+
+        addSubtree(clipsStateNode, "clips", [this](StateHasher& h) {
+            hashClipState(h);
+        });
+
+        // Live parameter values are left out: automation moves them during playback
+        addSubtree(effectsStateNode, "effects", [this](StateHasher& h) {
+            for (const auto& effect : effects) {
+                if (!effect) continue;
+                h.add(effect->getVSTPath());
+                h.add(effect->getName());
+                h.add(effect->enabled());
+            }
+        });
+
+        // What the project saves: points at negative times are defaults and aren't saved
+        addSubtree(automationStateNode, "automation", [this](StateHasher& h) {
+            std::vector<std::pair<const std::string*, const std::string*>> keys;
+            for (const auto& [effectName, parameterMap] : automationData) {
+                for (const auto& entry : parameterMap) {
+                    keys.emplace_back(&effectName, &entry.first);
+                }
+            }
+            std::sort(keys.begin(), keys.end(), [](const auto& a, const auto& b) {
+                return std::tie(*a.first, *a.second) < std::tie(*b.first, *b.second);
+            });
+            for (const auto& [effectName, parameterName] : keys) {
+                const auto& points = automationData.at(*effectName).at(*parameterName);
+                h.add(*effectName);
+                h.add(*parameterName);
+                for (const auto& point : points) {
+                    if (point.time >= 0.0) {
+                        h.add(point);
+                    }
+                }
+            }
+            for (const auto& [effectName, parameterName] : automatedParameters) {
+                h.add(effectName);
+                h.add(parameterName);
+            }
+        });
+
+        return hasher.get();
+    });
+}
+
+bool Track::cueStreams(double playheadSeconds, double sampleRate) {
+    if (!frozenClip || !frozenClip->stream || !frozenClip->pollAudioData(sampleRate)) {
+        return true;
+    }
+
+    // Same position processFrozen reads from
+    const auto clipPosition = static_cast<juce::int64>(std::llround((playheadSeconds - frozenClip->startTime) * sampleRate));
+    frozenClip->stream->cue(std::max<juce::int64>(0, clipPosition));
+    return frozenClip->stream->isCued();
+}
+
+bool Track::processFrozen(double playheadSeconds, juce::AudioBuffer<float>& output, int numSamples, double sampleRate) {
+    if (!frozenClip) {
+        return false;
+    }
+
+    output.clear(0, numSamples);
+    const auto& clip = *frozenClip;
+    if (muted || !clip.pollAudioData(sampleRate)) {
+        return true;
+    }
+
+    // The render already carries the plugins, the fader and the automation
+    const auto clipPosition = static_cast<juce::int64>(std::llround((playheadSeconds - clip.startTime) * sampleRate));
+    const auto outputStart = std::max<juce::int64>(0, -clipPosition);
+    const auto readStart = clipPosition + outputStart;
+    const auto numToRead = std::min<juce::int64>(numSamples - outputStart, clip.getNumLoadedSamples(sampleRate) - readStart);
+    if (numToRead <= 0) {
+        return true;
+    }
+
+    // Refers to output's channels; no allocation for any sane channel count
+    juce::AudioBuffer<float> dest(output.getArrayOfWritePointers(), output.getNumChannels(),
+                                  static_cast<int>(outputStart), static_cast<int>(numToRead));
+    if (clip.stream) {
+        clip.stream->read(dest, readStart, static_cast<int>(numToRead));
+    } else {
+        const auto& source = *clip.getLoadedBuffer(sampleRate);
+        for (int ch = 0; ch < dest.getNumChannels(); ++ch) {
+            dest.copyFrom(ch, 0, source, juce::jmin(ch, source.getNumChannels() - 1),
+                          static_cast<int>(readStart), static_cast<int>(numToRead));
+        }
+    }
+    return true;
+}
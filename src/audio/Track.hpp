@@ -3,14 +3,22 @@
 #include <juce_core/juce_core.h>
 #include <juce_audio_basics/juce_audio_basics.h>
 
+#include <array>
+#include <functional>
 #include <string>
 #include <vector>
 #include <memory>
 #include <limits>
+#include <cstdint>
 
 #include "Effect.hpp"
+#include "AudioScratchArena.hpp"
+#include "AutomationLane.hpp"
+#include "SpscQueue.hpp"
+#include "StateHashNode.hpp"
 
 class AudioClip;
+class StateHasher;
 
 inline float floatToDecibels(float linear, float minusInfinityDb = -100.0f) {
     constexpr double reference = 0.75;
@@ -49,7 +57,7 @@ public:
     };
 
     Track();
-    virtual ~Track() = default;
+    virtual ~Track();
 
     // Common track properties
     void setName(const std::string& name);
@@ -58,11 +66,19 @@ public:
     float getVolume() const;
     void setPan(float pan);
     float getPan() const;
+    // What setVolume and setPan last set, which automation never moves
+    float getFaderVolume() const { return faderVolumeDb; }
+    float getFaderPan() const { return faderPan; }
     
     // Common track states
-    void toggleMute() { muted = !muted; }
+    void toggleMute() { muted = !muted; settingsStateNode.invalidate(); }
     bool isMuted() const { return muted; }
-    void setSolo(bool solo) { soloed = solo; }
+    void setSolo(bool solo) {
+        if (soloed != solo) {
+            soloed = solo;
+            settingsStateNode.invalidate();
+        }
+    }
     bool isSolo() const { return soloed; }
 
     // Track type identification
@@ -71,6 +87,10 @@ public:
     // Audio processing - must be implemented by derived classes
     virtual void process(double playheadSeconds, juce::AudioBuffer<float>& outputBuffer, int numSamples, double sampleRate) = 0;
     virtual void prepareToPlay(double sampleRate, int bufferSize) = 0;
+    // Cues every streaming clip to where playback from playheadSeconds will
+    // first read it. True once the disk thread has filled them all; call it
+    // again to poll. Message thread, with the audio callback locked.
+    virtual bool cueStreams(double playheadSeconds, double sampleRate);
 
     // Audio clip management - must be implemented by derived classes
     virtual void clearClips() = 0;
@@ -81,14 +101,23 @@ public:
 
     // Effect management - common to all track types
     Effect* addEffect(const std::string& vstPath);
+    // Loads and prepares a plugin for this track without adding it to the chain
+    std::unique_ptr<Effect> createEffect(const std::string& vstPath) const;
+    // Puts newEffects in place of the chain and returns the old one. Hold the
+    // audio callback lock if the track is being rendered; load new plugins
+    // with createEffect before taking it.
+    std::vector<std::unique_ptr<Effect>> swapEffects(std::vector<std::unique_ptr<Effect>> newEffects);
     bool removeEffect(int index);
     bool removeEffect(const std::string& name);
     Effect* getEffect(int index);
     Effect* getEffect(const std::string& name);
     int getEffectIndex(const std::string& name) const;
     inline std::vector<std::unique_ptr<Effect>>& getEffects() { return effects; }
+    inline const std::vector<std::unique_ptr<Effect>>& getEffects() const { return effects; }
     int getEffectCount() const { return effects.size(); }
     
+    // Runs the chain, split into sub-blocks at plugin automation breakpoints
+    // when the block was set up by applyAutomation
     void processEffects(juce::AudioBuffer<float>& buffer);
     void updateEffectEditors() {
         for (auto& effect : effects) {
@@ -113,6 +142,7 @@ public:
         if (std::find(automatedParameters.begin(), automatedParameters.end(), paramPair) == automatedParameters.end()) {
             automatedParameters.push_back(paramPair);
         }
+        automationChanged();
     }
     
     inline const std::unordered_map<std::string, std::unordered_map<std::string, std::vector<AutomationPoint>>>& getAutomationData() const {
@@ -122,6 +152,10 @@ public:
     inline const std::vector<std::pair<std::string, std::string>>& getAutomatedParameters() const {
         return automatedParameters;
     }
+
+    // (effect index, parameter index) of each parameter playback moves, whose
+    // live value is the automation's rather than the user's
+    std::vector<std::pair<int, int>> getAutomatedEffectParameters() const;
     
     inline const std::vector<AutomationPoint>* getAutomationPoints(const std::string& effectName, const std::string& parameterName) const {
         auto effectIt = automationData.find(effectName);
@@ -162,6 +196,7 @@ public:
                             }
                         }
                     }
+                    automationChanged();
                     return true;
                 }
             }
@@ -183,6 +218,7 @@ public:
                 if (it != points.end()) {
                     it->time = newTime;
                     it->value = std::max(0.0f, std::min(1.0f, newValue));
+                    automationChanged();
                     return true;
                 }
             }
@@ -207,6 +243,7 @@ public:
                 if (it != points.end()) {
                     it->time = newTime;
                     it->value = std::max(0.0f, std::min(1.0f, newValue));
+                    automationChanged();
                     return true;
                 }
             }
@@ -239,6 +276,7 @@ public:
                             automatedParameters.end()
                         );
                     }
+                    automationChanged();
                     return true;
                 }
             }
@@ -259,6 +297,7 @@ public:
                     });
                 if (it != points.end()) {
                     it->curve = std::max(0.0f, std::min(1.0f, newCurve));
+                    automationChanged();
                     return true;
                 }
             }
@@ -281,6 +320,7 @@ public:
                     });
                 if (it != points.end()) {
                     it->curve = std::max(0.0f, std::min(1.0f, newCurve));
+                    automationChanged();
                     return true;
                 }
             }
@@ -304,6 +344,7 @@ public:
                     automationData.erase(effectIt);
                 }
                 
+                automationChanged();
                 return true;
             }
         }
@@ -319,120 +360,78 @@ public:
     
     float getCurrentParameterValue(const std::string& effectName, const std::string& parameterName) const;
 
-    inline void applyAutomation(double positionSeconds) {
-        auto getInterpolatedValue = [](const std::vector<AutomationPoint>& points, double time) -> float {
-            if (points.empty()) return -1.0f;
-            
-            std::vector<const AutomationPoint*> timelinePoints;
-            for (const auto& point : points) {
-                if (point.time >= 0.0) {
-                    timelinePoints.push_back(&point);
-                }
-            }
-            
-            if (timelinePoints.empty()) return -1.0f;
-            
-            std::sort(timelinePoints.begin(), timelinePoints.end(), 
-                [](const AutomationPoint* a, const AutomationPoint* b) {
-                    return a->time < b->time;
-                });
-            
-            if (time <= timelinePoints[0]->time) {
-                return timelinePoints[0]->value;
-            }
-            
-            if (time >= timelinePoints.back()->time) {
-                return timelinePoints.back()->value;
-            }
-            
-            for (size_t i = 0; i < timelinePoints.size() - 1; ++i) {
-                const auto* p1 = timelinePoints[i];
-                const auto* p2 = timelinePoints[i + 1];
-                
-                if (time >= p1->time && time <= p2->time) {
-                    double t = (time - p1->time) / (p2->time - p1->time);
-                    
-                    if (std::abs(p1->curve - 0.5f) < 0.001f) {
-                        return p1->value + t * (p2->value - p1->value);
-                    } else {
-                        float curve = p1->curve;
-                        float adjustedT;
-                        
-                        if (curve < 0.5f) {
-                            // Ease-in: slow start, fast end
-                            // Ultra-sharp at 0.0f (almost perfect corner)
-                            float factor = 50.0f * (0.5f - curve); // 0.0f->25.0f, 0.5f->0.0f
-                            adjustedT = std::pow(t, 1.0f + factor);
-                        } else {
-                            // Ease-out: fast start, slow end  
-                            // Ultra-sharp at 1.0f (almost perfect corner)
-                            float factor = 50.0f * (curve - 0.5f); // 0.5f->0.0f, 1.0f->25.0f
-                            adjustedT = 1.0f - std::pow(1.0f - t, 1.0f + factor);
-                        }
-                        
-                        return p1->value + adjustedT * (p2->value - p1->value);
-                    }
-                }
-            }
-            
-            return -1.0f;
-        };
-        
-        auto trackIt = automationData.find("Track");
-        if (trackIt != automationData.end()) {
-            auto& trackParams = trackIt->second;
-            
-            auto volumeIt = trackParams.find("Volume");
-            if (volumeIt != trackParams.end() && !volumeIt->second.empty()) {
-                float automatedValue = getInterpolatedValue(volumeIt->second, positionSeconds);
-                if (automatedValue >= 0.0f) {
-                    float dbValue = automationToVolumeSlider(automatedValue);
-                    volumeDb = floatToDecibels(dbValue);
-                }
-            }
-            
-            // Apply Pan automation
-            auto panIt = trackParams.find("Pan");
-            if (panIt != trackParams.end() && !panIt->second.empty()) {
-                float automatedValue = getInterpolatedValue(panIt->second, positionSeconds);
-                if (automatedValue >= 0.0f) {
-                    pan = (automatedValue * 2.0f) - 1.0f;
-                    pan = juce::jlimit(-1.0f, 1.0f, pan);
-                }
-            }
-        }
+    // Evaluates the compiled automation lanes for the block starting at
+    // positionSeconds. Plugin parameters are set for the block start and the
+    // breakpoints inside it are remembered for processEffects; automated
+    // volume and pan become per-sample gain ramps. Called by whichever thread
+    // renders the track, once per block, before process().
+    void applyAutomation(double positionSeconds, int numSamples, double sampleRate);
+
+    // Frees lanes the render thread has swapped out and recompiles and
+    // publishes them if automation changed since the last call. Message
+    // thread only; the engine calls it once per UI frame.
+    void reclaimAutomation();
+
+    // Freeze: the track's post-fader output, rendered offline by the engine,
+    // played back as a single clip in place of its clips and plugins
+    bool isFrozen() const { return frozenClip != nullptr; }
+    const AudioClip* getFrozenClip() const { return frozenClip.get(); }
+    std::uint64_t getFreezeFingerprint() const { return freezeFingerprint; }
+    // Swaps the frozen render in (or out, with nullptr) and hands back the
+    // previous one to be freed. Message thread, with the audio callback locked.
+    std::unique_ptr<AudioClip> setFrozenClip(std::unique_ptr<AudioClip> clip, std::uint64_t fingerprint);
+
+    // Hash of everything a freeze bakes in: clips, plugins and their
+    // parameters, automation, volume and pan. Live values of automated
+    // parameters are left out, since playback keeps moving them.
+    std::uint64_t computeFreezeFingerprint() const;
+    // True if what computeFreezeFingerprint covers may have changed since the
+    // last call: the saved state moved in the hash tree, or
+    // updateParameterTracking saw a plugin parameter move. Ask the engine's
+    // hash tree first so its changed-subtree report isn't swallowed here.
+    bool takeFreezeInputsChanged();
+
+    // Hash of everything the track saves, as a tree of its settings, clips,
+    // effects and automation. Only the parts edited since the last call are
+    // rehashed; the names of those whose hash changed ("settings", "clips",
+    // "effects", "automation") are appended to changedSubtrees.
+    std::uint64_t getStateHash(std::vector<std::string>* changedSubtrees = nullptr) const;
+    // Edits to the track invalidate this node too
+    void setStateParent(StateHashNode* parent) const { stateNode.setParent(parent); }
+
+    // Set by the engine while it renders the track. Adding, removing or
+    // moving clips and effects then happens under lock, the one every
+    // renderer holds, and removed effects go to retireEffect to be freed once
+    // no render can reach them.
+    struct RenderHost {
+        juce::CriticalSection* lock = nullptr;
+        std::function<void(std::unique_ptr<Effect>)> retireEffect;
+    };
+    void setRenderHost(const RenderHost* host) { renderHost = host; }
 
-        for (size_t i = 0; i < effects.size(); ++i) {
-            const auto& effect = effects[i];
-            if (!effect) continue;
-            
-            auto params = effect->getAllParameters();
-            std::string effectKey = effect->getName() + "_" + std::to_string(i);
-            auto it = automationData.find(effectKey);
-            if (it != automationData.end()) {
-                auto& paramMap = it->second;
-                for (int p = 0; p < params.size(); ++p) {
-                    auto* ap = params[p];
-                    if (!ap) continue;
-                    
-                    std::string paramName = ap->getName(256).toStdString();
-                    auto pit = paramMap.find(paramName);
-                    if (pit != paramMap.end() && !pit->second.empty()) {
-                        float automatedValue = getInterpolatedValue(pit->second, positionSeconds);
-                        if (automatedValue >= 0.0f) {
-                            effect->setParameter(p, automatedValue);
-                        }
-                    }
-                }
-            }
+protected:
+    // Runs edit under the render host's lock, or straight away for a track
+    // nothing renders yet
+    template <typename Edit>
+    void editRendered(Edit&& edit) {
+        if (renderHost && renderHost->lock) {
+            const juce::ScopedLock lock(*renderHost->lock);
+            edit();
+        } else {
+            edit();
         }
     }
+    // Hands effects taken out of the chain to the render host, or frees them
+    void retireEffects(std::vector<std::unique_ptr<Effect>> removed);
 
-protected:
     // Common track data
     std::string name;
     float volumeDb = 0.0f;
     float pan = 0.0f;
+    // volumeDb and pan as the user set them; automation rewrites the two
+    // above on the audio thread, so hashes and snapshots read these
+    float faderVolumeDb = 0.0f;
+    float faderPan = 0.0f;
     bool muted = false;
     bool soloed = false;
 
@@ -440,6 +439,9 @@ protected:
     double currentSampleRate = 44100.0;
     int currentBufferSize = 512;
 
+    // Preallocated per-track scratch space, sized in prepareToPlay
+    AudioScratchArena scratchBuffers;
+
     // Effects chain
     std::vector<std::unique_ptr<Effect>> effects;
 
@@ -448,14 +450,119 @@ protected:
     
     // List of automated parameters in the order they were automated
     std::vector<std::pair<std::string, std::string>> automatedParameters;
+
+    // automationData compiled into per-parameter lanes. Rebuilt on the
+    // message thread after every automation or effect-chain edit and passed
+    // to the render thread the same way the engine passes its render state.
+    SpscQueue<AutomationLanes*, 8> automationQueue;
+    SpscQueue<AutomationLanes*, 16> retiredAutomationQueue;
+    AutomationLanes* activeAutomation = nullptr; // owned by the render thread
+    std::unique_ptr<AutomationLanes> unpublishedAutomation; // waiting for room in automationQueue
+
+    bool automationDirty = false;
+
+    // Per-sample gains for the current block, valid while automationRampsActive.
+    // Every ramp already includes the track volume; the pan laws match AudioTrack's.
+    enum AutomationRamp {
+        GainRamp,        // volume only
+        MonoLeftRamp,    // mono source, constant-power pan
+        MonoRightRamp,
+        StereoLeftRamp,  // stereo source, balance pan
+        StereoRightRamp,
+        NumAutomationRamps
+    };
+    static constexpr int automationRampStep = 32;  // samples between exact evaluations
+    static constexpr int maxAutomationSplits = 32; // plugin sub-blocks per block
+    juce::AudioBuffer<float> automationRamps;
+    bool automationRampsActive = false;
+
+    // Sample offsets in the current block where a plugin parameter lane has a breakpoint
+    std::array<int, maxAutomationSplits> automationSplits {};
+    int numAutomationSplits = 0;
+    double automationBlockStart = 0.0;
+    double automationSampleRate = 44100.0;
+    int automationBlockSamples = 0;
+
+    // Sizes automationRamps; derived classes call it from prepareToPlay
+    void prepareAutomation(int maxBlockSize);
+    void fillAutomationRamps(AutomationLane* volumeLane, AutomationLane* panLane,
+                             double positionSeconds, int numSamples, double sampleRate);
+    void addAutomationSplit(int sampleOffset);
+    void setEffectAutomation(double positionSeconds);
+
+    // Calls fn(start, length) for each sub-block of the current block, moving
+    // automated plugin parameters to the start of each one first
+    template <typename Fn>
+    void forEachAutomationSegment(int numSamples, Fn&& fn) {
+        if (numAutomationSplits == 0 || numSamples != automationBlockSamples) {
+            fn(0, numSamples);
+            return;
+        }
+
+        int segmentStart = 0;
+        for (int s = 0; s <= numAutomationSplits; ++s) {
+            const int segmentEnd = s < numAutomationSplits ? automationSplits[static_cast<size_t>(s)] : numSamples;
+            if (segmentEnd <= segmentStart) continue;
+
+            if (segmentStart > 0) {
+                setEffectAutomation(automationBlockStart + segmentStart / automationSampleRate);
+            }
+            fn(segmentStart, segmentEnd - segmentStart);
+            segmentStart = segmentEnd;
+        }
+    }
+
+    // Multiplies numSamples of a channel by one of the automation ramps, read from rampOffset on
+    void applyAutomationRamp(juce::AudioBuffer<float>& buffer, int channel, AutomationRamp ramp, int rampOffset, int numSamples) const {
+        juce::FloatVectorOperations::multiply(buffer.getWritePointer(channel),
+                                              automationRamps.getReadPointer(ramp, rampOffset), numSamples);
+    }
+
+    // Final track fader: the gain ramp when volume is automated, a flat gain otherwise
+    void applyTrackGain(juce::AudioBuffer<float>& buffer, int numSamples);
+
+    std::unique_ptr<AutomationLanes> compileAutomation() const;
+    // Marks the lanes stale; they are recompiled once on the next reclaimAutomation
+    void automationChanged() {
+        automationDirty = true;
+        automationStateNode.invalidate();
+    }
+
+    // getStateHash's tree. Every edit invalidates the node it touches; clips
+    // edited in place are caught by the MIDI fingerprint check instead.
+    mutable StateHashNode stateNode;
+    mutable StateHashNode settingsStateNode;
+    mutable StateHashNode clipsStateNode;
+    mutable StateHashNode effectsStateNode;
+    mutable StateHashNode automationStateNode;
+    // The clips, as saved, for getStateHash
+    virtual void hashClipState(StateHasher&) const {}
     
     // Parameter change detection for automation
     std::pair<std::string, std::string> potentialAutomation;
     std::unordered_map<std::string, std::unordered_map<std::string, float>> lastParameterValues;
     bool hasActivePotentialAutomation = false;
 
+    const RenderHost* renderHost = nullptr;
+
+    // Frozen render and the fingerprint it was made from
+    std::unique_ptr<AudioClip> frozenClip;
+    std::uint64_t freezeFingerprint = 0;
+    // What takeFreezeInputsChanged last looked at
+    std::uint64_t freezeCheckedStateHash = 0;
+    bool parametersMovedSinceFreezeCheck = true;
+
+    // Clip content for computeFreezeFingerprint
+    virtual void hashFreezeContent(StateHasher&) const {}
+    // Plays the frozen render into output in place of process(). False if
+    // the track isn't frozen.
+    bool processFrozen(double playheadSeconds, juce::AudioBuffer<float>& output, int numSamples, double sampleRate);
+
     // Helper method for effects management
     void updateEffectIndices();
+    // Resting points for the effect's parameters at chain position index,
+    // for every lane that doesn't have one yet
+    void addRestingAutomation(Effect& effect, size_t index);
     
     // Parameter change detection
     void detectParameterChanges();
@@ -0,0 +1,148 @@
+#include "TrackRenderPool.hpp"
+#include "../DebugConfig.hpp"
+
+#include <thread>
+
+TrackRenderPool::Worker::Worker(TrackRenderPool& owner)
+    : juce::Thread("MULO Track Render"), pool(owner) {}
+
+void TrackRenderPool::Worker::run() {
+    while (!threadShouldExit()) {
+        pool.wakeSignal.acquire();
+
+        if (threadShouldExit() || pool.shuttingDown.load(std::memory_order_acquire)) {
+            break;
+        }
+
+        while (pool.runNextJob()) {}
+    }
+}
+
+TrackRenderPool::~TrackRenderPool() {
+    stopWorkers();
+}
+
+void TrackRenderPool::setNumThreads(int numThreads) {
+    numThreads = juce::jmax(0, numThreads);
+    if (numThreads == getNumThreads()) {
+        return;
+    }
+
+    stopWorkers();
+    startWorkers(numThreads);
+}
+
+void TrackRenderPool::setUseRealtimePriority(bool shouldUseRealtime) {
+    if (useRealtimePriority == shouldUseRealtime) {
+        return;
+    }
+
+    useRealtimePriority = shouldUseRealtime;
+
+    // Restart so the new scheduling policy takes effect
+    const int numThreads = getNumThreads();
+    stopWorkers();
+    startWorkers(numThreads);
+}
+
+void TrackRenderPool::setBlockTiming(int blockSize, double sampleRate) {
+    expectedBlockSize = juce::jmax(1, blockSize);
+    expectedSampleRate = sampleRate > 0.0 ? sampleRate : 44100.0;
+}
+
+void TrackRenderPool::startWorkers(int numThreads) {
+    shuttingDown.store(false, std::memory_order_release);
+
+    for (int i = 0; i < numThreads; ++i) {
+        auto worker = std::make_unique<Worker>(*this);
+
+        bool started = false;
+        if (useRealtimePriority) {
+            auto options = juce::Thread::RealtimeOptions()
+                               .withPriority(8)
+                               .withApproximateAudioProcessingTime(expectedBlockSize, expectedSampleRate);
+            started = worker->startRealtimeThread(options);
+            if (!started) {
+                DEBUG_PRINT("[TrackRenderPool] Real-time priority refused, using high priority worker");
+            }
+        }
+
+        if (!started) {
+            started = worker->startThread(juce::Thread::Priority::highest);
+        }
+
+        if (started) {
+            workers.push_back(std::move(worker));
+        }
+    }
+
+    DEBUG_PRINT("[TrackRenderPool] Running with " << workers.size() << " worker threads");
+}
+
+void TrackRenderPool::stopWorkers() {
+    if (workers.empty()) {
+        return;
+    }
+
+    shuttingDown.store(true, std::memory_order_release);
+
+    for (auto& worker : workers) {
+        worker->signalThreadShouldExit();
+    }
+    wakeSignal.release(static_cast<std::ptrdiff_t>(workers.size()));
+
+    for (auto& worker : workers) {
+        worker->stopThread(1000);
+    }
+    workers.clear();
+
+    // Drain any wake-ups that nobody consumed
+    while (wakeSignal.try_acquire()) {}
+}
+
+void TrackRenderPool::runJobs(int numJobs, JobFunction function, void* context) {
+    if (numJobs <= 0) {
+        return;
+    }
+
+    if (workers.empty() || numJobs == 1) {
+        for (int i = 0; i < numJobs; ++i) {
+            function(context, i);
+        }
+        return;
+    }
+
+    jobFunction = function;
+    jobContext = context;
+    remainingJobs.store(numJobs, std::memory_order_relaxed);
+    work.store(static_cast<juce::uint64>(numJobs) << 32, std::memory_order_release);
+
+    const int workersToWake = juce::jmin(static_cast<int>(workers.size()), numJobs - 1);
+    wakeSignal.release(workersToWake);
+
+    while (runNextJob()) {}
+
+    // Wait for jobs still in flight on the workers
+    while (remainingJobs.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+}
+
+bool TrackRenderPool::runNextJob() {
+    auto current = work.load(std::memory_order_acquire);
+
+    for (;;) {
+        const auto numJobs = static_cast<juce::uint32>(current >> 32);
+        const auto index = static_cast<juce::uint32>(current & 0xffffffffu);
+
+        if (index >= numJobs) {
+            return false;
+        }
+
+        if (work.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            jobFunction(jobContext, static_cast<int>(index));
+            remainingJobs.fetch_sub(1, std::memory_order_acq_rel);
+            return true;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <atomic>
+#include <memory>
+#include <semaphore>
+#include <vector>
+
+// TrackRenderPool - fans independent per-track render jobs out over a set of
+// worker threads. The calling (device) thread always takes part in the work,
+// so a pool with zero workers renders exactly like the old serial loop.
+class TrackRenderPool {
+public:
+    TrackRenderPool() = default;
+    ~TrackRenderPool();
+
+    // 0 disables the workers. Must not be called while run() is in progress;
+    // the engine sets up a new pool and swaps it in between blocks instead.
+    void setNumThreads(int numThreads);
+    int getNumThreads() const { return static_cast<int>(workers.size()); }
+
+    // Ask for SCHED_RR workers on Linux (and the platform equivalent elsewhere).
+    // Falls back to a normal high priority thread if the OS refuses.
+    void setUseRealtimePriority(bool shouldUseRealtime);
+    bool isUsingRealtimePriority() const { return useRealtimePriority; }
+
+    void setBlockTiming(int blockSize, double sampleRate);
+
+    // Calls fn(index) once for every index in [0, numJobs) and returns when
+    // all of them have finished. Allocation-free, safe to call from the audio thread.
+    template <typename Fn>
+    void run(int numJobs, Fn& fn) {
+        runJobs(numJobs, [](void* context, int index) { (*static_cast<Fn*>(context))(index); }, &fn);
+    }
+
+private:
+    using JobFunction = void (*)(void*, int);
+
+    class Worker : public juce::Thread {
+    public:
+        explicit Worker(TrackRenderPool& owner);
+        void run() override;
+
+    private:
+        TrackRenderPool& pool;
+    };
+
+    void runJobs(int numJobs, JobFunction function, void* context);
+    bool runNextJob();
+    void startWorkers(int numThreads);
+    void stopWorkers();
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::counting_semaphore<> wakeSignal { 0 };
+    std::atomic<bool> shuttingDown { false };
+
+    // Job counter packed as (numJobs << 32 | nextIndex) so a late worker can
+    // never claim an index from a previous block against a new job count.
+    std::atomic<juce::uint64> work { 0 };
+    std::atomic<int> remainingJobs { 0 };
+    JobFunction jobFunction = nullptr;
+    void* jobContext = nullptr;
+
+    bool useRealtimePriority = true;
+    int expectedBlockSize = 512;
+    double expectedSampleRate = 44100.0;
+};
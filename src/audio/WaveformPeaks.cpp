@@ -0,0 +1,362 @@
+#include "WaveformPeaks.hpp"
+#include "../DebugConfig.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    constexpr char sidecarMagic[4] = { 'M', 'P', 'K', 'S' };
+    constexpr std::int64_t maxTopLevelPeaks = 64;
+    constexpr int maxChannels = 64;
+    constexpr int maxLevels = 48;
+
+    // Rounded outwards, so a quiet passage never draws as silence
+    std::int8_t quantizeMin(float value) {
+        return static_cast<std::int8_t>(juce::jlimit(-127.f, 127.f, std::floor(value * 127.f)));
+    }
+
+    std::int8_t quantizeMax(float value) {
+        return static_cast<std::int8_t>(juce::jlimit(-127.f, 127.f, std::ceil(value * 127.f)));
+    }
+
+    std::int64_t getNumPeaksAbove(std::int64_t numPeaks) {
+        return (numPeaks + WaveformPeaks::levelRatio - 1) / WaveformPeaks::levelRatio;
+    }
+}
+
+std::int64_t WaveformPeaks::Pyramid::getSamplesPerPeak(int level) const {
+    std::int64_t samplesPerPeak = baseSamplesPerPeak;
+    for (int i = 0; i < level; ++i) {
+        samplesPerPeak *= levelRatio;
+    }
+    return samplesPerPeak;
+}
+
+int WaveformPeaks::Pyramid::chooseLevel(double samplesPerPixel) const {
+    int level = 0;
+    while (level + 1 < getNumLevels() && static_cast<double>(getSamplesPerPeak(level + 1)) <= samplesPerPixel) {
+        ++level;
+    }
+    return level;
+}
+
+WaveformPeaks::Range WaveformPeaks::Pyramid::getRange(int level, std::int64_t startSample, std::int64_t endSample, int channel) const {
+    Range range;
+    if (levels.empty() || channel >= numChannels) return range;
+
+    level = juce::jlimit(0, getNumLevels() - 1, level);
+    const Level& peaksAtLevel = levels[static_cast<std::size_t>(level)];
+    const std::int64_t samplesPerPeak = getSamplesPerPeak(level);
+
+    const std::int64_t first = std::max<std::int64_t>(0, startSample) / samplesPerPeak;
+    if (first >= peaksAtLevel.numPeaks) return range;
+    const std::int64_t last = juce::jlimit(first + 1, peaksAtLevel.numPeaks, (endSample + samplesPerPeak - 1) / samplesPerPeak);
+
+    const int firstChannel = channel < 0 ? 0 : channel;
+    const int endChannel = channel < 0 ? numChannels : channel + 1;
+    const std::int8_t* data = peaks + peaksAtLevel.offset;
+
+    int low = 127;
+    int high = -127;
+    for (std::int64_t peak = first; peak < last; ++peak) {
+        const std::int8_t* pair = data + peak * numChannels * 2;
+        for (int ch = firstChannel; ch < endChannel; ++ch) {
+            low = std::min<int>(low, pair[ch * 2]);
+            high = std::max<int>(high, pair[ch * 2 + 1]);
+        }
+    }
+
+    range.min = static_cast<float>(low) / 127.f;
+    range.max = static_cast<float>(high) / 127.f;
+    return range;
+}
+
+WaveformPeaks::WaveformPeaks()
+    : buildThreads(juce::ThreadPoolOptions{}
+                       .withThreadName("MULO Waveform Peaks")
+                       .withNumberOfThreads(juce::jmax(1, juce::SystemStats::getNumCpus() / 4))) {
+    formatManager.registerBasicFormats();
+}
+
+WaveformPeaks::~WaveformPeaks() {
+    buildThreads.removeAllJobs(true, 5000);
+}
+
+void WaveformPeaks::setFallbackDirectory(const juce::File& directory) {
+    const juce::ScopedLock sl(lock);
+    fallbackDirectory = directory;
+}
+
+juce::File WaveformPeaks::getSidecarFile(const juce::File& audioFile) const {
+    return audioFile.getSiblingFile(audioFile.getFileName() + ".peaks");
+}
+
+juce::File WaveformPeaks::getFallbackSidecarFile(const juce::File& audioFile) const {
+    const juce::ScopedLock sl(lock);
+    if (fallbackDirectory == juce::File()) return {};
+
+    // The path's hash keeps same-named files in different folders apart
+    return fallbackDirectory.getChildFile(audioFile.getFileName() + "-"
+        + juce::String::toHexString(audioFile.getFullPathName().hashCode64()) + ".peaks");
+}
+
+WaveformPeaks::SharedPyramid WaveformPeaks::get(const juce::File& audioFile) {
+    const std::string key = audioFile.getFullPathName().toStdString();
+    if (key.empty()) return nullptr;
+
+    const juce::uint32 now = juce::Time::getMillisecondCounter();
+    {
+        const juce::ScopedLock sl(lock);
+        auto entry = entries.find(key);
+        if (entry != entries.end() && now - entry->second.lastChecked < recheckIntervalMs) {
+            return entry->second.pyramid;
+        }
+    }
+
+    // Stat'ed outside the lock, so a slow disk only holds up its own caller
+    const std::int64_t sourceSize = audioFile.getSize();
+    const std::int64_t sourceModified = audioFile.getLastModificationTime().toMilliseconds();
+    {
+        const juce::ScopedLock sl(lock);
+        auto entry = entries.find(key);
+        if (entry != entries.end()) {
+            if (entry->second.sourceSize == sourceSize && entry->second.sourceModified == sourceModified) {
+                entry->second.lastChecked = now;
+                return entry->second.pyramid;
+            }
+            // Rewritten since; a build still running for it is discarded
+            // when it finishes, and the sidecar fails readSidecar's check
+            entries.erase(entry);
+        }
+    }
+
+    if (!audioFile.existsAsFile()) return nullptr;
+
+    // Mapping a sidecar only reads its header, so it is fine on the UI thread
+    auto fromSidecar = readSidecar(getSidecarFile(audioFile), audioFile);
+    if (!fromSidecar) {
+        const juce::File fallback = getFallbackSidecarFile(audioFile);
+        if (fallback != juce::File()) fromSidecar = readSidecar(fallback, audioFile);
+    }
+
+    const juce::ScopedLock sl(lock);
+    auto [entry, inserted] = entries.try_emplace(key);
+    if (!inserted) return entry->second.pyramid;
+
+    entry->second.sourceSize = sourceSize;
+    entry->second.sourceModified = sourceModified;
+    entry->second.lastChecked = now;
+    if (fromSidecar) {
+        entry->second.pyramid = SharedPyramid(std::move(fromSidecar));
+        return entry->second.pyramid;
+    }
+
+    entry->second.buildId = nextBuildId++;
+    const std::uint64_t buildId = entry->second.buildId;
+    buildThreads.addJob([this, audioFile, key, buildId] { runBuild(audioFile, key, buildId); });
+    return nullptr;
+}
+
+void WaveformPeaks::invalidate(const juce::File& audioFile) {
+    const juce::ScopedLock sl(lock);
+    entries.erase(audioFile.getFullPathName().toStdString());
+}
+
+void WaveformPeaks::clear() {
+    const juce::ScopedLock sl(lock);
+    entries.clear();
+}
+
+void WaveformPeaks::runBuild(const juce::File& audioFile, const std::string& key, std::uint64_t buildId) {
+    // Taken before decoding, so a file rewritten mid-build fails the next check
+    const std::int64_t sourceSize = audioFile.getSize();
+    const std::int64_t sourceModified = audioFile.getLastModificationTime().toMilliseconds();
+
+    std::unique_ptr<Pyramid> built;
+    if (std::unique_ptr<juce::AudioFormatReader> reader { formatManager.createReaderFor(audioFile) }) {
+        built = build(*reader);
+    }
+
+    if (built) {
+        built->sourceSize = sourceSize;
+        built->sourceModified = sourceModified;
+
+        if (!writeSidecar(*built, getSidecarFile(audioFile))) {
+            const juce::File fallback = getFallbackSidecarFile(audioFile);
+            if (fallback == juce::File() || !fallback.getParentDirectory().createDirectory()
+                || !writeSidecar(*built, fallback)) {
+                DEBUG_PRINT("[WaveformPeaks] Couldn't save peaks for " << key);
+            }
+        }
+    } else {
+        DEBUG_PRINT("[WaveformPeaks] Couldn't read " << key);
+    }
+
+    {
+        const juce::ScopedLock sl(lock);
+        auto entry = entries.find(key);
+        // Invalidated while building; a newer build may already be running
+        if (entry != entries.end() && entry->second.buildId == buildId) {
+            entry->second.pyramid = SharedPyramid(std::move(built));
+        }
+    }
+    generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+std::unique_ptr<WaveformPeaks::Pyramid> WaveformPeaks::build(juce::AudioFormatReader& reader) {
+    const std::int64_t length = reader.lengthInSamples;
+    const int numChannels = static_cast<int>(reader.numChannels);
+    if (length <= 0 || numChannels <= 0 || numChannels > maxChannels || reader.sampleRate <= 0.0) return nullptr;
+
+    auto pyramid = std::make_unique<Pyramid>();
+    pyramid->sampleRate = reader.sampleRate;
+    pyramid->lengthInSamples = length;
+    pyramid->numChannels = numChannels;
+
+    const std::size_t bytesPerPeak = static_cast<std::size_t>(numChannels) * 2;
+    std::int64_t numPeaks = (length + baseSamplesPerPeak - 1) / baseSamplesPerPeak;
+    std::size_t totalBytes = 0;
+    while (true) {
+        pyramid->levels.push_back({ numPeaks, totalBytes });
+        totalBytes += static_cast<std::size_t>(numPeaks) * bytesPerPeak;
+        if (numPeaks <= maxTopLevelPeaks) break;
+        numPeaks = getNumPeaksAbove(numPeaks);
+    }
+    pyramid->ownedPeaks.resize(totalBytes);
+    std::int8_t* const data = pyramid->ownedPeaks.data();
+
+    // Level 0 straight from the audio, a block of peaks per read
+    constexpr int peaksPerRead = 512;
+    juce::AudioBuffer<float> buffer(numChannels, baseSamplesPerPeak * peaksPerRead);
+    std::int8_t* out = data;
+    for (std::int64_t start = 0; start < length; start += buffer.getNumSamples()) {
+        const int numSamples = static_cast<int>(std::min<std::int64_t>(buffer.getNumSamples(), length - start));
+        if (!reader.read(&buffer, 0, numSamples, start, true, true)) return nullptr;
+
+        for (int first = 0; first < numSamples; first += baseSamplesPerPeak) {
+            const int count = std::min(baseSamplesPerPeak, numSamples - first);
+            for (int ch = 0; ch < numChannels; ++ch) {
+                const auto minAndMax = juce::FloatVectorOperations::findMinAndMax(buffer.getReadPointer(ch, first), count);
+                *out++ = quantizeMin(minAndMax.getStart());
+                *out++ = quantizeMax(minAndMax.getEnd());
+            }
+        }
+    }
+
+    // Every other level from the one below it
+    for (std::size_t level = 1; level < pyramid->levels.size(); ++level) {
+        const Pyramid::Level& below = pyramid->levels[level - 1];
+        const Pyramid::Level& current = pyramid->levels[level];
+        const std::int8_t* source = data + below.offset;
+        std::int8_t* target = data + current.offset;
+
+        for (std::int64_t peak = 0; peak < current.numPeaks; ++peak) {
+            const std::int64_t first = peak * levelRatio;
+            const std::int64_t last = std::min<std::int64_t>(first + levelRatio, below.numPeaks);
+            for (int ch = 0; ch < numChannels; ++ch) {
+                std::int8_t low = 127;
+                std::int8_t high = -127;
+                for (std::int64_t i = first; i < last; ++i) {
+                    low = std::min(low, source[(i * numChannels + ch) * 2]);
+                    high = std::max(high, source[(i * numChannels + ch) * 2 + 1]);
+                }
+                *target++ = low;
+                *target++ = high;
+            }
+        }
+    }
+
+    pyramid->peaks = data;
+    return pyramid;
+}
+
+// ["MPKS"][int32 version][int64 source size][int64 source mtime, ms]
+// [double sample rate][int64 length][int32 channels][int32 base samples per
+// peak][int32 level ratio][int32 levels][int64 peaks per level...][peaks]
+// Little-endian throughout.
+bool WaveformPeaks::writeSidecar(const Pyramid& pyramid, const juce::File& sidecar) {
+    if (pyramid.levels.empty()) return false;
+
+    juce::TemporaryFile temp(sidecar);
+    {
+        juce::FileOutputStream out(temp.getFile());
+        if (!out.openedOk()) return false;
+
+        out.write(sidecarMagic, sizeof(sidecarMagic));
+        out.writeInt(formatVersion);
+        out.writeInt64(pyramid.sourceSize);
+        out.writeInt64(pyramid.sourceModified);
+        out.writeDouble(pyramid.sampleRate);
+        out.writeInt64(pyramid.lengthInSamples);
+        out.writeInt(pyramid.numChannels);
+        out.writeInt(baseSamplesPerPeak);
+        out.writeInt(levelRatio);
+        out.writeInt(pyramid.getNumLevels());
+        for (const auto& level : pyramid.levels) {
+            out.writeInt64(level.numPeaks);
+        }
+
+        const auto& top = pyramid.levels.back();
+        const std::size_t totalBytes = top.offset + static_cast<std::size_t>(top.numPeaks) * static_cast<std::size_t>(pyramid.numChannels) * 2;
+        out.write(pyramid.peaks, totalBytes);
+        out.flush();
+        if (out.getStatus().failed()) return false;
+    }
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+std::unique_ptr<WaveformPeaks::Pyramid> WaveformPeaks::readSidecar(const juce::File& sidecar, const juce::File& audioFile) {
+    if (!sidecar.existsAsFile()) return nullptr;
+
+    auto mapped = std::make_unique<juce::MemoryMappedFile>(sidecar, juce::MemoryMappedFile::readOnly);
+    if (mapped->getData() == nullptr) return nullptr;
+
+    juce::MemoryInputStream in(mapped->getData(), mapped->getSize(), false);
+    char magic[sizeof(sidecarMagic)] = {};
+    if (in.read(magic, sizeof(magic)) != static_cast<int>(sizeof(magic))
+        || std::memcmp(magic, sidecarMagic, sizeof(magic)) != 0
+        || in.readInt() != formatVersion) {
+        return nullptr;
+    }
+
+    auto pyramid = std::make_unique<Pyramid>();
+    pyramid->sourceSize = in.readInt64();
+    pyramid->sourceModified = in.readInt64();
+    if (pyramid->sourceSize != audioFile.getSize()
+        || pyramid->sourceModified != audioFile.getLastModificationTime().toMilliseconds()) {
+        return nullptr;
+    }
+
+    pyramid->sampleRate = in.readDouble();
+    pyramid->lengthInSamples = in.readInt64();
+    pyramid->numChannels = in.readInt();
+    const int samplesPerPeak = in.readInt();
+    const int ratio = in.readInt();
+    const int numLevels = in.readInt();
+    if (in.isExhausted() || pyramid->sampleRate <= 0.0 || pyramid->lengthInSamples <= 0
+        || pyramid->numChannels <= 0 || pyramid->numChannels > maxChannels
+        || samplesPerPeak != baseSamplesPerPeak || ratio != levelRatio
+        || numLevels <= 0 || numLevels > maxLevels) {
+        return nullptr;
+    }
+
+    // Each level has to be the one build() would have made, or getRange could read past the end
+    const std::size_t bytesPerPeak = static_cast<std::size_t>(pyramid->numChannels) * 2;
+    std::int64_t expectedPeaks = (pyramid->lengthInSamples + baseSamplesPerPeak - 1) / baseSamplesPerPeak;
+    std::size_t totalBytes = 0;
+    for (int level = 0; level < numLevels; ++level) {
+        const std::int64_t numPeaks = in.readInt64();
+        if (numPeaks != expectedPeaks) return nullptr;
+        pyramid->levels.push_back({ numPeaks, totalBytes });
+        totalBytes += static_cast<std::size_t>(numPeaks) * bytesPerPeak;
+        expectedPeaks = getNumPeaksAbove(numPeaks);
+    }
+
+    const auto dataStart = static_cast<std::size_t>(in.getPosition());
+    if (dataStart + totalBytes != mapped->getSize()) return nullptr;
+
+    pyramid->peaks = static_cast<const std::int8_t*>(mapped->getData()) + dataStart;
+    pyramid->mappedFile = std::move(mapped);
+    return pyramid;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// WaveformPeaks - process-wide cache of the min/max peak pyramids the
+// timeline draws audio from. Level 0 of a pyramid holds each channel's
+// lowest and highest sample over every baseSamplesPerPeak samples, as signed
+// bytes; each level above covers levelRatio peaks of the one below, up to a
+// top level of a few dozen peaks. A view picks the level that matches its
+// zoom, so drawing costs the same at any zoom and never touches the audio.
+// Pyramids are built on the cache's own background threads and kept in a
+// "<file>.peaks" sidecar next to the audio (or in the fallback directory
+// when that isn't writable), which is only reused while the audio file's
+// size and modification time still match the ones it was built from. A
+// pyramid in memory is held to the same test: the file is stat'ed again at
+// most once per recheck interval, and a pyramid for an older version of it
+// is dropped and rebuilt.
+class WaveformPeaks {
+public:
+    static constexpr int formatVersion = 1;
+    static constexpr juce::uint32 recheckIntervalMs = 1000;
+    static constexpr int baseSamplesPerPeak = 128;
+    static constexpr int levelRatio = 4;
+
+    // Sample values, -1 to 1
+    struct Range {
+        float min = 0.f;
+        float max = 0.f;
+    };
+
+    // A finished pyramid; immutable, safe to read from any thread
+    class Pyramid {
+    public:
+        double getSampleRate() const { return sampleRate; }
+        std::int64_t getLengthInSamples() const { return lengthInSamples; }
+        double getLengthInSeconds() const { return sampleRate > 0.0 ? static_cast<double>(lengthInSamples) / sampleRate : 0.0; }
+        int getNumChannels() const { return numChannels; }
+        int getNumLevels() const { return static_cast<int>(levels.size()); }
+        std::int64_t getSamplesPerPeak(int level) const;
+
+        // The coarsest level that still has a peak for every samplesPerPixel
+        int chooseLevel(double samplesPerPixel) const;
+
+        // Lowest and highest sample in [startSample, endSample) as `level`
+        // sees it; a range shorter than one peak gets the peak it starts in.
+        // channel -1 covers every channel.
+        Range getRange(int level, std::int64_t startSample, std::int64_t endSample, int channel = -1) const;
+
+    private:
+        friend class WaveformPeaks;
+
+        struct Level {
+            std::int64_t numPeaks = 0;
+            std::size_t offset = 0; // into peaks, in bytes
+        };
+
+        // The audio file as it was when the pyramid was built from it
+        std::int64_t sourceSize = 0;
+        std::int64_t sourceModified = 0;
+
+        double sampleRate = 0.0;
+        std::int64_t lengthInSamples = 0;
+        int numChannels = 0;
+        std::vector<Level> levels;
+
+        // [min, max] per channel per peak, level after level. Points into
+        // mappedFile when read from a sidecar, ownedPeaks when just built.
+        const std::int8_t* peaks = nullptr;
+        std::vector<std::int8_t> ownedPeaks;
+        std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    };
+    using SharedPyramid = std::shared_ptr<const Pyramid>;
+
+    static WaveformPeaks& getInstance() {
+        static WaveformPeaks instance;
+        return instance;
+    }
+
+    // Where sidecars go for audio in folders that can't be written to
+    void setFallbackDirectory(const juce::File& directory);
+
+    // The file's pyramid if it is in memory or has a current sidecar.
+    // Otherwise nullptr, and the pyramid is built in the background;
+    // getGeneration() moves on when it is ready. Never blocks on decoding.
+    // A file changed since its pyramid was built gets nullptr and a rebuild.
+    SharedPyramid get(const juce::File& audioFile);
+
+    // Bumped every time a background build finishes
+    std::uint64_t getGeneration() const { return generation.load(std::memory_order_acquire); }
+
+    // Forgets the file's pyramid so the next get() looks at its sidecar
+    // again, without waiting out the recheck interval, e.g. after writing it
+    void invalidate(const juce::File& audioFile);
+    // Forgets every pyramid in memory; sidecars stay
+    void clear();
+
+    // The whole pyramid for a file, decoded on the calling thread
+    static std::unique_ptr<Pyramid> build(juce::AudioFormatReader& reader);
+    static bool writeSidecar(const Pyramid& pyramid, const juce::File& sidecar);
+    // nullptr unless the sidecar is intact and was built from the file as it is now
+    static std::unique_ptr<Pyramid> readSidecar(const juce::File& sidecar, const juce::File& audioFile);
+
+private:
+    WaveformPeaks();
+    ~WaveformPeaks();
+    WaveformPeaks(const WaveformPeaks&) = delete;
+    WaveformPeaks& operator=(const WaveformPeaks&) = delete;
+
+    struct Entry {
+        SharedPyramid pyramid;  // null while building, and for files that can't be read
+        std::uint64_t buildId = 0;
+        // The audio file as get() last saw it
+        std::int64_t sourceSize = 0;
+        std::int64_t sourceModified = 0;
+        juce::uint32 lastChecked = 0; // juce::Time::getMillisecondCounter
+    };
+
+    juce::File getSidecarFile(const juce::File& audioFile) const;
+    juce::File getFallbackSidecarFile(const juce::File& audioFile) const;
+    void runBuild(const juce::File& audioFile, const std::string& key, std::uint64_t buildId);
+
+    mutable juce::CriticalSection lock;
+    std::unordered_map<std::string, Entry> entries;
+    juce::File fallbackDirectory;
+    std::uint64_t nextBuildId = 1;
+    std::atomic<std::uint64_t> generation { 0 };
+
+    juce::AudioFormatManager formatManager;
+    juce::ThreadPool buildThreads;
+};
@@ -61,6 +61,8 @@ void Application::initialise(const juce::String& commandLine) {
     exeDirectory = fs::canonical("/proc/self/exe").parent_path().string();
 #endif
     loadConfig();
+    engine.setSampleIndexFile(exeDirectory + "/sample_index.txt");
+    engine.setWaveformPeaksDirectory(exeDirectory + "/peaks");
     if (!uiState.vstDirecory.empty()) {
         engine.setVSTDirectory(uiState.vstDirecory);
     }
@@ -70,6 +72,14 @@ void Application::initialise(const juce::String& commandLine) {
         engine.setSampleDirectory(uiState.fileBrowserDirectory);
         DEBUG_PRINT("Using fileBrowserDirectory as sample directory: " << uiState.fileBrowserDirectory);
     }
+    engine.setRealtimeRenderPriority(uiState.realtimeRenderThreads);
+    engine.setRenderThreadCount(uiState.renderThreads);
+    engine.setClipStreamingThreshold(uiState.clipStreamingThresholdSeconds);
+    engine.setSamplePoolBudgetMB(uiState.samplePoolBudgetMB);
+    engine.setResamplerQuality(uiState.resamplerQuality);
+    engine.setPluginSleepAfterSilence(uiState.pluginSleepSeconds);
+    engine.setPluginsOutOfProcess(uiState.pluginsOutOfProcess);
+    engine.setPluginDatabaseFile(exeDirectory + "/plugins.json");
     
     createWindow();
     applyTheme(resources, uiState.selectedTheme);
@@ -86,6 +96,7 @@ void Application::initialise(const juce::String& commandLine) {
     
     // Initialize Firebase for marketplace functionality
     initFirebase();
+    initCollabSession();
 
     ui->setScale(uiState.uiScale);
     ui->forceUpdate();
@@ -120,6 +131,7 @@ void Application::update() {
     if (!running) return;
     
     processPendingEngineUpdates();
+    engine.reclaimRetiredState();
     handleEvents();
 
     bool rClick = isButtonPressed(mb::Right);
@@ -136,6 +148,17 @@ void Application::update() {
             component->update();
 
     updateParameterTracking();
+
+#ifdef MULO_DEBUG_AUDIO_ALLOCATIONS
+    static std::uint64_t lastAudioThreadAllocations = 0;
+    const auto audioThreadAllocations = engine.getAudioThreadAllocationCount();
+    if (audioThreadAllocations != lastAudioThreadAllocations) {
+        std::cerr << "[Audio] " << (audioThreadAllocations - lastAudioThreadAllocations)
+                  << " heap allocation(s) on the audio thread (largest "
+                  << AudioThreadAllocationGuard::getLargestAllocation() << " bytes)" << std::endl;
+        lastAudioThreadAllocations = audioThreadAllocations;
+    }
+#endif
     
     // Update window title
     std::string compositionName = engine.getCurrentCompositionName();
@@ -358,12 +381,7 @@ void Application::handleEvents() {
     }
 
     if (pendingTrackRemoveName != "") {
-        auto track = engine.getTrackByName(pendingTrackRemoveName);
-        
-        if (track)
-            track->clearEffects();
-            
-
+        // The engine tears down the track (and its plugins) once the audio thread has let go of it
         engine.removeTrackByName(pendingTrackRemoveName);
         pendingTrackRemoveName = "";
     }
@@ -1031,6 +1049,15 @@ void Application::loadConfig() {
         uiState.vstDirectories = readConfig<std::vector<std::string>>("vstDirectories", std::vector<std::string>());
         uiState.saveDirectory = readConfig<std::string>("saveDirectory", "");
         uiState.selectedTheme = readConfig<std::string>("selectedTheme", "Dark");
+        uiState.renderThreads = readConfig<int>("renderThreads", -1);
+        uiState.realtimeRenderThreads = readConfig<bool>("realtimeRenderThreads", true);
+        uiState.clipStreamingThresholdSeconds = readConfig<double>("clipStreamingThresholdSeconds", 60.0);
+        uiState.samplePoolBudgetMB = readConfig<int>("samplePoolBudgetMB", 1024);
+        uiState.resamplerQuality = readConfig<std::string>("resamplerQuality", "normal");
+        uiState.exportBitDepth = readConfig<int>("exportBitDepth", 24);
+        uiState.exportStems = readConfig<bool>("exportStems", false);
+        uiState.pluginSleepSeconds = readConfig<double>("pluginSleepSeconds", 1.0);
+        uiState.pluginsOutOfProcess = readConfig<bool>("pluginsOutOfProcess", false);
         
         DEBUG_PRINT("Configuration loaded from: " << configPath);
     } catch (const nlohmann::json::parse_error& e) {
@@ -1064,6 +1091,16 @@ MIDIClip* Application::getTimelineSelectedMIDIClip() const {
     return nullptr;
 }
 
+void Application::markMIDIClipChanged(const MIDIClip* clip) {
+    if (!clip) return;
+    for (auto& track : getAllTracks()) {
+        if (track && track->getType() == Track::TrackType::MIDI
+            && static_cast<MIDITrack*>(track.get())->markMIDIClipChanged(clip)) {
+            return;
+        }
+    }
+}
+
 void Application::setPluginTrusted(const std::string& pluginName, bool trusted) {
     // Check database
 }
@@ -1440,6 +1477,7 @@ void Application::readFromRoom(const std::string& roomName) {
 }
 
 void Application::joinRoom(const std::string& roomName) {
+    collabSession.join(roomName);
 #ifdef FIREBASE_AVAILABLE
     if (!realtimeDatabase || !auth) {
         std::cout << "Firebase not ready for collaboration" << std::endl;
@@ -1521,10 +1559,13 @@ void Application::joinRoom(const std::string& roomName) {
     });
 #else
     std::cout << "Firebase not available - mock room join: " << roomName << std::endl;
+    // No room state to wait for
+    collabSession.start();
 #endif
 }
 
 void Application::leaveRoom(const std::string& roomName) {
+    collabSession.leave();
 #ifdef FIREBASE_AVAILABLE
     if (!realtimeDatabase || !auth) {
         std::cout << "Firebase not ready for collaboration" << std::endl;
@@ -1699,6 +1740,245 @@ void Application::checkRoomEngineState(const std::string& roomName) {
 #endif
 }
 
+#ifdef FIREBASE_AVAILABLE
+namespace {
+    // A room's deltas under rooms/<room>/ops, base64 since the database holds
+    // no raw bytes. Push keys keep them in the order they were sent, and the
+    // listener collects them as they arrive, so read() never waits.
+    class FirebaseCollabBackend : public CollabBackend, private firebase::database::ChildListener {
+    public:
+        explicit FirebaseCollabBackend(firebase::database::Database* database) : database(database) {}
+
+        ~FirebaseCollabBackend() override {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!openRoom.empty()) {
+                opsReference.RemoveChildListener(this);
+            }
+        }
+
+        void open(const std::string& room) override {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!openRoom.empty()) {
+                opsReference.RemoveChildListener(this);
+            }
+            openRoom = room;
+            deltas.clear();
+            opsReference = database->GetReference(("rooms/" + room + "/ops").c_str());
+            opsReference.AddChildListener(this);
+        }
+
+        void close(const std::string& room) override {
+            std::lock_guard<std::mutex> guard(lock);
+            if (openRoom == room) {
+                opsReference.RemoveChildListener(this);
+                openRoom.clear();
+                deltas.clear();
+            }
+        }
+
+        void append(const std::string& room, const juce::MemoryBlock& delta) override {
+            auto reference = database->GetReference(("rooms/" + room + "/ops").c_str()).PushChild();
+            reference.SetValue(firebase::Variant(delta.toBase64Encoding().toStdString()));
+        }
+
+        std::vector<juce::MemoryBlock> read(const std::string& room, std::size_t from) override {
+            std::lock_guard<std::mutex> guard(lock);
+            if (room != openRoom || from >= deltas.size()) {
+                return {};
+            }
+            return std::vector<juce::MemoryBlock>(deltas.begin() + static_cast<std::ptrdiff_t>(from), deltas.end());
+        }
+
+    private:
+        void OnChildAdded(const firebase::database::DataSnapshot& snapshot, const char*) override {
+            if (!snapshot.value().is_string()) {
+                return;
+            }
+            juce::MemoryBlock delta;
+            if (delta.fromBase64Encoding(juce::String(snapshot.value().string_value()))) {
+                std::lock_guard<std::mutex> guard(lock);
+                deltas.push_back(std::move(delta));
+            }
+        }
+        void OnChildChanged(const firebase::database::DataSnapshot&, const char*) override {}
+        void OnChildMoved(const firebase::database::DataSnapshot&, const char*) override {}
+        void OnChildRemoved(const firebase::database::DataSnapshot&) override {}
+        void OnCancelled(const firebase::database::Error&, const char* message) override {
+            std::cout << "Collaboration ops listener cancelled: " << message << std::endl;
+        }
+
+        firebase::database::Database* database;
+        firebase::database::DatabaseReference opsReference;
+        std::mutex lock;
+        std::string openRoom;
+        std::vector<juce::MemoryBlock> deltas;
+    };
+}
+#endif
+
+void Application::initCollabSession() {
+#ifdef FIREBASE_AVAILABLE
+    if (realtimeDatabase) {
+        collabSession.setBackend(std::make_shared<FirebaseCollabBackend>(realtimeDatabase));
+    }
+#else
+    collabSession.setBackend(std::make_shared<FakeCollabBackend>());
+#endif
+
+    CollabSession::Callbacks callbacks;
+    callbacks.takeSnapshot = [this]() { return takeCollabSnapshot(); };
+    callbacks.saveState = [this]() { return engine.getStateBinary(); };
+    callbacks.loadState = [this](const std::vector<std::uint8_t>& state) { engine.applyStateBinary(state); };
+    callbacks.apply = [this](const CollabOp& op, const CollabClip* target) { applyCollabOp(op, target); };
+    collabSession.setCallbacks(std::move(callbacks));
+}
+
+int Application::publishCollabChanges() {
+    return collabSession.publish();
+}
+
+int Application::pollCollabChanges() {
+    return collabSession.receive();
+}
+
+CollabSnapshot Application::takeCollabSnapshot() {
+    CollabSnapshot snapshot;
+
+    auto addTrack = [&snapshot](const Track& track) {
+        CollabTrack collabTrack;
+        collabTrack.name = track.getName();
+        // The user's values; automation moves the live ones every block
+        collabTrack.volume = track.getFaderVolume();
+        collabTrack.pan = track.getFaderPan();
+        collabTrack.muted = track.isMuted();
+        collabTrack.solo = track.isSolo();
+
+        const auto& effects = track.getEffects();
+        const auto automated = track.getAutomatedEffectParameters();
+        for (size_t e = 0; e < effects.size(); ++e) {
+            collabTrack.effects.push_back(effects[e]->getName());
+            for (int i = 0; i < effects[e]->getNumParameters(); ++i) {
+                if (std::find(automated.begin(), automated.end(), std::make_pair(static_cast<int>(e), i)) != automated.end()) {
+                    continue;
+                }
+                collabTrack.parameters[CollabOp::makeParameterKey(static_cast<int>(e), i)] = effects[e]->getParameter(i);
+            }
+        }
+
+        for (const auto& clip : track.getClips()) {
+            CollabClip collabClip;
+            collabClip.file = clip.sourceFile.getFileName().toStdString();
+            collabClip.startTime = clip.startTime;
+            collabClip.offset = clip.offset;
+            collabClip.duration = clip.duration;
+            collabClip.volume = clip.volume;
+            collabTrack.clips.push_back(std::move(collabClip));
+        }
+
+        if (const auto* midiTrack = dynamic_cast<const MIDITrack*>(&track)) {
+            collabTrack.midiFingerprint = midiTrack->getMIDIClipFingerprint();
+        }
+
+        snapshot.tracks.push_back(std::move(collabTrack));
+    };
+
+    if (auto* masterTrack = engine.getMasterTrack()) {
+        addTrack(*masterTrack);
+    }
+    for (const auto& track : engine.getAllTracks()) {
+        if (track) {
+            addTrack(*track);
+        }
+    }
+    return snapshot;
+}
+
+void Application::applyCollabOp(const CollabOp& op, const CollabClip* target) {
+    Track* track = engine.getTrackByName(op.track);
+    if (!track && engine.getMasterTrack() && engine.getMasterTrack()->getName() == op.track) {
+        track = engine.getMasterTrack();
+    }
+    if (!track) {
+        return;
+    }
+
+    // The clip the op targets as this peer has it, if it has not moved here since
+    auto findClip = [target](const std::vector<AudioClip>& clips) -> int {
+        for (size_t i = 0; target && i < clips.size(); ++i) {
+            const auto& clip = clips[i];
+            if (clip.sourceFile.getFileName().toStdString() == target->file && clip.startTime == target->startTime
+                && clip.offset == target->offset && clip.duration == target->duration && clip.volume == target->volume) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    };
+
+    // The render thread reads clips, track values and parameters live. Clip
+    // ops edit a copy that goes in with one swap under the callback lock, so
+    // nothing is decoded or freed while it is held.
+    switch (op.type) {
+        case CollabOp::Type::AddClip:
+        case CollabOp::Type::MoveClip:
+        case CollabOp::Type::RemoveClip: {
+            auto* audioTrack = dynamic_cast<AudioTrack*>(track);
+            if (!audioTrack) {
+                break;
+            }
+            std::vector<AudioClip> clips = audioTrack->getClips();
+            const int index = findClip(clips);
+            if (op.type == CollabOp::Type::AddClip) {
+                clips.emplace_back(engine.findSampleFile(op.clip.file), op.clip.startTime, op.clip.offset,
+                                   op.clip.duration, op.clip.volume);
+            } else if (index < 0) {
+                break;
+            } else if (op.type == CollabOp::Type::MoveClip) {
+                AudioClip moved = clips[static_cast<size_t>(index)];
+                moved.startTime = op.clip.startTime;
+                moved.offset = op.clip.offset;
+                moved.duration = op.clip.duration;
+                moved.volume = op.clip.volume;
+                clips.erase(clips.begin() + index);
+                clips.push_back(std::move(moved));
+            } else {
+                clips.erase(clips.begin() + index);
+            }
+            audioTrack->requestClipAudio(clips);
+            const juce::ScopedLock audioLock(engine.getAudioCallbackLock());
+            audioTrack->swapClips(clips);
+            break;
+        }
+        case CollabOp::Type::SetTrackValue: {
+            const juce::ScopedLock audioLock(engine.getAudioCallbackLock());
+            switch (op.trackValue) {
+                case CollabOp::TrackValue::Volume: track->setVolume(op.value); break;
+                case CollabOp::TrackValue::Pan: track->setPan(op.value); break;
+                case CollabOp::TrackValue::Mute:
+                    if (track->isMuted() != (op.value != 0.f)) {
+                        track->toggleMute();
+                    }
+                    break;
+                case CollabOp::TrackValue::Solo: track->setSolo(op.value != 0.f); break;
+            }
+            break;
+        }
+        case CollabOp::Type::SetParameter: {
+            int effectIndex = 0;
+            int parameterIndex = 0;
+            if (!CollabOp::parseParameterKey(op.key, effectIndex, parameterIndex)) {
+                break;
+            }
+            const juce::ScopedLock audioLock(engine.getAudioCallbackLock());
+            if (auto* effect = track->getEffect(effectIndex); effect && parameterIndex < effect->getNumParameters()) {
+                effect->setParameter(parameterIndex, op.value);
+            }
+            break;
+        }
+        case CollabOp::Type::ReplaceState:
+            break; // loaded through the loadState callback
+    }
+}
+
 void Application::cleanupFirebaseResources() {
 #ifdef FIREBASE_AVAILABLE
     std::lock_guard<std::mutex> lock(firebaseMutex);
@@ -1751,11 +2031,18 @@ void Application::processPendingEngineUpdates() {
                     
                     if (timeSinceLastLoad > 16) {
                         auto startTime = std::chrono::steady_clock::now();
-                        engine.load(pendingEngineStateUpdate);
+                        // Only what differs is touched; plugins and decoded audio stay
+                        engine.applyState(pendingEngineStateUpdate);
                         auto endTime = std::chrono::steady_clock::now();
                         auto loadTime = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
                         std::cout << "Applied pending engine state update safely (" << loadTime << "ms)" << std::endl;
                         lastLoadTime = endTime;
+
+                        // The room's state is in; its ops can be replayed on top
+                        if (!collabSession.getRoom().empty() && !collabSession.isActive()) {
+                            collabSession.start();
+                            pollCollabChanges();
+                        }
                         
                         hasPendingEngineUpdate = false;
                         pendingEngineStateUpdate.clear();
@@ -16,6 +16,7 @@
 #include <thread>
 #include <list>
 #include "EmailService.hpp"
+#include "CollabSession.hpp"
 
 #ifdef FIREBASE_AVAILABLE
     #include <firebase/database.h>
@@ -98,10 +99,34 @@ public:
     inline std::vector<std::unique_ptr<Track>>& getAllTracks() { return engine.getAllTracks(); }
     inline void addTrack(const std::string& name, const std::string& samplePath) { engine.addTrack(name, samplePath); }
     inline void removeTrack(const std::string& name) { pendingTrackRemoveName = name; }
+    // Starts a background export, or cancels the one already running
     inline void exportAudio() {
+        if (engine.isExporting()) {
+            engine.cancelExport();
+            return;
+        }
+
         std::string path = selectDirectory();
-        engine.exportMaster(path);
+        if (path.empty()) {
+            return;
+        }
+
+        ExportSampleFormat format = ExportSampleFormat::Int24;
+        if (uiState.exportBitDepth == 16) format = ExportSampleFormat::Int16;
+        else if (uiState.exportBitDepth == 32) format = ExportSampleFormat::Float32;
+
+        if (uiState.exportStems) {
+            engine.exportStems(path, format);
+        } else {
+            engine.exportMaster(path, format);
+        }
     }
+    inline bool isExporting() const { return engine.isExporting(); }
+    inline ExportProgress getExportProgress() const { return engine.getExportProgress(); }
+    inline Engine::LoadProgress getLoadProgress() { return engine.getLoadProgress(); }
+    inline bool freezeTrack(const std::string& trackName) { return engine.freezeTrack(trackName); }
+    inline void unfreezeTrack(const std::string& trackName) { engine.unfreezeTrack(trackName); }
+    inline bool isTrackFrozen(const std::string& trackName) { return engine.isTrackFrozen(trackName); }
     inline void setMetronomeEnabled(bool enabled) { engine.setMetronomeEnabled(enabled); }
     inline bool isMetronomeEnabled() const { return engine.isMetronomeEnabled(); }
 
@@ -156,34 +181,31 @@ public:
     inline std::pair<int, int> getTimeSignature() {return engine.getTimeSignature(); }
 
     inline AudioClip* getReferenceClip(const std::string& trackName) { return engine.getTrackByName(trackName)->getReferenceClip(); }
+    // The track swaps its clips under the audio callback lock and frees the
+    // removed ones after it, so these are safe while the song plays or exports
     inline void addClipToTrack(const std::string& trackName, const AudioClip& clip) { 
-        engine.getTrackByName(trackName)->addClip(clip); 
-        // Force state update after clip modification
-        std::string currentRoom = readConfig<std::string>("collab_room", "");
-        if (!currentRoom.empty()) {
-            updateRoomEngineState(currentRoom, engine.getStateString());
-        }
+        auto* track = engine.getTrackByName(trackName);
+        if (!track) return;
+        track->addClip(clip); 
+        // Send the edit to the room, if there is one
+        publishCollabChanges();
     }
     inline void removeClipFromTrack(const std::string& trackName, size_t index) { 
-        engine.getTrackByName(trackName)->removeClip(index); 
-        // Force state update after clip modification
-        std::string currentRoom = readConfig<std::string>("collab_room", "");
-        if (!currentRoom.empty()) {
-            updateRoomEngineState(currentRoom, engine.getStateString());
-        }
+        auto* track = engine.getTrackByName(trackName);
+        if (!track) return;
+        track->removeClip(index); 
+        // Send the edit to the room, if there is one
+        publishCollabChanges();
     }
     
     // Method for updating clip positions (for moves)
     inline void updateClipInTrack(const std::string& trackName, size_t index, const AudioClip& newClip) {
-        auto* track = engine.getTrackByName(trackName);
+        auto* track = dynamic_cast<AudioTrack*>(engine.getTrackByName(trackName));
         if (track && index < track->getClips().size()) {
-            track->removeClip(index);
-            track->addClip(newClip);
-            // Force state update after clip modification
-            std::string currentRoom = readConfig<std::string>("collab_room", "");
-            if (!currentRoom.empty()) {
-                updateRoomEngineState(currentRoom, engine.getStateString());
-            }
+            // One edit, so no block renders the track without the clip
+            track->replaceClip(index, newClip);
+            // Goes out as a move of the same clip, not a removal and an add
+            publishCollabChanges();
         }
     }
 
@@ -224,6 +246,15 @@ public:
         writeConfig("sampleRate", uiState.sampleRate);
         writeConfig("autoSaveIntervalSeconds", uiState.autoSaveIntervalSeconds);
         writeConfig("enableAutoVSTScan", uiState.enableAutoVSTScan);
+        writeConfig("renderThreads", uiState.renderThreads);
+        writeConfig("realtimeRenderThreads", uiState.realtimeRenderThreads);
+        writeConfig("clipStreamingThresholdSeconds", uiState.clipStreamingThresholdSeconds);
+        writeConfig("samplePoolBudgetMB", uiState.samplePoolBudgetMB);
+        writeConfig("resamplerQuality", uiState.resamplerQuality);
+        writeConfig("exportBitDepth", uiState.exportBitDepth);
+        writeConfig("exportStems", uiState.exportStems);
+        writeConfig("pluginSleepSeconds", uiState.pluginSleepSeconds);
+        writeConfig("pluginsOutOfProcess", uiState.pluginsOutOfProcess);
     }
     void saveLayoutConfig();
 
@@ -232,7 +263,8 @@ public:
     inline Track* getSelectedTrackPtr() { return engine.getSelectedTrackPtr(); }
     inline bool hasSelectedTrack() const { return engine.hasSelectedTrack(); }
 
-    inline void loadComposition(const std::string& path) { engine.loadComposition(path); engine.generateMetronomeTrack(); }
+    // The file is read in the background; getLoadProgress().reading until it's in
+    inline void loadComposition(const std::string& path) { engine.beginLoadComposition(path); }
     inline std::string getCurrentCompositionName() const { return engine.getCurrentCompositionName(); }
     inline void setCurrentCompositionName(const std::string& name) { engine.setCurrentCompositionName(name); }
     inline void saveState() { engine.save(); }
@@ -240,6 +272,8 @@ public:
 
     MIDIClip* getSelectedMIDIClip() const;
     MIDIClip* getTimelineSelectedMIDIClip() const;
+    // Call after editing a clip in place, so its track compiles it again
+    void markMIDIClipChanged(const MIDIClip* clip);
 
     // Parameter tracking for automation
     void updateParameterTracking();
@@ -287,6 +321,13 @@ public:
     void updateRoomEngineState(const std::string& roomName, const std::string& engineState);
     void checkRoomEngineState(const std::string& roomName);
     void writeToRoom(const std::string& roomName, const std::string& section, const std::string& data);
+    // Edits since the last call go to the joined room as typed ops, and ops
+    // from the other participants are applied here. Both return how many.
+    int publishCollabChanges();
+    int pollCollabChanges();
+    // Hash of what publishCollabChanges compares, to tell cheaply whether a
+    // publish would send anything
+    std::uint64_t getCollabSnapshotHash() { return CollabSession::hashSnapshot(takeCollabSnapshot()); }
     
     mutable std::mutex firebaseMutex;
 
@@ -394,6 +435,12 @@ private:
     std::string pendingEngineStateUpdate;
     bool hasPendingEngineUpdate = false;
 
+    // Room edits as ops; starts once the room's state has been loaded
+    CollabSession collabSession;
+    void initCollabSession();
+    CollabSnapshot takeCollabSnapshot();
+    void applyCollabOp(const CollabOp& op, const CollabClip* target);
+
     void initUI();
     void initUIResources();
     void createWindow();
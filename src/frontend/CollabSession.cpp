@@ -0,0 +1,807 @@
+#include "CollabSession.hpp"
+
+#include "../DebugConfig.hpp"
+#include "../audio/StateHasher.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+namespace {
+    constexpr int deltaMagic = 0x4c4f434d; // "MCOL"
+    constexpr int deltaVersion = 2; // 2: parameters keyed by chain index
+
+    CollabTrack* findTrack(CollabSnapshot& snapshot, const std::string& name) {
+        for (auto& track : snapshot.tracks) {
+            if (track.name == name) {
+                return &track;
+            }
+        }
+        return nullptr;
+    }
+
+    CollabClip* findClip(CollabTrack& track, const std::string& id) {
+        for (auto& clip : track.clips) {
+            if (clip.id == id) {
+                return &clip;
+            }
+        }
+        return nullptr;
+    }
+
+    // Tracks, their effects and their MIDI are the same, so ops can cover the rest
+    bool sameStructure(const CollabSnapshot& a, const CollabSnapshot& b) {
+        if (a.tracks.size() != b.tracks.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.tracks.size(); ++i) {
+            if (a.tracks[i].name != b.tracks[i].name || a.tracks[i].effects != b.tracks[i].effects
+                || a.tracks[i].midiFingerprint != b.tracks[i].midiFingerprint) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    CollabOp makeTrackValueOp(const std::string& track, CollabOp::TrackValue which, float value) {
+        CollabOp op;
+        op.type = CollabOp::Type::SetTrackValue;
+        op.track = track;
+        op.trackValue = which;
+        op.value = value;
+        return op;
+    }
+
+    void writeClip(juce::MemoryOutputStream& out, const CollabClip& clip) {
+        out.writeString(juce::String::fromUTF8(clip.file.c_str()));
+        out.writeDouble(clip.startTime);
+        out.writeDouble(clip.offset);
+        out.writeDouble(clip.duration);
+        out.writeFloat(clip.volume);
+    }
+
+    void readClip(juce::MemoryInputStream& in, CollabClip& clip) {
+        clip.file = in.readString().toStdString();
+        clip.startTime = in.readDouble();
+        clip.offset = in.readDouble();
+        clip.duration = in.readDouble();
+        clip.volume = in.readFloat();
+    }
+}
+
+bool CollabClip::sameContent(const CollabClip& other) const {
+    return file == other.file && startTime == other.startTime && offset == other.offset
+        && duration == other.duration && volume == other.volume;
+}
+
+std::string CollabOp::getObjectId() const {
+    switch (type) {
+        case Type::AddClip:
+        case Type::MoveClip:
+        case Type::RemoveClip:
+            return "clip/" + track + "/" + key;
+        case Type::SetTrackValue:
+            return "track/" + track + "/" + std::to_string(static_cast<int>(trackValue));
+        case Type::SetParameter:
+            return "param/" + track + "/" + key;
+        case Type::ReplaceState:
+            break;
+    }
+    return "state";
+}
+
+bool CollabOp::isNewerThan(std::uint64_t otherLamport, std::uint64_t otherSite) const {
+    return lamport != otherLamport ? lamport > otherLamport : site > otherSite;
+}
+
+std::string CollabOp::makeParameterKey(int effectIndex, int parameterIndex) {
+    return std::to_string(effectIndex) + "/" + std::to_string(parameterIndex);
+}
+
+bool CollabOp::parseParameterKey(const std::string& key, int& effectIndex, int& parameterIndex) {
+    const auto separator = key.find('/');
+    if (separator == std::string::npos) {
+        return false;
+    }
+    const auto isIndex = [](const std::string& text) {
+        return !text.empty() && text.size() <= 9
+            && std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; });
+    };
+    const auto effectText = key.substr(0, separator);
+    const auto parameterText = key.substr(separator + 1);
+    if (!isIndex(effectText) || !isIndex(parameterText)) {
+        return false;
+    }
+    effectIndex = std::stoi(effectText);
+    parameterIndex = std::stoi(parameterText);
+    return true;
+}
+
+void FakeCollabBackend::append(const std::string& room, const juce::MemoryBlock& delta) {
+    std::lock_guard<std::mutex> guard(lock);
+    rooms[room].push_back(delta);
+}
+
+std::vector<juce::MemoryBlock> FakeCollabBackend::read(const std::string& room, std::size_t from) {
+    std::lock_guard<std::mutex> guard(lock);
+    const auto it = rooms.find(room);
+    if (it == rooms.end() || from >= it->second.size()) {
+        return {};
+    }
+    return std::vector<juce::MemoryBlock>(it->second.begin() + static_cast<std::ptrdiff_t>(from), it->second.end());
+}
+
+std::size_t FakeCollabBackend::getBytesSent(const std::string& room) const {
+    std::lock_guard<std::mutex> guard(lock);
+    std::size_t bytes = 0;
+    if (const auto it = rooms.find(room); it != rooms.end()) {
+        for (const auto& delta : it->second) {
+            bytes += delta.getSize();
+        }
+    }
+    return bytes;
+}
+
+CollabSession::CollabSession() {
+    site = static_cast<std::uint64_t>(juce::Random::getSystemRandom().nextInt64()) | 1;
+}
+
+void CollabSession::setBackend(std::shared_ptr<CollabBackend> newBackend) {
+    if (backend && !room.empty()) {
+        backend->close(room);
+    }
+    backend = std::move(newBackend);
+    if (backend && !room.empty()) {
+        backend->open(room);
+    }
+}
+
+void CollabSession::join(const std::string& newRoom) {
+    leave();
+    room = newRoom;
+    // A fresh site each time, so this peer's ops from an earlier visit replay like anyone's
+    site = static_cast<std::uint64_t>(juce::Random::getSystemRandom().nextInt64()) | 1;
+    if (backend) {
+        backend->open(room);
+    }
+    DEBUG_PRINT("[CollabSession] Joined " + room);
+}
+
+void CollabSession::leave() {
+    if (backend && !room.empty()) {
+        backend->close(room);
+    }
+    room.clear();
+    active = false;
+    readPosition = 0;
+    lamport = 0;
+    nextClipNumber = 1;
+    agreed = {};
+    versions.clear();
+    stateVersion = {};
+}
+
+void CollabSession::start() {
+    if (room.empty()) {
+        return;
+    }
+    resetAgreedState();
+    active = true;
+}
+
+void CollabSession::resetAgreedState() {
+    agreed = callbacks.takeSnapshot ? callbacks.takeSnapshot() : CollabSnapshot{};
+    assignInitialClipIds(agreed);
+}
+
+void CollabSession::assignInitialClipIds(CollabSnapshot& snapshot) {
+    for (auto& track : snapshot.tracks) {
+        std::unordered_map<std::string, int> uses;
+        for (auto& clip : track.clips) {
+            const auto base = clip.file + "@" + std::to_string(std::llround(clip.startTime * 1000.0));
+            const int use = uses[base]++;
+            clip.id = use == 0 ? base : base + "#" + std::to_string(use);
+        }
+    }
+}
+
+std::uint64_t CollabSession::hashSnapshot(const CollabSnapshot& snapshot) {
+    StateHasher hasher;
+    for (const auto& track : snapshot.tracks) {
+        hasher.add(track.name);
+        hasher.add(track.volume);
+        hasher.add(track.pan);
+        hasher.add(track.muted);
+        hasher.add(track.solo);
+        hasher.add(track.midiFingerprint);
+        for (const auto& effect : track.effects) {
+            hasher.add(effect);
+        }
+        for (const auto& [key, value] : track.parameters) {
+            hasher.add(key);
+            hasher.add(value);
+        }
+        for (const auto& clip : track.clips) {
+            hasher.add(clip.file);
+            hasher.add(clip.startTime);
+            hasher.add(clip.offset);
+            hasher.add(clip.duration);
+            hasher.add(clip.volume);
+        }
+    }
+    return hasher.get();
+}
+
+std::vector<CollabOp> CollabSession::diff(const CollabSnapshot& from, CollabSnapshot& to, std::uint64_t site,
+                                          std::uint64_t& nextClipNumber) {
+    std::vector<CollabOp> ops;
+
+    for (size_t t = 0; t < to.tracks.size(); ++t) {
+        const auto& before = from.tracks[t];
+        auto& after = to.tracks[t];
+
+        if (after.volume != before.volume) {
+            ops.push_back(makeTrackValueOp(after.name, CollabOp::TrackValue::Volume, after.volume));
+        }
+        if (after.pan != before.pan) {
+            ops.push_back(makeTrackValueOp(after.name, CollabOp::TrackValue::Pan, after.pan));
+        }
+        if (after.muted != before.muted) {
+            ops.push_back(makeTrackValueOp(after.name, CollabOp::TrackValue::Mute, after.muted ? 1.f : 0.f));
+        }
+        if (after.solo != before.solo) {
+            ops.push_back(makeTrackValueOp(after.name, CollabOp::TrackValue::Solo, after.solo ? 1.f : 0.f));
+        }
+
+        for (const auto& [key, value] : after.parameters) {
+            const auto it = before.parameters.find(key);
+            if (it == before.parameters.end() || it->second != value) {
+                CollabOp op;
+                op.type = CollabOp::Type::SetParameter;
+                op.track = after.name;
+                op.key = key;
+                op.value = value;
+                ops.push_back(std::move(op));
+            }
+        }
+
+        // Unchanged clips keep their ids, then a leftover clip of the same
+        // file is taken to have moved or been trimmed; what is still left
+        // over was added or removed
+        std::vector<bool> matched(before.clips.size(), false);
+        std::vector<CollabClip*> unmatched;
+        for (auto& clip : after.clips) {
+            clip.id.clear();
+            for (size_t i = 0; i < before.clips.size(); ++i) {
+                if (!matched[i] && before.clips[i].sameContent(clip)) {
+                    matched[i] = true;
+                    clip.id = before.clips[i].id;
+                    break;
+                }
+            }
+            if (clip.id.empty()) {
+                unmatched.push_back(&clip);
+            }
+        }
+
+        for (auto* clip : unmatched) {
+            CollabOp op;
+            op.track = after.name;
+            for (size_t i = 0; i < before.clips.size(); ++i) {
+                if (!matched[i] && before.clips[i].file == clip->file) {
+                    matched[i] = true;
+                    clip->id = before.clips[i].id;
+                    op.type = CollabOp::Type::MoveClip;
+                    break;
+                }
+            }
+            if (clip->id.empty()) {
+                clip->id = juce::String::toHexString(static_cast<juce::int64>(site)).toStdString()
+                         + ":" + std::to_string(nextClipNumber++);
+                op.type = CollabOp::Type::AddClip;
+            }
+            op.key = clip->id;
+            op.clip = *clip;
+            ops.push_back(std::move(op));
+        }
+
+        for (size_t i = 0; i < before.clips.size(); ++i) {
+            if (!matched[i]) {
+                CollabOp op;
+                op.type = CollabOp::Type::RemoveClip;
+                op.track = after.name;
+                op.key = before.clips[i].id;
+                ops.push_back(std::move(op));
+            }
+        }
+    }
+
+    for (auto& op : ops) {
+        op.site = site;
+    }
+    return ops;
+}
+
+int CollabSession::publish() {
+    if (!active || !backend || !callbacks.takeSnapshot) {
+        return 0;
+    }
+
+    auto current = callbacks.takeSnapshot();
+    std::vector<CollabOp> ops;
+
+    if (!sameStructure(agreed, current)) {
+        if (!callbacks.saveState) {
+            return 0;
+        }
+        CollabOp op;
+        op.type = CollabOp::Type::ReplaceState;
+        op.site = site;
+        op.lamport = ++lamport;
+        op.state = callbacks.saveState();
+        stateVersion = { op.lamport, site };
+        ops.push_back(std::move(op));
+
+        assignInitialClipIds(current);
+        agreed = std::move(current);
+    } else {
+        ops = diff(agreed, current, site, nextClipNumber);
+        if (ops.empty()) {
+            return 0;
+        }
+        for (auto& op : ops) {
+            op.lamport = ++lamport;
+            versions[op.getObjectId()] = { op.lamport, site };
+        }
+        agreed = std::move(current);
+    }
+
+    const auto delta = encode(ops);
+    backend->append(room, delta);
+    DEBUG_PRINT("[CollabSession] Sent " + std::to_string(ops.size()) + " ops in "
+                + std::to_string(delta.getSize()) + " bytes");
+    return static_cast<int>(ops.size());
+}
+
+int CollabSession::receive() {
+    if (!active || !backend) {
+        return 0;
+    }
+
+    const auto deltas = backend->read(room, readPosition);
+    readPosition += deltas.size();
+
+    int applied = 0;
+    for (const auto& delta : deltas) {
+        std::vector<CollabOp> ops;
+        if (!decode(delta, ops)) {
+            DEBUG_PRINT("[CollabSession] Skipped a delta that could not be read");
+            continue;
+        }
+
+        for (const auto& op : ops) {
+            lamport = std::max(lamport, op.lamport);
+            if (op.site == site) {
+                continue; // applied when it was sent
+            }
+
+            // Whatever a later document replacement has already settled
+            if (!op.isNewerThan(stateVersion.lamport, stateVersion.site)) {
+                continue;
+            }
+
+            if (op.type == CollabOp::Type::ReplaceState) {
+                if (callbacks.loadState) {
+                    callbacks.loadState(op.state);
+                }
+                stateVersion = { op.lamport, op.site };
+                for (auto it = versions.begin(); it != versions.end();) {
+                    it = op.isNewerThan(it->second.lamport, it->second.site) ? versions.erase(it) : std::next(it);
+                }
+                resetAgreedState();
+                ++applied;
+                continue;
+            }
+
+            // A removed clip stays removed whichever edit to it is newer, so
+            // a remove lands here even after a later move of the same clip
+            const auto objectId = op.getObjectId();
+            const auto version = versions.find(objectId);
+            const bool newer = version == versions.end() || op.isNewerThan(version->second.lamport, version->second.site);
+            if (!newer && op.type != CollabOp::Type::RemoveClip) {
+                continue;
+            }
+
+            auto* track = findTrack(agreed, op.track);
+            if (track == nullptr) {
+                continue;
+            }
+
+            const CollabClip* target = nullptr;
+            if (op.type == CollabOp::Type::MoveClip || op.type == CollabOp::Type::RemoveClip) {
+                target = findClip(*track, op.key);
+                if (target == nullptr) {
+                    continue; // a removed clip stays removed
+                }
+            } else if (op.type == CollabOp::Type::AddClip && findClip(*track, op.key) != nullptr) {
+                continue;
+            }
+
+            if (callbacks.apply) {
+                callbacks.apply(op, target);
+            }
+            applyToSnapshot(agreed, op);
+            if (newer) {
+                versions[objectId] = { op.lamport, op.site };
+            }
+            ++applied;
+        }
+    }
+
+    if (applied > 0) {
+        DEBUG_PRINT("[CollabSession] Applied " + std::to_string(applied) + " remote ops");
+    }
+    return applied;
+}
+
+void CollabSession::applyToSnapshot(CollabSnapshot& snapshot, const CollabOp& op) {
+    auto* track = findTrack(snapshot, op.track);
+    if (track == nullptr) {
+        return;
+    }
+
+    switch (op.type) {
+        case CollabOp::Type::AddClip:
+            track->clips.push_back(op.clip);
+            track->clips.back().id = op.key;
+            break;
+        case CollabOp::Type::MoveClip:
+            if (auto* clip = findClip(*track, op.key)) {
+                *clip = op.clip;
+                clip->id = op.key;
+            }
+            break;
+        case CollabOp::Type::RemoveClip:
+            track->clips.erase(std::remove_if(track->clips.begin(), track->clips.end(),
+                                              [&](const CollabClip& clip) { return clip.id == op.key; }),
+                               track->clips.end());
+            break;
+        case CollabOp::Type::SetTrackValue:
+            switch (op.trackValue) {
+                case CollabOp::TrackValue::Volume: track->volume = op.value; break;
+                case CollabOp::TrackValue::Pan: track->pan = op.value; break;
+                case CollabOp::TrackValue::Mute: track->muted = op.value != 0.f; break;
+                case CollabOp::TrackValue::Solo: track->solo = op.value != 0.f; break;
+            }
+            break;
+        case CollabOp::Type::SetParameter:
+            track->parameters[op.key] = op.value;
+            break;
+        case CollabOp::Type::ReplaceState:
+            break;
+    }
+}
+
+juce::MemoryBlock CollabSession::encode(const std::vector<CollabOp>& ops) {
+    // [magic][version][site][count], then per op its type, stamp, target and
+    // whatever that type carries. All of a delta's ops come from one site.
+    juce::MemoryOutputStream out;
+    out.writeInt(deltaMagic);
+    out.writeByte(static_cast<char>(deltaVersion));
+    out.writeInt64(static_cast<juce::int64>(ops.empty() ? 0 : ops.front().site));
+    out.writeCompressedInt(static_cast<int>(ops.size()));
+
+    for (const auto& op : ops) {
+        jassert(op.site == ops.front().site);
+        out.writeByte(static_cast<char>(op.type));
+        out.writeInt64(static_cast<juce::int64>(op.lamport));
+        out.writeString(juce::String::fromUTF8(op.track.c_str()));
+        out.writeString(juce::String::fromUTF8(op.key.c_str()));
+
+        switch (op.type) {
+            case CollabOp::Type::AddClip:
+            case CollabOp::Type::MoveClip:
+                writeClip(out, op.clip);
+                break;
+            case CollabOp::Type::RemoveClip:
+                break;
+            case CollabOp::Type::SetTrackValue:
+                out.writeByte(static_cast<char>(op.trackValue));
+                out.writeFloat(op.value);
+                break;
+            case CollabOp::Type::SetParameter:
+                out.writeFloat(op.value);
+                break;
+            case CollabOp::Type::ReplaceState:
+                out.writeCompressedInt(static_cast<int>(op.state.size()));
+                out.write(op.state.data(), op.state.size());
+                break;
+        }
+    }
+
+    return out.getMemoryBlock();
+}
+
+bool CollabSession::decode(const juce::MemoryBlock& delta, std::vector<CollabOp>& ops) {
+    juce::MemoryInputStream in(delta, false);
+    if (delta.getSize() < 13 || in.readInt() != deltaMagic || in.readByte() != deltaVersion) {
+        return false;
+    }
+
+    const auto deltaSite = static_cast<std::uint64_t>(in.readInt64());
+    const int count = in.readCompressedInt();
+    if (count < 0) {
+        return false;
+    }
+
+    ops.clear();
+    for (int i = 0; i < count; ++i) {
+        if (in.isExhausted()) {
+            return false;
+        }
+
+        CollabOp op;
+        const auto type = static_cast<std::uint8_t>(in.readByte());
+        if (type < static_cast<std::uint8_t>(CollabOp::Type::AddClip)
+            || type > static_cast<std::uint8_t>(CollabOp::Type::ReplaceState)) {
+            return false;
+        }
+        op.type = static_cast<CollabOp::Type>(type);
+        op.site = deltaSite;
+        op.lamport = static_cast<std::uint64_t>(in.readInt64());
+        op.track = in.readString().toStdString();
+        op.key = in.readString().toStdString();
+
+        switch (op.type) {
+            case CollabOp::Type::AddClip:
+            case CollabOp::Type::MoveClip:
+                readClip(in, op.clip);
+                op.clip.id = op.key;
+                break;
+            case CollabOp::Type::RemoveClip:
+                break;
+            case CollabOp::Type::SetTrackValue: {
+                const auto which = static_cast<std::uint8_t>(in.readByte());
+                if (which < static_cast<std::uint8_t>(CollabOp::TrackValue::Volume)
+                    || which > static_cast<std::uint8_t>(CollabOp::TrackValue::Solo)) {
+                    return false;
+                }
+                op.trackValue = static_cast<CollabOp::TrackValue>(which);
+                op.value = in.readFloat();
+                break;
+            }
+            case CollabOp::Type::SetParameter:
+                op.value = in.readFloat();
+                break;
+            case CollabOp::Type::ReplaceState: {
+                const int size = in.readCompressedInt();
+                if (size < 0 || size > in.getNumBytesRemaining()) {
+                    return false;
+                }
+                op.state.resize(static_cast<size_t>(size));
+                in.read(op.state.data(), size);
+                break;
+            }
+        }
+        ops.push_back(std::move(op));
+    }
+
+    return true;
+}
+
+std::vector<std::string> CollabSession::runSelfTest() {
+    std::vector<std::string> failures;
+    auto check = [&failures](bool passed, const std::string& what) {
+        if (!passed) {
+            failures.push_back(what);
+        }
+    };
+
+    int effectIndex = -1;
+    int parameterIndex = -1;
+    check(CollabOp::parseParameterKey(CollabOp::makeParameterKey(3, 17), effectIndex, parameterIndex)
+              && effectIndex == 3 && parameterIndex == 17,
+          "a parameter key reads back as the indices it was made from");
+    check(!CollabOp::parseParameterKey("Delay/Mix", effectIndex, parameterIndex)
+              && !CollabOp::parseParameterKey("1/", effectIndex, parameterIndex)
+              && !CollabOp::parseParameterKey("1/2/3", effectIndex, parameterIndex),
+          "parameter keys by name are rejected");
+
+    // Each peer's project is a snapshot, edited the way Application applies
+    // ops to the engine: clips are found by what the session last saw of them
+    auto makeProject = [] {
+        CollabTrack master;
+        master.name = "Master";
+        CollabTrack drums;
+        drums.name = "Drums";
+        drums.volume = 1.f;
+        drums.effects = { "Delay", "Delay" };
+        for (int e = 0; e < 2; ++e) {
+            for (int p = 0; p < 2; ++p) {
+                drums.parameters[CollabOp::makeParameterKey(e, p)] = 0.5f;
+            }
+        }
+        drums.clips.push_back({ "", "kick.wav", 0.0, 0.0, 1.0, 1.f });
+        drums.clips.push_back({ "", "snare.wav", 1.0, 0.0, 1.0, 1.f });
+        CollabSnapshot project;
+        project.tracks = { master, drums };
+        return project;
+    };
+
+    auto applyToProject = [](CollabSnapshot& project, const CollabOp& op, const CollabClip* target) {
+        auto* track = findTrack(project, op.track);
+        if (track == nullptr) {
+            return;
+        }
+        const auto clip = std::find_if(track->clips.begin(), track->clips.end(), [target](const CollabClip& c) {
+            return target != nullptr && c.sameContent(*target);
+        });
+        switch (op.type) {
+            case CollabOp::Type::AddClip:
+                track->clips.push_back(op.clip);
+                track->clips.back().id.clear();
+                break;
+            case CollabOp::Type::MoveClip:
+                if (clip != track->clips.end()) {
+                    *clip = op.clip;
+                    clip->id.clear();
+                }
+                break;
+            case CollabOp::Type::RemoveClip:
+                if (clip != track->clips.end()) {
+                    track->clips.erase(clip);
+                }
+                break;
+            case CollabOp::Type::SetTrackValue:
+                switch (op.trackValue) {
+                    case CollabOp::TrackValue::Volume: track->volume = op.value; break;
+                    case CollabOp::TrackValue::Pan: track->pan = op.value; break;
+                    case CollabOp::TrackValue::Mute: track->muted = op.value != 0.f; break;
+                    case CollabOp::TrackValue::Solo: track->solo = op.value != 0.f; break;
+                }
+                break;
+            case CollabOp::Type::SetParameter: {
+                int effect = 0;
+                int parameter = 0;
+                if (CollabOp::parseParameterKey(op.key, effect, parameter) && track->parameters.count(op.key) != 0) {
+                    track->parameters[op.key] = op.value;
+                }
+                break;
+            }
+            case CollabOp::Type::ReplaceState:
+                break;
+        }
+    };
+
+    auto sameProject = [](const CollabSnapshot& a, const CollabSnapshot& b) {
+        if (a.tracks.size() != b.tracks.size()) {
+            return false;
+        }
+        auto sortedClips = [](std::vector<CollabClip> clips) {
+            std::sort(clips.begin(), clips.end(), [](const CollabClip& x, const CollabClip& y) {
+                return std::tie(x.file, x.startTime, x.offset, x.duration, x.volume)
+                     < std::tie(y.file, y.startTime, y.offset, y.duration, y.volume);
+            });
+            return clips;
+        };
+        for (size_t i = 0; i < a.tracks.size(); ++i) {
+            const auto& x = a.tracks[i];
+            const auto& y = b.tracks[i];
+            const auto xClips = sortedClips(x.clips);
+            const auto yClips = sortedClips(y.clips);
+            if (x.name != y.name || x.volume != y.volume || x.pan != y.pan || x.muted != y.muted || x.solo != y.solo
+                || x.parameters != y.parameters
+                || !std::equal(xClips.begin(), xClips.end(), yClips.begin(), yClips.end(),
+                               [](const CollabClip& c, const CollabClip& d) { return c.sameContent(d); })) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    auto backend = std::make_shared<FakeCollabBackend>();
+    const std::string testRoom = "self-test";
+    CollabSnapshot projectA = makeProject();
+    CollabSnapshot projectB = makeProject();
+    CollabSession a;
+    CollabSession b;
+    auto connect = [&](CollabSession& session, CollabSnapshot& project) {
+        Callbacks sessionCallbacks;
+        sessionCallbacks.takeSnapshot = [&project]() { return project; };
+        sessionCallbacks.apply = [&project, &applyToProject](const CollabOp& op, const CollabClip* target) {
+            applyToProject(project, op, target);
+        };
+        session.setCallbacks(std::move(sessionCallbacks));
+        session.setBackend(backend);
+        session.join(testRoom);
+        session.start();
+    };
+    connect(a, projectA);
+    connect(b, projectB);
+
+    auto exchange = [&]() {
+        a.receive();
+        b.receive();
+    };
+    auto drums = [](CollabSnapshot& project) -> CollabTrack& { return *findTrack(project, "Drums"); };
+
+    // Edits to different objects, sent both ways
+    drums(projectA).volume = 0.8f;
+    drums(projectA).clips[1].startTime = 2.0;
+    drums(projectB).pan = -0.5f;
+    drums(projectB).clips.push_back({ "", "hat.wav", 3.0, 0.0, 0.5, 1.f });
+    drums(projectB).parameters[CollabOp::makeParameterKey(1, 0)] = 0.9f;
+    check(a.publish() == 2, "A sends a volume op and a move");
+    check(b.publish() == 3, "B sends a pan op, an add and a parameter op");
+    exchange();
+    check(sameProject(projectA, projectB), "peers converge after exchanging edits to different objects");
+    check(drums(projectA).clips.size() == 3 && drums(projectA).pan == -0.5f, "A has B's clip and pan");
+    check(drums(projectA).parameters[CollabOp::makeParameterKey(1, 0)] == 0.9f
+              && drums(projectA).parameters[CollabOp::makeParameterKey(0, 0)] == 0.5f,
+          "a parameter op reaches only its own instance of a plugin used twice");
+
+    // An edit made after seeing another peer's wins over it whatever the sites
+    drums(projectA).volume = 0.2f;
+    a.publish();
+    b.receive();
+    drums(projectB).volume = 0.4f;
+    b.publish();
+    a.receive();
+    check(sameProject(projectA, projectB) && drums(projectA).volume == 0.4f,
+          "the edit stamped after receiving the other peer's is the one both keep");
+
+    // Concurrent edits to the same value settle on the newer stamp everywhere
+    drums(projectA).volume = 0.1f;
+    drums(projectB).volume = 0.9f;
+    a.publish();
+    b.publish();
+    exchange();
+    check(sameProject(projectA, projectB), "peers converge after concurrent edits to one value");
+
+    // A concurrent move and remove of one clip settle on the remove
+    const auto kick = std::find_if(drums(projectA).clips.begin(), drums(projectA).clips.end(),
+                                   [](const CollabClip& clip) { return clip.file == "kick.wav"; });
+    if (kick != drums(projectA).clips.end()) {
+        drums(projectA).clips.erase(kick);
+    }
+    for (auto& clip : drums(projectB).clips) {
+        if (clip.file == "kick.wav") {
+            clip.startTime = 0.5;
+        }
+    }
+    b.publish();
+    a.publish();
+    exchange();
+    check(sameProject(projectA, projectB) && drums(projectB).clips.size() == 2,
+          "peers converge on the remove after a concurrent move and remove");
+
+    // Every site's stamps rise through the log, and each delta outranks what
+    // its sender had received
+    std::vector<CollabOp> log;
+    for (const auto& delta : backend->read(testRoom, 0)) {
+        std::vector<CollabOp> ops;
+        check(decode(delta, ops), "every delta in the room decodes");
+        log.insert(log.end(), ops.begin(), ops.end());
+    }
+    std::unordered_map<std::uint64_t, std::uint64_t> lastStamp;
+    for (const auto& op : log) {
+        auto& last = lastStamp[op.site];
+        check(op.lamport > last, "a site's Lamport stamps rise with every op it sends");
+        last = op.lamport;
+    }
+    const auto volumeOps = std::count_if(log.begin(), log.end(), [](const CollabOp& op) {
+        return op.type == CollabOp::Type::SetTrackValue && op.trackValue == CollabOp::TrackValue::Volume;
+    });
+    check(volumeOps == 5, "every volume edit was sent");
+    for (size_t i = 0; i < log.size(); ++i) {
+        if (log[i].site == b.getSite() && log[i].type == CollabOp::Type::SetTrackValue && log[i].value == 0.4f) {
+            const bool afterA = std::all_of(log.begin(), log.begin() + static_cast<std::ptrdiff_t>(i),
+                                            [&](const CollabOp& op) { return op.site == b.getSite() || op.lamport < log[i].lamport; });
+            check(afterA, "an op sent after receiving outranks everything received");
+        }
+    }
+
+    a.leave();
+    b.leave();
+    return failures;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// CollabSession - keeps a collaboration room in step by exchanging typed
+// edits instead of the whole project. Each publish compares the project
+// against the last state everyone agreed on and sends what changed as ops
+// (a clip added, moved or removed, a track's volume, a parameter) packed
+// into one binary delta. Every op targets one object and carries a Lamport
+// stamp; a remote op only lands if its stamp is newer than the last write to
+// that object, so concurrent edits settle the same way on every peer.
+// Edits no op covers (tracks or effects added, removed or reordered, MIDI
+// notes) replace the whole document, last writer wins. Message thread only.
+
+// One clip as the session sees it. Ids are the clip's content in the state
+// a room starts from, and "<site>:<n>" for clips added since.
+struct CollabClip {
+    std::string id;
+    std::string file;
+    double startTime = 0.0;
+    double offset = 0.0;
+    double duration = 0.0;
+    float volume = 1.f;
+
+    // Everything but the id
+    bool sameContent(const CollabClip& other) const;
+};
+
+struct CollabTrack {
+    std::string name;
+    float volume = 0.f;
+    float pan = 0.f;
+    bool muted = false;
+    bool solo = false;
+    std::vector<std::string> effects;         // names, in chain order
+    std::map<std::string, float> parameters;  // by CollabOp::makeParameterKey
+    std::vector<CollabClip> clips;
+    std::uint64_t midiFingerprint = 0;        // MIDI clips, which have no ops
+};
+
+// The master track comes first
+struct CollabSnapshot {
+    std::vector<CollabTrack> tracks;
+};
+
+struct CollabOp {
+    enum class Type : std::uint8_t { AddClip = 1, MoveClip, RemoveClip, SetTrackValue, SetParameter, ReplaceState };
+    enum class TrackValue : std::uint8_t { Volume = 1, Pan, Mute, Solo };
+
+    Type type = Type::SetTrackValue;
+    std::uint64_t lamport = 0;
+    std::uint64_t site = 0;
+    std::string track;
+    std::string key;       // clip id, parameter key, or empty
+    TrackValue trackValue = TrackValue::Volume;
+    float value = 0.f;     // SetTrackValue (mute and solo as 0 or 1), SetParameter
+    CollabClip clip;       // AddClip and MoveClip: the clip as it now is
+    std::vector<std::uint8_t> state; // ReplaceState: Engine::getStateBinary
+
+    // What the op's conflict resolution is kept by
+    std::string getObjectId() const;
+    // Total order of stamps; the site breaks lamport ties
+    bool isNewerThan(std::uint64_t otherLamport, std::uint64_t otherSite) const;
+
+    // SetParameter keys, "<effect index>/<parameter index>". Effects go by
+    // their place in the chain, which is the same on every peer while ops
+    // are exchanged, so two instances of one plugin stay apart.
+    static std::string makeParameterKey(int effectIndex, int parameterIndex);
+    // False unless the key is one makeParameterKey wrote
+    static bool parseParameterKey(const std::string& key, int& effectIndex, int& parameterIndex);
+};
+
+// Where a room's deltas live. Every peer sees a room's deltas in the same
+// order. Implementations must be safe to call from any thread.
+class CollabBackend {
+public:
+    virtual ~CollabBackend() = default;
+
+    virtual void open(const std::string& room) = 0;
+    virtual void close(const std::string& room) = 0;
+    virtual void append(const std::string& room, const juce::MemoryBlock& delta) = 0;
+    // The room's deltas from index `from` on that have arrived so far
+    virtual std::vector<juce::MemoryBlock> read(const std::string& room, std::size_t from) = 0;
+};
+
+// Every room in memory; sessions sharing one behave like peers on a server
+class FakeCollabBackend : public CollabBackend {
+public:
+    void open(const std::string&) override {}
+    void close(const std::string&) override {}
+    void append(const std::string& room, const juce::MemoryBlock& delta) override;
+    std::vector<juce::MemoryBlock> read(const std::string& room, std::size_t from) override;
+
+    // Total bytes appended to the room
+    std::size_t getBytesSent(const std::string& room) const;
+
+private:
+    mutable std::mutex lock;
+    std::unordered_map<std::string, std::vector<juce::MemoryBlock>> rooms;
+};
+
+class CollabSession {
+public:
+    // How the session reaches the project. apply() is given the clip an op
+    // targets as the session last saw it, or null for ops that name no clip.
+    struct Callbacks {
+        std::function<CollabSnapshot()> takeSnapshot;
+        std::function<std::vector<std::uint8_t>()> saveState;
+        std::function<void(const std::vector<std::uint8_t>&)> loadState;
+        std::function<void(const CollabOp& op, const CollabClip* target)> apply;
+    };
+
+    CollabSession();
+
+    void setBackend(std::shared_ptr<CollabBackend> newBackend);
+    void setCallbacks(Callbacks newCallbacks) { callbacks = std::move(newCallbacks); }
+
+    // Joining reads the room's log from the start, but nothing is sent or
+    // applied until start() says the project holds the room's initial state
+    void join(const std::string& room);
+    void leave();
+    void start();
+    bool isActive() const { return active; }
+    const std::string& getRoom() const { return room; }
+    std::uint64_t getSite() const { return site; }
+
+    // Sends what changed since the last publish or receive, if anything.
+    // Returns the number of ops sent.
+    int publish();
+    // Applies the ops other peers have sent since the last call that win
+    // against what this peer has written. Returns the number applied.
+    int receive();
+
+    // The ops that turn `from` into `to`; clips in `to` get their ids here
+    static std::vector<CollabOp> diff(const CollabSnapshot& from, CollabSnapshot& to, std::uint64_t site,
+                                      std::uint64_t& nextClipNumber);
+
+    static juce::MemoryBlock encode(const std::vector<CollabOp>& ops);
+    // False if the delta is not one encode() wrote
+    static bool decode(const juce::MemoryBlock& delta, std::vector<CollabOp>& ops);
+
+    // Clip ids for a state the room starts from, the same on every peer
+    static void assignInitialClipIds(CollabSnapshot& snapshot);
+
+    // Everything diff() compares, ids left out
+    static std::uint64_t hashSnapshot(const CollabSnapshot& snapshot);
+
+    // Two sessions on one FakeCollabBackend trading edits both ways, checked
+    // for Lamport order and for ending up with the same project. Returns what
+    // failed, nothing if all passed. Used by `MULO --test-collab`
+    static std::vector<std::string> runSelfTest();
+
+private:
+    struct Stamp {
+        std::uint64_t lamport = 0;
+        std::uint64_t site = 0;
+    };
+
+    // Brings the agreed state up to date with an op that has been applied
+    static void applyToSnapshot(CollabSnapshot& snapshot, const CollabOp& op);
+    // The agreed state taken afresh from the project, as after a load
+    void resetAgreedState();
+
+    std::shared_ptr<CollabBackend> backend;
+    Callbacks callbacks;
+    std::string room;
+    std::uint64_t site = 0;
+    std::uint64_t lamport = 0;
+    std::uint64_t nextClipNumber = 1;
+    std::size_t readPosition = 0;
+    bool active = false;
+
+    CollabSnapshot agreed; // what every peer has seen, as far as this one knows
+    std::unordered_map<std::string, Stamp> versions; // last write per object
+    Stamp stateVersion;    // last whole-document replacement
+};
@@ -28,6 +28,15 @@ struct UIState {
     float uiScale = 1.f;
     double sampleRate = 44100.0;
     int autoSaveIntervalSeconds = 300;
+    int renderThreads = -1;
+    bool realtimeRenderThreads = true;
+    double clipStreamingThresholdSeconds = 60.0;
+    int samplePoolBudgetMB = 1024;
+    std::string resamplerQuality = "normal";
+    int exportBitDepth = 24; // 16, 24 or 32 (float)
+    bool exportStems = false; // one file per track next to the master
+    double pluginSleepSeconds = 1.0; // silence before an idle plugin sleeps, 0 never
+    bool pluginsOutOfProcess = false; // host each plugin in its own process
     bool settingsShown = false;
     bool marketplaceShown = false;
     bool enableAutoVSTScan = false;
@@ -39,6 +48,14 @@ struct UIState {
         DEBUG_PRINT("          [UI Theme] " << selectedTheme);
         DEBUG_PRINT("       [Sample Rate] " << sampleRate);
         DEBUG_PRINT("[Auto Save Interval] " << autoSaveIntervalSeconds);
+        DEBUG_PRINT("    [Render Threads] " << renderThreads);
+        DEBUG_PRINT("  [Stream Clips Over] " << clipStreamingThresholdSeconds << "s");
+        DEBUG_PRINT("  [Sample Pool Budget] " << samplePoolBudgetMB << " MB");
+        DEBUG_PRINT(" [Resampler Quality] " << resamplerQuality);
+        DEBUG_PRINT("  [Export Bit Depth] " << exportBitDepth);
+        DEBUG_PRINT("      [Export Stems] " << (exportStems ? "yes" : "no"));
+        DEBUG_PRINT("  [Plugin Sleep After] " << pluginSleepSeconds << "s");
+        DEBUG_PRINT("[Plugins Out Of Proc] " << (pluginsOutOfProcess ? "yes" : "no"));
     }
 
     inline std::string getExecutableDirectory() {
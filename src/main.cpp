@@ -1,9 +1,82 @@
 #include "frontend/Application.hpp"
+#include "frontend/CollabSession.hpp"
 #include "audio/Effect.hpp"
+#include "audio/PluginHost.hpp"
+#include "audio/ProjectFile.hpp"
+#include "audio/Resampler.hpp"
 #include "DebugConfig.hpp"
 #include <juce_events/juce_events.h>
 
-int main() {
+#include <cstdio>
+#include <cstring>
+
+namespace {
+    int runResamplerBenchmark() {
+        const std::pair<double, double> conversions[] = { { 96000.0, 44100.0 }, { 44100.0, 48000.0 } };
+        for (const auto& [sourceRate, targetRate] : conversions) {
+            std::printf("Resampling %.0f Hz -> %.0f Hz\n", sourceRate, targetRate);
+            for (const auto& result : Resampler::runBenchmark(sourceRate, targetRate)) {
+                std::printf("  %-7s %10.2f Msamples/s  %8.1fx realtime\n",
+                            Resampler::getQualityName(result.quality).c_str(),
+                            result.outputSamplesPerSecond / 1.0e6,
+                            result.realtimeFactor);
+            }
+        }
+        return 0;
+    }
+
+    int runEffectBenchmark() {
+        std::printf("Effect::processAudio overhead on a pass-through plugin\n");
+        for (const auto& result : Effect::runBenchmark()) {
+            std::printf("  %-15s %4d samples  plugin %8.1f ns  effect %8.1f ns  overhead %8.1f ns/block  %llu allocations\n",
+                        result.layout.c_str(), result.blockSize,
+                        result.pluginNanosPerBlock, result.effectNanosPerBlock,
+                        result.effectNanosPerBlock - result.pluginNanosPerBlock,
+                        static_cast<unsigned long long>(result.allocations));
+        }
+        return 0;
+    }
+
+    int runProjectBenchmark() {
+        std::printf("Saving and loading a generated project\n");
+        for (const auto& result : ProjectFile::runBenchmark()) {
+            std::printf("  %-14s save %9.1f ms  load %9.1f ms  %8.2f MB\n",
+                        result.format.c_str(), result.saveMs, result.loadMs,
+                        static_cast<double>(result.fileBytes) / (1024.0 * 1024.0));
+        }
+        return 0;
+    }
+
+    int runCollabSelfTest() {
+        const auto failures = CollabSession::runSelfTest();
+        for (const auto& failure : failures) {
+            std::printf("FAILED: %s\n", failure.c_str());
+        }
+        std::printf("Collaboration self-test: %s\n", failures.empty() ? "passed" : "failed");
+        return failures.empty() ? 0 : 1;
+    }
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--benchmark-resampler") == 0) {
+            return runResamplerBenchmark();
+        }
+        if (std::strcmp(argv[i], "--benchmark-effect") == 0) {
+            return runEffectBenchmark();
+        }
+        if (std::strcmp(argv[i], "--benchmark-project") == 0) {
+            return runProjectBenchmark();
+        }
+        if (std::strcmp(argv[i], "--test-collab") == 0) {
+            return runCollabSelfTest();
+        }
+        // Started by RemotePluginInstance; hosts one plugin and never opens the UI
+        if (std::strcmp(argv[i], "--plugin-host") == 0 && i + 1 < argc) {
+            return PluginHost::run(juce::String::fromUTF8(argv[i + 1]));
+        }
+    }
+
     juce::MessageManager::getInstance();
     
     Application app;